@@ -55,6 +55,59 @@ namespace itl2
 		Gets description of the analysis this analyzer does.
 		*/
 		virtual std::string description() const = 0;
+
+		/**
+		Tests if this analyzer can be evaluated from a fixed-size accumulator state that is updated one point at a time,
+		without access to the full point list of the particle.
+		Analyzers that return true must implement stateSize, init, add, merge and finalize.
+		*/
+		virtual bool supportsAccumulation() const
+		{
+			return false;
+		}
+
+		/**
+		Gets count of elements in the accumulator state of this analyzer.
+		*/
+		virtual size_t stateSize() const
+		{
+			return 0;
+		}
+
+		/**
+		Initializes accumulator state that does not contain any points.
+		@param state Pointer to stateSize() elements.
+		*/
+		virtual void init(double* state) const
+		{
+		}
+
+		/**
+		Adds a point to the accumulator state.
+		*/
+		virtual void add(double* state, const POINT& p) const
+		{
+			throw ITLException(string("Analyzer ") + name() + " does not support accumulation.");
+		}
+
+		/**
+		Merges accumulator state of a disjoint set of points to another state.
+		@param state The state that is updated.
+		@param other The state that is merged into state.
+		*/
+		virtual void merge(double* state, const double* other) const
+		{
+			throw ITLException(string("Analyzer ") + name() + " does not support accumulation.");
+		}
+
+		/**
+		Calculates the analysis results from the accumulator state.
+		The results must equal to those returned by analyze for the same points.
+		*/
+		virtual std::vector<double> finalize(const double* state) const
+		{
+			throw ITLException(string("Analyzer ") + name() + " does not support accumulation.");
+		}
 	};
 
 
@@ -121,6 +174,100 @@ namespace itl2
 					resultLine.push_back(currentResults[m]);
 			}
 		}
+
+		/**
+		Tests if all the analyzers in this set support accumulation of points one at a time.
+		If they do, particles can be analyzed without storing their point lists using the init, add, merge and finalize methods.
+		*/
+		bool supportsAccumulation() const
+		{
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				if (!(*this)[n]->supportsAccumulation())
+					return false;
+			}
+			return true;
+		}
+
+		/**
+		Initializes accumulator state for all the analyzers in this set.
+		The first element of the state is the count of points added to it, and it is followed by the states of the individual analyzers.
+		*/
+		void init(std::vector<double>& state) const
+		{
+			size_t s = 1;
+			for (size_t n = 0; n < this->size(); n++)
+				s += (*this)[n]->stateSize();
+
+			state.resize(s);
+			state[0] = 0;
+
+			double* p = &state[1];
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				(*this)[n]->init(p);
+				p += (*this)[n]->stateSize();
+			}
+		}
+
+		/**
+		Adds a point to accumulator state created by init.
+		*/
+		void add(std::vector<double>& state, const POINT& point) const
+		{
+			state[0]++;
+
+			double* p = &state[1];
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				(*this)[n]->add(p, point);
+				p += (*this)[n]->stateSize();
+			}
+		}
+
+		/**
+		Merges accumulator state of a disjoint point set to another state.
+		*/
+		void merge(std::vector<double>& state, const std::vector<double>& other) const
+		{
+			state[0] += other[0];
+
+			double* p = &state[1];
+			const double* q = &other[1];
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				(*this)[n]->merge(p, q);
+				p += (*this)[n]->stateSize();
+				q += (*this)[n]->stateSize();
+			}
+		}
+
+		/**
+		Gets count of points added to an accumulator state.
+		*/
+		static size_t pointCount(const std::vector<double>& state)
+		{
+			return (size_t)state[0];
+		}
+
+		/**
+		Calculates analysis results from accumulator state.
+		@param state Accumulator state.
+		@param resultLine Results will be added to this array.
+		*/
+		void finalize(const std::vector<double>& state, std::vector<double>& resultLine) const
+		{
+			if (pointCount(state) <= 0)
+				throw ITLException("Particle analyzer received no input points.");
+
+			const double* p = &state[1];
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				std::vector<double> currentResults = (*this)[n]->finalize(p);
+				resultLine.insert(resultLine.end(), currentResults.begin(), currentResults.end());
+				p += (*this)[n]->stateSize();
+			}
+		}
 	};
 
 
@@ -205,6 +352,24 @@ namespace itl2
 				value = newValue;
 			}
 
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return analyze(std::vector<POINT>());
+			}
+
 			virtual std::string name() const override
 			{
 				return "Value";
@@ -246,6 +411,56 @@ namespace itl2
 				return results;
 			}
 
+			/**
+			Replaces the point (x, y, z) stored in state by (px, py, pz) if the latter is smaller in the order defined by vecComparer.
+			*/
+			static void keepMinimum(double* state, double px, double py, double pz)
+			{
+				if (pz < state[2] || (pz == state[2] && (py < state[1] || (py == state[1] && px < state[0]))))
+				{
+					state[0] = px;
+					state[1] = py;
+					state[2] = pz;
+				}
+			}
+
+			static void initMinimum(double* state)
+			{
+				state[0] = std::numeric_limits<double>::infinity();
+				state[1] = std::numeric_limits<double>::infinity();
+				state[2] = std::numeric_limits<double>::infinity();
+			}
+
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 3;
+			}
+
+			virtual void init(double* state) const override
+			{
+				initMinimum(state);
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				keepMinimum(state, (double)p[0], (double)p[1], (double)p[2]);
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				keepMinimum(state, other[0], other[1], other[2]);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return { state[0], state[1], state[2] };
+			}
+
 			virtual std::string name() const override
 			{
 				return "coordinates";
@@ -286,6 +501,36 @@ namespace itl2
 				return results;
 			}
 
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 3;
+			}
+
+			virtual void init(double* state) const override
+			{
+				Coordinates3D<POINT, pixel_t>::initMinimum(state);
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				Coordinates3D<POINT, pixel_t>::keepMinimum(state, (double)p[0], (double)p[1], (double)p[2]);
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				Coordinates3D<POINT, pixel_t>::keepMinimum(state, other[0], other[1], other[2]);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return { state[0], state[1] };
+			}
+
 			virtual std::string name() const override
 			{
 				return "coordinates2d";
@@ -317,6 +562,36 @@ namespace itl2
 				return results;
 			}
 
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 1;
+			}
+
+			virtual void init(double* state) const override
+			{
+				state[0] = 0;
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				state[0]++;
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				state[0] += other[0];
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return { state[0] };
+			}
+
 			virtual std::string name() const override
 			{
 				return "volume";
@@ -539,6 +814,40 @@ namespace itl2
 				return results;
 			}
 
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 1;
+			}
+
+			virtual void init(double* state) const override
+			{
+				state[0] = 0.0;
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				for (size_t dimension = 0; dimension < p.size(); dimension++)
+				{
+					if (p[dimension] <= 0 || p[dimension] >= dimensions[dimension] - 1)
+						state[0] = 1.0;
+				}
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				state[0] = std::max(state[0], other[0]);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return { state[0] };
+			}
+
 			virtual std::string name() const override
 			{
 				return "isonedge";
@@ -551,31 +860,81 @@ namespace itl2
 		};
 
 		/**
-		Calculates principal components.
+		Calculates centroid and principal components from running sums of point coordinates.
 		*/
-		template<class POINT, typename pixel_t> class PCA3D : public Analyzer<POINT, pixel_t>
+		template<class POINT, typename pixel_t> class Moments3D : public Analyzer<POINT, pixel_t>
 		{
+		private:
+			/*
+			The accumulator state is
+			[count, reference point (3), sum of (p - reference) (3), sum of (p - reference)(p - reference)^T (xx, xy, xz, yy, yz, zz)].
+			The reference point is the minimum of the points in the order defined by vecComparer.
+			This keeps the sums small, and as long as they can be represented exactly, the state does not depend
+			on the order in which the points are added or merged.
+			*/
+			static constexpr size_t N = 0;
+			static constexpr size_t R = 1;
+			static constexpr size_t S1 = 4;
+			static constexpr size_t S2 = 7;
+
+			/**
+			Changes reference point of the state.
+			*/
+			static void shift(double* state, const double* newRef)
+			{
+				double n = state[N];
+				double d[] = { state[R] - newRef[0], state[R + 1] - newRef[1], state[R + 2] - newRef[2] };
+				double* s = &state[S1];
+				double* S = &state[S2];
+
+				size_t k = 0;
+				for (size_t i = 0; i < 3; i++)
+				{
+					for (size_t j = i; j < 3; j++)
+					{
+						S[k] += d[i] * s[j] + s[i] * d[j] + n * d[i] * d[j];
+						k++;
+					}
+				}
+
+				for (size_t i = 0; i < 3; i++)
+				{
+					s[i] += n * d[i];
+					state[R + i] = newRef[i];
+				}
+			}
+
+			static bool isLess(const double* a, const double* b)
+			{
+				if (a[2] != b[2])
+					return a[2] < b[2];
+				if (a[1] != b[1])
+					return a[1] < b[1];
+				return a[0] < b[0];
+			}
+
+		public:
 			virtual std::string name() const override
 			{
-				return "pca";
+				return "moments";
 			}
 
 			virtual std::string description() const override
 			{
-				return "Calculates orientation of the particle using principal component analysis. Outputs:\n"
-					"Centroid of the particle in columns 'CX', 'CY', and 'CZ'.\n"
-					"Meridional eccentricity in column 'e (meridional)'.\n"
-					"Standard deviations of the projections of the particle points to the principal axes in columns 'l1', 'l2', and 'l3'.\n"
-					"Orientations of the three principal axes of the particle, in spherical coordinates, in columns\n"
-					"'phiN' and 'thetaN', where N is in 1...3, phiN is the azimuthal angle and thetaN is the polar angle.\n"
-					"Maximum distance from the centroid to the edge of the particle in colum 'rmax'.\n"
-					"Maximum diameter of the projection of the particle on each principal component in columns 'd1', 'd2', and 'd3'.\n"
-					"Scaling factor for a bounding ellipsoid in column 'bounding scale'. An ellipsoid that bounds the\n"
-					"particle and whose semi-axes correspond to the principal components has semi-axis lengths\n"
-					"$b lN$, where $b$ is the bounding scale and $lN$ are the lengths of the principal axes.";
+				return "Calculates centroid, eccentricity and orientation of the particle using principal component analysis. "
+					"The output columns are the same than the first columns of the 'pca' analyzer, i.e. 'CX', 'CY', 'CZ', 'e (meridional)', 'l1', 'l2', 'l3', and 'phiN' and 'thetaN', where N is in 1...3. "
+					"Unlike 'pca', this analyzer does not need to store the points of the particle, and it is therefore suitable for images containing very large particles.";
 			}
 
 			virtual std::vector<string> getTitles() const override
+			{
+				return principalComponentTitles();
+			}
+
+			/**
+			Gets titles of the values added to results by principalComponents.
+			*/
+			static std::vector<string> principalComponentTitles()
 			{
 				std::vector<string> titles;
 				titles.push_back("CX [pixel]");
@@ -591,30 +950,16 @@ namespace itl2
 				titles.push_back("theta2 [rad]");
 				titles.push_back("phi3 [rad]");
 				titles.push_back("theta3 [rad]");
-				titles.push_back("rmax [pixel]");	// Overall maximum radius from center point
-				titles.push_back("d1 [pixel]");     // Maximum diameter in direction of first principal component.
-				titles.push_back("d2 [pixel]");     // Maximum diameter in direction of second principal component.
-				titles.push_back("d3 [pixel]");     // Maximum diameter in direction of third principal component.
-				titles.push_back("bounding scale [1]");
 				return titles;
 			}
 
-			virtual std::vector<double> analyze(const std::vector<POINT>& points) const override
+			/**
+			Calculates eccentricity, principal axis lengths and orientations of the principal axes from centroid and covariance matrix of particle points.
+			Adds the centroid and the calculated values to the results array.
+			@param t1, t2, t3 Directions of the principal axes are stored to these vectors.
+			*/
+			static void principalComponents(const Vec3d& centroid, const Matrix3x3d& CI, std::vector<double>& results, Vec3d& t1, Vec3d& t2, Vec3d& t3)
 			{
-				std::vector<double> results;
-
-
-				Vec3d centroid = mean<POINT, Vec3d, double>(points);
-
-				Matrix3x3d CI;
-				for (const auto& p : points)
-				{
-					Vec3d d = Vec3d(p) - centroid;
-					CI += Matrix3x3d::outer(d, d);
-				}
-				CI /= (double)points.size();
-
-				Vec3d t1, t2, t3;
 				double lambda1, lambda2, lambda3;
 				CI.eigsym(t1, t2, t3, lambda1, lambda2, lambda3);
 
@@ -656,6 +1001,168 @@ namespace itl2
 				
 				results.push_back(phi3);
 				results.push_back(theta3);
+			}
+
+			virtual std::vector<double> analyze(const std::vector<POINT>& points) const override
+			{
+				double state[13];
+				init(state);
+				for (const auto& p : points)
+					add(state, p);
+				return finalize(state);
+			}
+
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 13;
+			}
+
+			virtual void init(double* state) const override
+			{
+				std::fill(state, state + 13, 0.0);
+			}
+
+			virtual void add(double* state, const POINT& point) const override
+			{
+				double p[] = { (double)point.x, (double)point.y, (double)point.z };
+
+				if (state[N] <= 0)
+				{
+					for (size_t i = 0; i < 3; i++)
+						state[R + i] = p[i];
+				}
+				else if (isLess(p, &state[R]))
+				{
+					shift(state, p);
+				}
+
+				double d[] = { p[0] - state[R], p[1] - state[R + 1], p[2] - state[R + 2] };
+
+				state[N]++;
+				size_t k = 0;
+				for (size_t i = 0; i < 3; i++)
+				{
+					state[S1 + i] += d[i];
+					for (size_t j = i; j < 3; j++)
+					{
+						state[S2 + k] += d[i] * d[j];
+						k++;
+					}
+				}
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				if (other[N] <= 0)
+					return;
+
+				if (state[N] <= 0)
+				{
+					std::copy(other, other + 13, state);
+					return;
+				}
+
+				double tmp[13];
+				std::copy(other, other + 13, tmp);
+
+				if (isLess(&tmp[R], &state[R]))
+					shift(state, &tmp[R]);
+				else
+					shift(tmp, &state[R]);
+
+				state[N] += tmp[N];
+				for (size_t i = S1; i < 13; i++)
+					state[i] += tmp[i];
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				double n = state[N];
+				Vec3d m(state[S1] / n, state[S1 + 1] / n, state[S1 + 2] / n);
+				Vec3d centroid = Vec3d(state[R], state[R + 1], state[R + 2]) + m;
+
+				const double* S = &state[S2];
+				Matrix3x3d CI(S[0], S[1], S[2],
+								S[1], S[3], S[4],
+								S[2], S[4], S[5]);
+				CI /= n;
+				CI -= Matrix3x3d::outer(m, m);
+
+				std::vector<double> results;
+				Vec3d t1, t2, t3;
+				principalComponents(centroid, CI, results, t1, t2, t3);
+				return results;
+			}
+		};
+
+		/**
+		Calculates principal components.
+		*/
+		template<class POINT, typename pixel_t> class PCA3D : public Analyzer<POINT, pixel_t>
+		{
+			virtual std::string name() const override
+			{
+				return "pca";
+			}
+
+			virtual std::string description() const override
+			{
+				return "Calculates orientation of the particle using principal component analysis. Outputs:\n"
+					"Centroid of the particle in columns 'CX', 'CY', and 'CZ'.\n"
+					"Meridional eccentricity in column 'e (meridional)'.\n"
+					"Standard deviations of the projections of the particle points to the principal axes in columns 'l1', 'l2', and 'l3'.\n"
+					"Orientations of the three principal axes of the particle, in spherical coordinates, in columns\n"
+					"'phiN' and 'thetaN', where N is in 1...3, phiN is the azimuthal angle and thetaN is the polar angle.\n"
+					"Maximum distance from the centroid to the edge of the particle in colum 'rmax'.\n"
+					"Maximum diameter of the projection of the particle on each principal component in columns 'd1', 'd2', and 'd3'.\n"
+					"Scaling factor for a bounding ellipsoid in column 'bounding scale'. An ellipsoid that bounds the\n"
+					"particle and whose semi-axes correspond to the principal components has semi-axis lengths\n"
+					"$b lN$, where $b$ is the bounding scale and $lN$ are the lengths of the principal axes.";
+			}
+
+			virtual std::vector<string> getTitles() const override
+			{
+				std::vector<string> titles = Moments3D<POINT, pixel_t>::principalComponentTitles();
+				titles.push_back("rmax [pixel]");	// Overall maximum radius from center point
+				titles.push_back("d1 [pixel]");     // Maximum diameter in direction of first principal component.
+				titles.push_back("d2 [pixel]");     // Maximum diameter in direction of second principal component.
+				titles.push_back("d3 [pixel]");     // Maximum diameter in direction of third principal component.
+				titles.push_back("bounding scale [1]");
+				return titles;
+			}
+
+			virtual std::vector<double> analyze(const std::vector<POINT>& points) const override
+			{
+				std::vector<double> results;
+
+
+				Vec3d centroid = mean<POINT, Vec3d, double>(points);
+
+				Matrix3x3d CI;
+				for (const auto& p : points)
+				{
+					Vec3d d = Vec3d(p) - centroid;
+					CI += Matrix3x3d::outer(d, d);
+				}
+				CI /= (double)points.size();
+
+				Vec3d t1, t2, t3;
+				Moments3D<POINT, pixel_t>::principalComponents(centroid, CI, results, t1, t2, t3);
+
+				double l1 = results[4];
+				double l2 = results[5];
+				double l3 = results[6];
+				double phi1 = results[7];
+				double theta1 = results[8];
+				double phi2 = results[9];
+				double theta2 = results[10];
+				double phi3 = results[11];
+				double theta3 = results[12];
 
 
 				// Calculate maximum radius, projections to principal axes, etc.
@@ -976,6 +1483,62 @@ namespace itl2
 				return results;
 			}
 
+			/**
+			Initializes accumulator state that stores (min, max) pairs for the given count of dimensions.
+			*/
+			static void initBounds(double* state, size_t dimensions)
+			{
+				for (size_t n = 0; n < dimensions; n++)
+				{
+					state[2 * n] = std::numeric_limits<double>::infinity();
+					state[2 * n + 1] = -std::numeric_limits<double>::infinity();
+				}
+			}
+
+			/**
+			Updates (min, max) pairs in the accumulator state.
+			@param other (min, max) pairs of another state.
+			*/
+			static void mergeBounds(double* state, const double* other, size_t dimensions)
+			{
+				for (size_t n = 0; n < dimensions; n++)
+				{
+					state[2 * n] = std::min(state[2 * n], other[2 * n]);
+					state[2 * n + 1] = std::max(state[2 * n + 1], other[2 * n + 1]);
+				}
+			}
+
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 6;
+			}
+
+			virtual void init(double* state) const override
+			{
+				initBounds(state, 3);
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				double bounds[] = { (double)p.x, (double)p.x, (double)p.y, (double)p.y, (double)p.z, (double)p.z };
+				mergeBounds(state, bounds, 3);
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				mergeBounds(state, other, 3);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return std::vector<double>(state, state + 6);
+			}
+
 			virtual std::string name() const override
 			{
 				return "bounds";
@@ -1032,6 +1595,37 @@ namespace itl2
 				return results;
 			}
 
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			virtual size_t stateSize() const override
+			{
+				return 4;
+			}
+
+			virtual void init(double* state) const override
+			{
+				BoundingBox3D<POINT, pixel_t>::initBounds(state, 2);
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				double bounds[] = { (double)p.x, (double)p.x, (double)p.y, (double)p.y };
+				BoundingBox3D<POINT, pixel_t>::mergeBounds(state, bounds, 2);
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				BoundingBox3D<POINT, pixel_t>::mergeBounds(state, other, 2);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return std::vector<double>(state, state + 4);
+			}
+
 			virtual std::string name() const override
 			{
 				return "bounds2d";
@@ -1085,6 +1679,95 @@ namespace itl2
 				return "Shows position and radius of the smallest possible sphere that contains all the points in the particle. Outputs columns 'bounding sphere X', 'bounding sphere Y', 'bounding sphere Z', and 'bounding sphere radius'. Uses the MiniBall algorithm from Welzl, E. - Smallest enclosing disks (balls and ellipsoids).";
 			}
 		};
+
+		/**
+		Calculates mean, minimum and maximum of pixel values of another image in the points of the particle.
+		*/
+		template<class POINT, typename pixel_t, typename intensity_t = pixel_t> class Intensity : public Analyzer<POINT, pixel_t>
+		{
+		private:
+			const Image<intensity_t>& intensity;
+
+		public:
+			/**
+			Constructor
+			@param intensity The image whose values are measured. The image must not be deleted before this analyzer.
+			*/
+			Intensity(const Image<intensity_t>& intensity) : intensity(intensity)
+			{
+			}
+
+			virtual std::vector<std::string> getTitles() const override
+			{
+				std::vector<std::string> labels;
+				labels.push_back("mean intensity");
+				labels.push_back("min intensity");
+				labels.push_back("max intensity");
+				return labels;
+			}
+
+			virtual std::vector<double> analyze(const std::vector<POINT>& points) const override
+			{
+				double state[4];
+				init(state);
+				for (const auto& p : points)
+					add(state, p);
+				return finalize(state);
+			}
+
+			virtual bool supportsAccumulation() const override
+			{
+				return true;
+			}
+
+			/*
+			The accumulator state is [count, sum, min, max].
+			*/
+			virtual size_t stateSize() const override
+			{
+				return 4;
+			}
+
+			virtual void init(double* state) const override
+			{
+				state[0] = 0;
+				state[1] = 0;
+				state[2] = std::numeric_limits<double>::infinity();
+				state[3] = -std::numeric_limits<double>::infinity();
+			}
+
+			virtual void add(double* state, const POINT& p) const override
+			{
+				double v = (double)intensity(p);
+				state[0]++;
+				state[1] += v;
+				state[2] = std::min(state[2], v);
+				state[3] = std::max(state[3], v);
+			}
+
+			virtual void merge(double* state, const double* other) const override
+			{
+				state[0] += other[0];
+				state[1] += other[1];
+				state[2] = std::min(state[2], other[2]);
+				state[3] = std::max(state[3], other[3]);
+			}
+
+			virtual std::vector<double> finalize(const double* state) const override
+			{
+				return { state[1] / state[0], state[2], state[3] };
+			}
+
+			virtual std::string name() const override
+			{
+				return "intensity";
+			}
+
+			virtual std::string description() const override
+			{
+				return "Calculates mean, minimum and maximum pixel value of a separate intensity image in the pixels of the particle. Outputs columns 'mean intensity', 'min intensity' and 'max intensity'.";
+			}
+		};
 	}
 
 	/**
@@ -1097,6 +1780,7 @@ namespace itl2
 		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::IsOnEdge<Vec3sc, pixel_t>(dimensions)));
 		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::Volume<Vec3sc, pixel_t>()));
 		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::PCA3D<Vec3sc, pixel_t>()));
+		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::Moments3D<Vec3sc, pixel_t>()));
 		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::SurfaceArea3D<Vec3sc, pixel_t>()));
 		//analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::Color<Vec3sc, pixel_t>()));
 		analyzers.push_back(std::shared_ptr<Analyzer<Vec3sc, pixel_t> >(new analyzers::BoundingBox3D<Vec3sc, pixel_t>()));
@@ -2,6 +2,9 @@
 #include "autothreshold.h"
 #include "pointprocess.h"
 #include "io/raw.h"
+#include "noise.h"
+#include "generation.h"
+#include "timer.h"
 
 #include <iostream>
 #include <cmath>
@@ -708,7 +711,7 @@ namespace itl2
 				for (coord_t i = 0; i < data.pixelCount(); i++)
 					avec(i) = 0.0;
 
-				double total = partialSum(data, data.pixelCount());
+				double total = partialSum(data, data.pixelCount() - 1);
 				double temp = 1.0;
 				coord_t threshold = 0;
 				for (coord_t i = 0; i < data.pixelCount(); i++) {
@@ -1170,5 +1173,165 @@ namespace itl2
 
 			raw::writed(out, "./autothreshold/local_otsu");
 		}
+
+		/**
+		Creates smooth uint16 and noisy float32 test images of given size, and calls
+		f(img, imgf, method, bc) for each given thresholding method and boundary condition.
+		*/
+		template<typename F> void forLocalThresholdCases(const Vec3c& dimensions, std::initializer_list<AutoThresholdMethod> methods, F f)
+		{
+			Image<uint16_t> tmp(dimensions);
+			noise(tmp, 1000, 300, 11);
+			Image<uint16_t> img;
+			gaussFilter(tmp, img, 1.5);
+
+			Image<float32_t> imgf(img.dimensions());
+			noise(imgf, 1.0, 0.3, 13);
+
+			for (AutoThresholdMethod method : methods)
+			{
+				for (BoundaryCondition bc : { BoundaryCondition::Nearest, BoundaryCondition::Zero })
+					f(img, imgf, method, bc);
+			}
+		}
+
+		/**
+		Calculates local threshold with the direct algorithm, to be used as the reference result.
+		*/
+		template<typename pixel_t> void directLocalThreshold(const Image<pixel_t>& img, Image<pixel_t>& out, const Vec3c& r, const internals::LocalThresholdSettings& settings, BoundaryCondition bc)
+		{
+			filter<pixel_t, pixel_t, const internals::LocalThresholdSettings&, internals::localThresholdProcessNeighbourhood<pixel_t>>(img, out, r, settings, NeighbourhoodType::Rectangular, bc);
+		}
+
+		void localThresholdMethods()
+		{
+			// Methods that are not histogram-based must give the same results as the direct algorithm.
+			forLocalThresholdCases(Vec3c(60, 50, 40), { AutoThresholdMethod::Mean, AutoThresholdMethod::Niblack, AutoThresholdMethod::Phansalkar,
+				AutoThresholdMethod::Sauvola, AutoThresholdMethod::MidGrey, AutoThresholdMethod::Bernsen },
+				[](const Image<uint16_t>& img, const Image<float32_t>& imgf, AutoThresholdMethod method, BoundaryCondition bc)
+				{
+					// Arguments are selected so that the thresholds fall somewhere in the range of pixel values.
+					double arg0 = std::numeric_limits<double>::quiet_NaN();
+					double arg1 = std::numeric_limits<double>::quiet_NaN();
+					if (method == AutoThresholdMethod::Sauvola)
+					{
+						arg0 = 0.5;
+						arg1 = 300;
+					}
+					else if (method == AutoThresholdMethod::Phansalkar)
+					{
+						arg1 = 300;
+					}
+
+					Vec3c r(4, 3, 2);
+					internals::LocalThresholdSettings settings = { method, arg0, arg1, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN() };
+
+					Image<uint16_t> expected, result;
+					directLocalThreshold(img, expected, r, settings, bc);
+					itl2::localThreshold(img, result, r, method, arg0, arg1, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN(), bc);
+
+					// Pixels whose value is practically equal to the threshold may differ due to rounding.
+					size_t diff = 0;
+					for (coord_t n = 0; n < img.pixelCount(); n++)
+					{
+						if (expected(n) != result(n))
+							diff++;
+					}
+					testAssert(diff <= (size_t)(0.001 * img.pixelCount()), string("local threshold, ") + toString(method) + ", " + toString(bc));
+
+					Image<float32_t> expectedf, resultf;
+					settings.arg1 = method == AutoThresholdMethod::Sauvola || method == AutoThresholdMethod::Phansalkar ? 0.3 : arg1;
+					directLocalThreshold(imgf, expectedf, r, settings, bc);
+					itl2::localThreshold(imgf, resultf, r, method, settings.arg0, settings.arg1, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN(), bc);
+					testAssert(equals(expectedf, resultf), string("local threshold for float32 image, ") + toString(method) + ", " + toString(bc));
+				});
+		}
+
+		void localThresholdHistogram()
+		{
+			// Intermodes and Minimum are not tested as the small neighbourhood histograms do not smooth into bimodal shape.
+			// The 2D case checks that the radius is not used in the unused z-dimension.
+			for (const Vec3c& dimensions : { Vec3c(45, 40, 30), Vec3c(45, 40, 1) })
+			{
+				forLocalThresholdCases(dimensions, { AutoThresholdMethod::Otsu, AutoThresholdMethod::Huang,
+					AutoThresholdMethod::IsoData, AutoThresholdMethod::Li, AutoThresholdMethod::MaxEntropy, AutoThresholdMethod::MinError,
+					AutoThresholdMethod::Moments, AutoThresholdMethod::RenyiEntropy, AutoThresholdMethod::Shanbhag,
+					AutoThresholdMethod::Triangle, AutoThresholdMethod::Yen, AutoThresholdMethod::Median, AutoThresholdMethod::Percentile },
+					[](const Image<uint16_t>& img, const Image<float32_t>& imgf, AutoThresholdMethod method, BoundaryCondition bc)
+					{
+						Vec3c r(4, 3, 2);
+						string desc = toString(method) + ", " + toString(bc) + ", " + toString(img.dimensions());
+
+						// Sliding histogram must give the same result as the direct algorithm.
+						internals::LocalThresholdSettings settings = { method, 0, 2000, 200, std::numeric_limits<double>::quiet_NaN() };
+						Image<uint16_t> expected, result;
+						directLocalThreshold(img, expected, r, settings, bc);
+						itl2::localThreshold(img, result, r, method, settings.arg0, settings.arg1, settings.arg2, settings.arg3, bc);
+						testAssert(equals(expected, result), string("sliding histogram local threshold, ") + desc);
+
+						settings = { method, 0, 2, 100, std::numeric_limits<double>::quiet_NaN() };
+						Image<float32_t> expectedf, resultf;
+						directLocalThreshold(imgf, expectedf, r, settings, bc);
+						itl2::localThreshold(imgf, resultf, r, method, settings.arg0, settings.arg1, settings.arg2, settings.arg3, bc);
+						testAssert(equals(expectedf, resultf), string("sliding histogram local threshold for float32 image, ") + desc);
+
+						// With threshold grid, pixels at the grid points must equal to the direct result.
+						Vec3c spacing(3, 5, 4);
+						itl2::localThreshold(imgf, resultf, r, method, settings.arg0, settings.arg1, settings.arg2, settings.arg3, bc, spacing);
+						bool ok = true;
+						for (coord_t z = 0; z < imgf.depth(); z++)
+						{
+							for (coord_t y = 0; y < imgf.height(); y++)
+							{
+								for (coord_t x = 0; x < imgf.width(); x++)
+								{
+									bool isGridPoint = (x % spacing.x == 0 || x == imgf.width() - 1)
+										&& (y % spacing.y == 0 || y == imgf.height() - 1)
+										&& (z % spacing.z == 0 || z == imgf.depth() - 1);
+									if (isGridPoint && expectedf(x, y, z) != resultf(x, y, z))
+										ok = false;
+								}
+							}
+						}
+						testAssert(ok, string("local threshold at grid points, ") + desc);
+					});
+			}
+
+			// Failure to determine the threshold is reported as an exception.
+			forLocalThresholdCases(Vec3c(45, 40, 30), { AutoThresholdMethod::Intermodes },
+				[](const Image<uint16_t>& img, const Image<float32_t>& imgf, AutoThresholdMethod method, BoundaryCondition bc)
+				{
+					try
+					{
+						Image<uint16_t> result;
+						itl2::localThreshold(img, result, Vec3c(4, 3, 2), method, 0, 2000, 200, std::numeric_limits<double>::quiet_NaN(), bc);
+						testAssert(false, string("intermodes should not find bimodal histogram, ") + toString(bc));
+					}
+					catch (const ITLException&)
+					{
+					}
+				});
+		}
+
+		void localThresholdHistogramSpeed()
+		{
+			Image<uint16_t> tmp(200, 200, 200);
+			noise(tmp, 1000, 300, 11);
+			Image<uint16_t> img;
+			gaussFilter(tmp, img, 1.5);
+
+			Image<uint16_t> out;
+			Timer timer;
+			for (coord_t r : { 5, 15 })
+			{
+				for (coord_t spacing : { 1, 4, 8 })
+				{
+					timer.start();
+					itl2::localThreshold(img, out, Vec3c(r, r, r), AutoThresholdMethod::Otsu, 0, 2000, 256, std::numeric_limits<double>::quiet_NaN(), BoundaryCondition::Nearest, Vec3c(spacing, spacing, spacing));
+					timer.stop();
+					cout << "Sliding histogram local Otsu threshold, r = " << r << ", grid spacing = " << spacing << " took " << timer.getTime() << " ms." << endl;
+				}
+			}
+		}
 	}
 }
\ No newline at end of file
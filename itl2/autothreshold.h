@@ -7,8 +7,10 @@
 #include "median.h"
 #include "neighbourhood.h"
 #include "filters.h"
+#include "boxfilters.h"
 
 #include <algorithm>
+#include <exception>
 
 namespace itl2
 {
@@ -681,20 +683,11 @@ namespace itl2
 		}
 
 		/**
-		Calculates threshold value for given image/neighbourhood automatically.
-		arg* parameters are documented in AutoThresholdMethod enum docs.
+		Returns true if the given method calculates the threshold value from histogram of the image or neighbourhood.
 		*/
-		template<typename pixel_t> double autoThresholdValue(const Image<pixel_t>& img,
-			AutoThresholdMethod method,
-			double arg0,
-			double arg1,
-			double arg2,
-			double arg3,
-			bool showProgressInfo)
+		inline bool isHistogramMethod(AutoThresholdMethod method)
 		{
-			double th;
-
-			if (method == AutoThresholdMethod::Otsu
+			return method == AutoThresholdMethod::Otsu
 				|| method == AutoThresholdMethod::Huang
 				|| method == AutoThresholdMethod::Intermodes
 				|| method == AutoThresholdMethod::IsoData
@@ -708,16 +701,41 @@ namespace itl2
 				|| method == AutoThresholdMethod::Triangle
 				|| method == AutoThresholdMethod::Yen
 				|| method == AutoThresholdMethod::Median
-				|| method == AutoThresholdMethod::Percentile)
+				|| method == AutoThresholdMethod::Percentile;
+		}
+
+		/**
+		Replaces NaN histogram range and bin count arguments of histogram-based methods by their default values.
+		*/
+		template<typename pixel_t> void histogramThresholdDefaults(double& rangeMin, double& rangeMax, double& binCount)
+		{
+			internals::autothreshold::setDefault(rangeMin, internals::ThresholdDefaults<pixel_t>::range().x);
+			internals::autothreshold::setDefault(rangeMax, internals::ThresholdDefaults<pixel_t>::range().y);
+			internals::autothreshold::setDefault(binCount, (double)internals::ThresholdDefaults<pixel_t>::binCount());
+		}
+
+		/**
+		Calculates threshold value for given image/neighbourhood automatically.
+		arg* parameters are documented in AutoThresholdMethod enum docs.
+		*/
+		template<typename pixel_t> double autoThresholdValue(const Image<pixel_t>& img,
+			AutoThresholdMethod method,
+			double arg0,
+			double arg1,
+			double arg2,
+			double arg3,
+			bool showProgressInfo)
+		{
+			double th;
+
+			if (isHistogramMethod(method))
 			{
 				double rangeMin = arg0;
 				double rangeMax = arg1;
 				double binCount = arg2;
 				double arg = arg3;
 
-				internals::autothreshold::setDefault(rangeMin, internals::ThresholdDefaults<pixel_t>::range().x);
-				internals::autothreshold::setDefault(rangeMax, internals::ThresholdDefaults<pixel_t>::range().y);
-				internals::autothreshold::setDefault(binCount, (double)internals::ThresholdDefaults<pixel_t>::binCount());
+				histogramThresholdDefaults<pixel_t>(rangeMin, rangeMax, binCount);
 
 				size_t count = pixelRound<size_t>(binCount);
 
@@ -812,6 +830,291 @@ namespace itl2
 			else
 				return (typename NumberUtils<pixel_t>::FloatType)0;
 		}
+
+		/**
+		Calculates count of threshold grid points along a dimension of length n when the grid spacing is s.
+		The grid points are at 0, s, 2s, ..., and the last point is always at n - 1.
+		*/
+		inline coord_t thresholdGridCount(coord_t n, coord_t s)
+		{
+			if (n <= 1)
+				return 1;
+			return (n - 2) / s + 2;
+		}
+
+		/**
+		Calculates position of grid point i along a dimension of length n when the grid spacing is s.
+		*/
+		inline coord_t thresholdGridPosition(coord_t i, coord_t n, coord_t s)
+		{
+			return std::min(i * s, n - 1);
+		}
+
+		/**
+		Finds the grid cell containing position x and relative position of x in that cell.
+		@param i Index of the grid point at or before x is assigned to this variable.
+		@param t Relative position between grid points i and i + 1 is assigned to this variable.
+		*/
+		inline void thresholdGridCell(coord_t x, coord_t n, coord_t s, coord_t gridCount, coord_t& i, double& t)
+		{
+			i = x / s;
+			if (i >= gridCount - 1)
+			{
+				i = gridCount - 1;
+				t = 0;
+			}
+			else
+			{
+				coord_t x0 = thresholdGridPosition(i, n, s);
+				coord_t x1 = thresholdGridPosition(i + 1, n, s);
+				t = (double)(x - x0) / (double)(x1 - x0);
+			}
+		}
+
+		/**
+		Local thresholding with histogram-based methods.
+		The histogram of the neighbourhood is updated incrementally as the neighbourhood slides in the x-direction:
+		the column of pixels entering the neighbourhood is added to the histogram, and the column leaving it is removed.
+		Histogram bins of the rows of the neighbourhood are cached so that each row is binned only once per output plane.
+		The threshold is calculated either for each pixel, or for points of a regular grid, and interpolated linearly between
+		the grid points. The image is processed in parallel in slabs perpendicular to the z-direction.
+		@param gridSpacing Spacing between points where the threshold is calculated. Set to (1, 1, 1) to calculate the threshold for each pixel.
+		*/
+		template<typename pixel_t> void slidingHistogramThreshold(const Image<pixel_t>& img,
+			Image<pixel_t>& out,
+			const Vec3c& radius,
+			AutoThresholdMethod method,
+			double arg0,
+			double arg1,
+			double arg2,
+			double arg3,
+			BoundaryCondition bc,
+			const Vec3c& gridSpacing,
+			bool showProgressInfo = true)
+		{
+			double rangeMin = arg0;
+			double rangeMax = arg1;
+			double binCountArg = arg2;
+			double arg = arg3;
+			histogramThresholdDefaults<pixel_t>(rangeMin, rangeMax, binCountArg);
+
+			coord_t binCount = pixelRound<coord_t>(binCountArg);
+			if (binCount <= 0 || binCount > (coord_t)std::numeric_limits<uint32_t>::max())
+				throw ITLException("Invalid histogram bin count.");
+
+			Vec2d range(rangeMin, rangeMax);
+			Vec3c r = max(radius, Vec3c(0, 0, 0));
+
+			// Zero radius in those dimensions that are not in use
+			for (size_t n = img.dimensionality(); n < r.size(); n++)
+				r[n] = 0;
+
+			Vec3c s = max(gridSpacing, Vec3c(1, 1, 1));
+			Vec3c dimensions = img.dimensions();
+			Vec3c gridSize(thresholdGridCount(dimensions.x, s.x), thresholdGridCount(dimensions.y, s.y), thresholdGridCount(dimensions.z, s.z));
+
+			bool perPixel = s == Vec3c(1, 1, 1);
+			Image<double> thresholds;
+			if (!perPixel)
+				thresholds.ensureSize(gridSize);
+
+			// Rows of the neighbourhood are stored padded with r.x pixels on both sides.
+			coord_t rowCountY = 2 * r.y + 1;
+			coord_t rowCountZ = 2 * r.z + 1;
+			coord_t rowLength = dimensions.x + 2 * r.x;
+			coord_t zeroBin = histogramBin<pixel_t>(pixel_t(), range, binCount);
+
+			// Exceptions must not propagate out of the parallel region, so the first one is stored and re-thrown afterwards.
+			bool failed = false;
+			std::exception_ptr error;
+			auto storeError = [&]()
+			{
+				#pragma omp critical(sliding_histogram_threshold_error)
+				{
+					if (!error)
+						error = std::current_exception();
+					failed = true;
+				}
+			};
+
+			ProgressIndicator progress(gridSize.z + (perPixel ? 0 : dimensions.z), showProgressInfo);
+
+			#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				Image<double> hist;
+
+				// Cache of binned rows. Row (y, z) is stored in slot (z mod rowCountZ, y mod rowCountY).
+				std::vector<uint32_t> bins;
+				std::vector<Vec2c> keys;
+				std::vector<const uint32_t*> rows;
+
+				// All threads must reach the loop below even if the allocation fails.
+				try
+				{
+					hist.ensureSize(binCount);
+					bins.resize(rowCountY * rowCountZ * rowLength);
+					keys.resize(rowCountY * rowCountZ, Vec2c(std::numeric_limits<coord_t>::lowest(), std::numeric_limits<coord_t>::lowest()));
+					rows.resize(rowCountY * rowCountZ);
+				}
+				catch (...)
+				{
+					storeError();
+				}
+
+				#pragma omp for schedule(static)
+				for (coord_t gz = 0; gz < gridSize.z; gz++)
+				{
+					if (failed)
+						continue;
+
+					try
+					{
+						coord_t z = thresholdGridPosition(gz, dimensions.z, s.z);
+
+						for (coord_t gy = 0; gy < gridSize.y; gy++)
+						{
+							coord_t y = thresholdGridPosition(gy, dimensions.y, s.y);
+
+							// Bin rows that have not been binned yet.
+							size_t rowIndex = 0;
+							for (coord_t zz = z - r.z; zz <= z + r.z; zz++)
+							{
+								for (coord_t yy = y - r.y; yy <= y + r.y; yy++)
+								{
+									size_t slot = (size_t)((((zz % rowCountZ) + rowCountZ) % rowCountZ) * rowCountY + ((yy % rowCountY) + rowCountY) % rowCountY);
+									uint32_t* row = &bins[slot * rowLength];
+									if (keys[slot] != Vec2c(yy, zz))
+									{
+										keys[slot] = Vec2c(yy, zz);
+
+										coord_t sy = yy;
+										coord_t sz = zz;
+										bool outside = sy < 0 || sy >= dimensions.y || sz < 0 || sz >= dimensions.z;
+										if (bc == BoundaryCondition::Zero && outside)
+										{
+											for (coord_t xx = 0; xx < rowLength; xx++)
+												row[xx] = (uint32_t)zeroBin;
+										}
+										else
+										{
+											clamp<coord_t>(sy, 0, dimensions.y - 1);
+											clamp<coord_t>(sz, 0, dimensions.z - 1);
+											for (coord_t xx = -r.x; xx < dimensions.x + r.x; xx++)
+											{
+												coord_t bin;
+												if (xx < 0 || xx >= dimensions.x)
+												{
+													if (bc == BoundaryCondition::Zero)
+														bin = zeroBin;
+													else
+														bin = histogramBin(img(std::clamp<coord_t>(xx, 0, dimensions.x - 1), sy, sz), range, binCount);
+												}
+												else
+												{
+													bin = histogramBin(img(xx, sy, sz), range, binCount);
+												}
+												row[xx + r.x] = (uint32_t)bin;
+											}
+										}
+									}
+									rows[rowIndex] = row;
+									rowIndex++;
+								}
+							}
+
+							// Slide the neighbourhood along the row.
+							// Row element xx + r.x corresponds to pixel xx, so neighbourhood of pixel x spans elements [x, x + 2 r.x].
+							coord_t histX = -1;
+							for (coord_t gx = 0; gx < gridSize.x; gx++)
+							{
+								coord_t x = thresholdGridPosition(gx, dimensions.x, s.x);
+
+								if (histX < 0 || 2 * (x - histX) > 2 * r.x + 1)
+								{
+									// Building the histogram from scratch is faster than sliding long distances.
+									setValue(hist, 0.0);
+									for (const uint32_t* row : rows)
+									{
+										for (coord_t xx = x; xx <= x + 2 * r.x; xx++)
+											hist(row[xx])++;
+									}
+								}
+								else
+								{
+									for (const uint32_t* row : rows)
+									{
+										for (coord_t xx = histX + 1; xx <= x; xx++)
+										{
+											hist(row[xx + 2 * r.x])++;
+											hist(row[xx - 1])--;
+										}
+									}
+								}
+								histX = x;
+
+								double bin = histogramAutoThreshold(hist, method, arg);
+								double th = bin / binCount * (rangeMax - rangeMin) + rangeMin;
+
+								if (perPixel)
+									out(x, y, z) = intuitive::gt(img(x, y, z), th) ? (pixel_t)1 : (pixel_t)0;
+								else
+									thresholds(gx, gy, gz) = th;
+							}
+						}
+					}
+					catch (...)
+					{
+						storeError();
+					}
+
+					progress.step();
+				}
+			}
+
+			if (error)
+				std::rethrow_exception(error);
+
+			if (!perPixel)
+			{
+				// Interpolate the threshold between the grid points.
+				#pragma omp parallel for if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+				for (coord_t z = 0; z < dimensions.z; z++)
+				{
+					coord_t gz;
+					double tz;
+					thresholdGridCell(z, dimensions.z, s.z, gridSize.z, gz, tz);
+					coord_t gz1 = std::min(gz + 1, gridSize.z - 1);
+
+					for (coord_t y = 0; y < dimensions.y; y++)
+					{
+						coord_t gy;
+						double ty;
+						thresholdGridCell(y, dimensions.y, s.y, gridSize.y, gy, ty);
+						coord_t gy1 = std::min(gy + 1, gridSize.y - 1);
+
+						for (coord_t x = 0; x < dimensions.x; x++)
+						{
+							coord_t gx;
+							double tx;
+							thresholdGridCell(x, dimensions.x, s.x, gridSize.x, gx, tx);
+							coord_t gx1 = std::min(gx + 1, gridSize.x - 1);
+
+							double c00 = (1 - tx) * thresholds(gx, gy, gz) + tx * thresholds(gx1, gy, gz);
+							double c10 = (1 - tx) * thresholds(gx, gy1, gz) + tx * thresholds(gx1, gy1, gz);
+							double c01 = (1 - tx) * thresholds(gx, gy, gz1) + tx * thresholds(gx1, gy, gz1);
+							double c11 = (1 - tx) * thresholds(gx, gy1, gz1) + tx * thresholds(gx1, gy1, gz1);
+							double c0 = (1 - ty) * c00 + ty * c10;
+							double c1 = (1 - ty) * c01 + ty * c11;
+							double th = (1 - tz) * c0 + tz * c1;
+
+							out(x, y, z) = intuitive::gt(img(x, y, z), th) ? (pixel_t)1 : (pixel_t)0;
+						}
+					}
+
+					progress.step();
+				}
+			}
+		}
 	}
 
 	/**
@@ -821,6 +1124,9 @@ namespace itl2
 	@param method Thesholding method.
 	@param arg0, arg1, arg2, arg3 Arguments for the thresholding method. These are documented in docs of AutoThresholdMethod enumeration.
 	@param bc Boundary condition.
+	@param gridSpacing Histogram-based methods calculate the threshold at points of a regular grid with this spacing,
+	and interpolate it linearly between the grid points. Set to (1, 1, 1) to calculate the threshold separately for each pixel.
+	Other methods always calculate the threshold separately for each pixel.
 	*/
 	template<typename pixel_t> void localThreshold(const Image<pixel_t>& img,
 		Image<pixel_t>& out,
@@ -830,22 +1136,71 @@ namespace itl2
 		double arg1 = std::numeric_limits<double>::quiet_NaN(),
 		double arg2 = std::numeric_limits<double>::quiet_NaN(),
 		double arg3 = std::numeric_limits<double>::quiet_NaN(),
-		BoundaryCondition bc = BoundaryCondition::Nearest)
+		BoundaryCondition bc = BoundaryCondition::Nearest,
+		const Vec3c& gridSpacing = Vec3c(1, 1, 1))
 	{
 		img.mustNotBe(out);
 		out.ensureSize(img);
 
-		internals::LocalThresholdSettings settings = {method, arg0, arg1, arg2, arg3};
-
-		// TODO: This can be done faster (using separable filtering) for non-histogram-based auto threshold methods.
+		if ((method == AutoThresholdMethod::Mean
+			|| method == AutoThresholdMethod::Niblack
+			|| method == AutoThresholdMethod::Phansalkar
+			|| method == AutoThresholdMethod::Sauvola)
+			&& internals::canUseBoxSums(img))
+		{
+			// These methods depend only on local mean and standard deviation, which can be calculated using running sums.
+			internals::boxStatistics(img, radius, bc, method != AutoThresholdMethod::Mean, [&](coord_t x, coord_t y, coord_t z, double mean, double var)
+				{
+					double stddev = std::sqrt(var);
+					double th;
+					switch (method)
+					{
+					case AutoThresholdMethod::Mean: th = internals::autothreshold::mean(mean, arg0); break;
+					case AutoThresholdMethod::Niblack: th = internals::autothreshold::niblack(mean, stddev, arg0, arg1); break;
+					case AutoThresholdMethod::Phansalkar: th = internals::autothreshold::phansalkar(mean, stddev, arg0, arg1, arg2, arg3); break;
+					default: th = internals::autothreshold::sauvola(mean, stddev, arg0, arg1, arg2); break;
+					}
+					out(x, y, z) = intuitive::gt(img(x, y, z), th) ? (pixel_t)1 : (pixel_t)0;
+				});
+		}
+		else if (method == AutoThresholdMethod::MidGrey || method == AutoThresholdMethod::Bernsen)
+		{
+			// These methods depend only on local minimum and maximum, which can be calculated using separable filtering.
+			Image<pixel_t> localMax;
+			maxFilter(img, localMax, radius, NeighbourhoodType::Rectangular, bc);
+			minFilter(img, out, radius, NeighbourhoodType::Rectangular, bc);
 
-		filter<pixel_t, pixel_t, const internals::LocalThresholdSettings&, internals::localThresholdProcessNeighbourhood<pixel_t>>(img, out, radius, settings, NeighbourhoodType::Rectangular, bc);
+			#pragma omp parallel for if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+			{
+				double m = (double)out(n);
+				double M = (double)localMax(n);
+				double th;
+				if (method == AutoThresholdMethod::MidGrey)
+					th = internals::autothreshold::midgrey(m, M, arg0);
+				else
+					th = internals::autothreshold::bernsen(m, M, arg0, (m + M) / 2.0);
+				out(n) = intuitive::gt(img(n), th) ? (pixel_t)1 : (pixel_t)0;
+			}
+		}
+		else if (internals::isHistogramMethod(method))
+		{
+			internals::slidingHistogramThreshold(img, out, radius, method, arg0, arg1, arg2, arg3, bc, gridSpacing);
+		}
+		else
+		{
+			internals::LocalThresholdSettings settings = { method, arg0, arg1, arg2, arg3 };
+			filter<pixel_t, pixel_t, const internals::LocalThresholdSettings&, internals::localThresholdProcessNeighbourhood<pixel_t>>(img, out, radius, settings, NeighbourhoodType::Rectangular, bc);
+		}
 	}
 
 	namespace tests
 	{
 		void autothreshold();
 		void localThreshold();
+		void localThresholdMethods();
+		void localThresholdHistogram();
+		void localThresholdHistogramSpeed();
 	}
 
 }
@@ -0,0 +1,113 @@
+
+#include "boxfilters.h"
+#include "filters.h"
+#include "noise.h"
+#include "conversions.h"
+#include "timer.h"
+#include "testutils.h"
+
+using namespace std;
+
+namespace itl2
+{
+	namespace tests
+	{
+		namespace
+		{
+			/**
+			Calculates maximum difference between two images, relative to the magnitude of the values.
+			*/
+			double maxDifference(const Image<double>& a, const Image<double>& b)
+			{
+				double diff = 0;
+				for (coord_t n = 0; n < a.pixelCount(); n++)
+				{
+					double d = std::abs(a(n) - b(n)) / std::max(1.0, std::abs(a(n)));
+					if (!(d <= diff))
+						diff = d;
+				}
+				return diff;
+			}
+
+			template<typename pixel_t> void testBoxFilters(const Image<pixel_t>& img, const Vec3c& r, BoundaryCondition bc)
+			{
+				string desc = string(", r = ") + toString(r) + ", bc = " + toString(bc) + ", image size = " + toString(img.dimensions());
+
+				// The direct algorithm is calculated in double precision to get an accurate reference.
+				Image<double> imgd;
+				convert(img, imgd);
+
+				Image<double> expected, result;
+
+				filter<double, double, internals::meanOp<double> >(imgd, expected, r, NeighbourhoodType::Rectangular, bc);
+				boxMeanFilter(img, result, r, bc);
+				testAssert(maxDifference(expected, result) < 1e-9, string("box mean") + desc);
+
+				filter<double, double, internals::varianceOp<double> >(imgd, expected, r, NeighbourhoodType::Rectangular, bc);
+				boxVarianceFilter(img, result, r, bc);
+				testAssert(maxDifference(expected, result) < 1e-9, string("box variance") + desc);
+
+				filter<double, double, internals::stddevOp<double> >(imgd, expected, r, NeighbourhoodType::Rectangular, bc);
+				boxStddevFilter(img, result, r, bc);
+				testAssert(maxDifference(expected, result) < 1e-9, string("box stddev") + desc);
+			}
+		}
+
+		void boxFilters()
+		{
+			Image<uint16_t> img(37, 29, 23);
+			noise(img, 1000, 300, 3);
+
+			Image<float32_t> imgf(img.dimensions());
+			noise(imgf, 1e4, 10, 5);
+
+			Image<uint8_t> img2(64, 47);
+			noise(img2, 100, 50, 7);
+
+			for (BoundaryCondition bc : { BoundaryCondition::Nearest, BoundaryCondition::Zero })
+			{
+				for (const Vec3c& r : { Vec3c(1, 1, 1), Vec3c(3, 0, 2), Vec3c(0, 5, 1), Vec3c(20, 2, 30) })
+				{
+					testBoxFilters(img, r, bc);
+					testBoxFilters(imgf, r, bc);
+					testBoxFilters(img2, r, bc);
+				}
+			}
+
+			// The public filters must select running sums for rectangular neighbourhoods only.
+			Image<double> expected, result;
+			filter<uint16_t, double, internals::varianceOp<uint16_t> >(img, expected, Vec3c(2, 2, 2), NeighbourhoodType::Ellipsoidal, BoundaryCondition::Nearest);
+			varianceFilter(img, result, 2, NeighbourhoodType::Ellipsoidal);
+			testAssert(equals(expected, result), "ellipsoidal variance");
+
+			// Non-finite values are processed with the direct algorithm.
+			imgf(10, 10, 10) = std::numeric_limits<float32_t>::quiet_NaN();
+			meanFilter(imgf, result, 2, NeighbourhoodType::Rectangular);
+			testAssert(std::isnan(result(11, 11, 11)) && !std::isnan(result(0, 0, 0)), "mean filtering of image containing NaN");
+		}
+
+		void boxFiltersSpeed()
+		{
+			Image<uint16_t> img(300, 300, 300);
+			noise(img, 1000, 300, 3);
+
+			Image<float32_t> out;
+			Timer timer;
+			for (coord_t r : { 2, 5, 10, 25 })
+			{
+				timer.start();
+				boxStddevFilter(img, out, Vec3c(r, r, r));
+				timer.stop();
+				cout << "Running sum standard deviation filter, r = " << r << " took " << timer.getTime() << " ms." << endl;
+
+				if (r <= 5)
+				{
+					timer.start();
+					filter<uint16_t, float32_t, internals::stddevOp<uint16_t> >(img, out, Vec3c(r, r, r), NeighbourhoodType::Rectangular, BoundaryCondition::Nearest);
+					timer.stop();
+					cout << "Direct standard deviation filter, r = " << r << " took " << timer.getTime() << " ms." << endl;
+				}
+			}
+		}
+	}
+}
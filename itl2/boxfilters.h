@@ -0,0 +1,354 @@
+#pragma once
+
+#include "image.h"
+#include "boundarycondition.h"
+#include "math/vec3.h"
+#include "progress.h"
+#include "utilities.h"
+
+#include <vector>
+#include <cmath>
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Tests if all pixels of the image are finite.
+		*/
+		template<typename pixel_t> bool allFinite(const Image<pixel_t>& img)
+		{
+			if constexpr (std::is_floating_point_v<pixel_t>)
+			{
+				for (coord_t n = 0; n < img.pixelCount(); n++)
+				{
+					if (!std::isfinite(img(n)))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		Tests if box sums can be used to calculate local statistics of the given image.
+		Running sums are not suitable for non-real pixel types, and a single non-finite value would
+		spread to all the sums after it.
+		*/
+		template<typename pixel_t> bool canUseBoxSums(const Image<pixel_t>& img)
+		{
+			if constexpr (std::is_arithmetic_v<pixel_t>)
+				return allFinite(img);
+			else
+				return false;
+		}
+
+		/**
+		Width of the column tiles processed by one thread in the column pass of box sums.
+		The running sums of one tile should fit in the L1 cache.
+		*/
+		static const coord_t BOX_SUM_TILE_WIDTH = 512;
+
+		/**
+		Calculates sums of pixel values (minus shift) and optionally squared pixel values in windows of
+		size (2 * r.x + 1) x (2 * r.y + 1) centered at each pixel of one slice of the input image.
+		@param in Input image.
+		@param z Index of the slice. If the slice is not in the image, it is treated according to the boundary condition.
+		@param r Radius of the window.
+		@param bc Boundary condition.
+		@param shift Value that is subtracted from all pixel values before summing. This improves accuracy of the variance.
+		@param squares Set to true to calculate sums of squared values, too.
+		@param rowSum, rowSum2 Temporary images of the same size than one slice of the input image.
+		@param sum, sum2 The sums are placed to these images. Their size must be the size of one slice of the input image.
+		*/
+		template<typename pixel_t> void boxSumsInSlice(const Image<pixel_t>& in, coord_t z, const Vec3c& r, BoundaryCondition bc, double shift, bool squares,
+			Image<double>& rowSum, Image<double>& rowSum2, Image<double>& sum, Image<double>& sum2)
+		{
+			coord_t w = in.width();
+			coord_t h = in.height();
+
+			bool outsideSlice = z < 0 || z >= in.depth();
+			if (outsideSlice && bc == BoundaryCondition::Nearest)
+			{
+				z = z < 0 ? 0 : in.depth() - 1;
+				outsideSlice = false;
+			}
+
+			// Sums along rows.
+			#pragma omp parallel for if(!omp_in_parallel() && w * h > PARALLELIZATION_THRESHOLD)
+			for (coord_t y = 0; y < h; y++)
+			{
+				const pixel_t* pLine = outsideSlice ? nullptr : &in(0, y, z);
+				auto value = [&](coord_t x)
+				{
+					if (outsideSlice)
+						return -shift;
+
+					if (x < 0)
+					{
+						if (bc == BoundaryCondition::Zero)
+							return -shift;
+						x = 0;
+					}
+					else if (x >= w)
+					{
+						if (bc == BoundaryCondition::Zero)
+							return -shift;
+						x = w - 1;
+					}
+					return (double)pLine[x] - shift;
+				};
+
+				double s = 0;
+				double s2 = 0;
+				for (coord_t x = -r.x; x <= r.x; x++)
+				{
+					double v = value(x);
+					s += v;
+					s2 += v * v;
+				}
+
+				double* pSum = &rowSum(0, y);
+				double* pSum2 = squares ? &rowSum2(0, y) : nullptr;
+				for (coord_t x = 0; x < w; x++)
+				{
+					pSum[x] = s;
+					double a = value(x + r.x + 1);
+					double b = value(x - r.x);
+					s += a - b;
+					if (squares)
+					{
+						pSum2[x] = s2;
+						s2 += a * a - b * b;
+					}
+				}
+			}
+
+			// Sums of row sums along columns.
+			// The columns are processed in tiles so that the running sums of a tile stay in cache, and the
+			// rows are read in memory order.
+			double zeroRow = -shift * (2 * r.x + 1);
+			double zeroRow2 = shift * shift * (2 * r.x + 1);
+			coord_t tileCount = (w + BOX_SUM_TILE_WIDTH - 1) / BOX_SUM_TILE_WIDTH;
+			#pragma omp parallel if(!omp_in_parallel() && w * h > PARALLELIZATION_THRESHOLD)
+			{
+				std::vector<double> acc(BOX_SUM_TILE_WIDTH);
+				std::vector<double> acc2(BOX_SUM_TILE_WIDTH);
+
+				#pragma omp for
+				for (coord_t tile = 0; tile < tileCount; tile++)
+				{
+					coord_t x0 = tile * BOX_SUM_TILE_WIDTH;
+					coord_t tw = std::min(BOX_SUM_TILE_WIDTH, w - x0);
+
+					// Adds (sign = 1) or subtracts (sign = -1) row y to the running sums.
+					auto addRow = [&](coord_t y, double sign)
+					{
+						if (y < 0 || y >= h)
+						{
+							if (bc == BoundaryCondition::Zero)
+							{
+								for (coord_t i = 0; i < tw; i++)
+									acc[i] += sign * zeroRow;
+								if (squares)
+								{
+									for (coord_t i = 0; i < tw; i++)
+										acc2[i] += sign * zeroRow2;
+								}
+								return;
+							}
+							y = y < 0 ? 0 : h - 1;
+						}
+
+						const double* pRow = &rowSum(x0, y);
+						for (coord_t i = 0; i < tw; i++)
+							acc[i] += sign * pRow[i];
+						if (squares)
+						{
+							const double* pRow2 = &rowSum2(x0, y);
+							for (coord_t i = 0; i < tw; i++)
+								acc2[i] += sign * pRow2[i];
+						}
+					};
+
+					std::fill(acc.begin(), acc.end(), 0.0);
+					std::fill(acc2.begin(), acc2.end(), 0.0);
+					for (coord_t y = -r.y; y <= r.y; y++)
+						addRow(y, 1);
+
+					for (coord_t y = 0; y < h; y++)
+					{
+						double* pSum = &sum(x0, y);
+						for (coord_t i = 0; i < tw; i++)
+							pSum[i] = acc[i];
+						if (squares)
+						{
+							double* pSum2 = &sum2(x0, y);
+							for (coord_t i = 0; i < tw; i++)
+								pSum2[i] = acc2[i];
+						}
+
+						addRow(y + r.y + 1, 1);
+						addRow(y - r.y, -1);
+					}
+				}
+			}
+		}
+
+		/**
+		Calculates mean and variance of pixel values in a rectangular window centered at each pixel of the input image,
+		using running sums in O(1) time per pixel regardless of the size of the window.
+		The image is processed one slice at a time, so the memory requirement is a few slices of double values.
+		For each pixel, calls output(x, y, z, mean, variance).
+		The variance is the sample variance, consistent with itl2::internals::varianceOp.
+		@param in Input image. The image must not contain non-finite values, see canUseBoxSums.
+		@param r Radius of the window. The size of the window is 2 * r + 1.
+		@param bc Boundary condition.
+		@param variance Set to false if only mean values are required. In that case the variance passed to output is undefined.
+		@param output Function that is called for each pixel.
+		@param showProgressInfo Set to true to show a progress bar.
+		*/
+		template<typename pixel_t, typename Output> void boxStatistics(const Image<pixel_t>& in, Vec3c r, BoundaryCondition bc, bool variance, Output output, bool showProgressInfo = true)
+		{
+			// Zero radius in those dimensions that are not in use
+			for (size_t n = in.dimensionality(); n < r.size(); n++)
+				r[n] = 0;
+			r = max(r, Vec3c(0, 0, 0));
+
+			if (in.pixelCount() <= 0)
+				return;
+
+			// Shift the values by (approximate) mean to avoid cancellation in the variance.
+			double shift = 0;
+			if (variance)
+			{
+				coord_t step = std::max<coord_t>(1, in.pixelCount() / 10000);
+				size_t count = 0;
+				for (coord_t n = 0; n < in.pixelCount(); n += step)
+				{
+					shift += (double)in(n);
+					count++;
+				}
+				shift /= count;
+			}
+
+			coord_t w = in.width();
+			coord_t h = in.height();
+			Image<double> rowSum(w, h), rowSum2(variance ? w : 1, variance ? h : 1);
+			Image<double> planeSum(w, h), planeSum2(variance ? w : 1, variance ? h : 1);
+			Image<double> sum(w, h), sum2(variance ? w : 1, variance ? h : 1);
+
+			// Adds (sign = 1) or subtracts (sign = -1) box sums of slice z to the running sums.
+			auto addSlice = [&](coord_t z, double sign)
+			{
+				boxSumsInSlice(in, z, r, bc, shift, variance, rowSum, rowSum2, planeSum, planeSum2);
+
+				#pragma omp parallel for if(!omp_in_parallel() && w * h > PARALLELIZATION_THRESHOLD)
+				for (coord_t n = 0; n < w * h; n++)
+				{
+					sum(n) += sign * planeSum(n);
+					if (variance)
+						sum2(n) += sign * planeSum2(n);
+				}
+			};
+
+			for (coord_t z = -r.z; z <= r.z; z++)
+				addSlice(z, 1);
+
+			double count = (double)(2 * r.x + 1) * (double)(2 * r.y + 1) * (double)(2 * r.z + 1);
+
+			ProgressIndicator prog(in.depth(), showProgressInfo);
+			for (coord_t z = 0; z < in.depth(); z++)
+			{
+				#pragma omp parallel for if(!omp_in_parallel() && w * h > PARALLELIZATION_THRESHOLD)
+				for (coord_t y = 0; y < h; y++)
+				{
+					for (coord_t x = 0; x < w; x++)
+					{
+						double s = sum(x, y);
+						double m = s / count;
+						double v = 0;
+						if (variance)
+						{
+							v = (sum2(x, y) - s * m) / (count - 1);
+							// Rounding errors may cause small negative values.
+							if (v < 0)
+								v = 0;
+						}
+						output(x, y, z, m + shift, v);
+					}
+				}
+
+				if (z < in.depth() - 1)
+				{
+					addSlice(z + r.z + 1, 1);
+					addSlice(z - r.z, -1);
+				}
+
+				prog.step();
+			}
+		}
+	}
+
+	/**
+	Calculates mean filtering in a rectangular neighbourhood using running sums.
+	The processing time does not depend on the size of the neighbourhood.
+	@param in Input image. The image should not contain non-finite values.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void boxMeanFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		out.mustNotBe(in);
+		out.ensureSize(in);
+
+		internals::boxStatistics(in, nbRadius, bc, false, [&](coord_t x, coord_t y, coord_t z, double mean, double var)
+			{
+				out(x, y, z) = pixelRound<out_t>(mean);
+			});
+	}
+
+	/**
+	Calculates variance filtering in a rectangular neighbourhood using running sums.
+	The processing time does not depend on the size of the neighbourhood.
+	@param in Input image. The image should not contain non-finite values.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void boxVarianceFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		out.mustNotBe(in);
+		out.ensureSize(in);
+
+		internals::boxStatistics(in, nbRadius, bc, true, [&](coord_t x, coord_t y, coord_t z, double mean, double var)
+			{
+				out(x, y, z) = pixelRound<out_t>(var);
+			});
+	}
+
+	/**
+	Calculates standard deviation filtering in a rectangular neighbourhood using running sums.
+	The processing time does not depend on the size of the neighbourhood.
+	@param in Input image. The image should not contain non-finite values.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void boxStddevFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		out.mustNotBe(in);
+		out.ensureSize(in);
+
+		internals::boxStatistics(in, nbRadius, bc, true, [&](coord_t x, coord_t y, coord_t z, double mean, double var)
+			{
+				out(x, y, z) = pixelRound<out_t>(std::sqrt(var));
+			});
+	}
+
+	namespace tests
+	{
+		void boxFilters();
+		void boxFiltersSpeed();
+	}
+}
@@ -0,0 +1,133 @@
+
+#include "connectedcomponents.h"
+#include "floodfill.h"
+#include "generation.h"
+#include "pointprocess.h"
+#include "projections.h"
+#include "noise.h"
+#include "conversions.h"
+#include "timer.h"
+#include "io/raw.h"
+
+using namespace std;
+
+namespace itl2
+{
+	namespace tests
+	{
+		/**
+		Labels nonzero regions of the image using flood fill.
+		*/
+		uint32_t labelUsingFloodfill(Image<uint32_t>& img, Connectivity connectivity)
+		{
+			uint32_t particleColor = std::numeric_limits<uint32_t>::max();
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+			{
+				if (img(n) != 0)
+					img(n) = particleColor;
+			}
+
+			uint32_t label = 1;
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					for (coord_t x = 0; x < img.width(); x++)
+					{
+						if (img(x, y, z) == particleColor)
+						{
+							floodfillSingleThreaded(img, Vec3c(x, y, z), label, label, connectivity);
+							label++;
+						}
+					}
+				}
+			}
+
+			return label - 1;
+		}
+
+		void connectedComponents()
+		{
+			Image<uint8_t> img(100, 80, 90);
+			noise(img, 0, 1, 123);
+			threshold(img, (uint8_t)0);
+			for (coord_t n = 0; n < 200; n++)
+			{
+				Vec3d pos(frand((double)img.width()), frand((double)img.height()), frand((double)img.depth()));
+				draw(img, Sphere(pos, frand(1, 6)), (uint8_t)2);
+			}
+
+			for (Connectivity connectivity : { Connectivity::NearestNeighbours, Connectivity::AllNeighbours })
+			{
+				Image<uint32_t> expected;
+				convert(img, expected);
+				uint32_t expectedCount = labelUsingFloodfill(expected, connectivity);
+
+				Image<uint32_t> result;
+				size_t count = itl2::connectedComponents(img, result, connectivity);
+
+				testAssert(count == expectedCount, "component count");
+				testAssert(equals(result, expected), "labels");
+
+				// Labeling of regions that have specific color only.
+				Image<uint32_t> expected2;
+				convert(img, expected2);
+				for (coord_t n = 0; n < expected2.pixelCount(); n++)
+				{
+					if (expected2(n) != 2)
+						expected2(n) = 0;
+				}
+				labelUsingFloodfill(expected2, connectivity);
+
+				Image<uint64_t> result2;
+				itl2::connectedComponents(img, result2, connectivity, (uint8_t)2);
+
+				Image<uint32_t> result2c;
+				convert(result2, result2c);
+				testAssert(equals(result2c, expected2), "labels of single color");
+			}
+
+			// Too many components for the label data type.
+			Image<uint8_t> checkerboard(64, 64, 1);
+			for (coord_t y = 0; y < checkerboard.height(); y++)
+				for (coord_t x = 0; x < checkerboard.width(); x++)
+					checkerboard(x, y) = (x + y) % 2;
+			Image<uint8_t> out;
+			try
+			{
+				itl2::connectedComponents(checkerboard, out, Connectivity::NearestNeighbours);
+				testAssert(false, "label overflow not detected");
+			}
+			catch (const ITLException&)
+			{
+			}
+		}
+
+		void connectedComponentsSpeed()
+		{
+			Image<uint8_t> img(500, 500, 500);
+			for (coord_t n = 0; n < 20000; n++)
+			{
+				Vec3d pos(frand((double)img.width()), frand((double)img.height()), frand((double)img.depth()));
+				draw(img, Sphere(pos, frand(1, 10)), (uint8_t)1);
+			}
+
+			Timer timer;
+
+			timer.start();
+			Image<uint32_t> expected;
+			convert(img, expected);
+			labelUsingFloodfill(expected, Connectivity::AllNeighbours);
+			timer.stop();
+			cout << "Flood fill labeling took " << timer.getTime() << " ms." << endl;
+
+			timer.start();
+			Image<uint32_t> result;
+			itl2::connectedComponents(img, result, Connectivity::AllNeighbours);
+			timer.stop();
+			cout << "Run-based labeling took " << timer.getTime() << " ms." << endl;
+
+			testAssert(equals(result, expected), "labels");
+		}
+	}
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <omp.h>
+
+#include "image.h"
+#include "connectivity.h"
+#include "indexforest.h"
+#include "utilities.h"
+
+namespace itl2
+{
+	/**
+	Run-length encoded foreground of an image, and the connected component that each run belongs to.
+	*/
+	class ComponentRuns
+	{
+	public:
+		/**
+		Run of consecutive foreground pixels on an image row. The run covers pixels x0, ..., x1.
+		*/
+		struct Run
+		{
+			int32_t x0;
+			int32_t x1;
+		};
+
+		/**
+		Dimensions of the image.
+		*/
+		Vec3c dimensions;
+
+		/**
+		All the runs in the image, ordered by z, y, and x.
+		*/
+		std::vector<Run> runs;
+
+		/**
+		Index of the first run of each image row in the runs list.
+		The runs of row (y, z) are runs[rowStart[rowIndex(y, z)]], ..., runs[rowStart[rowIndex(y, z) + 1] - 1].
+		*/
+		std::vector<size_t> rowStart;
+
+		/**
+		Zero-based index of the connected component of each run.
+		The components are numbered in the order they are encountered when the image is scanned in z, y, x order.
+		*/
+		std::vector<size_t> component;
+
+		/**
+		Count of connected components.
+		*/
+		size_t componentCount = 0;
+
+		/**
+		Gets index of image row (y, z) in the rowStart list.
+		*/
+		size_t rowIndex(coord_t y, coord_t z) const
+		{
+			return (size_t)(z * dimensions.y + y);
+		}
+
+		/**
+		Calls f(run, y, z, component) for all runs in the image.
+		The rows are processed in parallel, so f must be thread-safe.
+		*/
+		template<typename F> void forAllRuns(F f, bool multiThreaded = true) const
+		{
+			coord_t rowCount = dimensions.y * dimensions.z;
+
+			#pragma omp parallel for schedule(dynamic, 16) if(multiThreaded && !omp_in_parallel() && runs.size() > PARALLELIZATION_THRESHOLD)
+			for (coord_t row = 0; row < rowCount; row++)
+			{
+				coord_t y = row % dimensions.y;
+				coord_t z = row / dimensions.y;
+				for (size_t i = rowStart[row]; i < rowStart[row + 1]; i++)
+					f(runs[i], y, z, component[i]);
+			}
+		}
+
+		/**
+		Calculates count of pixels in each component.
+		*/
+		std::vector<size_t> volumes(bool multiThreaded = true) const
+		{
+			std::vector<size_t> result(componentCount, 0);
+			forAllRuns([&](const Run& run, coord_t y, coord_t z, size_t c)
+				{
+					size_t length = (size_t)(run.x1 - run.x0 + 1);
+					#pragma omp atomic
+					result[c] += length;
+				}, multiThreaded);
+			return result;
+		}
+
+		/**
+		Sets the pixels of each run to value(component of the run).
+		@param clearBackground Set to true to set all pixels not in any run to zero.
+		*/
+		template<typename pixel_t, typename F> void fill(Image<pixel_t>& img, F value, bool clearBackground, bool multiThreaded = true) const
+		{
+			coord_t rowCount = dimensions.y * dimensions.z;
+
+			#pragma omp parallel for if(multiThreaded && !omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			for (coord_t row = 0; row < rowCount; row++)
+			{
+				coord_t y = row % dimensions.y;
+				coord_t z = row / dimensions.y;
+				pixel_t* p = &img(0, y, z);
+
+				if (clearBackground)
+				{
+					for (coord_t x = 0; x < dimensions.x; x++)
+						p[x] = pixel_t();
+				}
+
+				for (size_t i = rowStart[row]; i < rowStart[row + 1]; i++)
+				{
+					pixel_t v = value(component[i]);
+					for (int32_t x = runs[i].x0; x <= runs[i].x1; x++)
+						p[x] = v;
+				}
+			}
+		}
+	};
+
+	namespace internals
+	{
+		/**
+		Merges components of overlapping runs in two rows.
+		@param gap Maximum count of pixels between two runs that are considered to be overlapping.
+		Use 0 for runs that must share x coordinates and 1 for runs that may be diagonal neighbours.
+		*/
+		inline void mergeRows(const std::vector<ComponentRuns::Run>& runs, size_t aStart, size_t aEnd, size_t bStart, size_t bEnd, int32_t gap, ConcurrentIndexForest& forest)
+		{
+			size_t i = aStart;
+			size_t j = bStart;
+			while (i < aEnd && j < bEnd)
+			{
+				const ComponentRuns::Run& a = runs[i];
+				const ComponentRuns::Run& b = runs[j];
+
+				if (a.x1 + gap < b.x0)
+				{
+					i++;
+				}
+				else if (b.x1 + gap < a.x0)
+				{
+					j++;
+				}
+				else
+				{
+					forest.union_sets(i, j);
+
+					if (a.x1 < b.x1)
+						i++;
+					else
+						j++;
+				}
+			}
+		}
+	}
+
+	/**
+	Finds connected components of foreground pixels.
+	The image is divided into slabs in the z direction, and the slabs are processed in parallel.
+	In the first pass, the foreground pixels of each slab are converted to runs. In the second pass,
+	overlapping runs in neighbouring rows, including those in neighbouring slabs, are merged using a lock-free disjoint-set forest.
+	Finally, the components are numbered in scan order.
+	@param image The image.
+	@param isForeground Function that returns true for pixel values that belong to the foreground.
+	@param connectivity Connectivity of the components.
+	@param result The runs and their components are stored here.
+	@param multiThreaded Set to false to process the image in the current thread only.
+	*/
+	template<typename pixel_t, typename Predicate> void findComponents(const Image<pixel_t>& image, Predicate isForeground, Connectivity connectivity, ComponentRuns& result, bool multiThreaded = true, bool showProgress = false)
+	{
+		if (connectivity != Connectivity::NearestNeighbours && connectivity != Connectivity::AllNeighbours)
+			throw ITLException("Unsupported connectivity value.");
+
+		const coord_t w = image.width();
+		const coord_t h = image.height();
+		const coord_t d = image.depth();
+
+		result.dimensions = image.dimensions();
+		result.runs.clear();
+		result.component.clear();
+		result.rowStart.resize(h * d + 1);
+
+		coord_t slabCount = multiThreaded ? std::max<coord_t>(1, std::min(d, (coord_t)omp_get_max_threads() * 4)) : 1;
+		auto slabMinZ = [=](coord_t s)
+		{
+			return s * d / slabCount;
+		};
+
+		size_t counter = 0;
+
+		// Find runs in each slab.
+		std::vector<std::vector<ComponentRuns::Run> > slabRuns(slabCount);
+		#pragma omp parallel for schedule(dynamic) if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			std::vector<ComponentRuns::Run>& runs = slabRuns[s];
+			for (coord_t z = slabMinZ(s); z < slabMinZ(s + 1); z++)
+			{
+				for (coord_t y = 0; y < h; y++)
+				{
+					result.rowStart[result.rowIndex(y, z)] = runs.size();
+
+					const pixel_t* p = &image(0, y, z);
+					for (coord_t x = 0; x < w; x++)
+					{
+						if (isForeground(p[x]))
+						{
+							coord_t x0 = x;
+							while (x + 1 < w && isForeground(p[x + 1]))
+								x++;
+							runs.push_back(ComponentRuns::Run{ (int32_t)x0, (int32_t)x });
+						}
+					}
+				}
+			}
+
+			showThreadProgress(counter, 3 * slabCount, showProgress);
+		}
+
+		// Concatenate the runs of the slabs.
+		std::vector<size_t> slabStart(slabCount + 1, 0);
+		for (coord_t s = 0; s < slabCount; s++)
+			slabStart[s + 1] = slabStart[s] + slabRuns[s].size();
+
+		result.runs.resize(slabStart[slabCount]);
+		result.rowStart[h * d] = slabStart[slabCount];
+
+		#pragma omp parallel for if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			std::copy(slabRuns[s].begin(), slabRuns[s].end(), result.runs.begin() + slabStart[s]);
+			slabRuns[s].clear();
+			slabRuns[s].shrink_to_fit();
+
+			for (size_t row = result.rowIndex(0, slabMinZ(s)); row < result.rowIndex(0, slabMinZ(s + 1)); row++)
+				result.rowStart[row] += slabStart[s];
+		}
+
+		// Merge overlapping runs in neighbouring rows.
+		// Rows on the first slice of a slab are merged with the last slice of the previous slab, too.
+		ConcurrentIndexForest forest(result.runs.size());
+		int32_t gap = connectivity == Connectivity::AllNeighbours ? 1 : 0;
+		auto merge = [&](coord_t y, coord_t z, coord_t ny, coord_t nz, int32_t gap)
+		{
+			if (ny < 0 || ny >= h || nz < 0)
+				return;
+
+			size_t row = result.rowIndex(y, z);
+			size_t nrow = result.rowIndex(ny, nz);
+			internals::mergeRows(result.runs, result.rowStart[row], result.rowStart[row + 1], result.rowStart[nrow], result.rowStart[nrow + 1], gap, forest);
+		};
+
+		#pragma omp parallel for schedule(dynamic) if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			for (coord_t z = slabMinZ(s); z < slabMinZ(s + 1); z++)
+			{
+				for (coord_t y = 0; y < h; y++)
+				{
+					merge(y, z, y - 1, z, gap);
+					merge(y, z, y, z - 1, gap);
+					if (connectivity == Connectivity::AllNeighbours)
+					{
+						merge(y, z, y - 1, z - 1, gap);
+						merge(y, z, y + 1, z - 1, gap);
+					}
+				}
+			}
+
+			showThreadProgress(counter, 3 * slabCount, showProgress);
+		}
+
+		// Number the components. The root of each set is its smallest element, i.e. the run that is encountered first in scan order.
+		std::vector<size_t> slabComponentStart(slabCount + 1, 0);
+		#pragma omp parallel for if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			size_t count = 0;
+			for (size_t i = slabStart[s]; i < slabStart[s + 1]; i++)
+			{
+				if (forest.find_set(i) == i)
+					count++;
+			}
+			slabComponentStart[s + 1] = count;
+		}
+
+		for (coord_t s = 0; s < slabCount; s++)
+			slabComponentStart[s + 1] += slabComponentStart[s];
+
+		result.componentCount = slabComponentStart[slabCount];
+		result.component.resize(result.runs.size());
+
+		#pragma omp parallel for if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			size_t c = slabComponentStart[s];
+			for (size_t i = slabStart[s]; i < slabStart[s + 1]; i++)
+			{
+				if (forest.find_set(i) == i)
+					result.component[i] = c++;
+			}
+		}
+
+		#pragma omp parallel for if(slabCount > 1 && !omp_in_parallel())
+		for (coord_t s = 0; s < slabCount; s++)
+		{
+			for (size_t i = slabStart[s]; i < slabStart[s + 1]; i++)
+			{
+				size_t root = forest.find_set(i);
+				if (root != i)
+					result.component[i] = result.component[root];
+			}
+
+			showThreadProgress(counter, 3 * slabCount, showProgress);
+		}
+	}
+
+	/**
+	Labels connected components of the input image.
+	The components are labeled with consecutive values starting from one, in the order they are encountered when the image is scanned in z, y, x order.
+	Background pixels are set to zero.
+	The input and output images may be the same image.
+	If the label data type does not support large enough values to label all the components, an exception is thrown.
+	@param in Input image.
+	@param out Output image.
+	@param connectivity Connectivity of the components.
+	@param regionColor Color of pixels that belong to the components. Pass zero to consider all nonzero pixels as foreground.
+	@return Count of components.
+	*/
+	template<typename pixel_t, typename label_t> size_t connectedComponents(const Image<pixel_t>& in, Image<label_t>& out, Connectivity connectivity = Connectivity::NearestNeighbours, pixel_t regionColor = 0, bool showProgress = true)
+	{
+		ComponentRuns runs;
+		if (regionColor == 0)
+			findComponents(in, [](pixel_t p) { return p != 0; }, connectivity, runs, true, showProgress);
+		else
+			findComponents(in, [=](pixel_t p) { return p == regionColor; }, connectivity, runs, true, showProgress);
+
+		if ((double)runs.componentCount > (double)std::numeric_limits<label_t>::max())
+			throw ITLException(string("Unable to label because there are not enough distinct pixel values available. The image contains ") + toString(runs.componentCount) + " regions. Consider using label image with higher bitdepth.");
+
+		out.ensureSize(in);
+		runs.fill(out, [](size_t c) { return (label_t)(c + 1); }, true);
+
+		return runs.componentCount;
+	}
+
+	namespace tests
+	{
+		void connectedComponents();
+		void connectedComponentsSpeed();
+	}
+}
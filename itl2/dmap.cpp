@@ -50,6 +50,66 @@ namespace itl2
 			dmap<uint32_t>("./input_data/test_piece_bin_256x256x256.raw", "./dmap/test_piece_result", "./input_data/test_piece_dmap_GT_256x256x256.raw", 0.5);
 			dmap<uint32_t>("./input_data/test_piece_bin_512x512x512.raw", "./dmap/test_piece_result", "./input_data/test_piece_dmap_GT_512x512x512.raw", 0.5);
 		}
+
+		namespace
+		{
+			/**
+			Calculates squared distance map and nearest background point of each pixel by brute force and compares them to the results of distanceTransform2.
+			*/
+			template<typename dmap_t> void dmapBruteForce(const Image<uint8_t>& img)
+			{
+				vector<Vec3c> background;
+				for (coord_t z = 0; z < img.depth(); z++)
+					for (coord_t y = 0; y < img.height(); y++)
+						for (coord_t x = 0; x < img.width(); x++)
+							if (img(x, y, z) == 0)
+								background.push_back(Vec3c(x, y, z));
+
+				Image<dmap_t> dmap, dmap2;
+				Image<Vec3c> nearest;
+				distanceTransform2(img, dmap, &nearest);
+				distanceTransform2(img, dmap2);
+
+				bool ok = true;
+				bool pointsOk = true;
+				for (coord_t z = 0; z < img.depth(); z++)
+				{
+					for (coord_t y = 0; y < img.height(); y++)
+					{
+						for (coord_t x = 0; x < img.width(); x++)
+						{
+							Vec3c p(x, y, z);
+							coord_t expected = std::numeric_limits<coord_t>::max();
+							for (const Vec3c& b : background)
+								expected = std::min(expected, (b - p).normSquared<coord_t>());
+
+							if ((coord_t)dmap(p) != expected || (coord_t)dmap2(p) != expected)
+								ok = false;
+							if ((nearest(p) - p).normSquared<coord_t>() != expected || img(nearest(p)) != 0)
+								pointsOk = false;
+						}
+					}
+				}
+
+				testAssert(ok, string("tiled distance map, ") + toString(imageDataType<dmap_t>()) + ", image size = " + toString(img.dimensions()));
+				testAssert(pointsOk, string("tiled distance map nearest object points, ") + toString(imageDataType<dmap_t>()) + ", image size = " + toString(img.dimensions()));
+			}
+		}
+
+		void dmapTiled()
+		{
+			// Image widths are chosen so that the last tile of rows is only partially filled.
+			for (const Vec3c& dims : { Vec3c(45, 38, 27), Vec3c(70, 3, 9), Vec3c(5, 40, 33) })
+			{
+				Image<uint8_t> img(dims);
+				for (coord_t n = 0; n < img.pixelCount(); n++)
+					img(n) = (n * 7919) % 97 < 2 ? 0 : 255;
+
+				dmapBruteForce<float32_t>(img);
+				dmapBruteForce<int32_t>(img);
+				dmapBruteForce<uint32_t>(img);
+			}
+		}
 		
 	}
 
@@ -52,26 +52,19 @@ namespace itl2
 
 		/*
 		Helper for distance map calculation.
-		Processes one row in dimension d whose start point is idx.
+		Processes one row of nd pixels starting from the given pointer. Consecutive pixels of the row are stride elements apart.
 		Optimized version that does not store nearest object point for each dmap point.
-		g and h are temporary images whose size must be output.dimension(d) x 1 x 1
+		g and h are temporary images whose size must be nd x 1 x 1
 		*/
-		template<typename pixel_t> void voronoi(size_t d, Vec3c idx, Image<pixel_t>& output, Image<pixel_t>& g, Image<pixel_t>& h)
+		template<typename pixel_t> void voronoi(pixel_t* row, coord_t stride, coord_t nd, Image<pixel_t>& g, Image<pixel_t>& h)
 		{
 			using signed_t = typename NumberUtils<pixel_t>::SignedType;
 
-			coord_t nd = output.dimension(d);
-
-			//Image<float32_t> g(nd);
-			//Image<float32_t> h(nd);
-
 			coord_t l = -1;
 
 			for (coord_t i = 0; i < nd; i++)
 			{
-				idx[d] = i;
-
-				pixel_t di = output(idx);
+				pixel_t di = row[i * stride];
 
 				pixel_t iw = static_cast<pixel_t>(i);
 
@@ -109,23 +102,11 @@ namespace itl2
 			{
 				pixel_t iw = static_cast<pixel_t>(i);
 
-				//pixel_t d1 = ::abs(g(l)) + (h(l) - iw) * (h(l) - iw);
-				//pixel_t d1 = g(l) + (pixel_t)(((signed_t)h(l) - (signed_t)iw) * ((signed_t)h(l) - (signed_t)iw));
-				//signed_t d1_tmp = (signed_t)g(l) + ((signed_t)h(l) - (signed_t)iw) * ((signed_t)h(l) - (signed_t)iw);
-				//if (d1_tmp >= std::numeric_limits<pixel_t>::max())
-				//	throw ITLException("Pixel data type cannot contain large enough values for calculating the distance map.");
-				//pixel_t d1 = (pixel_t)d1_tmp;
 				pixel_t d1 = calcD<pixel_t, signed_t>(g(l), h(l), iw);
 
 				while (l < ns)
 				{
 					// be sure to compute d2 *only* if l < ns
-					//pixel_t d2 = ::abs(g(l + 1)) + (h(l + 1) - iw) * (h(l + 1) - iw);
-					//pixel_t d2 = g(l + 1) + (pixel_t)(((signed_t)h(l + 1) - (signed_t)iw) * ((signed_t)h(l + 1) - (signed_t)iw));
-					//signed_t d2_tmp = (signed_t)g(l + 1) + ((signed_t)h(l + 1) - (signed_t)iw) * ((signed_t)h(l + 1) - (signed_t)iw);
-					//if (d2_tmp >= std::numeric_limits<pixel_t>::max())
-					//	throw ITLException("Pixel data type cannot contain large enough values for calculating the distance map.");
-					//pixel_t d2 = (pixel_t)d2_tmp;
 					pixel_t d2 = calcD<pixel_t, signed_t>(g(l + 1), h(l + 1), iw);
 
 					// then compare d1 and d2
@@ -136,36 +117,28 @@ namespace itl2
 					l++;
 					d1 = d2;
 				}
-				idx[d] = i;
 
-				output(idx) = d1;
+				row[i * stride] = d1;
 			}
 
 		}
 
 		/*
 		Helper for distance map calculation.
-		Processes one row in dimension d whose start point is idx.
-		Fills also nearestObjectPoint image by locations of nearest object point for each dmap point.
-		g, P, and h are temporary images whose size must be output.dimension(d) x 1 x 1
+		Processes one row of nd pixels starting from the given pointer. Consecutive pixels of the row are stride elements apart.
+		Fills also nearest object point row by locations of nearest object point for each dmap point.
+		The nearest object point row must have the same layout than the dmap row.
+		g, P, and h are temporary images whose size must be nd x 1 x 1
 		*/
-		template<typename pixel_t> void voronoi(size_t d, Vec3c idx, Image<pixel_t>& output, Image<Vec3c>& nearestObjectPoint, Image<pixel_t>& g, Image<Vec3c>& P, Image<pixel_t>& h)
+		template<typename pixel_t> void voronoi(pixel_t* row, Vec3c* nearestObjectPointRow, coord_t stride, coord_t nd, Image<pixel_t>& g, Image<Vec3c>& P, Image<pixel_t>& h)
 		{
 			using signed_t = typename NumberUtils<pixel_t>::SignedType;
 
-			coord_t nd = output.dimension(d);
-
-			//Image<float32_t> g(nd);
-			//Image<Vec3c> P(nd);
-			//Image<float32_t> h(nd);
-
 			coord_t l = -1;
 
 			for (coord_t i = 0; i < nd; i++)
 			{
-				idx[d] = i;
-
-				pixel_t di = output(idx);
+				pixel_t di = row[i * stride];
 
 				pixel_t iw = static_cast<pixel_t>(i);
 				
@@ -176,7 +149,7 @@ namespace itl2
 						l++;
 						g(l) = di;
 						h(l) = iw;
-						P(l) = nearestObjectPoint(idx);
+						P(l) = nearestObjectPointRow[i * stride];
 					}
 					else
 					{
@@ -187,7 +160,7 @@ namespace itl2
 						l++;
 						g(l) = di;
 						h(l) = iw;
-						P(l) = nearestObjectPoint(idx);
+						P(l) = nearestObjectPointRow[i * stride];
 					}
 				}
 			}
@@ -205,16 +178,12 @@ namespace itl2
 			{
 				pixel_t iw = static_cast<pixel_t>(i);
 
-				//pixel_t d1 = ::abs(g(l)) + (h(l) - iw) * (h(l) - iw);
-				//pixel_t d1 = g(l) + (pixel_t)(((signed_t)h(l) - (signed_t)iw) * ((signed_t)h(l) - (signed_t)iw));
 				pixel_t d1 = calcD<pixel_t, signed_t>(g(l), h(l), iw);
 				Vec3c Pc = P(l);
 
 				while (l < ns)
 				{
 					// be sure to compute d2 *only* if l < ns
-					//pixel_t d2 = ::abs(g(l + 1)) + (h(l + 1) - iw) * (h(l + 1) - iw);
-					//pixel_t d2 = g(l + 1) + (pixel_t)(((signed_t)h(l + 1) - (signed_t)iw) * ((signed_t)h(l + 1) - (signed_t)iw));
 					pixel_t d2 = calcD<pixel_t, signed_t>(g(l + 1), h(l + 1), iw);
 
 					// then compare d1 and d2
@@ -226,39 +195,84 @@ namespace itl2
 					d1 = d2;
 					Pc = P(l);
 				}
-				idx[d] = i;
 
-				output(idx) = d1;
+				row[i * stride] = d1;
 
-				nearestObjectPoint(idx) = Pc;
+				nearestObjectPointRow[i * stride] = Pc;
 			}
 
 		}
 
+		/**
+		Count of adjacent rows that are processed together in y- and z-directions.
+		The rows are copied to a contiguous buffer so that the image is read and written in runs of this many pixels
+		instead of one pixel per cache line.
+		*/
+		static const coord_t DMAP_TILE_WIDTH = 32;
 
+		/**
+		Copies a tile of rows between the image and a contiguous buffer.
+		The tile consists of rows in dimension d, starting at start and the next (count - 1) positions in the x-direction.
+		In the buffer, pixel i of row b is stored at buffer[i * DMAP_TILE_WIDTH + b].
+		@param toBuffer Set to true to copy from the image to the buffer, and to false to copy from the buffer to the image.
+		*/
+		template<typename pixel_t> void copyTile(Image<pixel_t>& img, size_t d, const Vec3c& start, coord_t count, std::vector<pixel_t>& buffer, bool toBuffer)
+		{
+			coord_t nd = img.dimension(d);
+			Vec3c pos = start;
+			for (coord_t i = 0; i < nd; i++)
+			{
+				pos[d] = i;
+				pixel_t* p = &img(pos);
+				pixel_t* q = &buffer[i * DMAP_TILE_WIDTH];
+				if (toBuffer)
+					std::copy(p, p + count, q);
+				else
+					std::copy(q, q + count, p);
+			}
+		}
+
+		/**
+		Processes all rows of the distance map in the given dimension.
+		Rows in x-direction are contiguous in memory and they are processed in-place.
+		Rows in y- and z-directions are processed in tiles of DMAP_TILE_WIDTH rows that are adjacent in the x-direction.
+		Each tile is copied to a contiguous buffer, processed there, and copied back.
+		*/
 		template<typename pixel_t>  void processDimension(Image<pixel_t>& output, size_t currentDimension, Image<Vec3c>* nearestObjectPoint, bool showProgressInfo = false)
 		{
-			// Determine count of pixels to process
+			coord_t nd = output.dimension(currentDimension);
+
+			// Determine count of tasks to process.
+			// Each task is one row in the x-direction, and one tile in the other directions.
 			Vec3c reducedDimensions = output.dimensions();
 			reducedDimensions[currentDimension] = 1;
-			coord_t rowCount = reducedDimensions.x * reducedDimensions.y * reducedDimensions.z;
+			if (currentDimension != 0)
+				reducedDimensions.x = (reducedDimensions.x + DMAP_TILE_WIDTH - 1) / DMAP_TILE_WIDTH;
+			coord_t taskCount = reducedDimensions.x * reducedDimensions.y * reducedDimensions.z;
 
 			bool failed = false;
 			ITLException error("");
 			size_t counter = 0;
 			#pragma omp parallel if(!omp_in_parallel() && output.pixelCount() > PARALLELIZATION_THRESHOLD)
 			{
-				// Temporary buffer
-				coord_t nd = output.dimension(currentDimension);
+				// Temporary buffers
 				Image<pixel_t> g(nd);
 				Image<Vec3c> P;
 				if (nearestObjectPoint)
 					P.ensureSize(nd);
 				Image<pixel_t> h(nd);
 
-				// Determine start points of pixel rows and process each row
+				std::vector<pixel_t> tile;
+				std::vector<Vec3c> pointTile;
+				if (currentDimension != 0)
+				{
+					tile.resize(nd * DMAP_TILE_WIDTH);
+					if (nearestObjectPoint)
+						pointTile.resize(nd * DMAP_TILE_WIDTH);
+				}
+
 				#pragma omp for
-				for (coord_t n = 0; n < rowCount; n++)
+				for (coord_t n = 0; n < taskCount; n++)
 				{
 				    if(!failed)
 				    {
@@ -266,23 +280,47 @@ namespace itl2
 					    {
 						    Vec3c start = indexToCoords(n, reducedDimensions);
 
-						    // Process the current row
-						    if (!nearestObjectPoint)
+						    if (currentDimension == 0)
 						    {
-							    voronoi(currentDimension, start, output, g, h);
+							    // Process the current row
+							    if (!nearestObjectPoint)
+								    voronoi(&output(start), 1, nd, g, h);
+							    else
+								    voronoi(&output(start), &(*nearestObjectPoint)(start), 1, nd, g, P, h);
 						    }
 						    else
 						    {
-							    voronoi(currentDimension, start, output, *nearestObjectPoint, g, P, h);
+							    // Process the current tile
+							    start.x *= DMAP_TILE_WIDTH;
+							    coord_t count = std::min(DMAP_TILE_WIDTH, output.width() - start.x);
+
+							    copyTile(output, currentDimension, start, count, tile, true);
+							    if (nearestObjectPoint)
+								    copyTile(*nearestObjectPoint, currentDimension, start, count, pointTile, true);
+
+							    for (coord_t b = 0; b < count; b++)
+							    {
+								    if (!nearestObjectPoint)
+									    voronoi(&tile[b], DMAP_TILE_WIDTH, nd, g, h);
+								    else
+									    voronoi(&tile[b], &pointTile[b], DMAP_TILE_WIDTH, nd, g, P, h);
+							    }
+
+							    copyTile(output, currentDimension, start, count, tile, false);
+							    if (nearestObjectPoint)
+								    copyTile(*nearestObjectPoint, currentDimension, start, count, pointTile, false);
 						    }
 					    }
 					    catch (ITLException ex)
 					    {
-						    error = ex;
-						    failed = true;
+						    #pragma omp critical(dmap_error)
+						    {
+							    error = ex;
+							    failed = true;
+						    }
 					    }
                     }
-					showThreadProgress(counter, rowCount, showProgressInfo);
+					showThreadProgress(counter, taskCount, showProgressInfo);
 				}
 			}
 
@@ -457,6 +495,7 @@ namespace itl2
 	namespace tests
 	{
 		void dmap1();
+		void dmapTiled();
 	}
 
 }
@@ -1,9 +1,662 @@
 
 #include "eval.h"
 #include "testutils.h"
+#include "generation.h"
+#include "pointprocess.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <map>
+#include <sstream>
+
+using namespace std;
 
 namespace itl2
 {
+	namespace internals
+	{
+		namespace
+		{
+			template<typename F> void unaryKernel(double* registers, size_t span, const EvalInstruction& ins, size_t count, F f)
+			{
+				double* out = registers + ins.out * span;
+				const double* a = registers + ins.a * span;
+				for (size_t i = 0; i < count; i++)
+					out[i] = f(a[i]);
+			}
+
+			template<typename F> void binaryKernel(double* registers, size_t span, const EvalInstruction& ins, size_t count, F f)
+			{
+				double* out = registers + ins.out * span;
+				const double* a = registers + ins.a * span;
+				const double* b = registers + ins.b * span;
+				for (size_t i = 0; i < count; i++)
+					out[i] = f(a[i], b[i]);
+			}
+
+			template<typename F> void ternaryKernel(double* registers, size_t span, const EvalInstruction& ins, size_t count, F f)
+			{
+				double* out = registers + ins.out * span;
+				const double* a = registers + ins.a * span;
+				const double* b = registers + ins.b * span;
+				const double* c = registers + ins.c * span;
+				for (size_t i = 0; i < count; i++)
+					out[i] = f(a[i], b[i], c[i]);
+			}
+
+			/**
+			Runs one instruction.
+			The operations mimic the corresponding exprtk operations for real numbers.
+			*/
+			void runInstruction(const EvalInstruction& ins, double* r, size_t span, size_t count)
+			{
+				switch (ins.op)
+				{
+				case EvalOp::Neg: unaryKernel(r, span, ins, count, [](double a) { return -a; }); break;
+				case EvalOp::Add: binaryKernel(r, span, ins, count, [](double a, double b) { return a + b; }); break;
+				case EvalOp::Sub: binaryKernel(r, span, ins, count, [](double a, double b) { return a - b; }); break;
+				case EvalOp::Mul: binaryKernel(r, span, ins, count, [](double a, double b) { return a * b; }); break;
+				case EvalOp::Div: binaryKernel(r, span, ins, count, [](double a, double b) { return a / b; }); break;
+				case EvalOp::Mod: binaryKernel(r, span, ins, count, [](double a, double b) { return std::fmod(a, b); }); break;
+				case EvalOp::Pow: binaryKernel(r, span, ins, count, [](double a, double b) { return std::pow(a, b); }); break;
+				case EvalOp::Lt: binaryKernel(r, span, ins, count, [](double a, double b) { return a < b ? 1.0 : 0.0; }); break;
+				case EvalOp::Lte: binaryKernel(r, span, ins, count, [](double a, double b) { return a <= b ? 1.0 : 0.0; }); break;
+				case EvalOp::Gt: binaryKernel(r, span, ins, count, [](double a, double b) { return a > b ? 1.0 : 0.0; }); break;
+				case EvalOp::Gte: binaryKernel(r, span, ins, count, [](double a, double b) { return a >= b ? 1.0 : 0.0; }); break;
+				case EvalOp::Eq: binaryKernel(r, span, ins, count, [](double a, double b) { return a == b ? 1.0 : 0.0; }); break;
+				case EvalOp::Ne: binaryKernel(r, span, ins, count, [](double a, double b) { return a != b ? 1.0 : 0.0; }); break;
+				case EvalOp::And: binaryKernel(r, span, ins, count, [](double a, double b) { return (a != 0 && b != 0) ? 1.0 : 0.0; }); break;
+				case EvalOp::Or: binaryKernel(r, span, ins, count, [](double a, double b) { return (a != 0 || b != 0) ? 1.0 : 0.0; }); break;
+				case EvalOp::Xor: binaryKernel(r, span, ins, count, [](double a, double b) { return ((a == 0) != (b == 0)) ? 1.0 : 0.0; }); break;
+				case EvalOp::Not: unaryKernel(r, span, ins, count, [](double a) { return a != 0 ? 0.0 : 1.0; }); break;
+				case EvalOp::Abs: unaryKernel(r, span, ins, count, [](double a) { return std::abs(a); }); break;
+				case EvalOp::Sqrt: unaryKernel(r, span, ins, count, [](double a) { return std::sqrt(a); }); break;
+				case EvalOp::Exp: unaryKernel(r, span, ins, count, [](double a) { return std::exp(a); }); break;
+				case EvalOp::Log: unaryKernel(r, span, ins, count, [](double a) { return std::log(a); }); break;
+				case EvalOp::Log10: unaryKernel(r, span, ins, count, [](double a) { return std::log10(a); }); break;
+				case EvalOp::Sin: unaryKernel(r, span, ins, count, [](double a) { return std::sin(a); }); break;
+				case EvalOp::Cos: unaryKernel(r, span, ins, count, [](double a) { return std::cos(a); }); break;
+				case EvalOp::Tan: unaryKernel(r, span, ins, count, [](double a) { return std::tan(a); }); break;
+				case EvalOp::Asin: unaryKernel(r, span, ins, count, [](double a) { return std::asin(a); }); break;
+				case EvalOp::Acos: unaryKernel(r, span, ins, count, [](double a) { return std::acos(a); }); break;
+				case EvalOp::Atan: unaryKernel(r, span, ins, count, [](double a) { return std::atan(a); }); break;
+				case EvalOp::Sinh: unaryKernel(r, span, ins, count, [](double a) { return std::sinh(a); }); break;
+				case EvalOp::Cosh: unaryKernel(r, span, ins, count, [](double a) { return std::cosh(a); }); break;
+				case EvalOp::Tanh: unaryKernel(r, span, ins, count, [](double a) { return std::tanh(a); }); break;
+				case EvalOp::Floor: unaryKernel(r, span, ins, count, [](double a) { return std::floor(a); }); break;
+				case EvalOp::Ceil: unaryKernel(r, span, ins, count, [](double a) { return std::ceil(a); }); break;
+				case EvalOp::Round: unaryKernel(r, span, ins, count, [](double a) { return a < 0 ? std::ceil(a - 0.5) : std::floor(a + 0.5); }); break;
+				case EvalOp::Trunc: unaryKernel(r, span, ins, count, [](double a) { return std::trunc(a); }); break;
+				case EvalOp::Sgn: unaryKernel(r, span, ins, count, [](double a) { return a > 0 ? 1.0 : (a < 0 ? -1.0 : 0.0); }); break;
+				case EvalOp::Min: binaryKernel(r, span, ins, count, [](double a, double b) { return std::min(a, b); }); break;
+				case EvalOp::Max: binaryKernel(r, span, ins, count, [](double a, double b) { return std::max(a, b); }); break;
+				case EvalOp::Atan2: binaryKernel(r, span, ins, count, [](double a, double b) { return std::atan2(a, b); }); break;
+				case EvalOp::Hypot: binaryKernel(r, span, ins, count, [](double a, double b) { return std::sqrt(a * a + b * b); }); break;
+				case EvalOp::Select: ternaryKernel(r, span, ins, count, [](double a, double b, double c) { return a != 0 ? b : c; }); break;
+				case EvalOp::Clamp: ternaryKernel(r, span, ins, count, [](double lo, double x, double hi) { return x < lo ? lo : (x > hi ? hi : x); }); break;
+				default: throw logic_error("Invalid bytecode instruction.");
+				}
+			}
+
+			/**
+			Thrown when the expression cannot be compiled into bytecode.
+			*/
+			struct Unsupported
+			{
+			};
+
+			/**
+			Node of expression tree.
+			*/
+			struct Node
+			{
+				enum class Kind { Input, Constant, Operation } kind;
+				EvalOp op;
+				double value;
+				size_t input;
+				vector<size_t> args;
+			};
+
+			/**
+			Recursive descent parser for the supported subset of the exprtk syntax.
+			The precedence of the operators follows exprtk.
+			*/
+			class Compiler
+			{
+			private:
+				const string& expr;
+				size_t inputCount;
+				size_t pos = 0;
+
+				/**
+				Current token. Identifiers are converted to lower case.
+				Empty string denotes end of the expression.
+				*/
+				string token;
+				bool tokenIsNumber = false;
+				double tokenValue = 0;
+
+				void next()
+				{
+					while (pos < expr.length() && isspace((unsigned char)expr[pos]))
+						pos++;
+
+					tokenIsNumber = false;
+					token.clear();
+
+					if (pos >= expr.length())
+						return;
+
+					char c = expr[pos];
+					if (isdigit((unsigned char)c) || (c == '.' && pos + 1 < expr.length() && isdigit((unsigned char)expr[pos + 1])))
+					{
+						size_t start = pos;
+						while (pos < expr.length() && (isdigit((unsigned char)expr[pos]) || expr[pos] == '.'))
+							pos++;
+						if (pos < expr.length() && (expr[pos] == 'e' || expr[pos] == 'E'))
+						{
+							size_t p = pos + 1;
+							if (p < expr.length() && (expr[p] == '+' || expr[p] == '-'))
+								p++;
+							if (p < expr.length() && isdigit((unsigned char)expr[p]))
+							{
+								pos = p;
+								while (pos < expr.length() && isdigit((unsigned char)expr[pos]))
+									pos++;
+							}
+						}
+
+						token = expr.substr(start, pos - start);
+						istringstream str(token);
+						str.imbue(locale::classic());
+						str >> tokenValue;
+						if (!str || !str.eof())
+							throw Unsupported();
+						tokenIsNumber = true;
+					}
+					else if (isalpha((unsigned char)c) || c == '_')
+					{
+						while (pos < expr.length() && (isalnum((unsigned char)expr[pos]) || expr[pos] == '_'))
+						{
+							token += (char)tolower((unsigned char)expr[pos]);
+							pos++;
+						}
+					}
+					else
+					{
+						static const char* twoCharOps[] = { "<=", ">=", "==", "!=", "<>", "&&", "||" };
+						for (const char* op : twoCharOps)
+						{
+							if (expr.compare(pos, 2, op) == 0)
+							{
+								token = op;
+								pos += 2;
+								return;
+							}
+						}
+
+						if (strchr("+-*/%^(),?:<>=&|", c) == nullptr)
+							throw Unsupported();
+
+						token = string(1, c);
+						pos++;
+					}
+				}
+
+				void expect(const string& t)
+				{
+					if (token != t || tokenIsNumber)
+						throw Unsupported();
+					next();
+				}
+
+				bool accept(const string& t)
+				{
+					if (token == t && !tokenIsNumber)
+					{
+						next();
+						return true;
+					}
+					return false;
+				}
+
+				size_t constant(double value)
+				{
+					Node n;
+					n.kind = Node::Kind::Constant;
+					n.op = EvalOp::Neg;
+					n.value = value;
+					n.input = 0;
+					nodes.push_back(n);
+					return nodes.size() - 1;
+				}
+
+				/**
+				Adds operation node. Operations on constants are evaluated immediately.
+				*/
+				size_t operation(EvalOp op, const vector<size_t>& args)
+				{
+					bool allConstant = true;
+					for (size_t arg : args)
+						allConstant = allConstant && nodes[arg].kind == Node::Kind::Constant;
+
+					if (allConstant)
+					{
+						double r[4] = { 0, 0, 0, 0 };
+						EvalInstruction ins = { op, 0, 1, 2, 3 };
+						for (size_t n = 0; n < args.size(); n++)
+							r[n + 1] = nodes[args[n]].value;
+						runInstruction(ins, r, 1, 1);
+						return constant(r[0]);
+					}
+
+					Node n;
+					n.kind = Node::Kind::Operation;
+					n.op = op;
+					n.value = 0;
+					n.input = 0;
+					n.args = args;
+					nodes.push_back(n);
+					return nodes.size() - 1;
+				}
+
+				size_t ternary()
+				{
+					size_t cond = logicalOr();
+					if (accept("?"))
+					{
+						size_t a = ternary();
+						expect(":");
+						size_t b = ternary();
+						return operation(EvalOp::Select, { cond, a, b });
+					}
+					return cond;
+				}
+
+				size_t logicalOr()
+				{
+					size_t left = logicalAnd();
+					while (true)
+					{
+						if (accept("or") || accept("|") || accept("||"))
+							left = operation(EvalOp::Or, { left, logicalAnd() });
+						else if (accept("xor"))
+							left = operation(EvalOp::Xor, { left, logicalAnd() });
+						else
+							return left;
+					}
+				}
+
+				size_t logicalAnd()
+				{
+					size_t left = comparison();
+					while (accept("and") || accept("&") || accept("&&"))
+						left = operation(EvalOp::And, { left, comparison() });
+					return left;
+				}
+
+				size_t comparison()
+				{
+					size_t left = additive();
+					while (true)
+					{
+						EvalOp op;
+						if (accept("<"))
+							op = EvalOp::Lt;
+						else if (accept("<="))
+							op = EvalOp::Lte;
+						else if (accept(">"))
+							op = EvalOp::Gt;
+						else if (accept(">="))
+							op = EvalOp::Gte;
+						else if (accept("==") || accept("="))
+							op = EvalOp::Eq;
+						else if (accept("!=") || accept("<>"))
+							op = EvalOp::Ne;
+						else
+							return left;
+
+						left = operation(op, { left, additive() });
+					}
+				}
+
+				size_t additive()
+				{
+					size_t left = multiplicative();
+					while (true)
+					{
+						if (accept("+"))
+							left = operation(EvalOp::Add, { left, multiplicative() });
+						else if (accept("-"))
+							left = operation(EvalOp::Sub, { left, multiplicative() });
+						else
+							return left;
+					}
+				}
+
+				size_t multiplicative()
+				{
+					size_t left = unary();
+					while (true)
+					{
+						if (accept("*"))
+							left = operation(EvalOp::Mul, { left, unary() });
+						else if (accept("/"))
+							left = operation(EvalOp::Div, { left, unary() });
+						else if (accept("%"))
+							left = operation(EvalOp::Mod, { left, unary() });
+						else
+							return left;
+					}
+				}
+
+				size_t unary()
+				{
+					// Unary minus binds less tightly than power, i.e. -a^b = -(a^b).
+					if (accept("-"))
+						return operation(EvalOp::Neg, { unary() });
+					if (accept("+"))
+						return unary();
+					return power();
+				}
+
+				size_t power()
+				{
+					// Power is right-associative.
+					size_t base = primary();
+					if (accept("^"))
+						return operation(EvalOp::Pow, { base, unary() });
+					return base;
+				}
+
+				vector<size_t> arguments()
+				{
+					vector<size_t> args;
+					expect("(");
+					args.push_back(ternary());
+					while (accept(","))
+						args.push_back(ternary());
+					expect(")");
+					return args;
+				}
+
+				size_t primary()
+				{
+					if (tokenIsNumber)
+					{
+						double v = tokenValue;
+						next();
+						return constant(v);
+					}
+
+					if (accept("("))
+					{
+						size_t n = ternary();
+						expect(")");
+						return n;
+					}
+
+					if (token.empty() || !(isalpha((unsigned char)token[0]) || token[0] == '_'))
+						throw Unsupported();
+
+					string name = token;
+					next();
+
+					if (name == "pi")
+						return constant(3.14159265358979323846264338327950288419716939937510);
+					if (name == "epsilon")
+						return constant(0.000000000100);
+					if (name == "inf")
+						return constant(numeric_limits<double>::infinity());
+					if (name == "true")
+						return constant(1);
+					if (name == "false")
+						return constant(0);
+
+					if (name.length() >= 2 && name[0] == 'x' && all_of(name.begin() + 1, name.end(), [](char c) { return isdigit((unsigned char)c); }))
+					{
+						if (name.length() > 2 && name[1] == '0')
+							throw Unsupported();
+						size_t index = fromString<size_t>(name.substr(1));
+						if (index >= inputCount)
+							throw Unsupported();
+						Node n;
+						n.kind = Node::Kind::Input;
+						n.op = EvalOp::Neg;
+						n.value = 0;
+						n.input = index;
+						nodes.push_back(n);
+						return nodes.size() - 1;
+					}
+
+					static const map<string, EvalOp> unaryFunctions =
+					{
+						{ "abs", EvalOp::Abs }, { "sqrt", EvalOp::Sqrt }, { "exp", EvalOp::Exp }, { "log", EvalOp::Log }, { "log10", EvalOp::Log10 },
+						{ "sin", EvalOp::Sin }, { "cos", EvalOp::Cos }, { "tan", EvalOp::Tan }, { "asin", EvalOp::Asin }, { "acos", EvalOp::Acos }, { "atan", EvalOp::Atan },
+						{ "sinh", EvalOp::Sinh }, { "cosh", EvalOp::Cosh }, { "tanh", EvalOp::Tanh },
+						{ "floor", EvalOp::Floor }, { "ceil", EvalOp::Ceil }, { "round", EvalOp::Round }, { "trunc", EvalOp::Trunc }, { "sgn", EvalOp::Sgn },
+						{ "not", EvalOp::Not }
+					};
+					static const map<string, EvalOp> binaryFunctions =
+					{
+						{ "pow", EvalOp::Pow }, { "atan2", EvalOp::Atan2 }, { "hypot", EvalOp::Hypot }
+					};
+
+					vector<size_t> args = arguments();
+
+					auto it = unaryFunctions.find(name);
+					if (it != unaryFunctions.end())
+					{
+						if (args.size() != 1)
+							throw Unsupported();
+						return operation(it->second, args);
+					}
+
+					it = binaryFunctions.find(name);
+					if (it != binaryFunctions.end())
+					{
+						if (args.size() != 2)
+							throw Unsupported();
+						return operation(it->second, args);
+					}
+
+					if (name == "min" || name == "max")
+					{
+						EvalOp op = name == "min" ? EvalOp::Min : EvalOp::Max;
+						size_t result = args[0];
+						for (size_t n = 1; n < args.size(); n++)
+							result = operation(op, { result, args[n] });
+						return result;
+					}
+
+					if (name == "if" && args.size() == 3)
+						return operation(EvalOp::Select, args);
+
+					if (name == "clamp" && args.size() == 3)
+						return operation(EvalOp::Clamp, args);
+
+					throw Unsupported();
+				}
+
+			public:
+				vector<Node> nodes;
+
+				Compiler(const string& expression, size_t inputCount) : expr(expression), inputCount(inputCount)
+				{
+				}
+
+				/**
+				Parses the expression and returns index of the root node.
+				*/
+				size_t parse()
+				{
+					next();
+					size_t root = ternary();
+					if (!token.empty() || tokenIsNumber)
+						throw Unsupported();
+					return root;
+				}
+			};
+		}
+
+		bool EvalProgram::compile(const string& expression, size_t inputCount)
+		{
+			code.clear();
+			constants.clear();
+			this->inputCount = inputCount;
+
+			Compiler compiler(expression, inputCount);
+			size_t root;
+			try
+			{
+				root = compiler.parse();
+			}
+			catch (Unsupported&)
+			{
+				return false;
+			}
+
+			const vector<Node>& nodes = compiler.nodes;
+
+			// Assign registers to constants.
+			map<uint64_t, size_t> constantRegs;
+			auto constantReg = [&](double value)
+			{
+				uint64_t key;
+				memcpy(&key, &value, sizeof(key));
+				auto it = constantRegs.find(key);
+				if (it != constantRegs.end())
+					return it->second;
+				size_t reg = inputCount + constants.size();
+				constants.push_back(value);
+				constantRegs[key] = reg;
+				return reg;
+			};
+
+			// Collect constants before allocating temporary registers.
+			vector<size_t> stack = { root };
+			while (!stack.empty())
+			{
+				const Node& n = nodes[stack.back()];
+				stack.pop_back();
+				if (n.kind == Node::Kind::Constant)
+					constantReg(n.value);
+				for (size_t arg : n.args)
+					stack.push_back(arg);
+			}
+
+			// Generate code. Temporary registers are reused as soon as their values are not needed anymore.
+			regCount = inputCount + constants.size();
+			vector<size_t> freeRegs;
+			size_t firstTemp = regCount;
+			std::function<size_t(size_t)> generate = [&](size_t index) -> size_t
+			{
+				const Node& n = nodes[index];
+				if (n.kind == Node::Kind::Input)
+					return n.input;
+				if (n.kind == Node::Kind::Constant)
+					return constantReg(n.value);
+
+				size_t argRegs[3] = { 0, 0, 0 };
+				for (size_t i = 0; i < n.args.size(); i++)
+					argRegs[i] = generate(n.args[i]);
+
+				for (size_t i = 0; i < n.args.size(); i++)
+				{
+					if (argRegs[i] >= firstTemp && find(freeRegs.begin(), freeRegs.end(), argRegs[i]) == freeRegs.end())
+						freeRegs.push_back(argRegs[i]);
+				}
+
+				size_t out;
+				if (!freeRegs.empty())
+				{
+					out = freeRegs.back();
+					freeRegs.pop_back();
+				}
+				else
+				{
+					out = regCount++;
+				}
+
+				code.push_back({ n.op, out, argRegs[0], argRegs[1], argRegs[2] });
+				return out;
+			};
+			resultReg = generate(root);
+
+			// Make sure that the program gives the same results than exprtk.
+			// This catches differences in operator precedence, function semantics etc.
+			const double sampleValues[] = { 0, 1, -1, 2, 3, -3.5, 0.5, 0.25, 7, 10, 100.75, 255, 1000, -65535, 1e-3, 12345.678 };
+			constexpr size_t valueCount = sizeof(sampleValues) / sizeof(sampleValues[0]);
+			constexpr size_t sampleCount = 64;
+
+			vector<double> registers(regCount * sampleCount);
+			initConstants(registers.data(), sampleCount);
+
+			vector<double> varValues;
+			vector<ImageBase*> dummyParams(inputCount, nullptr);
+			symbol_table_t symbols;
+			expression_t expr;
+			try
+			{
+				std::tie(symbols, expr) = internals::parse(expression, dummyParams, varValues);
+			}
+			catch (ITLException&)
+			{
+				return false;
+			}
+
+			vector<double> expected(sampleCount);
+			uint32_t seed = 1;
+			for (size_t k = 0; k < sampleCount; k++)
+			{
+				for (size_t m = 0; m < inputCount; m++)
+				{
+					// Simple linear congruential generator so that the samples are reproducible.
+					seed = seed * 1664525 + 1013904223;
+					double v = sampleValues[(seed >> 16) % valueCount];
+					registers[m * sampleCount + k] = v;
+					varValues[m] = v;
+				}
+				expected[k] = expr.value();
+			}
+
+			run(registers.data(), sampleCount, sampleCount);
+
+			for (size_t k = 0; k < sampleCount; k++)
+			{
+				double a = registers[resultReg * sampleCount + k];
+				double b = expected[k];
+				if (std::isnan(a) && std::isnan(b))
+					continue;
+				if (a == b)
+					continue;
+				if (!(std::abs(a - b) <= 1e-9 * std::max(1.0, std::max(std::abs(a), std::abs(b)))))
+					return false;
+			}
+
+			return true;
+		}
+
+		void EvalProgram::initConstants(double* registers, size_t span) const
+		{
+			for (size_t n = 0; n < constants.size(); n++)
+			{
+				double* p = registers + (inputCount + n) * span;
+				for (size_t i = 0; i < span; i++)
+					p[i] = constants[n];
+			}
+		}
+
+		void EvalProgram::run(double* registers, size_t span, size_t count) const
+		{
+			for (const EvalInstruction& ins : code)
+				runInstruction(ins, registers, span, count);
+		}
+	}
+
 	namespace tests
 	{
 		void eval()
@@ -24,5 +677,44 @@ namespace itl2
 			itl2::eval("x0 + 2 * x1", out, std::vector<ImageBase*>{&param1, & param2});
 			checkDifference(out, ans, "eval result");
 		}
+
+		void evalBytecode()
+		{
+			Image<float32_t> param1(100, 110, 120);
+			Image<uint16_t> param2(100, 110, 120);
+			ramp(param1, 0);
+			multiply(param1, 0.1f);
+			ramp(param2, 1);
+
+			const vector<string> expressions =
+			{
+				"x0 + 2 * x1",
+				"-x0^2 + x1 / 3 - 1",
+				"2^3^x0 % 7",
+				"x0 > 5 and x1 < 50 ? sqrt(x0) : max(x0, x1, 17)",
+				"if(x0 == x1, 1, clamp(0, sin(x0) * cos(x1) + abs(x0 - x1), 100))",
+				"round(x0) + floor(x1 / 7) - ceil(x0 / 3) + trunc(-x0) + sgn(x1 - 50)",
+				"not(x0 < 2) or x1 >= 60 xor x0 <> 3",
+				"hypot(x0, x1) + atan2(x0, x1) + log(x1 + 1) + log10(x0 + 1) + exp(-x0) + pow(x0, 0.5) + tanh(x1) + pi",
+			};
+
+			for (const string& expression : expressions)
+			{
+				internals::EvalProgram program;
+				testAssert(program.compile(expression, 2), string("compile ") + expression);
+
+				Image<float32_t> result(param1.dimensions());
+				Image<float32_t> gt(param1.dimensions());
+				internals::evalProgram(program, result, vector<ImageBase*>{ &param1, &param2 });
+				internals::evalExprtk(expression, gt, vector<ImageBase*>{ &param1, &param2 });
+				checkDifference(result, gt, string("bytecode result of ") + expression);
+			}
+
+			// Expressions that are not supported by the bytecode evaluator.
+			internals::EvalProgram program;
+			testAssert(!program.compile("2x0", 1), "implicit multiplication");
+			testAssert(!program.compile("roundn(x0, 2)", 1), "unsupported function");
+			testAssert(!program.compile("x1", 1), "too large input index");
+		}
 	}
-}
\ No newline at end of file
+}
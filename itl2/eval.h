@@ -40,12 +40,208 @@ namespace itl2
 
 			return std::make_tuple(symbol_table, expr);
 		}
+
+		/**
+		Operations of the bytecode evaluator.
+		*/
+		enum class EvalOp
+		{
+			Neg, Add, Sub, Mul, Div, Mod, Pow,
+			Lt, Lte, Gt, Gte, Eq, Ne,
+			And, Or, Xor, Not,
+			Abs, Sqrt, Exp, Log, Log10, Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh,
+			Floor, Ceil, Round, Trunc, Sgn,
+			Min, Max, Atan2, Hypot,
+			Select, Clamp
+		};
+
+		/**
+		One instruction of the bytecode evaluator.
+		Calculates out = op(a, b, c) for each element in a span of registers.
+		Unused operands are zero.
+		*/
+		struct EvalInstruction
+		{
+			EvalOp op;
+			size_t out;
+			size_t a;
+			size_t b;
+			size_t c;
+		};
+
+		/**
+		Expression compiled into a flat register-based program that is evaluated for spans of pixels at a time.
+		Each register contains values for all pixels in the span.
+		Registers [0, inputCount) contain the values of x0, x1, x2, etc., followed by registers that contain constants,
+		and finally registers for temporary values.
+		Only a commonly used subset of the exprtk syntax is supported.
+		*/
+		class EvalProgram
+		{
+		private:
+			std::vector<EvalInstruction> code;
+			std::vector<double> constants;
+			size_t inputCount = 0;
+			size_t regCount = 0;
+			size_t resultReg = 0;
+
+		public:
+			/**
+			Compiles the given expression.
+			Returns false if the expression contains constructs that are not supported by the bytecode evaluator,
+			or if the program does not produce the same results than exprtk for some test values.
+			In that case the expression must be evaluated using exprtk.
+			*/
+			bool compile(const std::string& expression, size_t inputCount);
+
+			/**
+			Gets count of registers required to run the program.
+			*/
+			size_t registerCount() const
+			{
+				return regCount;
+			}
+
+			/**
+			Gets index of the register that contains the result after the program has been run.
+			*/
+			size_t resultRegister() const
+			{
+				return resultReg;
+			}
+
+			/**
+			Fills the constant registers.
+			@param registers Register storage, registerCount() * span values.
+			@param span Count of values in each register.
+			*/
+			void initConstants(double* registers, size_t span) const;
+
+			/**
+			Runs the program.
+			The input registers and the constant registers must be set before calling this method.
+			@param registers Register storage, registerCount() * span values.
+			@param span Count of values in each register.
+			@param count Count of values to process in each register, count <= span.
+			*/
+			void run(double* registers, size_t span, size_t count) const;
+		};
+
+		/**
+		Converts pixels [start, start + count) of the given image to double values.
+		Pixels of non-scalar images are converted to zero like in ImageBase::getf.
+		*/
+		template<typename pixel_t> void loadSpan(const Image<pixel_t>& img, coord_t start, coord_t count, double* out)
+		{
+			if constexpr (std::is_arithmetic_v<pixel_t>)
+			{
+				const pixel_t* p = img.getData() + start;
+				for (coord_t n = 0; n < count; n++)
+					out[n] = (double)p[n];
+			}
+			else
+			{
+				for (coord_t n = 0; n < count; n++)
+					out[n] = 0.0;
+			}
+		}
+
+		inline void loadSpan(ImageBase& img, coord_t start, coord_t count, double* out)
+		{
+			switch (img.dataType())
+			{
+			case ImageDataType::UInt8: loadSpan((Image<uint8_t>&)img, start, count, out); break;
+			case ImageDataType::UInt16: loadSpan((Image<uint16_t>&)img, start, count, out); break;
+			case ImageDataType::UInt32: loadSpan((Image<uint32_t>&)img, start, count, out); break;
+			case ImageDataType::UInt64: loadSpan((Image<uint64_t>&)img, start, count, out); break;
+			case ImageDataType::Int8: loadSpan((Image<int8_t>&)img, start, count, out); break;
+			case ImageDataType::Int16: loadSpan((Image<int16_t>&)img, start, count, out); break;
+			case ImageDataType::Int32: loadSpan((Image<int32_t>&)img, start, count, out); break;
+			case ImageDataType::Int64: loadSpan((Image<int64_t>&)img, start, count, out); break;
+			case ImageDataType::Float32: loadSpan((Image<float32_t>&)img, start, count, out); break;
+			default:
+				for (coord_t n = 0; n < count; n++)
+					out[n] = img.getf(start + n);
+				break;
+			}
+		}
+
+		/**
+		Count of pixels processed at once by the bytecode evaluator.
+		*/
+		constexpr coord_t EVAL_SPAN = 1024;
+	}
+
+	namespace internals
+	{
+		/**
+		Evaluates mathematical expression pixel by pixel using exprtk.
+		Does not check image sizes.
+		*/
+		template<typename target_t> void evalExprtk(const std::string& expression, Image<target_t>& target, const std::vector<ImageBase*>& params)
+		{
+			#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				// Parse again to make separate expression object for each thread.
+				std::vector<double> varValues;
+				symbol_table_t symbols;
+				expression_t expr;
+				// Note: This does not work in clang
+				//auto [symbols, expr] = parse(expression, params, varValues);
+				std::tie(symbols, expr) = parse(expression, params, varValues);
+
+				#pragma omp for
+				for (coord_t n = 0; n < target.pixelCount(); n++)
+				{
+					for (size_t m = 0; m < params.size(); m++)
+						varValues[m] = params[m]->getf(n);
+
+					double result = expr.value();
+					target(n) = pixelRound<target_t>(result);
+				}
+			}
+		}
+
+		/**
+		Evaluates compiled expression for spans of pixels.
+		Does not check image sizes.
+		*/
+		template<typename target_t> void evalProgram(const EvalProgram& program, Image<target_t>& target, const std::vector<ImageBase*>& params)
+		{
+			coord_t spanCount = (target.pixelCount() + EVAL_SPAN - 1) / EVAL_SPAN;
+
+			#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				std::vector<double> registers(program.registerCount() * EVAL_SPAN);
+				program.initConstants(registers.data(), EVAL_SPAN);
+
+				#pragma omp for
+				for (coord_t n = 0; n < spanCount; n++)
+				{
+					coord_t start = n * EVAL_SPAN;
+					coord_t count = std::min(EVAL_SPAN, target.pixelCount() - start);
+
+					// The input values are read before the results are written so the target may be one of the parameters.
+					for (size_t m = 0; m < params.size(); m++)
+						loadSpan(*params[m], start, count, &registers[m * EVAL_SPAN]);
+
+					program.run(registers.data(), EVAL_SPAN, count);
+
+					const double* result = &registers[program.resultRegister() * EVAL_SPAN];
+					target_t* out = target.getData() + start;
+					for (coord_t i = 0; i < count; i++)
+						out[i] = pixelRound<target_t>(result[i]);
+				}
+			}
+		}
 	}
 
 	/**
 	Evaluates mathematical expression, given as a string, on each pixel of the target and the argument images.
 	The result is assigned into the corresponding pixel of the target image.
 	The parameter images can be referenced in the expression using terms x0, x1, x2, etc.
+	Commonly used expressions are compiled into a bytecode program that is evaluated for spans of pixels at a time.
+	Other expressions are evaluated pixel by pixel using exprtk.
 	*/
 	template<typename target_t> void eval(const std::string& expression, Image<target_t>& target, const std::vector<ImageBase*>& params)
 	{
@@ -59,30 +255,16 @@ namespace itl2
 			target.checkSize(*params[n]);
 		}
 
-		#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
-		{
-			// Parse again to make separate expression object for each thread.
-			std::vector<double> varValues;
-			internals::symbol_table_t symbols;
-			internals::expression_t expr;
-			// Note: This does not work in clang
-			//auto [symbols, expr] = internals::parse(expression, params, varValues);
-			std::tie(symbols, expr) = internals::parse(expression, params, varValues);
-
-			#pragma omp for
-			for (coord_t n = 0; n < target.pixelCount(); n++)
-			{
-				for (size_t m = 0; m < params.size(); m++)
-					varValues[m] = params[m]->getf(n);
-
-				double result = expr.value();
-				target(n) = pixelRound<target_t>(result);
-			}
-		}
+		internals::EvalProgram program;
+		if (program.compile(expression, params.size()))
+			internals::evalProgram(program, target, params);
+		else
+			internals::evalExprtk(expression, target, params);
 	}
 
 	namespace tests
 	{
 		void eval();
+		void evalBytecode();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "fastmedianfilter.h"
+#include "filters.h"
+#include "noise.h"
+#include "testutils.h"
+
+namespace itl2
+{
+	namespace tests
+	{
+		template<typename pixel_t> void testOneSlidingMedian(const Image<pixel_t>& img, const Vec3c& r, NeighbourhoodType nbType, BoundaryCondition bc)
+		{
+			Image<pixel_t> gt;
+			filter<pixel_t, pixel_t, internals::medianOp<pixel_t> >(img, gt, r, nbType, bc);
+
+			Image<pixel_t> result;
+			slidingMedianFilter(img, result, r, nbType, bc);
+
+			checkDifference(result, gt, string("sliding median, ") + typeid(pixel_t).name() + ", r = " + toString(r) + ", " + toString(nbType) + ", " + toString(bc));
+		}
+
+		template<typename pixel_t> void testSlidingMedian(Image<pixel_t>& img)
+		{
+			noise(img, (double)NumberUtils<pixel_t>::scale() / 2, (double)NumberUtils<pixel_t>::scale() / 5, 123);
+
+			for (NeighbourhoodType nbType : { NeighbourhoodType::Rectangular, NeighbourhoodType::Ellipsoidal })
+			{
+				for (BoundaryCondition bc : { BoundaryCondition::Zero, BoundaryCondition::Nearest })
+				{
+					testOneSlidingMedian(img, Vec3c(1, 1, 1), nbType, bc);
+					testOneSlidingMedian(img, Vec3c(3, 2, 1), nbType, bc);
+					testOneSlidingMedian(img, Vec3c(0, 2, 2), nbType, bc);
+					testOneSlidingMedian(img, Vec3c(4, 4, 4), nbType, bc);
+				}
+			}
+		}
+
+		void slidingMedian()
+		{
+			// Image smaller than the neighbourhood
+			Image<uint8_t> small(3, 2, 2);
+			noise(small, 100, 30, 123);
+			testOneSlidingMedian(small, Vec3c(4, 4, 4), NeighbourhoodType::Ellipsoidal, BoundaryCondition::Nearest);
+
+			Image<uint8_t> img8(37, 29, 21);
+			testSlidingMedian(img8);
+
+			Image<uint16_t> img16(37, 29, 21);
+			testSlidingMedian(img16);
+
+			Image<int16_t> imgs16(37, 29, 21);
+			testSlidingMedian(imgs16);
+
+			Image<float32_t> img32(37, 29, 21);
+			testSlidingMedian(img32);
+
+			Image<uint16_t> img2d(100, 80);
+			testSlidingMedian(img2d);
+		}
+	}
+}
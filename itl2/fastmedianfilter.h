@@ -0,0 +1,467 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cmath>
+
+#include "image.h"
+#include "neighbourhood.h"
+#include "math/numberutils.h"
+#include "utilities.h"
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Describes one row (in x-direction) of a median filtering neighbourhood.
+		The row contains pixels from -rx to rx (inclusive) relative to the center of the neighbourhood, at y and z offsets dy and dz.
+		*/
+		struct MedianWindowRow
+		{
+			coord_t dy;
+			coord_t dz;
+			coord_t rx;
+		};
+
+		/**
+		Converts neighbourhood defined by type and radius to a list of rows in x-direction.
+		Ellipsoidal neighbourhoods are convex, so each row in the mask is one contiguous span symmetric around x = 0.
+		@param pixelCount Total count of pixels in the neighbourhood is assigned to this variable.
+		*/
+		inline std::vector<MedianWindowRow> createMedianWindowRows(NeighbourhoodType nbType, const Vec3c& nbRadius, coord_t& pixelCount)
+		{
+			Image<uint8_t> mask;
+			createNeighbourhoodMask(nbType, nbRadius, mask);
+
+			std::vector<MedianWindowRow> rows;
+			pixelCount = 0;
+			for (coord_t z = 0; z < mask.depth(); z++)
+			{
+				for (coord_t y = 0; y < mask.height(); y++)
+				{
+					coord_t rx = -1;
+					for (coord_t x = 0; x <= nbRadius.x; x++)
+					{
+						if (mask(x, y, z) != 0)
+						{
+							rx = nbRadius.x - x;
+							break;
+						}
+					}
+
+					if (rx >= 0)
+					{
+						rows.push_back(MedianWindowRow{ y - nbRadius.y, z - nbRadius.z, rx });
+						pixelCount += 2 * rx + 1;
+					}
+				}
+			}
+
+			return rows;
+		}
+
+		/**
+		Gets pointer to the first pixel of row (y, z), taking boundary condition into account.
+		Returns nullptr if the row is outside of the image and the boundary condition is BoundaryCondition::Zero.
+		*/
+		template<typename pixel_t> const pixel_t* medianSourceRow(const Image<pixel_t>& img, coord_t y, coord_t z, BoundaryCondition bc)
+		{
+			if (bc == BoundaryCondition::Zero)
+			{
+				if (y < 0 || y >= img.height() || z < 0 || z >= img.depth())
+					return nullptr;
+			}
+			else
+			{
+				clamp<coord_t>(y, 0, img.height() - 1);
+				clamp<coord_t>(z, 0, img.depth() - 1);
+			}
+			return &img(0, y, z);
+		}
+
+		/**
+		Gets value of pixel x in a row returned by medianSourceRow.
+		*/
+		template<typename pixel_t> pixel_t medianSample(const pixel_t* row, coord_t x, coord_t width, BoundaryCondition bc)
+		{
+			if (!row)
+				return pixel_t();
+
+			if (x < 0)
+				return bc == BoundaryCondition::Zero ? pixel_t() : row[0];
+
+			if (x >= width)
+				return bc == BoundaryCondition::Zero ? pixel_t() : row[width - 1];
+
+			return row[x];
+		}
+
+		/**
+		Histogram of 8- or 16-bit integer values that supports insertion and removal of values and search of the k:th smallest value.
+		The histogram has two tiers: each coarse bin contains the total count of a range of fine bins.
+		The search position is retained between searches (Huang's method), and the coarse bins are used to skip over
+		long runs of fine bins, so that the median can be located fast even in 16-bit histograms.
+		*/
+		template<typename pixel_t> class TieredHistogram
+		{
+		private:
+			static constexpr size_t BITS = 8 * sizeof(pixel_t);
+			static constexpr size_t FINE_COUNT = (size_t)1 << BITS;
+			static constexpr size_t COARSE_SHIFT = BITS / 2;
+			static constexpr size_t COARSE_WIDTH = (size_t)1 << COARSE_SHIFT;
+			static constexpr size_t COARSE_COUNT = FINE_COUNT / COARSE_WIDTH;
+
+			std::vector<uint32_t> fine;
+			std::vector<uint32_t> coarse;
+
+			/**
+			Current search position (fine bin index).
+			*/
+			size_t pivot;
+
+			/**
+			Count of values in fine bins below pivot.
+			*/
+			size_t below;
+
+			static size_t index(pixel_t v)
+			{
+				return (size_t)((coord_t)v - (coord_t)std::numeric_limits<pixel_t>::lowest());
+			}
+
+			static pixel_t value(size_t i)
+			{
+				return (pixel_t)((coord_t)i + (coord_t)std::numeric_limits<pixel_t>::lowest());
+			}
+
+		public:
+			static_assert(std::is_integral_v<pixel_t> && sizeof(pixel_t) <= 2, "TieredHistogram supports only 8- and 16-bit integer pixels.");
+
+			TieredHistogram() :
+				fine(FINE_COUNT, 0),
+				coarse(COARSE_COUNT, 0),
+				pivot(0),
+				below(0)
+			{
+			}
+
+			/**
+			Adds value to the histogram.
+			*/
+			void add(pixel_t v)
+			{
+				size_t i = index(v);
+				fine[i]++;
+				coarse[i >> COARSE_SHIFT]++;
+				if (i < pivot)
+					below++;
+			}
+
+			/**
+			Removes value from the histogram. The value must have been added before.
+			*/
+			void remove(pixel_t v)
+			{
+				size_t i = index(v);
+				fine[i]--;
+				coarse[i >> COARSE_SHIFT]--;
+				if (i < pivot)
+					below--;
+			}
+
+			/**
+			Call after a set of add and remove calls before calling kth.
+			Does nothing, but is required for compatibility with SortedWindow.
+			*/
+			void commit()
+			{
+			}
+
+			/**
+			Finds k:th smallest value in the histogram (k = 0 corresponds to the smallest value).
+			There must be more than k values in the histogram.
+			*/
+			pixel_t kth(size_t k)
+			{
+				// Move down until there are at most k values below the pivot.
+				while (below > k)
+				{
+					if ((pivot & (COARSE_WIDTH - 1)) == 0 && below - coarse[(pivot >> COARSE_SHIFT) - 1] > k)
+					{
+						pivot -= COARSE_WIDTH;
+						below -= coarse[pivot >> COARSE_SHIFT];
+					}
+					else
+					{
+						pivot--;
+						below -= fine[pivot];
+					}
+				}
+
+				// Move up until the k:th value is in the pivot bin.
+				while (below + fine[pivot] <= k)
+				{
+					if ((pivot & (COARSE_WIDTH - 1)) == 0 && below + coarse[pivot >> COARSE_SHIFT] <= k)
+					{
+						below += coarse[pivot >> COARSE_SHIFT];
+						pivot += COARSE_WIDTH;
+					}
+					else
+					{
+						below += fine[pivot];
+						pivot++;
+					}
+				}
+
+				return value(pivot);
+			}
+
+			/**
+			Removes all values from the histogram.
+			*/
+			void clear()
+			{
+				for (size_t c = 0; c < COARSE_COUNT; c++)
+				{
+					if (coarse[c] != 0)
+					{
+						std::fill(fine.begin() + c * COARSE_WIDTH, fine.begin() + (c + 1) * COARSE_WIDTH, 0);
+						coarse[c] = 0;
+					}
+				}
+				pivot = 0;
+				below = 0;
+			}
+		};
+
+		/**
+		Sorted list of values that supports insertion and removal of values and search of the k:th smallest value.
+		Used for pixel data types whose range is too large for a histogram.
+		Additions and removals are collected and applied to the list in a single merge pass in commit().
+		*/
+		template<typename pixel_t> class SortedWindow
+		{
+		private:
+			std::vector<pixel_t> values;
+			std::vector<pixel_t> temp;
+			std::vector<pixel_t> entering;
+			std::vector<pixel_t> leaving;
+
+		public:
+			/**
+			Adds value to the window. The change is visible after the next call to commit().
+			*/
+			void add(pixel_t v)
+			{
+				entering.push_back(v);
+			}
+
+			/**
+			Removes value from the window. The value must be in the window.
+			The change is visible after the next call to commit().
+			*/
+			void remove(pixel_t v)
+			{
+				leaving.push_back(v);
+			}
+
+			/**
+			Applies pending additions and removals.
+			*/
+			void commit()
+			{
+				std::sort(entering.begin(), entering.end());
+				std::sort(leaving.begin(), leaving.end());
+
+				temp.clear();
+				temp.reserve(values.size() + entering.size());
+
+				size_t li = 0;
+				size_t ei = 0;
+				for (size_t n = 0; n < values.size(); n++)
+				{
+					pixel_t v = values[n];
+
+					if (li < leaving.size() && !(leaving[li] < v) && !(v < leaving[li]))
+					{
+						li++;
+						continue;
+					}
+
+					while (ei < entering.size() && entering[ei] < v)
+						temp.push_back(entering[ei++]);
+
+					temp.push_back(v);
+				}
+
+				while (ei < entering.size())
+					temp.push_back(entering[ei++]);
+
+				std::swap(values, temp);
+				entering.clear();
+				leaving.clear();
+			}
+
+			/**
+			Finds k:th smallest value in the window (k = 0 corresponds to the smallest value).
+			*/
+			pixel_t kth(size_t k) const
+			{
+				return values[k];
+			}
+
+			/**
+			Removes all values from the window.
+			*/
+			void clear()
+			{
+				values.clear();
+				entering.clear();
+				leaving.clear();
+			}
+		};
+
+		/**
+		Median filtering using window whose contents are updated incrementally as it slides along the x-direction.
+		@param Window Either TieredHistogram or SortedWindow.
+		*/
+		template<typename pixel_t, typename out_t, class Window> void slidingMedianFilter(const Image<pixel_t>& img, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType, BoundaryCondition bc)
+		{
+			coord_t pixelCount;
+			std::vector<MedianWindowRow> rows = createMedianWindowRows(nbType, nbRadius, pixelCount);
+
+			size_t n = (size_t)pixelCount / 2;
+			bool even = pixelCount % 2 == 0;
+
+			coord_t w = img.width();
+			coord_t h = img.height();
+			coord_t d = img.depth();
+
+			size_t counter = 0;
+			#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				Window window;
+				std::vector<const pixel_t*> sources(rows.size());
+
+				#pragma omp for
+				for (coord_t i = 0; i < h * d; i++)
+				{
+					coord_t y = i % h;
+					coord_t z = i / h;
+
+					for (size_t r = 0; r < rows.size(); r++)
+					{
+						sources[r] = medianSourceRow(img, y + rows[r].dy, z + rows[r].dz, bc);
+						for (coord_t dx = -rows[r].rx; dx <= rows[r].rx; dx++)
+							window.add(medianSample(sources[r], dx, w, bc));
+					}
+					window.commit();
+
+					for (coord_t x = 0; x < w; x++)
+					{
+						if (x > 0)
+						{
+							for (size_t r = 0; r < rows.size(); r++)
+							{
+								window.remove(medianSample(sources[r], x - rows[r].rx - 1, w, bc));
+								window.add(medianSample(sources[r], x + rows[r].rx, w, bc));
+							}
+							window.commit();
+						}
+
+						// This must give the same result than calcMedian.
+						if (!even)
+						{
+							out(x, y, z) = pixelRound<out_t>((typename NumberUtils<pixel_t>::FloatType)window.kth(n));
+						}
+						else
+						{
+							pixel_t vn1 = window.kth(n - 1);
+							pixel_t vn = window.kth(n);
+							out(x, y, z) = pixelRound<out_t>((vn + vn1) / (typename NumberUtils<pixel_t>::RealFloatType)2);
+						}
+					}
+
+					window.clear();
+
+					showThreadProgress(counter, h * d);
+				}
+			}
+		}
+
+		/**
+		Tests if sliding window median filtering is expected to be faster than direct filtering for given image and neighbourhood.
+		The estimates are relative costs per output pixel.
+		*/
+		template<typename pixel_t> bool isSlidingMedianFaster(const Image<pixel_t>& img, const Vec3c& nbRadius, NeighbourhoodType nbType)
+		{
+			if constexpr (!std::is_arithmetic_v<pixel_t>)
+			{
+				return false;
+			}
+			else
+			{
+				coord_t pixelCount;
+				std::vector<MedianWindowRow> rows = createMedianWindowRows(nbType, nbRadius, pixelCount);
+				double N = (double)pixelCount;
+				double R = (double)rows.size();
+				double w = (double)img.width();
+
+				// Direct filtering copies the whole bounding box of the neighbourhood and then selects the median.
+				double boxSize = (double)(2 * nbRadius.x + 1) * (double)(2 * nbRadius.y + 1) * (double)(2 * nbRadius.z + 1);
+				double direct = boxSize + 2 * N;
+
+				double sliding;
+				if constexpr (std::is_integral_v<pixel_t> && sizeof(pixel_t) <= 2)
+				{
+					// Initialization of each row, one addition and removal for each window row, and search in the histogram.
+					double search = sizeof(pixel_t) == 1 ? 8.0 : 32.0;
+					sliding = 2 * N / w + 2 * R + search;
+				}
+				else
+				{
+					// Initialization of each row, sorting of changed values, and merge of the sorted lists.
+					sliding = N * std::log2(N + 1) / w + 2 * R * std::log2(R + 1) + N;
+				}
+
+				return sliding < direct;
+			}
+		}
+	}
+
+	/**
+	Calculates median filtering using sliding window algorithm.
+	The neighbourhood is processed as a set of rows in x-direction. When the neighbourhood moves one step in the x-direction,
+	one pixel from each row leaves the neighbourhood and one enters it, and the contents of the window are updated accordingly.
+	For 8- and 16-bit integer images, the window is a two-tier histogram. Other pixel data types use a sorted list of values.
+	The output is equal to that of direct median filtering.
+	Consider using medianFilter function that selects between this and direct filtering algorithm automatically.
+	@param img Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void slidingMedianFilter(const Image<pixel_t>& img, Image<out_t>& out, Vec3c nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		out.mustNotBe(img);
+		out.ensureSize(img);
+
+		// Zero radius in those dimensions that are not in use
+		for (size_t n = img.dimensionality(); n < nbRadius.size(); n++)
+			nbRadius[n] = 0;
+
+		if constexpr (std::is_integral_v<pixel_t> && sizeof(pixel_t) <= 2)
+			internals::slidingMedianFilter<pixel_t, out_t, internals::TieredHistogram<pixel_t> >(img, out, nbRadius, nbType, bc);
+		else
+			internals::slidingMedianFilter<pixel_t, out_t, internals::SortedWindow<pixel_t> >(img, out, nbRadius, nbType, bc);
+	}
+
+	namespace tests
+	{
+		void slidingMedian();
+	}
+}
@@ -3,6 +3,8 @@
 #include <random>
 #include <cmath>
 #include <iomanip>
+#include <map>
+#include <tuple>
 
 #include "ompatomic.h"
 #include "io/raw.h"
@@ -19,318 +21,372 @@ using namespace std;
 
 namespace itl2
 {
-	void initFFTW()
+	namespace internals
 	{
-		static OmpAtomic<bool> isFFTWInit(false);
+		/**
+		Transformations whose plans are stored in the plan cache.
+		*/
+		enum class FFTWTransform
+		{
+			DCT,
+			IDCT,
+			RealToComplex,
+			ComplexToReal,
+			/**
+			Batch of 1D real-to-complex transforms, one for each row of the image.
+			*/
+			RowsRealToComplex,
+			/**
+			Batch of 1D complex-to-real transforms, one for each row of the image.
+			*/
+			RowsComplexToReal
+		};
 
-		if (!isFFTWInit)
+		/**
+		Identifies an FFTW plan in the plan cache.
+		A plan can be executed for any arrays whose sizes, alignments and in-place-ness match those used when the plan was created.
+		*/
+		struct FFTWPlanKey
 		{
-			#pragma omp critical
+			FFTWTransform transform;
+
+			/**
+			Dimensions of the real-valued image.
+			*/
+			Vec3c dimensions;
+
+			size_t dimensionality;
+
+			bool inPlace;
+			int inAlignment;
+			int outAlignment;
+			int threadCount;
+			bool measure;
+
+			bool operator<(const FFTWPlanKey& right) const
 			{
-				if (!isFFTWInit)
-				{
-					isFFTWInit = true;
-					fftwf_import_system_wisdom();
-				}
+				return std::make_tuple(transform, dimensions.x, dimensions.y, dimensions.z, dimensionality, inPlace, inAlignment, outAlignment, threadCount, measure) <
+					std::make_tuple(right.transform, right.dimensions.x, right.dimensions.y, right.dimensions.z, right.dimensionality, right.inPlace, right.inAlignment, right.outAlignment, right.threadCount, right.measure);
 			}
-		}
+		};
 
-		//#pragma omp critical
-		//{
-		//	if (!isFFTWInit)
-		//	{
-		//		isFFTWInit = true;
-		//		// NOTE: Enabling threading here makes things REALLY slow.
-		//		//fftwf_init_threads();
-		//		fftwf_import_system_wisdom();
-		//	}
-		//}
-	}
+		/**
+		Plans that have been created so far.
+		The plans are never destroyed as other threads might be executing them.
+		Access to the map must be protected by omp critical section, as FFTW planner calls must be.
+		*/
+		map<FFTWPlanKey, fftwf_plan> fftwPlans;
 
-	void setThreads()
-	{
-		//if (omp_in_parallel())
-		//	fftwf_plan_with_nthreads(1);
-		//else
-		//	fftwf_plan_with_nthreads(omp_get_num_threads());
-	}
+		/**
+		Indicates if plans are created using FFTW_MEASURE flag.
+		*/
+		bool fftwMeasure = false;
 
-	void dct(Image<float32_t>& img)
-	{
-		initFFTW();
+		/**
+		File where FFTW wisdom is saved. Empty if wisdom is not saved.
+		*/
+		string fftwWisdomFile;
 
-		if (img.dimensionality() == 1)
-		{
-			coord_t w = img.dimension(0);
+		/**
+		Transforms of images having less pixels than this are always calculated using a single thread.
+		*/
+		const coord_t FFTW_THREADING_THRESHOLD = 64 * 64 * 64;
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_1d((int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
+		/**
+		Calculates count of floats in the input and output arrays of the given transformation.
+		*/
+		void fftwArraySizes(const FFTWPlanKey& key, size_t& inSize, size_t& outSize)
+		{
+			size_t realSize = (size_t)key.dimensions.x * (size_t)key.dimensions.y * (size_t)key.dimensions.z;
+			size_t complexSize = 2 * (size_t)(key.dimensions.x / 2 + 1) * (size_t)key.dimensions.y * (size_t)key.dimensions.z;
+
+			switch (key.transform)
+			{
+			case FFTWTransform::RealToComplex:
+			case FFTWTransform::RowsRealToComplex:
+				inSize = realSize;
+				outSize = complexSize;
+				break;
+			case FFTWTransform::ComplexToReal:
+			case FFTWTransform::RowsComplexToReal:
+				inSize = complexSize;
+				outSize = realSize;
+				break;
+			default:
+				inSize = realSize;
+				outSize = realSize;
 			}
 		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_2d((int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
+		/**
+		Creates a new plan for the given transformation.
+		Must be called inside omp critical section.
+		*/
+		fftwf_plan createPlan(const FFTWPlanKey& key, float* in, float* out)
+		{
+			// FFTW_MEASURE overwrites the arrays, so in that case the plan is created
+			// using temporary arrays that have the same alignment than the real arrays.
+			float* tempIn = nullptr;
+			float* tempOut = nullptr;
+			if (key.measure)
+			{
+				size_t inSize, outSize;
+				fftwArraySizes(key, inSize, outSize);
+				if (key.inPlace)
+					inSize = std::max(inSize, outSize);
+
+				tempIn = (float*)fftwf_malloc(inSize * sizeof(float) + key.inAlignment);
+				if (!tempIn)
+					throw ITLException("Unable to allocate memory for FFTW planning.");
+				in = (float*)((char*)tempIn + key.inAlignment);
+
+				if (key.inPlace)
+				{
+					out = in;
+				}
+				else
+				{
+					tempOut = (float*)fftwf_malloc(outSize * sizeof(float) + key.outAlignment);
+					if (!tempOut)
+					{
+						fftwf_free(tempIn);
+						throw ITLException("Unable to allocate memory for FFTW planning.");
+					}
+					out = (float*)((char*)tempOut + key.outAlignment);
+				}
 			}
+
+			unsigned int flags = key.measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+
+			int w = (int)key.dimensions.x;
+			int h = (int)key.dimensions.y;
+			int d = (int)key.dimensions.z;
+
+			fftwf_plan_with_nthreads(key.threadCount);
+
+			fftwf_plan p = nullptr;
+			switch (key.transform)
+			{
+			case FFTWTransform::DCT:
+			case FFTWTransform::IDCT:
+			{
+				fftwf_r2r_kind kind = key.transform == FFTWTransform::DCT ? FFTW_REDFT10 : FFTW_REDFT01;
+				if (key.dimensionality == 1)
+					p = fftwf_plan_r2r_1d(w, in, out, kind, flags);
+				else if (key.dimensionality == 2)
+					p = fftwf_plan_r2r_2d(h, w, in, out, kind, kind, flags);
+				else
+					p = fftwf_plan_r2r_3d(d, h, w, in, out, kind, kind, kind, flags);
+				break;
+			}
+			case FFTWTransform::RealToComplex:
+				if (key.dimensionality == 1)
+					p = fftwf_plan_dft_r2c_1d(w, in, (fftwf_complex*)out, flags);
+				else if (key.dimensionality == 2)
+					p = fftwf_plan_dft_r2c_2d(h, w, in, (fftwf_complex*)out, flags);
+				else
+					p = fftwf_plan_dft_r2c_3d(d, h, w, in, (fftwf_complex*)out, flags);
+				break;
+			case FFTWTransform::ComplexToReal:
+				if (key.dimensionality == 1)
+					p = fftwf_plan_dft_c2r_1d(w, (fftwf_complex*)in, out, flags);
+				else if (key.dimensionality == 2)
+					p = fftwf_plan_dft_c2r_2d(h, w, (fftwf_complex*)in, out, flags);
+				else
+					p = fftwf_plan_dft_c2r_3d(d, h, w, (fftwf_complex*)in, out, flags);
+				break;
+			case FFTWTransform::RowsRealToComplex:
+				p = fftwf_plan_many_dft_r2c(1, &w, h * d, in, nullptr, 1, w, (fftwf_complex*)out, nullptr, 1, w / 2 + 1, flags);
+				break;
+			case FFTWTransform::RowsComplexToReal:
+				p = fftwf_plan_many_dft_c2r(1, &w, h * d, (fftwf_complex*)in, nullptr, 1, w / 2 + 1, out, nullptr, 1, w, flags);
+				break;
+			}
+
+			// Plans created elsewhere (e.g. in tomographic reconstruction) must stay single-threaded.
+			fftwf_plan_with_nthreads(1);
+
+			if (tempIn)
+				fftwf_free(tempIn);
+			if (tempOut)
+				fftwf_free(tempOut);
+
+			if (!p)
+				throw ITLException("Unable to create FFTW plan.");
+
+			if (key.measure && fftwWisdomFile.length() > 0)
+				fftwf_export_wisdom_to_filename(fftwWisdomFile.c_str());
+
+			return p;
 		}
-		else if (img.dimensionality() == 3)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
 
-			fftwf_plan p;
+		/**
+		Calculates the given transformation using a cached plan.
+		The plan is created if it does not exist yet.
+		@param dimensions Dimensions of the real-valued image.
+		@param dimensionality Dimensionality of the real-valued image.
+		*/
+		void executeFFTW(FFTWTransform transform, const Vec3c& dimensions, size_t dimensionality, float* in, float* out)
+		{
+			if (dimensionality < 1 || dimensionality > 3)
+				throw ITLException("Unsupported dimensionality.");
+
+			initFFTW();
+
+			FFTWPlanKey key;
+			key.transform = transform;
+			key.dimensions = dimensions;
+			key.dimensionality = dimensionality;
+			key.inPlace = in == out;
+			key.inAlignment = fftwf_alignment_of(in);
+			key.outAlignment = fftwf_alignment_of(out);
+			key.threadCount = omp_in_parallel() || dimensions.x * dimensions.y * dimensions.z < FFTW_THREADING_THRESHOLD ? 1 : omp_get_max_threads();
+
+			fftwf_plan p = nullptr;
+			bool failed = false;
+			ITLException error("");
 			#pragma omp critical
 			{
-				setThreads();
-				p = fftwf_plan_r2r_3d((int)d, (int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
+				key.measure = fftwMeasure;
+
+				auto it = fftwPlans.find(key);
+				if (it != fftwPlans.end())
+				{
+					p = it->second;
+				}
+				else
+				{
+					try
+					{
+						p = createPlan(key, in, out);
+						fftwPlans[key] = p;
+					}
+					catch (ITLException ex)
+					{
+						error = ex;
+						failed = true;
+					}
+				}
 			}
-			fftwf_execute(p);
-			#pragma omp critical
+
+			if (failed)
+				throw error;
+
+			// Executing a plan is thread-safe.
+			switch (transform)
 			{
-				fftwf_destroy_plan(p);
+			case FFTWTransform::DCT:
+			case FFTWTransform::IDCT:
+				fftwf_execute_r2r(p, in, out);
+				break;
+			case FFTWTransform::RealToComplex:
+			case FFTWTransform::RowsRealToComplex:
+				fftwf_execute_dft_r2c(p, in, (fftwf_complex*)out);
+				break;
+			case FFTWTransform::ComplexToReal:
+			case FFTWTransform::RowsComplexToReal:
+				fftwf_execute_dft_c2r(p, (fftwf_complex*)in, out);
+				break;
 			}
 		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
-
-		// Normalize the output image
-		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
 	}
 
-	void idct(Image<float32_t>& img)
+	void initFFTW()
 	{
-		initFFTW();
+		static OmpAtomic<bool> isFFTWInit(false);
 
-		if (img.dimensionality() == 1)
+		if (!isFFTWInit)
 		{
-			coord_t w = img.dimension(0);
-
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_1d((int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
 			#pragma omp critical
 			{
-				fftwf_destroy_plan(p);
+				if (!isFFTWInit)
+				{
+					fftwf_init_threads();
+					fftwf_plan_with_nthreads(1);
+					fftwf_import_system_wisdom();
+					isFFTWInit = true;
+				}
 			}
 		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
+	}
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_2d((int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
+	void setFFTWPlanning(bool measure, const std::string& wisdomFile)
+	{
+		initFFTW();
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_3d((int)d, (int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
+		#pragma omp critical
 		{
-			throw ITLException("Unsupported dimensionality.");
+			internals::fftwMeasure = measure;
+			internals::fftwWisdomFile = wisdomFile;
+			if (wisdomFile.length() > 0)
+				fftwf_import_wisdom_from_filename(wisdomFile.c_str());
 		}
+	}
+
+	void dct(Image<float32_t>& img)
+	{
+		internals::executeFFTW(internals::FFTWTransform::DCT, img.dimensions(), img.dimensionality(), img.getData(), img.getData());
 
 		// Normalize the output image
 		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
 	}
 
-
-	void fft(Image<float32_t>& img, Image<complex32_t>& out)
+	void idct(Image<float32_t>& img)
 	{
-		initFFTW();
-
-		if (img.dimensionality() == 1)
-		{
-			coord_t w = img.dimension(0);
+		internals::executeFFTW(internals::FFTWTransform::IDCT, img.dimensions(), img.dimensionality(), img.getData(), img.getData());
 
-			out.ensureSize(w / 2 + 1);
-
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_1d((int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
+		// Normalize the output image
+		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
+	}
 
-			out.ensureSize(w / 2 + 1, h);
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_2d((int)h, (int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
+	void fft(Image<float32_t>& img, Image<complex32_t>& out)
+	{
+		if (img.dimensionality() < 1 || img.dimensionality() > 3)
+			throw ITLException("Unsupported dimensionality.");
 
-			out.ensureSize(w / 2 + 1, h, d);
+		Vec3c dims = img.dimensions();
+		dims.x = dims.x / 2 + 1;
+		out.ensureSize(dims);
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_3d((int)d, (int)h, (int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
+		internals::executeFFTW(internals::FFTWTransform::RealToComplex, img.dimensions(), img.dimensionality(), img.getData(), (float*)out.getData());
 	}
 
-	void ifft(Image<complex32_t>& img, Image<float32_t>& out)
+	void ifft(Image<complex32_t>& img, Image<float32_t>& out, bool normalize)
 	{
-		initFFTW();
-
 		if (img.dimensionality() != out.dimensionality() ||
 			out.width() < img.width() ||
 			out.height() < img.height() ||
 			out.depth() < img.depth())
 			throw ITLException("Size and dimensionality of the output image is not set correctly.");
 
-		if (img.dimensionality() == 1)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			coord_t w = out.dimension(0);
-
-			//out.ensureSize(w);
+		internals::executeFFTW(internals::FFTWTransform::ComplexToReal, out.dimensions(), out.dimensionality(), (float*)img.getData(), out.getData());
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_1d((int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			//coord_t h = img.dimension(1);
-			coord_t w = out.dimension(0);
-			coord_t h = out.dimension(1);
+		// Normalize the output image
+		if (normalize)
+			divide(out, (double)out.pixelCount());
+	}
 
-			//out.ensureSize(w, h);
+	void fftRows(Image<float32_t>& img, Image<complex32_t>& out)
+	{
+		Vec3c dims = img.dimensions();
+		dims.x = dims.x / 2 + 1;
+		out.ensureSize(dims);
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_2d((int)h, (int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			//coord_t h = img.dimension(1);
-			//coord_t d = img.dimension(2);
-			coord_t w = out.dimension(0);
-			coord_t h = out.dimension(1);
-			coord_t d = out.dimension(2);
+		internals::executeFFTW(internals::FFTWTransform::RowsRealToComplex, img.dimensions(), 1, img.getData(), (float*)out.getData());
+	}
 
-			//out.ensureSize(w, h, d);
+	void ifftRows(Image<complex32_t>& img, Image<float32_t>& out, bool normalize)
+	{
+		if (img.width() != out.width() / 2 + 1 ||
+			img.height() != out.height() ||
+			img.depth() != out.depth())
+			throw ITLException("Size of the output image is not set correctly.");
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_3d((int)d, (int)h, (int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
+		internals::executeFFTW(internals::FFTWTransform::RowsComplexToReal, out.dimensions(), 1, (float*)img.getData(), out.getData());
 
-		// Normalize the output image
-		divide(out, (double)out.pixelCount());
+		if (normalize)
+			divide(out, (double)out.width());
 	}
 
 
@@ -620,14 +676,18 @@ namespace itl2
 	@param maxShift Maximal shift that is considered.
 	*/
 	Vec3d phaseCorrelation(Image<float32_t>& img1, Image<float32_t>& img2, const Vec3c& maxShift, double& goodness)
+	{
+		Image<complex32_t> img1FFT;
+		Image<complex32_t> img2FFT;
+		return phaseCorrelation(img1, img2, maxShift, goodness, img1FFT, img2FFT);
+	}
+
+	Vec3d phaseCorrelation(Image<float32_t>& img1, Image<float32_t>& img2, const Vec3c& maxShift, double& goodness, Image<complex32_t>& img1FFT, Image<complex32_t>& img2FFT)
 	{
 		//raw::writed(img1, "img1");
 		//raw::writed(img2, "img2");
 
 
-		Image<complex32_t> img1FFT;
-		Image<complex32_t> img2FFT;
-
 		fft(img1, img1FFT);
 		//raw::writed(img1FFT, "img1fft");
 
@@ -835,6 +895,108 @@ namespace itl2
 		}
 
 
+		void fftPlanCache()
+		{
+			// Transform pairs of various sizes, both in parallel and sequentially, so that plans are re-used from the cache.
+			vector<Vec3c> sizes = { Vec3c(31, 1, 1), Vec3c(32, 17, 1), Vec3c(20, 15, 12), Vec3c(31, 1, 1), Vec3c(20, 15, 12), Vec3c(70, 70, 70) };
+			bool ok = true;
+			#pragma omp parallel for
+			for (coord_t n = 0; n < 4 * (coord_t)sizes.size(); n++)
+			{
+				Image<float32_t> img(sizes[n % sizes.size()]);
+				noise(img, 100, 20, (unsigned int)n + 1);
+
+				Image<complex32_t> ft;
+				fft(img, ft);
+				Image<float32_t> comp(img.dimensions());
+				ifft(ft, comp);
+				subtract(comp, img);
+				abs(comp);
+
+				Image<float32_t> dcomp;
+				setValue(dcomp, img);
+				dct(dcomp);
+				idct(dcomp);
+				subtract(dcomp, img);
+				abs(dcomp);
+
+				if (!(max(comp) < 1e-3) || !(max(dcomp) < 1e-3))
+				{
+					#pragma omp critical(fft_test)
+					ok = false;
+				}
+			}
+			testAssert(ok, "FFT and DCT pairs using cached plans");
+
+			// Large transform outside of parallel region uses multiple threads.
+			Image<float32_t> img(100, 90, 80);
+			noise(img, 100, 20, 5);
+			Image<complex32_t> ft;
+			fft(img, ft);
+			Image<float32_t> comp(img.dimensions());
+			ifft(ft, comp);
+			subtract(comp, img);
+			abs(comp);
+			testAssert(max(comp) < 1e-3, "multithreaded FFT pair");
+
+			// Phase correlation of shifted blocks in parallel.
+			Image<float32_t> reference(64, 64, 64);
+			noise(reference, 100, 20, 7);
+			gaussFilterFFT(reference, 2.0, false);
+			bool shiftsOk = true;
+			#pragma omp parallel for
+			for (coord_t n = 0; n < 8; n++)
+			{
+				Vec3d shiftGT((double)(n % 3), -(double)(n % 2), (double)(n / 3));
+				Image<float32_t> shifted(reference.dimensions());
+				translate(reference, shifted, shiftGT);
+				Image<float32_t> ref;
+				setValue(ref, reference);
+				double goodness;
+				Vec3d shift = phaseCorrelation(shifted, ref, Vec3c(5, 5, 5), goodness);
+				if ((shift - shiftGT).abs().max() > 0.5)
+				{
+					#pragma omp critical(fft_test)
+					shiftsOk = false;
+				}
+			}
+			testAssert(shiftsOk, "parallel phase correlation");
+		}
+
+		void fftRows()
+		{
+			Image<float32_t> img(37, 12, 3);
+			noise(img, 100, 20, 7);
+
+			Image<complex32_t> ft;
+			itl2::fftRows(img, ft);
+
+			// Compare to transforms of individual rows.
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					Image<float32_t> row(img.width());
+					for (coord_t x = 0; x < img.width(); x++)
+						row(x) = img(x, y, z);
+
+					Image<complex32_t> rowft;
+					fft(row, rowft);
+
+					float32_t maxDiff = 0;
+					for (coord_t x = 0; x < rowft.width(); x++)
+						maxDiff = std::max(maxDiff, std::abs(rowft(x) - ft(x, y, z)));
+					testAssert(maxDiff < 1e-2, "batched FFT of rows");
+				}
+			}
+
+			Image<float32_t> comp(img.dimensions());
+			itl2::ifftRows(ft, comp);
+			subtract(comp, img);
+			abs(comp);
+			testAssert(max(comp) < 1e-3, "batched FFT pair of rows");
+		}
+
 		void modulo()
 		{
 			coord_t end = 10;
@@ -15,6 +15,15 @@ namespace itl2
 	*/
 	void initFFTW();
 
+	/**
+	Sets the planning mode of FFTW plans.
+	Plans are created when a transform of given size is calculated for the first time, and they are re-used in subsequent calls.
+	Large transforms that are not calculated inside a parallel region are calculated using multiple threads.
+	@param measure Set to true to measure the fastest algorithm for each new transform size (FFTW_MEASURE flag). This makes the first transform of each size slow but may make the subsequent transforms faster. Set to false to choose the algorithm using heuristics (FFTW_ESTIMATE flag, default).
+	@param wisdomFile File where FFTW wisdom is read from and saved to, so that measurements done in one session can be re-used in subsequent sessions. Pass empty string to disable saving.
+	*/
+	void setFFTWPlanning(bool measure, const std::string& wisdomFile = "");
+
 	/**
 	Calculates Discrete Cosine Transform of the input image.
 	Calculates 1D DCT if img is 1-dimensional, 2D DCT if img is 2-dimensional etc.
@@ -42,8 +51,26 @@ namespace itl2
 	Output image size must be set to the size of the original image where the FFT was calculated from.
 	Calculates 1D FFT if img is 1-dimensional, 2D FFT if img is 2-dimensional etc.
 	Input image data is used as a temporary buffer.
+	@param normalize Set to false to skip division of the output by the pixel count, e.g. if the caller has included it in a filter.
+	*/
+	void ifft(Image<complex32_t>& img, Image<float32_t>& out, bool normalize = true);
+
+	/**
+	Calculates 1D FFT of each row of the input image and places the results to the corresponding rows of the output image.
+	All the rows are transformed using a single batched FFTW plan.
+	Initializes output image to correct size.
+	Input image is not modified.
+	*/
+	void fftRows(Image<float32_t>& img, Image<complex32_t>& out);
+
+	/**
+	Calculates inverse 1D FFT of each row of the input image and places the results to the corresponding rows of the output image.
+	All the rows are transformed using a single batched FFTW plan.
+	Output image size must be set to the size of the original image where the FFT was calculated from.
+	Input image data is used as a temporary buffer.
+	@param normalize Set to false to skip division of the output by the row length, e.g. if the caller has included it in a filter.
 	*/
-	void ifft(Image<complex32_t>& img, Image<float32_t>& out);
+	void ifftRows(Image<complex32_t>& img, Image<float32_t>& out, bool normalize = true);
 
 	/**
 	Gaussian filtering.
@@ -90,6 +117,19 @@ namespace itl2
 	*/
 	Vec3d phaseCorrelation(Image<float32_t>& img1, Image<float32_t>& img2, const Vec3c& maxShift, double& goodness);
 
+	/**
+	Calculates shift between the two images with phase correlation method.
+	This version stores the Fourier transforms of the images to the given temporary images so that
+	their memory can be re-used in repeated calls.
+	@param img1 Reference image. This image is used as temporary storage so it will be modified.
+	@param img2 Shifted image. This image is not modified.
+	@param maxShift Maximal shift that is to be recognized.
+	@param goodness Estimate of goodness of fit between img1 and shifted img2.
+	@param img1FFT, img2FFT Temporary images.
+	@return Shift between img1 and img2.
+	*/
+	Vec3d phaseCorrelation(Image<float32_t>& img1, Image<float32_t>& img2, const Vec3c& maxShift, double& goodness, Image<complex32_t>& img1FFT, Image<complex32_t>& img2FFT);
+
 	namespace tests
 	{
 		void fourierTransformPair();
@@ -98,5 +138,7 @@ namespace itl2
 		void phaseCorrelation();
 		void phaseCorrelation2();
 		void modulo();
+		void fftPlanCache();
+		void fftRows();
 	}
 }
\ No newline at end of file
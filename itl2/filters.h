@@ -10,6 +10,9 @@
 #include "utilities.h"
 #include "fastmaxminfilters.h"
 #include "median.h"
+#include "fastmedianfilter.h"
+#include "boxfilters.h"
+#include "recursivegauss.h"
 
 namespace itl2
 {
@@ -1059,8 +1062,9 @@ namespace itl2
 
 		/**
 		Separable Gaussian filtering in-place.
+		@param allowRecursive Set to true to allow processing of dimensions with large standard deviation using recursive filter.
 		*/
-		template<typename pixel_t> void sepgauss(Image<pixel_t>& img, const Vec3d& sigma, coord_t derivativeDimension1, coord_t derivativeDimension2, BoundaryCondition bc, bool showProgressInfo = true)
+		template<typename pixel_t> void sepgauss(Image<pixel_t>& img, const Vec3d& sigma, coord_t derivativeDimension1, coord_t derivativeDimension2, BoundaryCondition bc, bool showProgressInfo = true, bool allowRecursive = true)
 		{
 			checkDerivativeDimension(derivativeDimension1);
 			checkDerivativeDimension(derivativeDimension2);
@@ -1075,6 +1079,7 @@ namespace itl2
 			Vec3<const Image<float32_t>* > kernels;
 			Vec3c nbRadius;
 			Image<float32_t> kernelImages[3];
+			Vec3c derOrders;
 
 			// Generate kernel for each direction
 			for (coord_t n = 0; n < 3; n++)
@@ -1082,22 +1087,38 @@ namespace itl2
 				coord_t derOrder = 0;
 				if(n == derivativeDimension1 || n == derivativeDimension2)
 					derOrder = derivativeDimension1 != derivativeDimension2 ? 1 : 2;
+				derOrders[n] = derOrder;
 
 				gaussianKernel1D(sigma[n], nbRadius[n], kernelImages[n], derOrder);
 				kernels[n] = &kernelImages[n];
 			}
 
-			sepFilter<pixel_t, const Image<float32_t>*, internals::convolution1DOp<pixel_t> >(img, nbRadius, kernels, bc, showProgressInfo);
+			bool useRecursive = allowRecursive && internals::canUseRecursiveGauss(img, sigma.max());
+
+			for (size_t n = 0; n < std::max<size_t>(1, img.dimensionality()); n++)
+			{
+				// Large kernels are replaced by recursive filter whose cost does not depend on sigma.
+				if constexpr (std::is_arithmetic_v<pixel_t>)
+				{
+					if (useRecursive && sigma[n] >= RECURSIVE_GAUSS_SIGMA_THRESHOLD)
+					{
+						recursiveGaussOneDimension(img, sigma[n], n, derOrders[n], bc, showProgressInfo);
+						continue;
+					}
+				}
+
+				internals::sepFilterOneDimension<pixel_t, const Image<float32_t>*, internals::convolution1DOp<pixel_t> >(img, nbRadius[n], n, kernels[n], bc, showProgressInfo);
+			}
 		}
 
 		/**
 		Separable Gaussian filtering.
 		Use only if data type has good enough accuracy.
 		*/
-		template<typename input_t, typename output_t> void sepgauss(const Image<input_t>& in, Image<output_t>& out, const Vec3d& sigma, coord_t derivativeDimension1, coord_t derivativeDimension2, BoundaryCondition bc, bool showProgressInfo = true)
+		template<typename input_t, typename output_t> void sepgauss(const Image<input_t>& in, Image<output_t>& out, const Vec3d& sigma, coord_t derivativeDimension1, coord_t derivativeDimension2, BoundaryCondition bc, bool showProgressInfo = true, bool allowRecursive = true)
 		{
 			setValue(out, in);
-			sepgauss(out, sigma, derivativeDimension1, derivativeDimension2, bc, showProgressInfo);
+			sepgauss(out, sigma, derivativeDimension1, derivativeDimension2, bc, showProgressInfo, allowRecursive);
 		}
 	}
 
@@ -1159,7 +1180,7 @@ namespace itl2
 		}
 		else
 		{
-			internals::sepgauss(in, out, sigma, -1, -1, bc);
+			internals::sepgauss(in, out, sigma, -1, -1, bc, true, allowOpt);
 		}
 	}
 
@@ -1468,90 +1489,6 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 
 
 
-// This version includes separable filtering optimization for float types only.
-#define DEFINE_FILTER_SEP_FLOAT(name, help) \
-/** \
-help \
-\
-Separable filtering is used for floating point pixel data types for rectangular neighbourhoods. \
-@param in Input image. \
-@param out Output image. \
-@param nbRadius Radius of filtering neighbourhood. \
-@param nbType Neighbourhood type. \
-@param bc Boundary condition. \
-*/ \
-template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest) \
-{ \
-	filter<pixel_t, out_t, internals::name##Op<pixel_t> >(in, out, nbRadius, nbType, bc); \
-} \
- \
-/** \
-help \
-\
-Separable filtering is used for floating point pixel data types for rectangular neighbourhoods. \
-@param in Input image. \
-@param out Output image. \
-@param nbRadius Radius of filtering neighbourhood. \
-@param nbType Neighbourhood type. \
-@param bc Boundary condition. \
-*/ \
-template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest) \
-{ \
-	name##Filter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc); \
-} \
-/** \
-help \
-\
-In-place filtering supports only rectangular neighbourhood. \
-@param img Image to process. \
-@param nbRadius Radius of filtering neighbourhood. \
-@param nbType Neighbourhood type. \
-@param bc Boundary condition. \
-*/ \
-inline void name##Filter(Image<float32_t>& img, const Vec3c& nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest) \
-{ \
-	sepFilter<float32_t, internals::name##Op<float32_t> >(img, nbRadius, bc); \
-} \
-/** \
-help \
-\
-In-place filtering supports only rectangular neighbourhood. \
-@param img Image to process. \
-@param nbRadius Radius of filtering neighbourhood. \
-@param nbType Neighbourhood type. \
-@param bc Boundary condition. \
-*/ \
-inline void name##Filter(Image<float32_t>& img, coord_t nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest) \
-{ \
-	sepFilter<float32_t, internals::name##Op<float32_t> >(img, Vec3c(nbRadius, nbRadius, nbRadius), bc); \
-} \
-/** \
-help \
-\
-Separable filtering is used for floating point pixel data types for rectangular neighbourhoods. \
-@param in Input image. \
-@param out Output image. \
-@param nbRadius Radius of filtering neighbourhood. \
-@param nbType Neighbourhood type. \
-@param bc Boundary condition. \
-*/ \
-template<> inline void name##Filter(const Image<float32_t>& in, Image<float32_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType, BoundaryCondition bc) \
-{ \
-	if(nbType == NeighbourhoodType::Rectangular) \
-	{ \
-		out.ensureSize(in); \
-		setValue<float32_t>(out, in); \
-		name##Filter(out, nbRadius, bc); \
-	} \
-	else \
-	{ \
-		filter<float32_t, float32_t, internals::name##Op<float32_t> >(in, out, nbRadius, nbType, bc); \
-	} \
-}
-
-	
-
-
 // Version with no parameters and no separable optimization
 #define DEFINE_FILTER(name, help) \
 /** \
@@ -1616,86 +1553,162 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 	// Now define the filtering operations
 	DEFINE_FILTER_MINMAX(min, Calculates minimum filtering.)
 	DEFINE_FILTER_MINMAX(max, Calculates maximum filtering.)
-	DEFINE_FILTER_SEP_FLOAT(mean, Calculates mean filtering.)
-	DEFINE_FILTER(median, Calculates median filtering.)
-	DEFINE_FILTER_1PARAM(maskedMedian, pixel_t, Calculates masked median filtering., Image value that should not be considered when calculating median.)
-
-	#define COMMA ,
-	DEFINE_FILTER_1PARAM(vawe, double, Calculates variance weighted mean filtering., Standard deviation of noise. For a rough order of magnitude estimateCOMMA measure standard deviation from a region that does not contain any features.)
-
-
-	// Variance requires special handling
 	/**
-	Calculates variance filtering.
+	Calculates mean filtering.
 
-	Separable optimization is used for rectangular neighbourhoods.
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
 	@param in Input image.
 	@param out Output image.
 	@param nbRadius Radius of filtering neighbourhood.
 	@param nbType Neighbourhood type.
-	@param bc Boundary condition (BoundaryCondition::Zero or Nearest).
+	@param bc Boundary condition.
 	*/
-	template<typename pixel_t, typename out_t> void varianceFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	template<typename pixel_t, typename out_t> void meanFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
 	{
-		filter<pixel_t, out_t, internals::varianceOp<pixel_t> >(in, out, nbRadius, nbType, bc);
+		if (nbType == NeighbourhoodType::Rectangular && internals::canUseBoxSums(in))
+			boxMeanFilter<pixel_t, out_t>(in, out, nbRadius, bc);
+		else
+			filter<pixel_t, out_t, internals::meanOp<pixel_t> >(in, out, nbRadius, nbType, bc);
 	}
-	
+
 	/**
-	Calculates variance filtering.
+	Calculates mean filtering.
 
-	Separable optimization is used for rectangular neighbourhoods.
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
 	@param in Input image.
 	@param out Output image.
 	@param nbRadius Radius of filtering neighbourhood.
 	@param nbType Neighbourhood type.
-	@param bc Boundary condition (BoundaryCondition::Zero or Nearest).
+	@param bc Boundary condition.
 	*/
-	template<typename pixel_t, typename out_t> void varianceFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	template<typename pixel_t, typename out_t> void meanFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
 	{
-		varianceFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc);
+		meanFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc);
+	}
+
+	/**
+	Calculates mean filtering.
+
+	In-place filtering supports only rectangular neighbourhood.
+	@param img Image to process.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param bc Boundary condition.
+	*/
+	inline void meanFilter(Image<float32_t>& img, const Vec3c& nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		sepFilter<float32_t, internals::meanOp<float32_t> >(img, nbRadius, bc);
+	}
+
+	/**
+	Calculates mean filtering.
+
+	In-place filtering supports only rectangular neighbourhood.
+	@param img Image to process.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param bc Boundary condition.
+	*/
+	inline void meanFilter(Image<float32_t>& img, coord_t nbRadius, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		meanFilter(img, Vec3c(nbRadius, nbRadius, nbRadius), bc);
 	}
 
 	namespace internals
 	{
-		inline float32_t rectVarianceFinalization(float32_t out, float32_t tmp)
+		/**
+		Tests if the image contains NaN values.
+		*/
+		template<typename pixel_t> bool containsNaN(const Image<pixel_t>& img)
 		{
-			return (float32_t)tmp - (float32_t)out * (float32_t)out;
+			if constexpr (std::is_floating_point_v<pixel_t>)
+			{
+				for (coord_t n = 0; n < img.pixelCount(); n++)
+				{
+					if (NumberUtils<pixel_t>::isnan(img(n)))
+						return true;
+				}
+			}
+			return false;
 		}
 	}
 
-	template<> inline void varianceFilter(const Image<float32_t>& in, Image<float32_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType, BoundaryCondition bc)
+	/**
+	Calculates median filtering.
+	Sliding window algorithm is used if it is estimated to be faster than direct filtering and the image does not contain NaN values.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void medianFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
 	{
-		if(nbType == NeighbourhoodType::Rectangular)
-		{
-			out.ensureSize(in);
+		Vec3c r = nbRadius;
+		for (size_t n = in.dimensionality(); n < r.size(); n++)
+			r[n] = 0;
 
-			// Calculate mean filtering of in. For now on, out = mean(in)
-			setValue(out, in);
-			sepFilter<float32_t, internals::meanOp<float32_t> >(out, nbRadius, bc);
+		if (internals::isSlidingMedianFaster(in, r, nbType) && !internals::containsNaN(in))
+			slidingMedianFilter<pixel_t, out_t>(in, out, r, nbType, bc);
+		else
+			filter<pixel_t, out_t, internals::medianOp<pixel_t> >(in, out, nbRadius, nbType, bc);
+	}
 
-			// Calculate in^2. For now on, out contains in^2.
-			Image<float32_t> tmp;
-			tmp.ensureSize(in);
-			setValue<float32_t>(tmp, in);
-			multiply(tmp, tmp);
+	/**
+	Calculates median filtering.
+	Sliding window algorithm is used if it is estimated to be faster than direct filtering and the image does not contain NaN values.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	*/
+	template<typename pixel_t, typename out_t> void medianFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		medianFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc);
+	}
 
-			// Calculate mean of orig^2. For now on, tmp = mean(in^2).
-			sepFilter<float32_t, internals::meanOp<float32_t> >(tmp, nbRadius, bc);
+	DEFINE_FILTER_1PARAM(maskedMedian, pixel_t, Calculates masked median filtering., Image value that should not be considered when calculating median.)
 
-			// Calculate variance with mean(in^2) - mean(in)^2 = tmp - out * out
-			pointProcessImageImage<float32_t, float32_t, float32_t, internals::rectVarianceFinalization>(out, tmp, false);
-		}
+	#define COMMA ,
+	DEFINE_FILTER_1PARAM(vawe, double, Calculates variance weighted mean filtering., Standard deviation of noise. For a rough order of magnitude estimateCOMMA measure standard deviation from a region that does not contain any features.)
+
+
+	/**
+	Calculates variance filtering.
+
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition (BoundaryCondition::Zero or Nearest).
+	*/
+	template<typename pixel_t, typename out_t> void varianceFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		if (nbType == NeighbourhoodType::Rectangular && internals::canUseBoxSums(in))
+			boxVarianceFilter<pixel_t, out_t>(in, out, nbRadius, bc);
 		else
-		{
-			filter<float32_t, float32_t, internals::varianceOp<float32_t> >(in, out, nbRadius, nbType, bc);
-		}
+			filter<pixel_t, out_t, internals::varianceOp<pixel_t> >(in, out, nbRadius, nbType, bc);
 	}
+	
+	/**
+	Calculates variance filtering.
 
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition (BoundaryCondition::Zero or Nearest).
+	*/
+	template<typename pixel_t, typename out_t> void varianceFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
+	{
+		varianceFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc);
+	}
 
 	/**
 	Calculates standard deviation filtering.
 
-	Separable optimization is used for rectangular neighbourhoods.
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
 	@param in Input image.
 	@param out Output image.
 	@param nbRadius Radius of filtering neighbourhood.
@@ -1704,13 +1717,16 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 	*/
 	template<typename pixel_t, typename out_t> void stddevFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest)
 	{
-		filter<pixel_t, out_t, internals::stddevOp<pixel_t> >(in, out, nbRadius, nbType, bc);
+		if (nbType == NeighbourhoodType::Rectangular && internals::canUseBoxSums(in))
+			boxStddevFilter<pixel_t, out_t>(in, out, nbRadius, bc);
+		else
+			filter<pixel_t, out_t, internals::stddevOp<pixel_t> >(in, out, nbRadius, nbType, bc);
 	}
 
 	/**
 	Calculates standard deviation filtering.
 
-	Separable optimization is used for rectangular neighbourhoods.
+	Running sums are used for rectangular neighbourhoods, so the processing time does not depend on the size of the neighbourhood.
 	@param in Input image.
 	@param out Output image.
 	@param nbRadius Radius of filtering neighbourhood.
@@ -27,6 +27,36 @@ namespace itl2
 		>::type;
 	};
 
+	namespace internals
+	{
+		/**
+		Determines the bin where the given pixel value belongs to in a histogram of dim bins spanning the given range.
+		Out-of-range values are placed to the first or the last bin.
+		*/
+		template<typename pixel_t> coord_t histogramBin(pixel_t pix, const Vec2d& range, coord_t dim)
+		{
+			coord_t bin = itl2::floor(((pix - range.x) / (range.y - range.x)) * (double)dim);
+
+			// Problem with above expression is that the terms inside floor() may give, e.g. 0.2899999998 for pixel
+			// that should go to bin 290-300. The floor makes it end in bin 280-290.
+			// Check that the pixel really belongs to the bin determined using above expression, and adjust if necessary.
+			// TODO: There is probably some numerically stable algorithm that does not need this check.
+			pixel_t binMin = pixelRound<pixel_t>(range.x + (double)bin / (double)dim * (range.y - range.x));
+			pixel_t binMax = pixelRound<pixel_t>(range.x + (double)(bin + 1) / (double)dim * (range.y - range.x));
+			if (pix < binMin)
+				bin--;
+			else if (pix >= binMax)
+				bin++;
+
+			if (bin < 0)
+				bin = 0;
+			else if (bin >= dim)
+				bin = dim - 1;
+
+			return bin;
+		}
+	}
+
 	/**
 	Calculates unweighted or weighted histogram of input image.
 	@param img Image whose histogram is calculated.
@@ -58,24 +88,7 @@ namespace itl2
 					{
 						if (img.edgeDistance(Vec3c(x, y, z)) >= edgeSkip)
 						{
-							pixel_t pix = img(x, y, z);
-							coord_t bin = itl2::floor(((pix - range.x) / (range.y - range.x)) * (double)dim);
-
-							// Problem with above expression is that the terms inside floor() may give, e.g. 0.2899999998 for pixel
-							// that should go to bin 290-300. The floor makes it end in bin 280-290.
-							// Check that the pixel really belongs to the bin determined using above expression, and adjust if necessary.
-							// TODO: There is probably some numerically stable algorithm that does not need this check.
-							pixel_t binMin = pixelRound<pixel_t>(range.x + (double)bin / (double)dim * (range.y - range.x));
-							pixel_t binMax = pixelRound<pixel_t>(range.x + (double)(bin + 1) / (double)dim * (range.y - range.x));
-							if (pix < binMin)
-								bin--;
-							else if (pix >= binMax)
-								bin++;
-
-							if (bin < 0)
-								bin = 0;
-							else if (bin >= dim)
-								bin = dim - 1;
+							coord_t bin = internals::histogramBin(img(x, y, z), range, dim);
 
 							if (!pWeight)
 								privateHist(bin)++;
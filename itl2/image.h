@@ -645,6 +645,27 @@ namespace itl2
 			pDataConst = pData;
 		}
 
+		/**
+		Makes this image a 1-dimensional view to a range of pixels of another image.
+		The pixels are taken in the order of their linear indices.
+		@param start Linear index of the first pixel in the view.
+		@param count Count of pixels in the view.
+		*/
+		void initLinearView(Image<pixel_t>& source, coord_t start, coord_t count)
+		{
+			if (start < 0 || count <= 0 || start + count > source.pixelCount())
+				throw ITLException("Invalid pixel range.");
+
+			deleteData();
+
+			dims.x = count;
+			dims.y = 1;
+			dims.z = 1;
+			pBufferObject = 0;
+			pData = &source(start);
+			pDataConst = pData;
+		}
+
 		void init(const Image<pixel_t>& source, coord_t startZ, coord_t endZ)
 		{
 			if (startZ < 0 || endZ < 0 || startZ >= source.depth() || endZ >= source.depth() || startZ > endZ)
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <vector>
-//#include <atomic>
+#include <atomic>
+#include <omp.h>
 
 #include "ompatomic.h"
+#include "buildsettings.h"
 
 namespace itl2
 {
@@ -112,4 +114,98 @@ namespace itl2
 		}
 	};
 
-}
\ No newline at end of file
+	/**
+	Disjoint-set forest that contains all sets in some range [0, max[.
+	Any number of threads may call find_set and union_sets concurrently. The operations do not use locks.
+	The root of each set is always the smallest element of the set.
+	*/
+	class ConcurrentIndexForest
+	{
+	private:
+		/**
+		Parent of each element. The parent of an element is never larger than the element itself.
+		*/
+		std::vector<std::atomic<size_t> > parents;
+
+	public:
+
+		/**
+		Creates forest containing no sets.
+		*/
+		ConcurrentIndexForest()
+		{
+		}
+
+		/**
+		Creates forest that contains elements in range [0, maxValue[.
+		*/
+		ConcurrentIndexForest(size_t maxValue)
+		{
+			initialize(maxValue);
+		}
+
+		/**
+		Creates forest that contains elements in range [0, maxValue[, each in a set of its own.
+		Erases old forest, if any.
+		*/
+		void initialize(size_t maxValue)
+		{
+			parents = std::vector<std::atomic<size_t> >(maxValue);
+
+			#pragma omp parallel for if(maxValue > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+			for (int64_t n = 0; n < (int64_t)maxValue; n++)
+				parents[n].store((size_t)n, std::memory_order_relaxed);
+		}
+
+		/**
+		Gets count of elements in the forest.
+		*/
+		size_t size() const
+		{
+			return parents.size();
+		}
+
+		/**
+		Finds root of the set where x is contained.
+		Uses path halving to shorten the paths from the elements to the roots.
+		*/
+		size_t find_set(size_t x)
+		{
+			while (true)
+			{
+				size_t parent = parents[x].load(std::memory_order_relaxed);
+				if (parent == x)
+					return x;
+
+				size_t grandParent = parents[parent].load(std::memory_order_relaxed);
+				if (grandParent != parent)
+					parents[x].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+
+				x = grandParent;
+			}
+		}
+
+		/**
+		Merges sets containing keys x and y.
+		*/
+		void union_sets(size_t x, size_t y)
+		{
+			while (true)
+			{
+				x = find_set(x);
+				y = find_set(y);
+				if (x == y)
+					return;
+
+				// Link the larger root below the smaller one. If some other thread has changed the larger root
+				// in the meantime, try again.
+				if (x < y)
+					std::swap(x, y);
+
+				size_t expected = x;
+				if (parents[x].compare_exchange_strong(expected, y, std::memory_order_relaxed))
+					return;
+			}
+		}
+	};
+}
@@ -52,26 +52,31 @@ namespace itl2
 
 	/**
 	Replaces val in the img by nearest non-val value.
+	This version uses the given temporary images so that their memory can be re-used in repeated calls.
 	@param image Image to process.
 	@param val Value that marks missing pixels.
+	@param distance, coords Temporary images.
 	*/
-	template<typename pixel_t> void inpaintNearest(Image<pixel_t>& image, pixel_t val = 0)
+	template<typename pixel_t> void inpaintNearest(Image<pixel_t>& image, pixel_t val, Image<float32_t>& distance, Image<Vec3c>& coords)
 	{
 		bool process = false;
+		bool hasValues = false;
 		for (coord_t n = 0; n < image.pixelCount(); n++)
 		{
 			if (isFlag(image(n), val))
-			{
 				process = true;
+			else
+				hasValues = true;
+
+			if (process && hasValues)
 				break;
-			}
 		}
 
-		if (process)
+		// If there are no non-val pixels, the nearest points would not be set.
+		if (process && hasValues)
 		{
-
-			Image<float32_t> distance(image.dimensions());
-			Image<Vec3c> coords(image.dimensions());
+			distance.ensureSize(image.dimensions());
+			coords.ensureSize(image.dimensions());
 
 			for (coord_t n = 0; n < image.pixelCount(); n++)
 			{
@@ -97,6 +102,18 @@ namespace itl2
 		}
 	}
 
+	/**
+	Replaces val in the img by nearest non-val value.
+	@param image Image to process.
+	@param val Value that marks missing pixels.
+	*/
+	template<typename pixel_t> void inpaintNearest(Image<pixel_t>& image, pixel_t val = 0)
+	{
+		Image<float32_t> distance;
+		Image<Vec3c> coords;
+		inpaintNearest(image, val, distance, coords);
+	}
+
 	/**
 	Replaces value val in the img by a value interpolated from nearby non-val pixels.
 
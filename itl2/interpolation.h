@@ -79,6 +79,12 @@ namespace itl2
 			return operator()(img, x.x, x.y, x.z);
 		}
 
+		/**
+		Interpolates given image at locations start + i * step, where i = 0, 1, ..., count - 1, and stores the results to out.
+		This is faster than interpolating each location separately, and should be used e.g. for scanlines of affine transformations.
+		*/
+		virtual void line(const Image<input_t>& img, const Vec3d& start, const Vec3d& step, coord_t count, output_t* out) const = 0;
+
 		/**
 		Returns boundary condition of this interpolator.
 		*/
@@ -88,18 +94,193 @@ namespace itl2
 		}
 	};
 
+	namespace internals
+	{
+		/**
+		Implements virtual methods of Interpolator using non-virtual interpolate method of derived class derived_t.
+		The derived classes can be used directly to avoid virtual function calls.
+		*/
+		template<typename derived_t, typename output_t, typename input_t, typename real_t> class InterpolatorImpl : public Interpolator<output_t, input_t, real_t>
+		{
+		public:
+			InterpolatorImpl(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
+			{
+
+			}
+
+			using Interpolator<output_t, input_t, real_t>::operator();
+
+			virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override final
+			{
+				return static_cast<const derived_t*>(this)->interpolate(img, x, y, z);
+			}
+
+			virtual void line(const Image<input_t>& img, const Vec3d& start, const Vec3d& step, coord_t count, output_t* out) const override final
+			{
+				const derived_t& derived = *static_cast<const derived_t*>(this);
+				for (coord_t i = 0; i < count; i++)
+				{
+					Vec3d p = start + (double)i * step;
+					out[i] = derived.interpolate(img, (real_t)p.x, (real_t)p.y, (real_t)p.z);
+				}
+			}
+		};
+
+		/**
+		Determines taps of a separable interpolation kernel in one dimension.
+		Locations that are exactly at pixel centers require only one tap, as the weights of the other taps are zero.
+		@param x Location where the image is interpolated.
+		@param before Count of taps before floor(x).
+		@param size Count of taps in the kernel.
+		@param first Position of the first tap will be stored here.
+		@param weights Weights of the taps will be stored here. Must have space for size elements.
+		@param weight Weight function.
+		@return Count of taps.
+		*/
+		template<typename real_t, typename weight_t> coord_t kernelTaps(real_t x, coord_t before, coord_t size, coord_t& first, real_t* weights, weight_t weight)
+		{
+			coord_t x0 = itl2::floor(x);
+			if ((real_t)x0 == x)
+			{
+				first = x0;
+				weights[0] = weight(x - x0);
+				return 1;
+			}
+
+			first = x0 - before;
+			for (coord_t i = 0; i < size; i++)
+				weights[i] = weight(x - (first + i));
+			return size;
+		}
+
+		/**
+		Tests if all taps of a separable interpolation kernel are inside the image.
+		*/
+		template<typename pixel_t> bool tapsInImage(const Image<pixel_t>& img, coord_t u0, coord_t nu, coord_t v0, coord_t nv, coord_t w0, coord_t nw)
+		{
+			return u0 >= 0 && v0 >= 0 && w0 >= 0 && u0 + nu <= img.width() && v0 + nv <= img.height() && w0 + nw <= img.depth();
+		}
+
+		/**
+		Calculates weighted sum of pixels of a separable interpolation kernel.
+		@param pixel Function that returns value of pixel (u, v, w).
+		*/
+		template<typename intermediate_t, typename real_t, typename pixel_t> intermediate_t separableSum(
+			coord_t u0, coord_t nu, const real_t* wu,
+			coord_t v0, coord_t nv, const real_t* wv,
+			coord_t w0, coord_t nw, const real_t* ww,
+			pixel_t pixel)
+		{
+			intermediate_t r = intermediate_t();
+			for (coord_t k = 0; k < nw; k++)
+			{
+				intermediate_t q = intermediate_t();
+				for (coord_t j = 0; j < nv; j++)
+				{
+					intermediate_t p = intermediate_t();
+					for (coord_t i = 0; i < nu; i++)
+						p = p + pixel(u0 + i, v0 + j, w0 + k) * wu[i];
+
+					q = q + p * wv[j];
+				}
+
+				r = r + q * ww[k];
+			}
+
+			return r;
+		}
+
+		/**
+		Calculates weighted sum of pixels of a separable interpolation kernel, skipping pixels having invalid value.
+		The result is normalized by the sum of weights of valid pixels in each dimension.
+		@param pixel Function that returns value of pixel (u, v, w).
+		@return False if there are no valid pixels.
+		*/
+		template<typename intermediate_t, typename real_t, typename input_t, typename pixel_t> bool separableSumInvalid(
+			coord_t u0, coord_t nu, const real_t* wu,
+			coord_t v0, coord_t nv, const real_t* wv,
+			coord_t w0, coord_t nw, const real_t* ww,
+			input_t invalidValue, pixel_t pixel, intermediate_t& r)
+		{
+			r = intermediate_t();
+			real_t wTotR = 0;
+			for (coord_t k = 0; k < nw; k++)
+			{
+				intermediate_t q = intermediate_t();
+				real_t wTotQ = 0;
+
+				for (coord_t j = 0; j < nv; j++)
+				{
+					intermediate_t p = intermediate_t();
+					real_t wTotP = 0;
+
+					for (coord_t i = 0; i < nu; i++)
+					{
+						input_t pixval = pixel(u0 + i, v0 + j, w0 + k);
+						if (pixval != invalidValue)
+						{
+							p = p + pixval * wu[i];
+							wTotP += wu[i];
+						}
+					}
+
+					if (wTotP > 0)
+					{
+						q = q + p / wTotP * wv[j];
+						wTotQ += wv[j];
+					}
+				}
+
+				if (wTotQ > 0)
+				{
+					r = r + q / wTotQ * ww[k];
+					wTotR += ww[k];
+				}
+			}
+
+			if (wTotR > 0)
+			{
+				r /= wTotR;
+				return true;
+			}
+
+			return false;
+		}
+
+		/**
+		Evaluates sum(img, pixel) with pixel access function that reads pixels directly from the image if the kernel is inside the image,
+		and with pixel access function obeying boundary conditions otherwise.
+		*/
+		template<typename input_t, typename sum_t> auto sumInsideOrAtEdge(const Image<input_t>& img, BoundaryCondition bc,
+			coord_t u0, coord_t nu, coord_t v0, coord_t nv, coord_t w0, coord_t nw, sum_t sum)
+		{
+			if (tapsInImage(img, u0, nu, v0, nv, w0, nw))
+			{
+				const input_t* data = img.getData();
+				const coord_t width = img.width();
+				const coord_t sliceSize = img.width() * img.height();
+				return sum([=](coord_t u, coord_t v, coord_t w) { return data[w * sliceSize + v * width + u]; });
+			}
+
+			return sum([&](coord_t u, coord_t v, coord_t w) { return itl2::getPixelSafe(img, u, v, w, bc); });
+		}
+	}
+
 	/**
 	Nearest neighbour interpolation functor.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType> class NearestNeighbourInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType> class NearestNeighbourInterpolator : public internals::InterpolatorImpl<NearestNeighbourInterpolator<output_t, input_t, real_t>, output_t, input_t, real_t>
 	{
 	public:
-		NearestNeighbourInterpolator(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
+		NearestNeighbourInterpolator(BoundaryCondition bc) : internals::InterpolatorImpl<NearestNeighbourInterpolator<output_t, input_t, real_t>, output_t, input_t, real_t>(bc)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		/**
+		Interpolates given image at the given location without virtual function call.
+		*/
+		output_t interpolate(const Image<input_t>& img, real_t x, real_t y, real_t z) const
 		{
 			coord_t ix = (coord_t)::round(x);
 			coord_t iy = (coord_t)::round(y);
@@ -115,49 +296,35 @@ namespace itl2
 	@param real_t Scalar real number type, typically double.
 	@param intermediate_t Type of intermediate values, typically double or Vec3d etc.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType > class LinearInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType > class LinearInterpolator : public internals::InterpolatorImpl<LinearInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
-		inline real_t w_lin(real_t dx) const
+		static real_t w_lin(real_t dx)
 		{
 			return 1 - fabs(dx);
 		}
 
 	public:
-		LinearInterpolator(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
+		LinearInterpolator(BoundaryCondition bc) : internals::InterpolatorImpl<LinearInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		/**
+		Interpolates given image at the given location without virtual function call.
+		*/
+		output_t interpolate(const Image<input_t>& img, real_t x, real_t y, real_t z) const
 		{
-			coord_t u0 = itl2::floor(x);
-			coord_t v0 = itl2::floor(y);
-			coord_t w0 = itl2::floor(z);
+			real_t wu[2], wv[2], ww[2];
+			coord_t u0, v0, w0;
+			coord_t nu = internals::kernelTaps(x, 0, 2, u0, wu, w_lin);
+			coord_t nv = internals::kernelTaps(y, 0, 2, v0, wv, w_lin);
+			coord_t nw = internals::kernelTaps(z, 0, 2, w0, ww, w_lin);
 
-			intermediate_t r = intermediate_t();
-			for (int k = 0; k <= 1; k++)
-			{
-				intermediate_t q = intermediate_t();
-				coord_t w = w0 + k;
-
-				for (int j = 0; j <= 1; j++)
+			intermediate_t r = internals::sumInsideOrAtEdge(img, this->boundaryCondition(), u0, nu, v0, nv, w0, nw, [&](auto pixel)
 				{
-					intermediate_t p = intermediate_t();
-					coord_t v = v0 + j;
-
-					for (int i = 0; i <= 1; i++)
-					{
-						coord_t u = u0 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
-						p = p + pixval * w_lin(x - u);
-					}
-
-					q = q + p * w_lin(y - v);
-				}
-
-				r = r + q * w_lin(z - w);
-			}
+					return internals::separableSum<intermediate_t>(u0, nu, wu, v0, nv, wv, w0, nw, ww, pixel);
+				});
 
 			return pixelRound<output_t>(r);
 		}
@@ -172,10 +339,10 @@ namespace itl2
 	@param real_t Scalar real number type, typically double.
 	@param intermediate_t Type of intermediate values, typically double or Vec3d etc.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class LinearInvalidValueInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class LinearInvalidValueInterpolator : public internals::InterpolatorImpl<LinearInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
-		inline real_t w_lin(real_t dx) const
+		static real_t w_lin(real_t dx)
 		{
 			return 1 - fabs(dx);
 		}
@@ -184,88 +351,45 @@ namespace itl2
 		output_t invalidOutputValue;
 
 	public:
-		LinearInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue) : Interpolator<output_t, input_t, real_t>(bc), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
+		LinearInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue) : internals::InterpolatorImpl<LinearInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		/**
+		Interpolates given image at the given location without virtual function call.
+		*/
+		output_t interpolate(const Image<input_t>& img, real_t x, real_t y, real_t z) const
 		{
-			coord_t u0 = (coord_t)floor(x);
-			coord_t v0 = (coord_t)floor(y);
-			coord_t w0 = (coord_t)floor(z);
-
-			intermediate_t r = intermediate_t();
-			real_t wTotR = 0;
-			for (int k = 0; k <= 1; k++)
-			{
-				intermediate_t q = intermediate_t();
-				coord_t w = w0 + k;
-				real_t wTotQ = 0;
-
-				for (int j = 0; j <= 1; j++)
+			real_t wu[2], wv[2], ww[2];
+			coord_t u0, v0, w0;
+			coord_t nu = internals::kernelTaps(x, 0, 2, u0, wu, w_lin);
+			coord_t nv = internals::kernelTaps(y, 0, 2, v0, wv, w_lin);
+			coord_t nw = internals::kernelTaps(z, 0, 2, w0, ww, w_lin);
+
+			intermediate_t r;
+			bool valid = internals::sumInsideOrAtEdge(img, this->boundaryCondition(), u0, nu, v0, nv, w0, nw, [&](auto pixel)
 				{
-					intermediate_t p = intermediate_t();
-					coord_t v = v0 + j;
-					real_t wTotP = 0;
+					return internals::separableSumInvalid<intermediate_t>(u0, nu, wu, v0, nv, wv, w0, nw, ww, invalidInputValue, pixel, r);
+				});
 
-					for (int i = 0; i <= 1; i++)
-					{
-						coord_t u = u0 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
-						if (pixval != invalidInputValue)
-						{
-							real_t ww = w_lin(x - u);
-							p = p + pixval * ww;
-							wTotP += ww;
-						}
-					}
-
-					if (wTotP > 0)
-					{
-						real_t ww = w_lin(y - v);
-						q = q + p / wTotP * ww;
-						wTotQ += ww;
-					}
-				}
-
-				if (wTotQ > 0)
-				{
-					real_t ww = w_lin(z - w);
-					r = r + q / wTotQ * ww;
-					wTotR += ww;
-				}
-			}
-
-			if (wTotR > 0)
-			{
-				r /= wTotR;
+			if (valid)
 				return pixelRound<output_t>(r);
-			}
 
 			return invalidOutputValue;
 		}
 	};
 
-	/**
-	Cubic interpolation functor.
-	This code is from
-	https://github.com/imagingbook/imagingbook-common/blob/master/src/main/java/imagingbook/lib/interpolation/BicubicInterpolator.java
-	See http://imagingbook.com
-	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInterpolator : public Interpolator<output_t, input_t, real_t>
+	namespace internals
 	{
-	private:
-		real_t a;
-
 		/*
 		Cubic weight funtion in 1D.
 		*/
-		real_t w_cub(real_t x) const
+		template<typename real_t> real_t w_cub(real_t x, real_t a)
 		{
 			if (x < 0)
 				x = -x;
-			
+
 			if (x < 1)
 				return (-a + 2) * x * x * x + (a - 3) * x * x + 1;
 			else if (x < 2)
@@ -273,42 +397,42 @@ namespace itl2
 
 			return 0;
 		}
+	}
+
+	/**
+	Cubic interpolation functor.
+	This code is from
+	https://github.com/imagingbook/imagingbook-common/blob/master/src/main/java/imagingbook/lib/interpolation/BicubicInterpolator.java
+	See http://imagingbook.com
+	*/
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInterpolator : public internals::InterpolatorImpl<CubicInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
+	{
+	private:
+		real_t a;
 
 	public:
-		CubicInterpolator(BoundaryCondition bc, real_t sharpness = (real_t)0.5) : Interpolator<output_t, input_t, real_t>(bc), a(sharpness)
+		CubicInterpolator(BoundaryCondition bc, real_t sharpness = (real_t)0.5) : internals::InterpolatorImpl<CubicInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), a(sharpness)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		/**
+		Interpolates given image at the given location without virtual function call.
+		*/
+		output_t interpolate(const Image<input_t>& img, real_t x, real_t y, real_t z) const
 		{
-			coord_t u0 = (coord_t)floor(x);
-			coord_t v0 = (coord_t)floor(y);
-			coord_t w0 = (coord_t)floor(z);
+			auto w_cub = [&](real_t d) { return internals::w_cub(d, a); };
 
-			intermediate_t r = intermediate_t();
-			for (int k = 0; k <= 3; k++)
-			{
-				coord_t w = w0 - 1 + k;
-				intermediate_t q = intermediate_t();
+			real_t wu[4], wv[4], ww[4];
+			coord_t u0, v0, w0;
+			coord_t nu = internals::kernelTaps(x, 1, 4, u0, wu, w_cub);
+			coord_t nv = internals::kernelTaps(y, 1, 4, v0, wv, w_cub);
+			coord_t nw = internals::kernelTaps(z, 1, 4, w0, ww, w_cub);
 
-				for (int j = 0; j <= 3; j++)
+			intermediate_t r = internals::sumInsideOrAtEdge(img, this->boundaryCondition(), u0, nu, v0, nv, w0, nw, [&](auto pixel)
 				{
-					coord_t v = v0 - 1 + j;
-					intermediate_t p = intermediate_t();
-
-					for (int i = 0; i <= 3; i++)
-					{
-						coord_t u = u0 - 1 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
-						p = p + pixval * w_cub(x - u);
-					}
-
-					q = q + p * w_cub(y - v);
-				}
-
-				r = r + q * w_cub(z - w);
-			}
+					return internals::separableSum<intermediate_t>(u0, nu, wu, v0, nv, wv, w0, nw, ww, pixel);
+				});
 
 			return pixelRound<output_t>(r);
 		}
@@ -322,89 +446,41 @@ namespace itl2
 	https://github.com/imagingbook/imagingbook-common/blob/master/src/main/java/imagingbook/lib/interpolation/BicubicInterpolator.java
 	See http://imagingbook.com
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInvalidValueInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInvalidValueInterpolator : public internals::InterpolatorImpl<CubicInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
 		real_t a;
 
-		/*
-		Cubic weight funtion in 1D.
-		*/
-		real_t w_cub(real_t x) const
-		{
-			if (x < 0)
-				x = -x;
-
-			if (x < 1)
-				return (-a + 2) * x * x * x + (a - 3) * x * x + 1;
-			else if (x < 2)
-				return -a * x * x * x + 5 * a * x * x - 8 * a * x + 4 * a;
-
-			return 0;
-		}
-
 		input_t invalidInputValue;
 		output_t invalidOutputValue;
 
 	public:
-		CubicInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue, real_t sharpness = (real_t)0.5) : Interpolator<output_t, input_t, real_t>(bc), a(sharpness), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
+		CubicInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue, real_t sharpness = (real_t)0.5) : internals::InterpolatorImpl<CubicInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), a(sharpness), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		/**
+		Interpolates given image at the given location without virtual function call.
+		*/
+		output_t interpolate(const Image<input_t>& img, real_t x, real_t y, real_t z) const
 		{
-			coord_t u0 = (coord_t)floor(x);
-			coord_t v0 = (coord_t)floor(y);
-			coord_t w0 = (coord_t)floor(z);
+			auto w_cub = [&](real_t d) { return internals::w_cub(d, a); };
 
-			intermediate_t r = intermediate_t();
-			real_t wTotR = 0;
-			for (int k = 0; k <= 3; k++)
-			{
-				intermediate_t q = intermediate_t();
-				coord_t w = w0 - 1 + k;
-				real_t wTotQ = 0;
-
-				for (int j = 0; j <= 3; j++)
-				{
-					intermediate_t p = intermediate_t();
-					coord_t v = v0 - 1 + j;
-					real_t wTotP = 0;
-
-					for (int i = 0; i <= 3; i++)
-					{
-						coord_t u = u0 - 1 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
-						if (pixval != invalidInputValue)
-						{
-							real_t ww = w_cub(x - u);
-							p = p + pixval * ww;
-							wTotP += ww;
-						}
-					}
+			real_t wu[4], wv[4], ww[4];
+			coord_t u0, v0, w0;
+			coord_t nu = internals::kernelTaps(x, 1, 4, u0, wu, w_cub);
+			coord_t nv = internals::kernelTaps(y, 1, 4, v0, wv, w_cub);
+			coord_t nw = internals::kernelTaps(z, 1, 4, w0, ww, w_cub);
 
-					if (wTotP > 0)
-					{
-						real_t ww = w_cub(y - v);
-						q = q + p / wTotP * ww;
-						wTotQ += ww;
-					}
-				}
-
-				if (wTotQ > 0)
+			intermediate_t r;
+			bool valid = internals::sumInsideOrAtEdge(img, this->boundaryCondition(), u0, nu, v0, nv, w0, nw, [&](auto pixel)
 				{
-					real_t ww = w_cub(z - w);
-					r = r + q / wTotQ * ww;
-					wTotR += ww;
-				}
-			}
+					return internals::separableSumInvalid<intermediate_t>(u0, nu, wu, v0, nv, wv, w0, nw, ww, invalidInputValue, pixel, r);
+				});
 
-			if (wTotR > 0)
-			{
-				r /= wTotR;
+			if (valid)
 				return pixelRound<output_t>(r);
-			}
 
 			return invalidOutputValue;
 		}
@@ -0,0 +1,496 @@
+
+#include "io/blockio.h"
+#include "io/raw.h"
+#include "itlexception.h"
+#include "utilities.h"
+#include "progress.h"
+#include "noise.h"
+#include "pointprocess.h"
+#include "transform.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <exception>
+#include <omp.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <stdlib.h>
+
+#elif defined(_WIN32)
+
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <malloc.h>
+
+#else
+
+	#error blockio.cpp not configured for this platform.
+
+#endif
+
+using namespace std;
+
+namespace itl2
+{
+	BlockIOSettings& blockIOSettings()
+	{
+		static BlockIOSettings settings;
+		return settings;
+	}
+
+	namespace
+	{
+		/**
+		Converts system error code to message.
+		*/
+		string systemErrorMessage()
+		{
+#if defined(__linux__) || defined(__APPLE__)
+			return strerror(errno);
+#elif defined(_WIN32)
+			return string("Error code ") + toString(GetLastError());
+#endif
+		}
+
+		/**
+		Memory buffer whose start is aligned to the direct I/O alignment.
+		*/
+		class AlignedBuffer
+		{
+		private:
+			void* p = nullptr;
+			size_t capacity = 0;
+
+			void release()
+			{
+#if defined(_WIN32)
+				_aligned_free(p);
+#else
+				free(p);
+#endif
+				p = nullptr;
+				capacity = 0;
+			}
+
+		public:
+			AlignedBuffer() = default;
+			AlignedBuffer(const AlignedBuffer&) = delete;
+			AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+			~AlignedBuffer()
+			{
+				release();
+			}
+
+			/**
+			Ensures that the buffer can hold at least the given count of bytes, and returns pointer to the data.
+			The contents of the buffer are not preserved.
+			*/
+			char* reserve(size_t size)
+			{
+				if (size > capacity)
+				{
+					release();
+#if defined(_WIN32)
+					p = _aligned_malloc(size, PositionalFile::DIRECT_ALIGNMENT);
+#else
+					if (posix_memalign(&p, PositionalFile::DIRECT_ALIGNMENT, size) != 0)
+						p = nullptr;
+#endif
+					if (!p)
+						throw ITLException(string("Unable to allocate ") + bytesToString((double)size) + " I/O buffer.");
+					capacity = size;
+				}
+				return (char*)p;
+			}
+		};
+
+		/**
+		Runs the given function for all tasks in parallel, and re-throws the first error in the calling thread.
+		*/
+		template<typename F> void runIOTasks(size_t taskCount, const BlockIOSettings& settings, bool showProgressInfo, F f)
+		{
+			int threads = settings.threads > 0 ? (int)settings.threads : omp_get_max_threads();
+
+			// Exceptions must not propagate out of the parallel region, so the first one is stored and re-thrown afterwards.
+			exception_ptr error;
+			ProgressIndicator prog(taskCount, showProgressInfo);
+#pragma omp parallel for if(!omp_in_parallel() && taskCount > 1) num_threads(threads) schedule(dynamic)
+			for (coord_t n = 0; n < (coord_t)taskCount; n++)
+			{
+				try
+				{
+					f((size_t)n);
+				}
+				catch (...)
+				{
+#pragma omp critical(blockio_error)
+					{
+						if (!error)
+							error = current_exception();
+					}
+				}
+				prog.step();
+			}
+
+			if (error)
+				rethrow_exception(error);
+		}
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+
+	PositionalFile::PositionalFile(const string& filename, bool writable, bool direct) :
+		filename(filename),
+		handle(-1),
+		direct(false)
+	{
+		int flags = writable ? O_RDWR : O_RDONLY;
+
+#if defined(__linux__)
+		if (direct)
+		{
+			// Not all file systems support direct I/O. In that case we fall back to buffered I/O.
+			handle = open(filename.c_str(), flags | O_DIRECT);
+			this->direct = handle >= 0;
+		}
+#endif
+
+		if (handle < 0)
+			handle = open(filename.c_str(), flags);
+
+		if (handle < 0)
+			throw ITLException(string("Unable to open ") + filename + ", " + systemErrorMessage());
+	}
+
+	PositionalFile::~PositionalFile()
+	{
+		close((int)handle);
+	}
+
+	size_t PositionalFile::readSome(size_t filePosition, void* buffer, size_t size) const
+	{
+		char* p = (char*)buffer;
+		size_t done = 0;
+		while (done < size)
+		{
+			ssize_t count = pread((int)handle, p + done, size - done, (off_t)(filePosition + done));
+			if (count < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw ITLException(string("Unable to read ") + filename + ", " + systemErrorMessage());
+			}
+			if (count == 0)
+				break;
+			done += (size_t)count;
+
+			// In direct I/O, a short read means that the end of the file has been reached, and
+			// continuing from an unaligned position would fail.
+			if (direct && done % DIRECT_ALIGNMENT != 0)
+				break;
+		}
+		return done;
+	}
+
+	void PositionalFile::write(size_t filePosition, const void* buffer, size_t size) const
+	{
+		const char* p = (const char*)buffer;
+		size_t done = 0;
+		while (done < size)
+		{
+			ssize_t count = pwrite((int)handle, p + done, size - done, (off_t)(filePosition + done));
+			if (count < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw ITLException(string("Unable to write to ") + filename + ", " + systemErrorMessage());
+			}
+			done += (size_t)count;
+		}
+	}
+
+#elif defined(_WIN32)
+
+	PositionalFile::PositionalFile(const string& filename, bool writable, bool direct) :
+		filename(filename),
+		handle((intptr_t)INVALID_HANDLE_VALUE),
+		direct(false)
+	{
+		// Direct I/O would require aligned writes, too, so it is not used in Windows.
+		DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+		HANDLE h = CreateFileA(filename.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h == INVALID_HANDLE_VALUE)
+			throw ITLException(string("Unable to open ") + filename + ", " + systemErrorMessage());
+		handle = (intptr_t)h;
+	}
+
+	PositionalFile::~PositionalFile()
+	{
+		CloseHandle((HANDLE)handle);
+	}
+
+	size_t PositionalFile::readSome(size_t filePosition, void* buffer, size_t size) const
+	{
+		char* p = (char*)buffer;
+		size_t done = 0;
+		while (done < size)
+		{
+			OVERLAPPED ov = { 0 };
+			size_t pos = filePosition + done;
+			ov.Offset = (DWORD)(pos & 0xffffffff);
+			ov.OffsetHigh = (DWORD)(pos >> 32);
+			DWORD request = (DWORD)std::min<size_t>(size - done, 1024 * 1024 * 1024);
+			DWORD count = 0;
+			if (!ReadFile((HANDLE)handle, p + done, request, &count, &ov))
+			{
+				if (GetLastError() == ERROR_HANDLE_EOF)
+					break;
+				throw ITLException(string("Unable to read ") + filename + ", " + systemErrorMessage());
+			}
+			if (count == 0)
+				break;
+			done += count;
+		}
+		return done;
+	}
+
+	void PositionalFile::write(size_t filePosition, const void* buffer, size_t size) const
+	{
+		const char* p = (const char*)buffer;
+		size_t done = 0;
+		while (done < size)
+		{
+			OVERLAPPED ov = { 0 };
+			size_t pos = filePosition + done;
+			ov.Offset = (DWORD)(pos & 0xffffffff);
+			ov.OffsetHigh = (DWORD)(pos >> 32);
+			DWORD request = (DWORD)std::min<size_t>(size - done, 1024 * 1024 * 1024);
+			DWORD count = 0;
+			if (!WriteFile((HANDLE)handle, p + done, request, &count, &ov))
+				throw ITLException(string("Unable to write to ") + filename + ", " + systemErrorMessage());
+			done += count;
+		}
+	}
+
+#endif
+
+	void PositionalFile::read(size_t filePosition, void* buffer, size_t size) const
+	{
+		if (readSome(filePosition, buffer, size) != size)
+			throw ITLException(string("Unexpected end of file while reading ") + filename + ", file size might be incorrect.");
+	}
+
+	namespace
+	{
+		/**
+		Divides ranges longer than maximum request size to multiple ranges.
+		*/
+		vector<FileRange> splitRanges(const vector<FileRange>& ranges, size_t maxSize)
+		{
+			maxSize = std::max<size_t>(maxSize, PositionalFile::DIRECT_ALIGNMENT);
+
+			vector<FileRange> result;
+			result.reserve(ranges.size());
+			for (const FileRange& r : ranges)
+			{
+				for (size_t pos = 0; pos < r.size; pos += maxSize)
+					result.push_back({ r.filePosition + pos, r.bufferPosition + pos, std::min(maxSize, r.size - pos) });
+			}
+			return result;
+		}
+
+		/**
+		Group of consecutive ranges that are read using a single read call.
+		*/
+		struct ReadSpan
+		{
+			size_t first;
+			size_t last;
+			size_t start;
+			size_t end;
+		};
+	}
+
+	void readRanges(const string& filename, const vector<FileRange>& ranges, void* buffer, bool showProgressInfo, const BlockIOSettings& settings)
+	{
+		if (ranges.empty())
+			return;
+
+		vector<FileRange> parts = splitRanges(ranges, settings.maxRequestSize);
+		std::sort(parts.begin(), parts.end(), [](const FileRange& a, const FileRange& b) { return a.filePosition < b.filePosition; });
+
+		// Combine nearby ranges to spans that are read using one call.
+		vector<ReadSpan> spans;
+		spans.push_back({ 0, 0, parts[0].filePosition, parts[0].filePosition + parts[0].size });
+		for (size_t n = 1; n < parts.size(); n++)
+		{
+			ReadSpan& span = spans.back();
+			const FileRange& r = parts[n];
+			size_t end = std::max(span.end, r.filePosition + r.size);
+			if (r.filePosition <= span.end + settings.maxGap && end - span.start <= settings.maxRequestSize)
+			{
+				span.last = n;
+				span.end = end;
+			}
+			else
+			{
+				spans.push_back({ n, n, r.filePosition, r.filePosition + r.size });
+			}
+		}
+
+		PositionalFile file(filename, false, settings.directRead);
+		char* pBuffer = (char*)buffer;
+
+		runIOTasks(spans.size(), settings, showProgressInfo, [&](size_t i)
+			{
+				const ReadSpan& span = spans[i];
+
+				if (span.first == span.last && !file.isDirect())
+				{
+					// Single range, read directly to the target buffer.
+					const FileRange& r = parts[span.first];
+					file.read(r.filePosition, pBuffer + r.bufferPosition, r.size);
+					return;
+				}
+
+				size_t start = span.start;
+				size_t end = span.end;
+				if (file.isDirect())
+				{
+					start = start / PositionalFile::DIRECT_ALIGNMENT * PositionalFile::DIRECT_ALIGNMENT;
+					end = (end + PositionalFile::DIRECT_ALIGNMENT - 1) / PositionalFile::DIRECT_ALIGNMENT * PositionalFile::DIRECT_ALIGNMENT;
+				}
+
+				// The staging buffer is allocated per span, as the spans might be processed by threads of an enclosing parallel region.
+				AlignedBuffer staging;
+				char* pStaging = staging.reserve(end - start);
+
+				// Direct reads may extend beyond the end of the file; that is fine as long as the requested ranges are covered.
+				size_t count = file.readSome(start, pStaging, end - start);
+				if (start + count < span.end)
+					throw ITLException(string("Unexpected end of file while reading ") + filename + ", file size might be incorrect.");
+
+				for (size_t n = span.first; n <= span.last; n++)
+				{
+					const FileRange& r = parts[n];
+					memcpy(pBuffer + r.bufferPosition, pStaging + (r.filePosition - start), r.size);
+				}
+			});
+	}
+
+	void writeRanges(const string& filename, const vector<FileRange>& ranges, const void* buffer, bool showProgressInfo, const BlockIOSettings& settings)
+	{
+		if (ranges.empty())
+			return;
+
+		vector<FileRange> parts = splitRanges(ranges, settings.maxRequestSize);
+
+		PositionalFile file(filename, true);
+		const char* pBuffer = (const char*)buffer;
+
+		runIOTasks(parts.size(), settings, showProgressInfo, [&](size_t i)
+			{
+				const FileRange& r = parts[i];
+				file.write(r.filePosition, pBuffer + r.bufferPosition, r.size);
+			});
+	}
+
+	namespace tests
+	{
+		void blockIO()
+		{
+			Image<uint16_t> img(123, 87, 45);
+			noise(img, 1000, 500, 9);
+
+			string filename = raw::writed(img, "./raw/blockio_test");
+
+			// Blocks that contain partial scanlines, whole scanlines and whole slices, and one that extends beyond the image.
+			vector<tuple<Vec3c, Vec3c> > blocks =
+			{
+				make_tuple(Vec3c(10, 20, 5), Vec3c(50, 30, 20)),
+				make_tuple(Vec3c(0, 20, 5), Vec3c(123, 30, 20)),
+				make_tuple(Vec3c(0, 0, 7), Vec3c(123, 87, 30)),
+				make_tuple(Vec3c(100, 80, 40), Vec3c(23, 7, 5)),
+			};
+
+			BlockIOSettings oldSettings = blockIOSettings();
+
+			for (size_t settingsIndex = 0; settingsIndex < 3; settingsIndex++)
+			{
+				BlockIOSettings settings;
+				if (settingsIndex == 1)
+				{
+					// Separate call for each range and part of a range.
+					settings.maxGap = 0;
+					settings.maxRequestSize = 1;
+				}
+				else if (settingsIndex == 2)
+				{
+					settings.directRead = true;
+				}
+				blockIOSettings() = settings;
+
+				for (const auto& block : blocks)
+				{
+					Vec3c start = get<0>(block);
+					Vec3c size = get<1>(block);
+
+					Image<uint16_t> result(size);
+					raw::readBlock(result, filename, start);
+
+					Image<uint16_t> expected(size);
+					crop(img, expected, start);
+
+					testAssert(equals(result, expected), string("block read with settings ") + toString(settingsIndex));
+				}
+
+				// Write the image in blocks and check that the file equals the original.
+				string outFile = concatDimensions(string("./raw/blockio_test_blocks_") + toString(settingsIndex), img.dimensions());
+				for (coord_t z = 0; z < img.depth(); z += 10)
+				{
+					for (coord_t x = 0; x < img.width(); x += 50)
+					{
+						Vec3c pos(x, 0, z);
+						Vec3c size(50, img.height(), 10);
+						size = min(size, img.dimensions() - pos);
+						raw::writeBlock(img, outFile, pos, img.dimensions(), pos, size);
+					}
+				}
+
+				Image<uint16_t> written;
+				raw::read(written, outFile);
+				testAssert(equals(written, img), string("block write with settings ") + toString(settingsIndex));
+			}
+
+			blockIOSettings() = oldSettings;
+
+			// Image data that does not start at the beginning of the file.
+			Image<uint16_t> header(10, 1, 1);
+			setValue(header, 17);
+			string offsetFile = "./raw/blockio_offset_test.raw";
+			raw::write(header, offsetFile);
+			raw::write(img, offsetFile, false);
+
+			for (const auto& block : blocks)
+			{
+				Image<uint16_t> result(get<1>(block));
+				raw::readBlockNoParse(result, offsetFile, img.dimensions(), get<0>(block), false, header.pixelCount() * sizeof(uint16_t));
+
+				Image<uint16_t> expected(get<1>(block));
+				crop(img, expected, get<0>(block));
+
+				testAssert(equals(result, expected), "block read with offset");
+			}
+		}
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "datatypes.h"
+
+namespace itl2
+{
+	/**
+	Settings for reading and writing blocks of binary files with positional I/O calls.
+	*/
+	struct BlockIOSettings
+	{
+		/**
+		Maximum count of threads used to read or write a single block.
+		Set to zero to use the default count of threads.
+		*/
+		size_t threads = 0;
+
+		/**
+		Set to true to read data with direct I/O, bypassing the operating system file cache.
+		Direct I/O is useful when large files are streamed through once, e.g. in distributed processing.
+		Direct I/O is supported on Linux only, and buffered I/O is used if it is not available.
+		*/
+		bool directRead = false;
+
+		/**
+		Gaps smaller than this (in bytes) between ranges that are read are read and discarded instead of
+		issuing separate read calls.
+		Writes never cover gaps.
+		*/
+		size_t maxGap = 64 * 1024;
+
+		/**
+		Maximum size of a single read or write call in bytes.
+		*/
+		size_t maxRequestSize = 16 * 1024 * 1024;
+	};
+
+	/**
+	Returns reference to settings that are used in block reads and writes by default.
+	*/
+	BlockIOSettings& blockIOSettings();
+
+	/**
+	Range of bytes that is transferred between a file and a memory buffer.
+	*/
+	struct FileRange
+	{
+		/**
+		Position of the first byte in the file.
+		*/
+		size_t filePosition;
+
+		/**
+		Position of the first byte in the buffer.
+		*/
+		size_t bufferPosition;
+
+		/**
+		Count of bytes in the range.
+		*/
+		size_t size;
+	};
+
+	/**
+	Adds a range to the list of ranges.
+	If the range continues the last range in the list both in the file and in the buffer, the last range is extended instead.
+	*/
+	inline void addRange(std::vector<FileRange>& ranges, size_t filePosition, size_t bufferPosition, size_t size)
+	{
+		if (size <= 0)
+			return;
+
+		if (!ranges.empty())
+		{
+			FileRange& last = ranges.back();
+			if (last.filePosition + last.size == filePosition && last.bufferPosition + last.size == bufferPosition)
+			{
+				last.size += size;
+				return;
+			}
+		}
+
+		ranges.push_back({ filePosition, bufferPosition, size });
+	}
+
+	/**
+	File that is read and written using positional calls (pread and pwrite or their equivalents).
+	The calls do not share file position, so a single file object can be used from multiple threads at once.
+	*/
+	class PositionalFile
+	{
+	private:
+		/**
+		Name of the file.
+		*/
+		std::string filename;
+
+		/**
+		File descriptor or handle.
+		*/
+		intptr_t handle;
+
+		/**
+		Indicates whether direct I/O is in use.
+		*/
+		bool direct;
+
+	public:
+		/**
+		Required alignment of file positions, buffers, and sizes in direct I/O.
+		*/
+		static const size_t DIRECT_ALIGNMENT = 4096;
+
+		/**
+		Opens the given file.
+		@param filename Name of the file.
+		@param writable Set to true to open the file for reading and writing. The file must exist.
+		@param direct Set to true to try to enable direct I/O. If direct I/O is not available, buffered I/O is used. See isDirect().
+		*/
+		PositionalFile(const std::string& filename, bool writable, bool direct = false);
+
+		~PositionalFile();
+
+		PositionalFile(const PositionalFile&) = delete;
+		PositionalFile& operator=(const PositionalFile&) = delete;
+
+		/**
+		Returns true if direct I/O is in use. In that case the file positions, buffers and sizes of all reads
+		must be aligned to DIRECT_ALIGNMENT bytes.
+		*/
+		bool isDirect() const
+		{
+			return direct;
+		}
+
+		/**
+		Reads at most size bytes starting from the given file position.
+		Returns count of bytes read. The count is less than size only if the end of the file is reached.
+		*/
+		size_t readSome(size_t filePosition, void* buffer, size_t size) const;
+
+		/**
+		Reads exactly size bytes starting from the given file position.
+		Throws exception if the end of the file is reached.
+		*/
+		void read(size_t filePosition, void* buffer, size_t size) const;
+
+		/**
+		Writes size bytes starting from the given file position.
+		*/
+		void write(size_t filePosition, const void* buffer, size_t size) const;
+	};
+
+	/**
+	Reads the given ranges of a file to a memory buffer in parallel.
+	Nearby ranges are read using one call, and long ranges are divided into multiple calls.
+	The ranges should be sorted by file position and they must not overlap in the buffer.
+	@param filename Name of the file.
+	@param ranges Ranges to read.
+	@param buffer The buffer where the data is placed.
+	@param showProgressInfo Set to true to show a progress bar.
+	@param settings Settings for the reads.
+	*/
+	void readRanges(const std::string& filename, const std::vector<FileRange>& ranges, void* buffer, bool showProgressInfo = false, const BlockIOSettings& settings = blockIOSettings());
+
+	/**
+	Writes data from a memory buffer to the given ranges of a file in parallel.
+	Long ranges are divided into multiple calls. Bytes outside of the ranges are never written.
+	The file must exist and the ranges must not overlap in the file.
+	@param filename Name of the file.
+	@param ranges Ranges to write.
+	@param buffer The buffer containing the data.
+	@param showProgressInfo Set to true to show a progress bar.
+	@param settings Settings for the writes.
+	*/
+	void writeRanges(const std::string& filename, const std::vector<FileRange>& ranges, const void* buffer, bool showProgressInfo = false, const BlockIOSettings& settings = blockIOSettings());
+
+	namespace tests
+	{
+		void blockIO();
+	}
+}
@@ -2,6 +2,7 @@
 
 #include "tiffio.h"
 
+#include "math/vec2.h"
 #include "math/vec3.h"
 #include "io/imagedatatype.h"
 #include "image.h"
@@ -11,6 +12,10 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstring>
+#include <exception>
+#include <omp.h>
 
 namespace itl2
 {
@@ -18,7 +23,59 @@ namespace itl2
 	{
 		namespace internals
 		{
-			bool getInfo(TIFF* tif, Vec3c& dimensions, ImageDataType& dataType, size_t& pixelSizeBytes, uint64_t& rawDataOffset, std::string& reason);
+			/**
+			Layout of the pixel data in a single directory of a .tif file.
+			A unit is either a strip or a row of tiles, so that unit i covers image rows [i * unitHeight, (i + 1) * unitHeight).
+			*/
+			struct PageLayout
+			{
+				bool isTiled = false;
+				coord_t tileWidth = 0;
+				coord_t unitHeight = 0;
+			};
+
+			/**
+			Information about a .tif file, including location of each image file directory (page) in the file.
+			*/
+			struct TiffInfo
+			{
+				Vec3c dimensions;
+				ImageDataType dataType = ImageDataType::Unknown;
+				size_t pixelSizeBytes = 0;
+
+				/**
+				Offset of pixel data of ImageJ fake tiff files, or zero for normal .tif files.
+				*/
+				uint64_t rawDataOffset = 0;
+
+				/**
+				File offset of each directory in the file, one per slice.
+				Using these with TIFFSetSubDirectory avoids walking the directory chain from the start of the file.
+				*/
+				std::vector<uint64_t> directoryOffsets;
+
+				/**
+				Layout of the first directory. Used to estimate the amount of work in reading.
+				*/
+				PageLayout firstPageLayout;
+			};
+
+			/**
+			Reads information about the .tif file and builds index of its directories.
+			Leaves the first directory current.
+			*/
+			bool getInfo(TIFF* tif, TiffInfo& info, std::string& reason);
+
+			/**
+			Gets information about the given .tif file.
+			The information is cached and the cache entry is reused as long as the size and modification time of the file do not change.
+			*/
+			bool getInfo(const std::string& filename, TiffInfo& info, std::string& reason);
+
+			/**
+			Removes cached information about the given file.
+			*/
+			void forgetInfo(const std::string& filename);
 
 			/**
 			Initialize .tiff reading library.
@@ -31,94 +88,191 @@ namespace itl2
 			*/
 			std::string tiffLastError();
 
-			template<typename pixel_t> void readDirectories(Image<pixel_t>& img, TIFF* tif, size_t z, const Vec3c& dimensions, const std::string& filename, uint64_t rawDataOffset)
-			{
-				if (z >= (size_t)img.depth())
-					throw ITLException("Invalid target z coordinate.");
+			/**
+			Makes directory at the given file offset current and determines its layout.
+			*/
+			PageLayout selectPage(TIFF* tif, uint64_t directoryOffset, const std::string& filename);
 
+			/**
+			Decodes one strip or row of tiles of the current directory of the .tif file and copies the part
+			that intersects region [start, start + size) to img, so that the start of the region is placed at (0, 0, imgZ).
+			Only tiles that intersect the region are decoded.
+			@param buffer Temporary buffer, reused between calls.
+			*/
+			template<typename pixel_t> void readUnit(TIFF* tif, const PageLayout& layout, coord_t unit, const Vec3c& dimensions, Image<pixel_t>& img, coord_t imgZ, const Vec3c& start, const Vec3c& size, std::vector<uint8_t>& buffer)
+			{
+				coord_t uy0 = unit * layout.unitHeight;
+				coord_t uy1 = std::min(uy0 + layout.unitHeight, dimensions.y);
+				coord_t y0 = std::max(uy0, start.y);
+				coord_t y1 = std::min(uy1, start.y + size.y);
 
-				if (rawDataOffset != 0)
+				if (!layout.isTiled)
 				{
-					// This is an ImageJ fake tiff. Read it as raw data file.
-					::itl2::raw::readBlockNoParse(img, filename, dimensions, Vec3c(0, 0, 0), false, (size_t)rawDataOffset);
-					return;
-				}
+					if (start.x == 0 && size.x == dimensions.x && img.width() == dimensions.x && y0 == uy0 && y1 == uy1)
+					{
+						// The strip is completely inside the region, decode it directly to the image.
+						if (TIFFReadEncodedStrip(tif, (tstrip_t)unit, &img(0, uy0 - start.y, imgZ), (tmsize_t)((uy1 - uy0) * dimensions.x * sizeof(pixel_t))) < 0)
+							throw ITLException(string("TIFF read error: ") + internals::tiffLastError());
+						return;
+					}
+
+					buffer.resize(TIFFStripSize(tif));
+					if (TIFFReadEncodedStrip(tif, (tstrip_t)unit, buffer.data(), (tmsize_t)buffer.size()) < 0)
+						throw ITLException(string("TIFF read error: ") + internals::tiffLastError());
 
-				// Read all directories
-				do
+					const pixel_t* pStrip = (const pixel_t*)buffer.data();
+					for (coord_t y = y0; y < y1; y++)
+						memcpy(&img(0, y - start.y, imgZ), &pStrip[(y - uy0) * dimensions.x + start.x], size.x * sizeof(pixel_t));
+				}
+				else
 				{
-					if (z >= (size_t)img.depth())
-						throw ITLException("TIFF file contains more frames than expected. This is a bug in the software. Please report it to the authors.");
+					buffer.resize(TIFFTileSize(tif));
+					const pixel_t* pTile = (const pixel_t*)buffer.data();
 
-					bool isTiled = TIFFIsTiled(tif) != 0;
-					if (isTiled)
+					for (coord_t tx0 = (start.x / layout.tileWidth) * layout.tileWidth; tx0 < start.x + size.x; tx0 += layout.tileWidth)
 					{
-						// Read tiles
-						// TODO: This is not very well tested.
+						ttile_t tile = TIFFComputeTile(tif, (uint32_t)tx0, (uint32_t)uy0, 0, 0);
+						if (TIFFReadEncodedTile(tif, tile, buffer.data(), (tmsize_t)buffer.size()) < 0)
+							throw ITLException(string("TIFF read error: ") + internals::tiffLastError());
+
+						coord_t x0 = std::max(tx0, start.x);
+						coord_t x1 = std::min(tx0 + layout.tileWidth, start.x + size.x);
+						for (coord_t y = y0; y < y1; y++)
+							memcpy(&img(x0 - start.x, y - start.y, imgZ), &pTile[(y - uy0) * layout.tileWidth + (x0 - tx0)], (x1 - x0) * sizeof(pixel_t));
+					}
+				}
+			}
 
-						uint32_t tileWidth = 0;
-						uint32_t tileHeight = 0;
-						uint32_t tileDepth = 0;
+			/**
+			Reads region [start, start + size) of a normal (not ImageJ fake) .tif file to img, such that the start of the region is placed at (0, 0, imgZ).
+			Each thread opens its own handle to the file.
+			If there are enough slices to read, the slices are divided among the threads, otherwise strips or rows of tiles of each slice are.
+			*/
+			template<typename pixel_t> void readRegion(Image<pixel_t>& img, coord_t imgZ, const std::string& filename, const TiffInfo& info, const Vec3c& start, const Vec3c& size)
+			{
+				if (size.x <= 0 || size.y <= 0 || size.z <= 0)
+					return;
+
+				if ((coord_t)info.directoryOffsets.size() < start.z + size.z)
+					throw ITLException(string("Unable to read expected number of slices from .tif file ") + filename);
 
-						TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth);
-						TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileHeight);
-						TIFFGetField(tif, TIFFTAG_TILEDEPTH, &tileDepth);
+				bool parallelSlices = size.z >= omp_get_max_threads();
 
-						if (tileDepth < 1)
-							tileDepth = 1;
+				// Each thread opens the file, so do not use more threads than there are slices or units to read.
+				coord_t workCount = size.z;
+				if (!parallelSlices && info.firstPageLayout.unitHeight > 0)
+					workCount = (start.y + size.y - 1) / info.firstPageLayout.unitHeight - start.y / info.firstPageLayout.unitHeight + 1;
+				int threadCount = (int)std::max<coord_t>(1, std::min<coord_t>(workCount, omp_get_max_threads()));
 
-						tmsize_t tiffTileSize = TIFFTileSize(tif);
-						auto buf = std::unique_ptr<pixel_t, decltype(_TIFFfree)*>( (pixel_t*)_TIFFmalloc(tiffTileSize), _TIFFfree );
+				// Exceptions must not propagate out of the parallel region, so the first one is stored and re-thrown afterwards.
+				std::exception_ptr error;
+				bool failed = false;
+				auto storeError = [&](std::exception_ptr e)
+				{
+					#pragma omp critical(tiff_read_region)
+					{
+						if (!error)
+							error = e;
+						failed = true;
+					}
+				};
 
-						for (coord_t z0 = z; z0 < dimensions.z; z0 += tileDepth)
+				coord_t firstUnit = 0;
+				coord_t endUnit = 0;
+
+				#pragma omp parallel num_threads(threadCount)
+				{
+					auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), "r"), TIFFClose);
+					TIFF* tif = tifObj.get();
+					if (!tif)
+						storeError(std::make_exception_ptr(ITLException(string("Error while reading .tif image: ") + internals::tiffLastError())));
+
+					std::vector<uint8_t> buffer;
+
+					if (parallelSlices)
+					{
+						#pragma omp for schedule(dynamic)
+						for (coord_t z = 0; z < size.z; z++)
 						{
-							for (coord_t y0 = 0; y0 < dimensions.y; y0 += tileHeight)
+							if (tif && !failed)
 							{
-								for (coord_t x0 = 0; x0 < dimensions.x; x0 += tileWidth)
+								try
 								{
-									TIFFReadTile(tif, buf.get(), (uint32_t)x0, (uint32_t)y0, (uint32_t)z0, 0);
-
-									// Plot tile to image
-									size_t n = 0;
-									for (coord_t zz = z0; zz < std::min(z0 + tileDepth, img.depth()); zz++)
-									{
-										for (coord_t yy = y0; yy < std::min(y0 + tileHeight, img.height()); yy++)
-										{
-											for (coord_t xx = x0; xx < std::min(x0 + tileWidth, img.width()); xx++)
-											{
-												img(xx, yy, zz) = buf.get()[n];
-												n++;
-											}
-										}
-									}
+									PageLayout layout = selectPage(tif, info.directoryOffsets[start.z + z], filename);
+									coord_t lastUnit = (start.y + size.y - 1) / layout.unitHeight;
+									for (coord_t unit = start.y / layout.unitHeight; unit <= lastUnit; unit++)
+										readUnit(tif, layout, unit, info.dimensions, img, imgZ + z, start, size, buffer);
+								}
+								catch (...)
+								{
+									storeError(std::current_exception());
 								}
 							}
 						}
-
 					}
 					else
 					{
-						// Read strips
-
-						tmsize_t stripSize = TIFFStripSize(tif);
-						tstrip_t stripCount = TIFFNumberOfStrips(tif);
-
-						uint32_t rowsPerStrip = 0;
-						TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
-
-						size_t imgPos = img.getLinearIndex(0, 0, z);
-						for (tstrip_t strip = 0; strip < stripCount; strip++)
+						for (coord_t z = 0; z < size.z; z++)
 						{
-							if (TIFFReadEncodedStrip(tif, strip, &(img.getData()[imgPos]), (tsize_t)-1) < 0)
-								throw ITLException(string("TIFF read error: ") + internals::tiffLastError());
+							PageLayout layout;
+							if (tif && !failed)
+							{
+								try
+								{
+									layout = selectPage(tif, info.directoryOffsets[start.z + z], filename);
+								}
+								catch (...)
+								{
+									storeError(std::current_exception());
+								}
+							}
+
+							// All threads must see the same bounds for the worksharing loop below.
+							#pragma omp single
+							{
+								firstUnit = layout.unitHeight > 0 ? start.y / layout.unitHeight : 0;
+								endUnit = layout.unitHeight > 0 ? (start.y + size.y - 1) / layout.unitHeight + 1 : 0;
+							}
 
-							imgPos += rowsPerStrip * img.width();
+							#pragma omp for schedule(dynamic)
+							for (coord_t unit = firstUnit; unit < endUnit; unit++)
+							{
+								if (tif && !failed)
+								{
+									try
+									{
+										readUnit(tif, layout, unit, info.dimensions, img, imgZ + z, start, size, buffer);
+									}
+									catch (...)
+									{
+										storeError(std::current_exception());
+									}
+								}
+							}
 						}
 					}
+				}
+
+				if (error)
+					std::rethrow_exception(error);
+			}
 
-					z++;
-				} while (TIFFReadDirectory(tif) == 1);
+			template<typename pixel_t> void readDirectories(Image<pixel_t>& img, size_t z, const std::string& filename, const TiffInfo& info)
+			{
+				if (z >= (size_t)img.depth())
+					throw ITLException("Invalid target z coordinate.");
 
+				if (info.rawDataOffset != 0)
+				{
+					// This is an ImageJ fake tiff. Read it as raw data file.
+					::itl2::raw::readBlockNoParse(img, filename, info.dimensions, Vec3c(0, 0, 0), false, (size_t)info.rawDataOffset);
+					return;
+				}
+
+				if (z + info.dimensions.z > (size_t)img.depth())
+					throw ITLException("TIFF file contains more frames than expected. This is a bug in the software. Please report it to the authors.");
+
+				readRegion(img, (coord_t)z, filename, info, Vec3c(0, 0, 0), info.dimensions);
 			}
 
 			/*
@@ -129,84 +283,69 @@ namespace itl2
 			{		
 				internals::initTIFF();
 
-				auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), "r"), TIFFClose);
-				TIFF* tif = tifObj.get();
-
-				if (tif)
-				{	
-					Vec3c dimensions;
-					ImageDataType dataType;
-					size_t pixelSizeBytes;
-					string reason;
-					uint64_t rawDataOffset;
-					if (internals::getInfo(tif, dimensions, dataType, pixelSizeBytes, rawDataOffset, reason))
+				TiffInfo info;
+				string reason;
+				if (!internals::getInfo(filename, info, reason))
+					throw ITLException(reason);
+
+				Vec3c dimensions = info.dimensions;
+
+				if (info.dataType != imageDataType<pixel_t>() && info.pixelSizeBytes != sizeof(pixel_t))
+					throw ITLException(string("Pixel data type in .tiff file is ") + toString(info.dataType) + " (" + toString(info.pixelSizeBytes) + " bytes per pixel), but image data type is " + toString(imageDataType<pixel_t>()) + " (" + toString(sizeof(pixel_t)) + " bytes per pixel).");
+
+				if (is2D)
+				{
+					if (dimensions.z > 1)
+						throw ITLException(string("Trying to read a 3D tiff as a 2D tiff: ") + filename);
+					dimensions.z = 1;
+					
+					if(allowResize)
+						img.ensureSize(dimensions.x, dimensions.y, img.depth());
+
+					if(img.dimensions() == Vec3c(dimensions.x, dimensions.y, img.depth()))
+					{
+						internals::readDirectories(img, z, filename, info);
+					}
+					else
 					{
-						if (dataType != imageDataType<pixel_t>() && pixelSizeBytes != sizeof(pixel_t))
-							throw ITLException(string("Pixel data type in .tiff file is ") + toString(dataType) + " (" + toString(pixelSizeBytes) + " bytes per pixel), but image data type is " + toString(imageDataType<pixel_t>()) + " (" + toString(sizeof(pixel_t)) + " bytes per pixel).");
+						//if(img.dimensions() != Vec3c(dimensions.x, dimensions.y, img.depth()))
+						//    throw ITLException(string("Dimensions of the data in the 2D .tif file ") + filename + string(" do not match to the dimensions of the image."));
 
-						if (is2D)
-						{
-							if (dimensions.z > 1)
-								throw ITLException(string("Trying to read a 3D tiff as a 2D tiff: ") + filename);
-							dimensions.z = 1;
-							
-							if(allowResize)
-								img.ensureSize(dimensions.x, dimensions.y, img.depth());
-
-							if(img.dimensions() == Vec3c(dimensions.x, dimensions.y, img.depth()))
-							{
-								internals::readDirectories(img, tif, z, dimensions, filename, rawDataOffset);
-							}
-							else
-							{
-								//if(img.dimensions() != Vec3c(dimensions.x, dimensions.y, img.depth()))
-								//    throw ITLException(string("Dimensions of the data in the 2D .tif file ") + filename + string(" do not match to the dimensions of the image."));
-
-								Image<pixel_t> tempImage(dimensions.x, dimensions.y, 1);
-								internals::readDirectories(tempImage, tif, 0, dimensions, filename, rawDataOffset);
-								
-								// Calculate shift such that the on-disk image becomes centered in the space available.
-								Vec3c target = (img.dimensions() - Vec3c(dimensions.x, dimensions.y, img.depth())) / 2;
-								target.z = z;
-								
-								// Copy pixel values to final image.
-								copyValues(img, tempImage, target);
-							}
-						}
-						else
-						{
-							if(allowResize)
-								img.ensureSize(dimensions);
-								
-							if(img.dimensions() == Vec3c(dimensions.x, dimensions.y, img.depth()))
-							{
-								internals::readDirectories(img, tif, 0, dimensions, filename, rawDataOffset);
-							}
-							else
-							{
-								//if(img.dimensions() != Vec3c(dimensions.x, dimensions.y, img.depth()))
-								//    throw ITLException(string("Dimensions of the data in the .tif file ") + filename + string(" do not match to the dimensions of the image."));
-
-								Image<pixel_t> tempImage(dimensions);
-								internals::readDirectories(tempImage, tif, 0, dimensions, filename, rawDataOffset);
-								
-								// Calculate shift such that the on-disk image becomes centered in the space available.
-								Vec3c target = (img.dimensions() - dimensions) / 2;
-								
-								// Copy pixel values to final image.
-								copyValues(img, tempImage, target);
-							}
-						}
+						Image<pixel_t> tempImage(dimensions.x, dimensions.y, 1);
+						internals::readDirectories(tempImage, 0, filename, info);
 						
-						return;
+						// Calculate shift such that the on-disk image becomes centered in the space available.
+						Vec3c target = (img.dimensions() - Vec3c(dimensions.x, dimensions.y, img.depth())) / 2;
+						target.z = z;
+						
+						// Copy pixel values to final image.
+						copyValues(img, tempImage, target);
+					}
+				}
+				else
+				{
+					if(allowResize)
+						img.ensureSize(dimensions);
+						
+					if(img.dimensions() == Vec3c(dimensions.x, dimensions.y, img.depth()))
+					{
+						internals::readDirectories(img, 0, filename, info);
 					}
 					else
 					{
-						throw ITLException(reason);
+						//if(img.dimensions() != Vec3c(dimensions.x, dimensions.y, img.depth()))
+						//    throw ITLException(string("Dimensions of the data in the .tif file ") + filename + string(" do not match to the dimensions of the image."));
+
+						Image<pixel_t> tempImage(dimensions);
+						internals::readDirectories(tempImage, 0, filename, info);
+						
+						// Calculate shift such that the on-disk image becomes centered in the space available.
+						Vec3c target = (img.dimensions() - dimensions) / 2;
+						
+						// Copy pixel values to final image.
+						copyValues(img, tempImage, target);
 					}
 				}
-
-				throw ITLException(string("Error while reading .tif image: ") + internals::tiffLastError());
 			}
 		}
 
@@ -235,6 +374,7 @@ namespace itl2
 
 		/**
 		Reads part of a .tif file to given image.
+		Only the strips or tiles that intersect the block are decoded.
 		NOTE: Does not support out of bounds start position.
 		@param img Image where the data is placed. The size of the image defines the size of the block that is read.
 		@param filename The name of the file to read.
@@ -244,121 +384,57 @@ namespace itl2
 		{
 			internals::initTIFF();
 
-			if (img.width() >= std::numeric_limits<uint32_t>::max() ||
-				img.height() >= std::numeric_limits<uint32_t>::max() ||
-				img.depth() >= std::numeric_limits<uint16_t>::max())
-				throw ITLException("The image is too large to be read as a block of .tif file.");
-
+			internals::TiffInfo info;
+			string reason;
+			if (!internals::getInfo(filename, info, reason))
+				throw ITLException(reason);
 
-			if ((start.x + img.width()) >= std::numeric_limits<uint32_t>::max() ||
-				(start.y + img.height()) >= std::numeric_limits<uint32_t>::max() ||
-				(start.z + img.depth()) >= std::numeric_limits<uint16_t>::max())
-				throw ITLException("The block to be read is too far from origin to be located from a .tif file.");
+			if (info.dataType != imageDataType<pixel_t>() && info.pixelSizeBytes != sizeof(pixel_t))
+				throw ITLException(string("Pixel data type in .tiff file is ") + toString(info.dataType) + " (" + toString(info.pixelSizeBytes) + " bytes per pixel), but image data type is " + toString(imageDataType<pixel_t>()) + " (" + toString(sizeof(pixel_t)) + " bytes per pixel).");
 
-			auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), "r"), TIFFClose);
-			TIFF* tif = tifObj.get();
-
-			if (tif)
+			if (info.rawDataOffset != 0)
 			{
-				Vec3c dimensions;
-				ImageDataType dataType;
-				size_t pixelSizeBytes;
-				string reason;
-				uint64_t rawDataOffset;
-				if (internals::getInfo(tif, dimensions, dataType, pixelSizeBytes, rawDataOffset, reason))
-				{
-					if (dataType != imageDataType<pixel_t>() && pixelSizeBytes != sizeof(pixel_t))
-						throw ITLException(string("Pixel data type in .tiff file is ") + toString(dataType) + " (" + toString(pixelSizeBytes) + " bytes per pixel), but image data type is " + toString(imageDataType<pixel_t>()) + " (" + toString(sizeof(pixel_t)) + " bytes per pixel).");
-
-					if (rawDataOffset != 0)
-					{
-						// This is an ImageJ fake tiff. Read it as a .raw file.
-						raw::readBlockNoParse(img, filename, dimensions, start, showProgressInfo, rawDataOffset);
-						return;
-					}
-
-					// Read all directories
-					coord_t tifz = start.z;
-					do
-					{
-						if(TIFFSetDirectory(tif, (uint16_t)tifz) != 1)
-							throw ITLException(string("Unable to read expected number of slices from .tif file ") + filename);
-
-						coord_t z = tifz - start.z;
-
-						if (z >= img.depth())
-							break; // All read!
-
-						bool isTiled = TIFFIsTiled(tif) != 0;
-						if (isTiled)
-						{
-							// Read tiles
-							
-							throw ITLException("Block-by-block reading of tiled .tif files is not implemented due to lack of tiled example .tif files. Please send your tiled .tif file to the developers of the software to get this feature implemented. Please use the info() command or the website to find the latest contact details.");
-						}
-						else
-						{
-							// Read strips
-
-							tmsize_t stripSize = TIFFStripSize(tif);
-							tstrip_t stripCount = TIFFNumberOfStrips(tif);
-							auto buf = std::unique_ptr<pixel_t, decltype(_TIFFfree)*>((pixel_t*)_TIFFmalloc(stripSize), _TIFFfree);
-							uint32_t rowsPerStrip = 0;
-							TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+				// This is an ImageJ fake tiff. Read it as a .raw file.
+				raw::readBlockNoParse(img, filename, info.dimensions, start, showProgressInfo, info.rawDataOffset);
+				return;
+			}
 
-							coord_t y = 0; // y-coordinate in full image coordinates
-							for (tstrip_t strip = 0; strip < stripCount; strip++)
-							{
-								if (TIFFReadEncodedStrip(tif, strip, buf.get(), (tsize_t)-1) < 0)
-									throw ITLException(string("TIFF read error: ") + internals::tiffLastError());
+			if (start.x < 0 || start.y < 0 || start.z < 0 ||
+				start.x >= info.dimensions.x || start.y >= info.dimensions.y || start.z >= info.dimensions.z)
+				throw ITLException("Out of bounds start position in tiff::readBlock.");
 
+			// Parts of the block that are outside of the file are not read.
+			Vec3c end = start + img.dimensions();
+			clamp(end, Vec3c(0, 0, 0), info.dimensions);
 
-								// stripy = y-coordinate in strip coordinates
-								// y in image coordinates = y - start.y
-								for (coord_t stripy = 0; y < start.y + img.height() && stripy < rowsPerStrip; y++, stripy++)
-								{
-									if (y >= start.y)
-									{
-										// Put the data to the image
-										for (coord_t x = start.x; x < start.x + img.width(); x++)
-											img(x - start.x, y - start.y, z) = buf.get()[x + stripy * dimensions.x];
-									}
-								}
-							}
-						}
-
-						tifz++;
-					} while (TIFFReadDirectory(tif) == 1);
-
-					return;
-				}
-				else
-				{
-					throw ITLException(reason);
-				}
-			}
-
-			throw ITLException(string("Error while reading .tif image: ") + internals::tiffLastError());
+			internals::readRegion(img, 0, filename, info, start, end - start);
 		}
 
 
 
 		/**
 		Writes a .tif file.
+		@param tileSize Size of tiles in the output file. Both components must be multiples of 16. Set to zero to write each slice as a single strip.
+		@param bigTiff Set to true to always write a BigTIFF file. BigTIFF format is used automatically if the image is too large for a normal .tif file.
 		*/
-		template<typename pixel_t> void write(const Image<pixel_t>& img, const std::string& filename)
+		template<typename pixel_t> void write(const Image<pixel_t>& img, const std::string& filename, const Vec2c& tileSize = Vec2c(0, 0), bool bigTiff = false)
 		{
 			createFoldersFor(filename);
 
 			internals::initTIFF();
+			internals::forgetInfo(filename);
 
 			if (img.width() >= std::numeric_limits<uint32_t>::max() ||
 				img.height() >= std::numeric_limits<uint32_t>::max() ||
 				img.depth() >= std::numeric_limits<uint16_t>::max())
 				throw ITLException("The image is too large to be written to a .tif file.");
 
+			bool isTiled = tileSize.x != 0 || tileSize.y != 0;
+			if (isTiled && (tileSize.x <= 0 || tileSize.y <= 0 || tileSize.x % 16 != 0 || tileSize.y % 16 != 0))
+				throw ITLException("Tile width and height of .tif file must be positive multiples of 16.");
+
 			string mode = "w"; // Normal tif file
-			if (img.pixelCount() * img.pixelSize() > (size_t)4 * (size_t)1000 * (size_t)1000 * (size_t)1000)
+			if (bigTiff || img.pixelCount() * img.pixelSize() > (size_t)4 * (size_t)1000 * (size_t)1000 * (size_t)1000)
 				mode = "w8"; // BigTIFF file
 			auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), mode.c_str()), TIFFClose);
 			TIFF* tif = tifObj.get();
@@ -432,7 +508,15 @@ namespace itl2
 					TIFFSetField(tif, TIFFTAG_DATATYPE, tiffDataType);
 					TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, sampleFormat);
 
-					TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, h);
+					if (isTiled)
+					{
+						TIFFSetField(tif, TIFFTAG_TILEWIDTH, (uint32_t)tileSize.x);
+						TIFFSetField(tif, TIFFTAG_TILELENGTH, (uint32_t)tileSize.y);
+					}
+					else
+					{
+						TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, h);
+					}
 					TIFFSetField(tif, TIFFTAG_PLANARCONFIG, 1);
 
 					TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
@@ -441,10 +525,35 @@ namespace itl2
 					TIFFSetField(tif, TIFFTAG_SOFTWARE, softName.c_str());
 
 					// Write image data
-					void* ptr = (void*)&img(0, 0, z);
-					if (TIFFWriteEncodedStrip(tif, 0, ptr, img.width() * img.height() * sizeof(pixel_t)) < 0)
+					if (isTiled)
 					{
-						throw ITLException(string("Unable to write data to .tif file ") + filename + ": " + internals::tiffLastError());
+						// Tiles that extend over the image edge are padded with zeroes.
+						std::vector<pixel_t> tile(tileSize.x * tileSize.y);
+						for (coord_t y0 = 0; y0 < img.height(); y0 += tileSize.y)
+						{
+							for (coord_t x0 = 0; x0 < img.width(); x0 += tileSize.x)
+							{
+								coord_t tw = std::min(tileSize.x, img.width() - x0);
+								coord_t th = std::min(tileSize.y, img.height() - y0);
+								if (tw < tileSize.x || th < tileSize.y)
+									std::fill(tile.begin(), tile.end(), pixel_t());
+
+								for (coord_t y = 0; y < th; y++)
+									memcpy(&tile[y * tileSize.x], &img(x0, y0 + y, z), tw * sizeof(pixel_t));
+
+								ttile_t tileIndex = TIFFComputeTile(tif, (uint32_t)x0, (uint32_t)y0, 0, 0);
+								if (TIFFWriteEncodedTile(tif, tileIndex, tile.data(), (tmsize_t)(tile.size() * sizeof(pixel_t))) < 0)
+									throw ITLException(string("Unable to write data to .tif file ") + filename + ": " + internals::tiffLastError());
+							}
+						}
+					}
+					else
+					{
+						void* ptr = (void*)&img(0, 0, z);
+						if (TIFFWriteEncodedStrip(tif, 0, ptr, img.width() * img.height() * sizeof(pixel_t)) < 0)
+						{
+							throw ITLException(string("Unable to write data to .tif file ") + filename + ": " + internals::tiffLastError());
+						}
 					}
 
 
@@ -475,12 +584,12 @@ namespace itl2
 		/*
 		Write a .tif file, adds .tif to the file name if it does not end with .tif or .tiff.
 		*/
-		template<typename pixel_t> void writed(const Image<pixel_t>& img, const std::string& filename)
+		template<typename pixel_t> void writed(const Image<pixel_t>& img, const std::string& filename, const Vec2c& tileSize = Vec2c(0, 0), bool bigTiff = false)
 		{
 			if (endsWithIgnoreCase(filename, ".tif") || endsWithIgnoreCase(filename, ".tiff"))
-				write(img, filename);
+				write(img, filename, tileSize, bigTiff);
 			else
-				write(img, filename + ".tif");
+				write(img, filename + ".tif", tileSize, bigTiff);
 		}
 
 
@@ -488,6 +597,7 @@ namespace itl2
 		{
 			void readWrite();
 			void imageJLargeTiff();
+			void tiledBlocks();
 		}
 	}
 }
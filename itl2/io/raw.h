@@ -9,6 +9,7 @@
 #include "timer.h"
 #include "math/mathutils.h"
 #include "io/imagedatatype.h"
+#include "io/blockio.h"
 #include "math/vec3.h"
 #include "progress.h"
 
@@ -296,39 +297,24 @@ namespace itl2
 		*/
 		template<typename pixel_t, typename ReadPixel = decltype(raw::readPixel<pixel_t>)> void readNoParse(Image<pixel_t>& img, const std::string& filename, size_t bytesToSkip = 0, ReadPixel readPixel = raw::readPixel<pixel_t>)
 		{
-			std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-
-			if(!in)
-            {
-                throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
-            }
-
-			in.seekg(bytesToSkip, std::ios::beg);
-
 			if constexpr (std::is_trivially_copyable_v<pixel_t>)
 			{
-				// Load directly to the buffer
-				size_t READ_SIZE = 200 * 1024 * 1024;
-				size_t read_start = 0;
-				char* pBuffer = (char*)img.getData();
-				while (read_start < img.pixelCount() * sizeof(pixel_t))
-				{
-					size_t read_size = READ_SIZE;
-					if (read_start + read_size > img.pixelCount() * sizeof(pixel_t))
-						read_size = img.pixelCount() * sizeof(pixel_t) - read_start;
-
-					in.read(pBuffer + read_start, read_size);
-
-					if (in.bad())
-					{
-						throw ITLException(std::string("Read failed, file size might be incorrect: ") + filename);
-					}
-
-					read_start += read_size;
-				}
+				// Load directly to the buffer, using multiple parallel reads.
+				std::vector<FileRange> ranges;
+				addRange(ranges, bytesToSkip, 0, img.pixelCount() * sizeof(pixel_t));
+				readRanges(filename, ranges, img.getData());
 			}
 			else
 			{
+				std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+
+				if (!in)
+				{
+					throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
+				}
+
+				in.seekg(bytesToSkip, std::ios::beg);
+
 				for (coord_t n = 0; n < img.pixelCount(); n++)
 				{
 					readPixel(in, img(n));
@@ -362,63 +348,21 @@ namespace itl2
 			}
 
 
-			std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-
-			if (!in)
-			{
-				throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
-			}
-
-			in.seekg(bytesToSkip, std::ios::beg);
-
-			pixel_t* pBuffer = img.getData();
-
-			if (cStart.x == 0 && cEnd.x == fileDimensions.x)
-			{
-				// Reading whole scan lines.
-				// We can read one slice per one read call.
-				for (coord_t z = cStart.z; z < cEnd.z; z++)
-				{
-					size_t filePos = (z * fileDimensions.x * fileDimensions.y + cStart.y * fileDimensions.x + cStart.x) * sizeof(pixel_t);
-					in.seekg(filePos);
-
-					size_t imgPos = img.getLinearIndex(0, 0, z - cStart.z);
-					in.read((char*)&pBuffer[imgPos], (cEnd.x - cStart.x) * (cEnd.y - cStart.y) * sizeof(pixel_t));
-
-					if (in.bad())
-					{
-						showProgress(cEnd.z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
-						throw ITLException(std::string("Failed to read (slice at a time) block of ") + filename + std::string(", ") + getStreamErrorMessage());
-					}
-
-					showProgress(z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
-				}
-			}
-			else
+			// Collect scanline ranges; ranges that are contiguous both in the file and in the image are merged.
+			// If whole scanlines are read, this results in one range per slice.
+			std::vector<FileRange> ranges;
+			size_t lineSize = (cEnd.x - cStart.x) * sizeof(pixel_t);
+			for (coord_t z = cStart.z; z < cEnd.z; z++)
 			{
-				// Reading partial scan lines.
-				for (coord_t z = cStart.z; z < cEnd.z; z++)
+				for (coord_t y = cStart.y; y < cEnd.y; y++)
 				{
-					for (coord_t y = cStart.y; y < cEnd.y; y++)
-					{
-						size_t filePos = (z * fileDimensions.x * fileDimensions.y + y * fileDimensions.x + cStart.x) * sizeof(pixel_t);
-						in.seekg(filePos);
-
-						size_t imgPos = img.getLinearIndex(0, y - cStart.y, z - cStart.z);
-						in.read((char*)&pBuffer[imgPos], (cEnd.x - cStart.x) * sizeof(pixel_t));
-
-						if (in.bad())
-						{
-							showProgress(cEnd.z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
-							throw ITLException(std::string("Failed to read block of ") + filename + std::string(", ") + getStreamErrorMessage());
-						}
-					}
-
-					
-					showProgress(z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
+					size_t filePos = bytesToSkip + (z * fileDimensions.x * fileDimensions.y + y * fileDimensions.x + cStart.x) * sizeof(pixel_t);
+					size_t imgPos = img.getLinearIndex(0, y - cStart.y, z - cStart.z) * sizeof(pixel_t);
+					addRange(ranges, filePos, imgPos, lineSize);
 				}
 			}
 
+			readRanges(filename, ranges, img.getData(), showProgressInfo);
 		}
 
 		template<typename pixel_t> void getInfoAndCheck(const std::string& filename, Vec3c& dimensions)
@@ -522,58 +466,21 @@ namespace itl2
 			// Create file if it does not exist, otherwise set file size to the correct value.
 			setFileSize(filename, fileDimensions.x * fileDimensions.y * fileDimensions.z * sizeof(pixel_t));
 
-			std::ofstream out(filename.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
-
-			if(!out)
-				throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
-
-			const pixel_t* pBuffer = img.getData();
+			// Collect scanline ranges; ranges that are contiguous both in the file and in the image are merged.
+			// Only the pixels in the block are written so that other processes may write to other blocks of the same file concurrently.
+			std::vector<FileRange> ranges;
+			size_t lineSize = (fileEndPos.x - fileStartPos.x) * sizeof(pixel_t);
+			for (coord_t z = fileStartPos.z; z < fileEndPos.z; z++)
 			{
-				ProgressIndicator prog(fileEndPos.z - fileStartPos.z, showProgressInfo);
-
-				for (coord_t z = fileStartPos.z; z < fileEndPos.z; z++)
+				for (coord_t y = fileStartPos.y; y < fileEndPos.y; y++)
 				{
-					if (fileStartPos.x == 0 && fileEndPos.x == fileDimensions.x &&
-						fileDimensions.x == blockDimensions.x &&
-						img.width() == fileDimensions.x)
-					{
-						// Writing whole scanlines.
-						// Write all scanlines in region [fileStartPos.y, fileEndPos.y[ at once in order to increase write speed.
-						size_t filePos = (z * fileDimensions.x * fileDimensions.y + fileStartPos.y * fileDimensions.x + fileStartPos.x) * sizeof(pixel_t);
-						out.seekp(filePos);
-
-						if (!out)
-							throw ITLException(std::string("Seek failed (fast write) for file ") + filename + std::string(", ") + getStreamErrorMessage());
-
-						size_t imgPos = img.getLinearIndex(imagePosition.x, imagePosition.y, z - fileStartPos.z + imagePosition.z);
-						out.write((char*)&pBuffer[imgPos], (fileEndPos.x - fileStartPos.x) * (fileEndPos.y - fileStartPos.y) * sizeof(pixel_t));
-
-						if (!out)
-							throw ITLException(std::string("Unable to write (fast) to ") + filename + std::string(", ") + getStreamErrorMessage());
-					}
-					else
-					{
-						// Writing partial scanlines.
-
-						for (coord_t y = fileStartPos.y; y < fileEndPos.y; y++)
-						{
-							size_t filePos = (z * fileDimensions.x * fileDimensions.y + y * fileDimensions.x + fileStartPos.x) * sizeof(pixel_t);
-							out.seekp(filePos);
-
-							if (!out)
-								throw ITLException(std::string("Seek failed for file ") + filename + std::string(", ") + getStreamErrorMessage());
-
-							size_t imgPos = img.getLinearIndex(imagePosition.x, y - fileStartPos.y + imagePosition.y, z - fileStartPos.z + imagePosition.z);
-							out.write((char*)&pBuffer[imgPos], (fileEndPos.x - fileStartPos.x) * sizeof(pixel_t));
-
-							if (!out)
-								throw ITLException(std::string("Unable to write to ") + filename + std::string(", ") + getStreamErrorMessage());
-						}
-					}
-
-					prog.step();
+					size_t filePos = (z * fileDimensions.x * fileDimensions.y + y * fileDimensions.x + fileStartPos.x) * sizeof(pixel_t);
+					size_t imgPos = img.getLinearIndex(imagePosition.x, y - fileStartPos.y + imagePosition.y, z - fileStartPos.z + imagePosition.z) * sizeof(pixel_t);
+					addRange(ranges, filePos, imgPos, lineSize);
 				}
 			}
+
+			writeRanges(filename, ranges, img.getData(), showProgressInfo);
 		}
 
 		/**
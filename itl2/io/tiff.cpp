@@ -3,6 +3,9 @@
 #include "io/raw.h"
 #include "projections.h"
 #include "transform.h"
+#include "filesystem.h"
+
+#include <map>
 
 namespace itl2
 {
@@ -202,16 +205,69 @@ namespace itl2
 				return reason.length() <= 0;
 			}
 
-			bool getInfo(TIFF* tif, Vec3c& dimensions, ImageDataType& dataType, size_t& pixelSizeBytes, uint64_t& rawDataOffset, string& reason)
+			/**
+			Determines layout of the pixel data in the current directory.
+			@return False if the layout is not supported.
+			*/
+			bool getCurrentLayout(TIFF* tif, PageLayout& layout, string& reason)
+			{
+				uint32_t height = 0;
+				TIFFGetFieldDefaulted(tif, TIFFTAG_IMAGELENGTH, &height);
+
+				layout = PageLayout();
+				layout.isTiled = TIFFIsTiled(tif) != 0;
+				if (layout.isTiled)
+				{
+					uint32_t tileWidth = 0;
+					uint32_t tileHeight = 0;
+					uint32_t tileDepth = 0;
+					TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth);
+					TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileHeight);
+					TIFFGetFieldDefaulted(tif, TIFFTAG_TILEDEPTH, &tileDepth);
+
+					if (tileWidth <= 0 || tileHeight <= 0)
+					{
+						reason = "Invalid tile size in TIFF file.";
+						return false;
+					}
+					if (tileDepth > 1)
+					{
+						reason = "Tiles spanning multiple slices are not supported in TIFF files.";
+						return false;
+					}
+
+					layout.tileWidth = tileWidth;
+					layout.unitHeight = tileHeight;
+				}
+				else
+				{
+					uint32_t rowsPerStrip = 0;
+					TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+					layout.unitHeight = std::max<coord_t>(1, std::min<coord_t>(rowsPerStrip, height));
+				}
+
+				return true;
+			}
+
+			bool getInfo(TIFF* tif, TiffInfo& info, string& reason)
 			{
 				// Read information from all .tif directories and make sure that all of them match.
+				// Store location of each directory so that they can be accessed directly later.
+
+				Vec3c& dimensions = info.dimensions;
+				ImageDataType& dataType = info.dataType;
+				size_t& pixelSizeBytes = info.pixelSizeBytes;
+				info.directoryOffsets.clear();
 
 				coord_t imageJDepth;
 				uint64_t imageJOffset;
 				if (!getCurrentDirectoryInfo(tif, dimensions, dataType, pixelSizeBytes, imageJDepth, imageJOffset, reason))
 					return false;
 
-				coord_t dirCount = 1;
+				info.directoryOffsets.push_back(TIFFCurrentDirOffset(tif));
+
+				if (!getCurrentLayout(tif, info.firstPageLayout, reason))
+					return false;
 
 				if (TIFFLastDirectory(tif) == 0)
 				{
@@ -259,45 +315,135 @@ namespace itl2
 							return false;
 						}
 
-						dirCount++;
+						info.directoryOffsets.push_back(TIFFCurrentDirOffset(tif));
 
 					} while (TIFFLastDirectory(tif) == 0);
 				}
 
-				TIFFSetDirectory(tif, 0);
+				TIFFSetSubDirectory(tif, info.directoryOffsets[0]);
 
+				coord_t dirCount = (coord_t)info.directoryOffsets.size();
 				if (imageJDepth > dirCount)
 				{
 					// This is an ImageJ fake tiff.
 					dimensions.z = imageJDepth;
-					rawDataOffset = imageJOffset;
+					info.rawDataOffset = imageJOffset;
 				}
 				else
 				{
 					// This is a normal tiff where each slice is in separate tiff directory.
 					dimensions.z = dirCount;
-					rawDataOffset = 0;
+					info.rawDataOffset = 0;
 				}
 				return true;
 			}
 
+			/**
+			Cached information about a .tif file.
+			*/
+			struct CachedTiffInfo
+			{
+				TiffInfo info;
+				uintmax_t fileSize;
+				fs::file_time_type writeTime;
+			};
+
+			/**
+			Maximum number of files whose information is cached.
+			The cache is cleared when it grows larger than this, e.g. while reading long image sequences.
+			*/
+			constexpr size_t MAX_CACHED_INFOS = 64;
+
+			std::map<string, CachedTiffInfo> infoCache;
+
+			bool getInfo(const std::string& filename, TiffInfo& info, std::string& reason)
+			{
+				std::error_code code;
+				uintmax_t fileSize = fs::file_size(filename, code);
+				if (code)
+				{
+					reason = "The file does not contain a valid TIFF header.";
+					return false;
+				}
+				fs::file_time_type writeTime = fs::last_write_time(filename, code);
+
+				bool found = false;
+				#pragma omp critical(tiff_info_cache)
+				{
+					auto it = infoCache.find(filename);
+					if (it != infoCache.end())
+					{
+						if (!code && it->second.fileSize == fileSize && it->second.writeTime == writeTime)
+						{
+							info = it->second.info;
+							found = true;
+						}
+						else
+						{
+							infoCache.erase(it);
+						}
+					}
+				}
+
+				if (found)
+					return true;
+
+				auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), "r"), TIFFClose);
+				TIFF* tif = tifObj.get();
+
+				if (!tif)
+				{
+					reason = "The file does not contain a valid TIFF header.";
+					return false;
+				}
+
+				if (!getInfo(tif, info, reason))
+					return false;
+
+				if (!code)
+				{
+					#pragma omp critical(tiff_info_cache)
+					{
+						if (infoCache.size() >= MAX_CACHED_INFOS)
+							infoCache.clear();
+						infoCache[filename] = CachedTiffInfo{ info, fileSize, writeTime };
+					}
+				}
+
+				return true;
+			}
+
+			void forgetInfo(const std::string& filename)
+			{
+				#pragma omp critical(tiff_info_cache)
+				{
+					infoCache.erase(filename);
+				}
+			}
+
+			PageLayout selectPage(TIFF* tif, uint64_t directoryOffset, const std::string& filename)
+			{
+				if (TIFFSetSubDirectory(tif, directoryOffset) != 1)
+					throw ITLException(string("Unable to read expected number of slices from .tif file ") + filename);
+
+				PageLayout layout;
+				string reason;
+				if (!getCurrentLayout(tif, layout, reason))
+					throw ITLException(reason + " File: " + filename);
+
+				return layout;
+			}
 		}
 
 		bool getInfo(const std::string& filename, Vec3c& dimensions, ImageDataType& dataType, string& reason)
 		{
 			internals::initTIFF();
-			auto tifObj = std::unique_ptr<TIFF, decltype(TIFFClose)*>(TIFFOpen(filename.c_str(), "r"), TIFFClose);
-			TIFF* tif = tifObj.get();
 
-			if (tif)
-			{
-				size_t bytesPerPixel = 0;
-				uint64_t dummy;
-				return internals::getInfo(tif, dimensions, dataType, bytesPerPixel, dummy, reason);
-			}
-
-			reason = "The file does not contain a valid TIFF header.";
-			return false;
+			internals::TiffInfo info;
+			bool result = internals::getInfo(filename, info, reason);
+			dimensions = info.dimensions;
+			dataType = info.dataType;
+			return result;
 		}
 
 
@@ -387,6 +533,43 @@ namespace itl2
 				testAssert(equals(headBlock, headBlockGT), ".tif block read and crop");
 			}
 
+			void tiledBlocks()
+			{
+				Image<uint16_t> img(150, 130, 40);
+				for (coord_t n = 0; n < img.pixelCount(); n++)
+					img(n) = (uint16_t)(n % 65521);
+
+				tiff::write(img, "./tiff/blocks_strips.tif");
+				tiff::write(img, "./tiff/blocks_tiled.tif", Vec2c(32, 48));
+				tiff::write(img, "./tiff/blocks_bigtiff.tif", Vec2c(64, 64), true);
+
+				std::vector<string> files = { "./tiff/blocks_strips.tif", "./tiff/blocks_tiled.tif", "./tiff/blocks_bigtiff.tif" };
+				std::vector<Vec3c> starts = { Vec3c(0, 0, 0), Vec3c(17, 33, 5), Vec3c(100, 90, 39), Vec3c(0, 47, 12) };
+				std::vector<Vec3c> sizes = { Vec3c(150, 130, 40), Vec3c(70, 50, 1), Vec3c(50, 40, 1), Vec3c(150, 20, 28) };
+
+				for (const string& file : files)
+				{
+					Vec3c dims;
+					ImageDataType dt;
+					string reason;
+					testAssert(tiff::getInfo(file, dims, dt, reason), string("getInfo ") + file);
+					testAssert(dims == img.dimensions(), string("tif dimensions ") + file);
+					testAssert(dt == ImageDataType::UInt16, string("tif data type ") + file);
+
+					Image<uint16_t> full;
+					tiff::read(full, file);
+					testAssert(equals(full, img), string("saved and loaded tiff do not equal ") + file);
+
+					for (size_t n = 0; n < starts.size(); n++)
+					{
+						Image<uint16_t> block(sizes[n]), blockGT(sizes[n]);
+						tiff::readBlock(block, file, starts[n]);
+						crop(img, blockGT, starts[n]);
+						testAssert(equals(block, blockGT), string(".tif block read and crop ") + file);
+					}
+				}
+			}
+
 			void imageJLargeTiff()
 			{
 				// NOTE: This test requires that the current folder contains file imagej_large.tif that
@@ -15,6 +15,13 @@ namespace itl2
 		namespace internals
 		{
 			std::vector<char> readBytesOfFile(const std::string& filename)
+			{
+				std::vector<char> result;
+				readBytesOfFile(filename, result);
+				return result;
+			}
+
+			void readBytesOfFile(const std::string& filename, std::vector<char>& buffer)
 			{
 				std::ifstream ifs(filename, std::ios_base::binary | std::ios::ate);
 				if (!ifs)
@@ -22,12 +29,10 @@ namespace itl2
 					throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
 				}
 				std::ifstream::pos_type pos = ifs.tellg();
-				std::vector<char> result(pos);
+				buffer.resize(pos);
 
 				ifs.seekg(0, std::ios::beg);
-				ifs.read(&result[0], pos);
-
-				return result;
+				ifs.read(buffer.data(), pos);
 			}
 
 			void writeBytesToFile(std::vector<char>& buffer, const std::string& filename, size_t startInFilePos)
@@ -42,6 +47,42 @@ namespace itl2
 				if (!out)
 					throw ITLException(std::string("Unable to write to ") + filename + std::string(", ") + getStreamErrorMessage());
 			}
+
+			void readBytes(std::istream& in, const std::string& filename, size_t pos, size_t count, std::vector<char>& buffer)
+			{
+				buffer.resize(count);
+				in.seekg(pos);
+				in.read(buffer.data(), count);
+				if (!in)
+					throw ITLException(std::string("Unable to read from ") + filename + std::string(", ") + getStreamErrorMessage());
+			}
+
+			void writeBytes(std::ostream& out, const std::string& filename, size_t pos, const std::vector<char>& buffer)
+			{
+				out.seekp(pos);
+				out.write(buffer.data(), buffer.size());
+				if (!out)
+					throw ITLException(std::string("Unable to write to ") + filename + std::string(", ") + getStreamErrorMessage());
+			}
+
+			void readShardIndex(std::istream& in, const std::string& filename, const ZarrMetadata& metadata, ShardIndex& index, std::vector<char>& buffer)
+			{
+				codecs::Pipeline indexCodecs;
+				metadata.codecs.front().getShardingConfiguration(index.innerChunkShape, index.innerCodecs, indexCodecs, index.indexLocation);
+				codecs::sharding::checkIndexCodecs(indexCodecs);
+
+				index.chunksPerShard = metadata.chunkSize.componentwiseDivide(index.innerChunkShape);
+				size_t indexSize = codecs::sharding::indexSize(index.chunksPerShard);
+
+				in.seekg(0, std::ios::end);
+				index.fileSize = (size_t)in.tellg();
+				if (index.fileSize < indexSize)
+					throw ITLException(filename + " is too small to contain a shard index.");
+
+				index.indexPos = index.indexLocation == codecs::sharding::indexLocation::start ? 0 : index.fileSize - indexSize;
+				readBytes(in, filename, index.indexPos, indexSize, buffer);
+				codecs::sharding::decodeIndex(buffer.data(), index.chunksPerShard, index.offsets, index.nBytes);
+			}
 		}
 
 		size_t startConcurrentWrite(const Vec3c& imageDimensions,
@@ -225,6 +266,23 @@ namespace itl2
 				draw(expected, AABoxsc::fromMinMax(Vec3<int>(startOnes - startBlock), Vec3<int>(blockSize)), (uint16_t)1);
 
 				testAssert(equals(expected, fromDisk), string("zarr test readBlock chunkSize=" + toString(chunkSize)));
+
+				// A corrupted chunk must be reported as an error in the calling thread.
+				string chunkFile = internals::chunkFile(path, 3, startOnes.componentwiseDivide(chunkSize), DEFAULT_SEPARATOR);
+				{
+					ofstream out(chunkFile, ios_base::binary | ios_base::trunc);
+					out << "corrupted";
+				}
+				bool thrown = false;
+				try
+				{
+					zarr::readBlock(fromDisk, path, startBlock);
+				}
+				catch (const ITLException&)
+				{
+					thrown = true;
+				}
+				testAssert(thrown, string("zarr test readBlock with corrupted chunk chunkSize=" + toString(chunkSize)));
 			}
 
 			void readBlock()
@@ -372,6 +430,75 @@ namespace itl2
 
 				testAssert(sizeEmptyChunks < sizeFullChunks, "shardingEmptyInnerChunksTest" + indexLocation);
 			}
+			void shardingPartialAccessTest(std::string indexLocation, bool withBlosc)
+			{
+				string path = "./testoutput/test_sharding_partial_" + indexLocation;
+				if (withBlosc) path += "_withBlosc";
+				path += ".zarr";
+
+				Vec3c imgShape(20, 20, 20);
+				Vec3c shardShape(10, 10, 10);
+				Vec3c chunkShape(5, 5, 5);
+
+				string bloscCodecConfig = R"({"cname": "lz4", "clevel": 1, "shuffle": "shuffle", "typesize": 4, "blocksize": 0})";
+				nlohmann::json innerCodecs = { codecs::ZarrCodec(codecs::Name::Bytes).toJSON() };
+				if (withBlosc) innerCodecs = { codecs::ZarrCodec(codecs::Name::Bytes).toJSON(), codecs::ZarrCodec(codecs::Name::Blosc, nlohmann::json::parse(bloscCodecConfig)).toJSON() };
+				nlohmann::json shardingCodecConfigJSON = {
+					{ "chunk_shape", { chunkShape.x, chunkShape.y, chunkShape.z }},
+					{ "codecs", innerCodecs },
+					{ "index_codecs", { codecs::ZarrCodec(codecs::Name::Bytes).toJSON() }},
+					{ "index_location", indexLocation }
+				};
+				ZarrMetadata metadata = { ImageDataType::UInt16, shardShape, { codecs::ZarrCodec(codecs::Name::Sharding, shardingCodecConfigJSON) }, DEFAULT_FILLVALUE, DEFAULT_SEPARATOR };
+				string desc = " indexLocation=" + indexLocation + " withBlosc=" + toString(withBlosc);
+
+				Image<uint16_t> img(imgShape);
+				ramp(img, 0);
+				add(img, 10);
+				zarr::write(img, path, metadata);
+
+				// Read a block that covers parts of several shards and inner chunks.
+				Vec3c blockStart(3, 4, 7);
+				Image<uint16_t> block(Vec3c(9, 11, 6));
+				zarr::readBlock(block, path, blockStart);
+				Image<uint16_t> expectedBlock(block.dimensions());
+				forAllPixels(expectedBlock, [&](coord_t x, coord_t y, coord_t z)
+					{
+						expectedBlock(x, y, z) = img(Vec3c(x, y, z) + blockStart);
+					});
+				testAssert(equals(expectedBlock, block), "zarr test partial shard read" + desc);
+
+				// Update parts of inner chunks repeatedly.
+				string shardFile = internals::chunkFile(path, 3, Vec3c(0, 0, 0), metadata.separator);
+				size_t originalSize = fileSize(shardFile);
+				Vec3c updateStart(4, 4, 4);
+				Vec3c updateSize(9, 5, 12);
+				for (uint16_t n = 0; n < 10; n++)
+				{
+					draw(img, AABoxc::fromPosSize(updateStart, updateSize), (uint16_t)(1000 + n));
+					zarr::writeBlock(img, path, updateStart, updateSize, metadata);
+				}
+				Image<uint16_t> fromDisk;
+				zarr::read(fromDisk, path);
+				testAssert(equals(img, fromDisk), "zarr test partial shard write" + desc);
+				testAssert((size_t)fileSize(shardFile) <= 3 * originalSize, "zarr test partial shard write is compacted" + desc);
+
+				// Clearing a shard should remove the shard file.
+				draw(img, AABoxc::fromPosSize(Vec3c(0, 0, 0), shardShape), (uint16_t)DEFAULT_FILLVALUE);
+				zarr::writeBlock(img, path, Vec3c(0, 0, 0), shardShape, metadata);
+				zarr::read(fromDisk, path);
+				testAssert(equals(img, fromDisk), "zarr test partial shard write of empty shard" + desc);
+				testAssert(!fs::exists(shardFile), "zarr test empty shard is removed" + desc);
+			}
+
+			void shardingPartialAccess()
+			{
+				shardingPartialAccessTest("end", false);
+				shardingPartialAccessTest("start", false);
+				shardingPartialAccessTest("end", true);
+				shardingPartialAccessTest("start", true);
+			}
+
 			void sharding()
 			{
 				shardingTest("end", false);
@@ -3,6 +3,7 @@
 #include <variant>
 #include <iostream>
 #include <string>
+#include <exception>
 
 #include "filesystem.h"
 #include "image.h"
@@ -138,8 +139,270 @@ namespace itl2
 			}
 
 			std::vector<char> readBytesOfFile(const std::string& filename);
+			void readBytesOfFile(const std::string& filename, std::vector<char>& buffer);
 			void writeBytesToFile(std::vector<char>& buffer, const std::string& filename, size_t startInFilePos = 0);
 
+			/**
+			Calculates shape of decoded chunk before the array-to-array codecs are reversed.
+			*/
+			inline Vec3c transposedChunkShape(const ZarrMetadata& metadata)
+			{
+				return codecs::transposedChunkShape(metadata.chunkSize, metadata.codecs);
+			}
+
+			/**
+			Reads count bytes starting from position pos of an open file.
+			*/
+			void readBytes(std::istream& in, const std::string& filename, size_t pos, size_t count, std::vector<char>& buffer);
+
+			/**
+			Writes contents of buffer to position pos of an open file.
+			*/
+			void writeBytes(std::ostream& out, const std::string& filename, size_t pos, const std::vector<char>& buffer);
+
+			/**
+			Copies a region from source image to target image one row at a time.
+			@param sourceStart, targetStart Positions of the source and target images in the coordinate system where the region is given.
+			*/
+			template<typename pixel_t>
+			void copyRows(const Image<pixel_t>& source, const Vec3c& sourceStart, Image<pixel_t>& target, const Vec3c& targetStart, const AABoxc& region)
+			{
+				size_t rowBytes = region.size().x * sizeof(pixel_t);
+				for (coord_t z = region.minc.z; z < region.maxc.z; z++)
+				{
+					for (coord_t y = region.minc.y; y < region.maxc.y; y++)
+					{
+						Vec3c pos(region.minc.x, y, z);
+						std::memcpy(&target(pos - targetStart), &source(pos - sourceStart), rowBytes);
+					}
+				}
+			}
+
+			/**
+			Tests if the chunks of the dataset are shards whose index can be read without reading the whole shard,
+			so that the inner chunks can be read and written individually.
+			*/
+			inline bool supportsPartialShardAccess(const ZarrMetadata& metadata)
+			{
+				if (metadata.codecs.size() != 1 || metadata.codecs.front().name != codecs::Name::Sharding)
+					return false;
+
+				Vec3c innerChunkShape;
+				codecs::Pipeline innerCodecs;
+				codecs::Pipeline indexCodecs;
+				codecs::sharding::indexLocation indexLocation;
+				metadata.codecs.front().getShardingConfiguration(innerChunkShape, innerCodecs, indexCodecs, indexLocation);
+				return indexCodecs == codecs::Pipeline{ codecs::ZarrCodec(codecs::Name::Bytes) };
+			}
+
+			/**
+			Index of a shard file and the configuration needed to decode its inner chunks.
+			*/
+			struct ShardIndex
+			{
+				Vec3c innerChunkShape;
+				codecs::Pipeline innerCodecs;
+				codecs::sharding::indexLocation indexLocation;
+				Vec3c chunksPerShard;
+				Image<codecs::sharding::index_t> offsets;
+				Image<codecs::sharding::index_t> nBytes;
+				size_t fileSize;
+				size_t indexPos;
+			};
+
+			/**
+			Reads only the index of a shard file.
+			*/
+			void readShardIndex(std::istream& in, const std::string& filename, const ZarrMetadata& metadata, ShardIndex& index, std::vector<char>& buffer);
+
+			/**
+			Calls lambda(innerChunkIndex, innerChunkBox) for each inner chunk of a shard that overlaps the given region.
+			The region and the inner chunk boxes are given in the coordinates of the shard.
+			*/
+			template<typename F>
+			void forOverlappingInnerChunks(const ShardIndex& index, const AABoxc& region, F&& lambda)
+			{
+				Vec3c first = region.minc.componentwiseDivide(index.innerChunkShape);
+				Vec3c last = (region.maxc - Vec3c(1, 1, 1)).componentwiseDivide(index.innerChunkShape);
+				for (coord_t z = first.z; z <= last.z; z++)
+				{
+					for (coord_t y = first.y; y <= last.y; y++)
+					{
+						for (coord_t x = first.x; x <= last.x; x++)
+						{
+							Vec3c innerIndex(x, y, z);
+							lambda(innerIndex, AABoxc::fromPosSize(innerIndex.componentwiseMultiply(index.innerChunkShape), index.innerChunkShape));
+						}
+					}
+				}
+			}
+
+			/**
+			Reads and decodes a single inner chunk of a shard file.
+			Empty inner chunks are filled with the fill value.
+			*/
+			template<typename pixel_t>
+			void readInnerChunk(std::istream& in, const std::string& filename, const ShardIndex& index, const Vec3c& innerIndex, fillValue_t fillValue,
+				std::vector<char>& buffer, Image<pixel_t>& innerChunk)
+			{
+				codecs::sharding::index_t nBytes = index.nBytes(innerIndex);
+				if (nBytes == codecs::sharding::EMPTY_CHUNK)
+				{
+					innerChunk.ensureSize(index.innerChunkShape);
+					draw<pixel_t>(innerChunk, AABoxc::fromPosSize(Vec3c(0, 0, 0), index.innerChunkShape), static_cast<pixel_t>(fillValue));
+					return;
+				}
+
+				readBytes(in, filename, index.offsets(innerIndex), nBytes, buffer);
+				innerChunk.ensureSize(codecs::transposedChunkShape(index.innerChunkShape, index.innerCodecs));
+				decodePipeline(index.innerCodecs, innerChunk, buffer, fillValue);
+			}
+
+			/**
+			Reads the part of a shard that overlaps readRegion to outputBlock.
+			Only the shard index and the inner chunks that overlap the region are read from the shard file.
+			@param readRegion Region to read, in the coordinates of the full image. The region must be inside the shard.
+			*/
+			template<typename pixel_t>
+			void readShardInBlock(Image<pixel_t>& outputBlock, const std::string& filename, const AABoxc& readRegion, const Vec3c& blockStart, const Vec3c& shardStart, const ZarrMetadata& metadata,
+				std::vector<char>& buffer, Image<pixel_t>& innerChunk)
+			{
+				std::ifstream in(filename, std::ios_base::binary);
+				if (!in)
+					throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
+
+				ShardIndex index;
+				readShardIndex(in, filename, metadata, index, buffer);
+
+				AABoxc localRegion = readRegion.translate(-shardStart);
+				forOverlappingInnerChunks(index, localRegion, [&](const Vec3c& innerIndex, const AABoxc& innerBox)
+					{
+						AABoxc region = localRegion.intersection(innerBox).translate(shardStart);
+						if (index.nBytes(innerIndex) == codecs::sharding::EMPTY_CHUNK)
+						{
+							draw<pixel_t>(outputBlock, region.translate(-blockStart), static_cast<pixel_t>(metadata.fillValue));
+						}
+						else
+						{
+							readInnerChunk(in, filename, index, innerIndex, metadata.fillValue, buffer, innerChunk);
+							copyRows(innerChunk, innerBox.minc + shardStart, outputBlock, blockStart, region);
+						}
+					});
+			}
+
+			/**
+			Writes the part of img that is inside updateRegion to an existing shard file.
+			Only the inner chunks that overlap the update region are encoded. They are appended to the shard file and the shard index is
+			updated, so that the other inner chunks are not read or re-encoded. If the shard file contains more unused than used bytes
+			after the update, the encoded inner chunks are copied to a new, compact shard file.
+			If all the inner chunks become empty, the shard file is deleted.
+			@param updateRegion Region to write, in the coordinates of img. The region must be inside the shard.
+			*/
+			template<typename pixel_t>
+			void writeShardInBlock(const Image<pixel_t>& img, const std::string& filename, const AABoxc& updateRegion, const Vec3c& shardStart, const ZarrMetadata& metadata)
+			{
+				typedef codecs::sharding::index_t index_t;
+
+				std::fstream io(filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+				if (!io)
+					throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
+
+				std::vector<char> buffer;
+				ShardIndex index;
+				readShardIndex(io, filename, metadata, index, buffer);
+
+				size_t indexSize = codecs::sharding::indexSize(index.chunksPerShard);
+				size_t dataStart = index.indexLocation == codecs::sharding::indexLocation::start ? indexSize : 0;
+				size_t dataEnd = index.indexLocation == codecs::sharding::indexLocation::start ? index.fileSize : index.indexPos;
+
+				// Encode updated inner chunks and place them after the current data.
+				std::vector<char> newData;
+				Image<pixel_t> innerChunk;
+				AABoxc localRegion = updateRegion.translate(-shardStart);
+				forOverlappingInnerChunks(index, localRegion, [&](const Vec3c& innerIndex, const AABoxc& innerBox)
+					{
+						AABoxc region = localRegion.intersection(innerBox);
+						if (region.size() != innerBox.size())
+							readInnerChunk(io, filename, index, innerIndex, metadata.fillValue, buffer, innerChunk);
+						else
+							innerChunk.ensureSize(index.innerChunkShape);
+
+						copyRows(img, Vec3c(0, 0, 0), innerChunk, innerBox.minc + shardStart, region.translate(shardStart));
+
+						if (allEquals(innerChunk, static_cast<pixel_t>(metadata.fillValue)))
+						{
+							index.offsets(innerIndex) = codecs::sharding::EMPTY_CHUNK;
+							index.nBytes(innerIndex) = codecs::sharding::EMPTY_CHUNK;
+						}
+						else
+						{
+							encodePipeline(index.innerCodecs, innerChunk, buffer, metadata.fillValue);
+							index.offsets(innerIndex) = dataEnd + newData.size();
+							index.nBytes(innerIndex) = buffer.size();
+							newData.insert(newData.end(), buffer.begin(), buffer.end());
+						}
+					});
+
+				size_t usedBytes = 0;
+				size_t nonEmptyCount = 0;
+				for (coord_t n = 0; n < index.nBytes.pixelCount(); n++)
+				{
+					if (index.nBytes(n) != codecs::sharding::EMPTY_CHUNK)
+					{
+						usedBytes += index.nBytes(n);
+						nonEmptyCount++;
+					}
+				}
+
+				if (nonEmptyCount <= 0)
+				{
+					io.close();
+					fs::remove(filename);
+					return;
+				}
+
+				size_t storedBytes = dataEnd - dataStart + newData.size();
+				if (storedBytes > 2 * usedBytes)
+				{
+					// Most of the file is unused. Copy the encoded inner chunks to a new shard file.
+					std::vector<char> shardBuffer(dataStart);
+					std::vector<char> chunkBuffer;
+					for (coord_t n = 0; n < index.nBytes.pixelCount(); n++)
+					{
+						index_t nBytes = index.nBytes(n);
+						if (nBytes == codecs::sharding::EMPTY_CHUNK)
+							continue;
+
+						index_t offset = index.offsets(n);
+						index.offsets(n) = shardBuffer.size();
+						if (offset >= dataEnd)
+						{
+							shardBuffer.insert(shardBuffer.end(), newData.begin() + (offset - dataEnd), newData.begin() + (offset - dataEnd + nBytes));
+						}
+						else
+						{
+							readBytes(io, filename, offset, nBytes, chunkBuffer);
+							shardBuffer.insert(shardBuffer.end(), chunkBuffer.begin(), chunkBuffer.end());
+						}
+					}
+					io.close();
+
+					codecs::sharding::encodeIndex(index.offsets, index.nBytes, buffer);
+					if (index.indexLocation == codecs::sharding::indexLocation::start)
+						std::memcpy(shardBuffer.data(), buffer.data(), buffer.size());
+					else
+						shardBuffer.insert(shardBuffer.end(), buffer.begin(), buffer.end());
+
+					writeBytesToFile(shardBuffer, filename);
+				}
+				else
+				{
+					codecs::sharding::encodeIndex(index.offsets, index.nBytes, buffer);
+					writeBytes(io, filename, dataEnd, newData);
+					writeBytes(io, filename, index.indexLocation == codecs::sharding::indexLocation::start ? 0 : dataEnd + newData.size(), buffer);
+				}
+			}
+
 			/*
 			 * outputBlock: image where the data should get read to
 			 * filename: path to the file containing this chunk
@@ -147,22 +410,12 @@ namespace itl2
 			 * blockStart: top left coordinate of outputBlock
 			 * chunkStart: top left coordinate of this chunk
 			 * metadata: metadata of the zarr dataset
+			 * buffer, imgChunk: temporary storage that can be re-used between calls
 			 */
-
 			template<typename pixel_t>
-			void readChunkInBlock(Image<pixel_t>& outputBlock, const std::string& filename, const AABoxc updateRegion, const Vec3c blockStart, const Vec3c chunkStart, const ZarrMetadata& metadata)
+			void readChunkInBlock(Image<pixel_t>& outputBlock, const std::string& filename, const AABoxc updateRegion, const Vec3c blockStart, const Vec3c chunkStart, const ZarrMetadata& metadata,
+				std::vector<char>& buffer, Image<pixel_t>& imgChunk)
 			{
-				Vec3c transposedChunkShape = metadata.chunkSize;
-				for (auto codec : metadata.codecs)
-				{
-					if (codec.name == codecs::Name::Transpose)
-					{
-						Vec3c order;
-						codec.getTransposeConfiguration(order);
-						transposedChunkShape = transposedChunkShape.transposed(order);
-					}
-				}
-
 				AABox<coord_t> currentChunk = AABox<coord_t>::fromPosSize(chunkStart, metadata.chunkSize);
 				if (updateRegion.overlapsExclusive(currentChunk))
 				{
@@ -173,16 +426,21 @@ namespace itl2
 					}
 					if (fs::is_regular_file(filename))
 					{
-						std::vector<char> buffer = readBytesOfFile(filename);
-						Image<pixel_t> imgChunk(transposedChunkShape);
-						decodePipeline(metadata.codecs, imgChunk, buffer, metadata.fillValue);
-
-						//write all pixels of chunk back to img
-						forAllInBox(readRegion, [&](coord_t x, coord_t y, coord_t z)
+						if (supportsPartialShardAccess(metadata))
 						{
-						  Vec3c pos = Vec3c(x, y, z);
-						  outputBlock(pos - blockStart) = imgChunk(pos - chunkStart);
-						});
+							// Read only the required inner chunks of the shard.
+							readShardInBlock(outputBlock, filename, readRegion, blockStart, chunkStart, metadata, buffer, imgChunk);
+						}
+						else
+						{
+							readBytesOfFile(filename, buffer);
+							imgChunk.ensureSize(transposedChunkShape(metadata));
+							decodePipeline(metadata.codecs, imgChunk, buffer, metadata.fillValue);
+
+							// After decoding, imgChunk is in the chunk coordinates, so the data can be copied
+							// one row at a time.
+							copyRows(imgChunk, chunkStart, outputBlock, blockStart, readRegion);
+						}
 					}
 					else
 					{
@@ -190,8 +448,18 @@ namespace itl2
 					}
 				}
 			}
+
+			template<typename pixel_t>
+			void readChunkInBlock(Image<pixel_t>& outputBlock, const std::string& filename, const AABoxc updateRegion, const Vec3c blockStart, const Vec3c chunkStart, const ZarrMetadata& metadata)
+			{
+				std::vector<char> buffer;
+				Image<pixel_t> imgChunk;
+				readChunkInBlock(outputBlock, filename, updateRegion, blockStart, chunkStart, metadata, buffer, imgChunk);
+			}
+
 			/**
 			Reads zarr chunk files.
+			Only the chunks that overlap the block are processed, and they are read and decoded in parallel.
 			*/
 			template<typename pixel_t>
 			void readChunksInRange(Image<pixel_t>& outputBlock, const std::string& path,
@@ -200,13 +468,55 @@ namespace itl2
 				const Vec3c& blockStart,
 				bool showProgressInfo)
 			{
-
 				const AABoxc selectedBlock = AABoxc::fromPosSize(blockStart, outputBlock.dimensions());
-				forAllChunks(datasetShape, metadata.chunkSize, showProgressInfo, [&](const Vec3c& chunkIndex, const Vec3c& chunkStart)
+				const AABoxc readBox = selectedBlock.intersection(AABoxc::fromPosSize(Vec3c(0, 0, 0), datasetShape));
+				if (readBox.size().min() <= 0)
+					return;
+
+				// Determine the range of chunk indices that overlap the block.
+				Vec3c firstChunk = readBox.minc.componentwiseDivide(metadata.chunkSize);
+				Vec3c lastChunk = (readBox.maxc - Vec3c(1, 1, 1)).componentwiseDivide(metadata.chunkSize);
+				Vec3c chunkCounts = lastChunk - firstChunk + Vec3c(1, 1, 1);
+				coord_t chunkCount = chunkCounts.product();
+
+				size_t dimensionality = getDimensionality(datasetShape);
+				size_t counter = 0;
+
+				// Exceptions must not propagate out of the parallel region, so the first one is stored and re-thrown afterwards.
+				std::exception_ptr error;
+
+				#pragma omp parallel if(!omp_in_parallel() && chunkCount > 1)
 				{
-				  string filename = chunkFile(path, getDimensionality(datasetShape), chunkIndex, metadata.separator);
-				  readChunkInBlock(outputBlock, filename, selectedBlock, blockStart, chunkStart, metadata);
-				});
+					// Per-thread temporary storage for reading and decoding the chunks.
+					std::vector<char> buffer;
+					Image<pixel_t> imgChunk;
+
+					#pragma omp for schedule(dynamic)
+					for (coord_t n = 0; n < chunkCount; n++)
+					{
+						try
+						{
+							Vec3c chunkIndex = firstChunk + indexToCoords(n, chunkCounts);
+							Vec3c chunkStart = chunkIndex.componentwiseMultiply(metadata.chunkSize);
+
+							string filename = chunkFile(path, dimensionality, chunkIndex, metadata.separator);
+							readChunkInBlock(outputBlock, filename, selectedBlock, blockStart, chunkStart, metadata, buffer, imgChunk);
+						}
+						catch (...)
+						{
+							#pragma omp critical(zarr_read_error)
+							{
+								if (!error)
+									error = std::current_exception();
+							}
+						}
+
+						showThreadProgress(counter, chunkCount, showProgressInfo);
+					}
+				}
+
+				if (error)
+					std::rethrow_exception(error);
 			}
 
 			/*
@@ -594,9 +904,15 @@ namespace itl2
 				  if (selectedBlock.overlapsExclusive(currentChunk))
 				  {
 					  AABoxc updateRegion = selectedBlock.intersection(currentChunk).intersection(img.bounds());
+					  string filename = chunkFile(path, getDimensionality(img.dimensions()), chunkIndex, metadata.separator);
+					  if (supportsPartialShardAccess(metadata) && fs::is_regular_file(filename) && !fs::exists(writesFolder(filename)))
+					  {
+						  // Re-encode only the updated inner chunks of an existing shard.
+						  writeShardInBlock(img, filename, updateRegion, chunkStart, metadata);
+						  return;
+					  }
 					  Image<pixel_t> imgChunk(metadata.chunkSize, metadata.fillValue);
 					  readBlock(imgChunk, path, chunkStart); //TODO: use readChunkInBlock
-					  string filename = chunkFile(path, getDimensionality(img.dimensions()), chunkIndex, metadata.separator);
 					  //write all pixels of chunk in img to imgChunk
 					  forAllInBox(updateRegion, [&](coord_t x, coord_t y, coord_t z)
 					  {
@@ -765,6 +1081,7 @@ namespace itl2
 			void zarrMetadataEquals();
 			void separator();
 			void sharding();
+			void shardingPartialAccess();
 			void emptyChunks();
 			void concurrency();
 
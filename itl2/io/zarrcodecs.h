@@ -405,10 +405,110 @@ namespace itl2
 			std::memcpy(buffer.data(), temp.data(), buffer.size());
 		}
 
+		namespace sharding
+		{
+			typedef uint64_t index_t;
+
+			/**
+			Value of offset and size in the shard index that indicates that the inner chunk is empty.
+			*/
+			inline constexpr index_t EMPTY_CHUNK = (index_t)-1;
+
+			/**
+			Throws an exception if the given sharding index codecs are not supported.
+			*/
+			inline void checkIndexCodecs(const Pipeline& indexCodecs)
+			{
+				Pipeline allowedIndexCodecPipeline = Pipeline{ codecs::ZarrCodec(codecs::Name::Bytes) };
+				if (indexCodecs != allowedIndexCodecPipeline)
+				{
+					//TODO implement decode other index_codecs
+					std::stringstream s;
+					s << "This zarr implementation only supports this sharding index_codec: " << allowedIndexCodecPipeline << " but got: " << indexCodecs;
+					throw ITLException(s.str());
+				}
+			}
+
+			/**
+			Calculates size of the shard index in bytes.
+			Only valid for index_codecs containing only the bytes codec.
+			*/
+			inline size_t indexSize(const Vec3c& chunksPerShard)
+			{
+				return 2 * sizeof(index_t) * chunksPerShard.product();
+			}
+
+			/**
+			Decodes shard index stored in the given buffer into offsets and sizes of the inner chunks.
+			*/
+			inline void decodeIndex(const char* indexBuffer, const Vec3c& chunksPerShard, Image<index_t>& offsets, Image<index_t>& nBytes)
+			{
+				offsets.ensureSize(chunksPerShard);
+				nBytes.ensureSize(chunksPerShard);
+
+				std::vector<index_t> temp(chunksPerShard.product() * 2);
+				std::memcpy(temp.data(), indexBuffer, temp.size() * sizeof(index_t));
+
+				size_t n = 0;
+				for (coord_t x = 0; x < chunksPerShard.x; x++)
+				{
+					for (coord_t y = 0; y < chunksPerShard.y; y++)
+					{
+						for (coord_t z = 0; z < chunksPerShard.z; z++)
+						{
+							offsets(x, y, z) = temp[n++];
+							nBytes(x, y, z) = temp[n++];
+						}
+					}
+				}
+			}
+
+			/**
+			Encodes offsets and sizes of the inner chunks into shard index buffer, without applying any bytes-to-bytes codecs.
+			*/
+			inline void encodeIndex(const Image<index_t>& offsets, const Image<index_t>& nBytes, std::vector<char>& indexBuffer)
+			{
+				Vec3c chunksPerShard = offsets.dimensions();
+				std::vector<index_t> temp(chunksPerShard.product() * 2);
+				size_t n = 0;
+				for (coord_t x = 0; x < chunksPerShard.x; x++)
+				{
+					for (coord_t y = 0; y < chunksPerShard.y; y++)
+					{
+						for (coord_t z = 0; z < chunksPerShard.z; z++)
+						{
+							temp[n++] = offsets(x, y, z);
+							temp[n++] = nBytes(x, y, z);
+						}
+					}
+				}
+				indexBuffer.resize(temp.size() * sizeof(index_t));
+				std::memcpy(indexBuffer.data(), temp.data(), indexBuffer.size());
+			}
+		}
+
+		/**
+		Calculates shape of a chunk encoded with the given codecs, after the array-to-array codecs have been applied.
+		*/
+		inline Vec3c transposedChunkShape(const Vec3c& chunkShape, const Pipeline& pipeline)
+		{
+			Vec3c shape = chunkShape;
+			for (auto& codec : pipeline)
+			{
+				if (codec.name == codecs::Name::Transpose)
+				{
+					Vec3c order;
+					codec.getTransposeConfiguration(order);
+					shape = shape.transposed(order);
+				}
+			}
+			return shape;
+		}
+
 		template<typename pixel_t>
 		void decodeShardingCodec(const ZarrCodec& codec, Image<pixel_t>& shard, std::vector<char>& buffer, fillValue_t fillValue)
 		{
-			typedef u_int64_t index_t;
+			typedef sharding::index_t index_t;
 
 			Vec3c innerChunkShape;
 			Pipeline codecs;
@@ -417,55 +517,31 @@ namespace itl2
 			codec.getShardingConfiguration(innerChunkShape, codecs, indexCodecs, indexLocation);
 
 			Vec3c chunksPerShard = shard.dimensions().componentwiseDivide(innerChunkShape);
-			int chunkCount = chunksPerShard.product();
-			Pipeline allowedIndexCodecPipeline = Pipeline{ codecs::ZarrCodec(codecs::Name::Bytes) };
-			if(indexCodecs != allowedIndexCodecPipeline)
-			{
-				//TODO implement decode other index_codecs
-				std::stringstream s;
-				s << "This zarr implementation only supports this sharding index_codec: " << allowedIndexCodecPipeline << " but got: " << indexCodecs;
-				throw ITLException(s.str());
-			}
-			int indexSize = 2 * sizeof(index_t) * chunkCount; //only valid for index_codec only containing bytesCodec
-			std::vector<char> indexBuffer;
+			sharding::checkIndexCodecs(indexCodecs);
+			size_t indexSize = sharding::indexSize(chunksPerShard);
 
+			const char* indexBuffer = nullptr;
 			switch (indexLocation)
 			{
 			case sharding::indexLocation::start:
-				indexBuffer.insert(indexBuffer.end(), buffer.begin(), buffer.begin() + indexSize);
+				indexBuffer = buffer.data();
 				break;
 			case sharding::indexLocation::end:
-				indexBuffer.insert(indexBuffer.end(), buffer.end() - indexSize, buffer.end());
+				indexBuffer = buffer.data() + buffer.size() - indexSize;
 			}
 
-			Image<index_t> shardIndexArrayOffsets(chunksPerShard);
-			Image<index_t> shardIndexArrayNBytes(chunksPerShard);
-
-			//decode indexArray buffer into shardIndexArrayOffsets and shardIndexArrayNBytes
-			//TODO: extract to decodeBytesCodec
-			std::vector<index_t> temp(chunkCount*2);
-			std::memcpy(temp.data(), indexBuffer.data(), indexBuffer.size());
+			Image<index_t> shardIndexArrayOffsets;
+			Image<index_t> shardIndexArrayNBytes;
+			sharding::decodeIndex(indexBuffer, chunksPerShard, shardIndexArrayOffsets, shardIndexArrayNBytes);
 
-			size_t n = 0;
-			for (coord_t x = 0; x < chunksPerShard.x; x++)
-			{
-				for (coord_t y = 0; y < chunksPerShard.y; y++)
-				{
-					for (coord_t z = 0; z < chunksPerShard.z; z++)
-					{
-						shardIndexArrayOffsets(x, y, z) = temp[n++];
-						shardIndexArrayNBytes(x, y, z) = temp[n++];
-					}
-				}
-			}
 			forAllChunks(shard.dimensions(), innerChunkShape, false, [&](const Vec3c& chunkIndex, const Vec3c& chunkStart)
 			{
 			  index_t nBytes = shardIndexArrayNBytes(chunkIndex);
 			  index_t offset = shardIndexArrayOffsets(chunkIndex);
 
 			  //TODO: check both variables. for testing nBytes is sufficient as the library used to test against had partially wrong offset values
-			  //if(nBytes==-1 && offset==-1){
-			  if(nBytes==-1){
+			  //if(nBytes==sharding::EMPTY_CHUNK && offset==sharding::EMPTY_CHUNK){
+			  if(nBytes==sharding::EMPTY_CHUNK){
 				  size_t ndrawn = draw(shard, AABoxc::fromMinMax(chunkStart, chunkStart + innerChunkShape), static_cast<pixel_t>(fillValue));
 #if defined(_DEBUG) || defined(BOUNDS_CHECK)
 				  assert(ndrawn==innerChunkShape.product());
@@ -479,7 +555,7 @@ namespace itl2
 
 				  chunkBuffer.insert(chunkBuffer.end(), chunkBegin, chunkEnd);
 
-				  Image<pixel_t> innerChunk(innerChunkShape);
+				  Image<pixel_t> innerChunk(transposedChunkShape(innerChunkShape, codecs));
 				  decodePipeline(codecs, innerChunk, chunkBuffer, fillValue);
 
 				  forAllPixels(innerChunk, [&](coord_t x, coord_t y, coord_t z)
@@ -498,7 +574,7 @@ namespace itl2
 		template<typename pixel_t>
 		void encodeShardingCodec(const ZarrCodec& codec, const Image <pixel_t>& shard, std::vector<char>& buffer, fillValue_t fillValue)
 		{
-			typedef u_int64_t index_t;
+			typedef sharding::index_t index_t;
 
 			Vec3c innerChunkShape;
 			Pipeline codecs;
@@ -506,23 +582,15 @@ namespace itl2
 			sharding::indexLocation indexLocation;
 			codec.getShardingConfiguration(innerChunkShape, codecs, indexCodecs, indexLocation);
 
-			Pipeline allowedIndexCodecPipeline = Pipeline{ codecs::ZarrCodec(codecs::Name::Bytes) };
-			if(indexCodecs != allowedIndexCodecPipeline)
-			{
-				//TODO implement decode other index_codecs
-				std::stringstream s;
-				s << "This zarr implementation only supports this sharding index_codec: " << allowedIndexCodecPipeline << " but got: " << indexCodecs;
-				throw ITLException(s.str());
-			}
+			sharding::checkIndexCodecs(indexCodecs);
 
 			if(!(shard.dimensions() >= innerChunkShape)) throw ITLException("inner chunk shape " + toString(innerChunkShape) + " does not fit into shard shape " + toString(shard.dimensions()));
 			Vec3c chunksPerShard = shard.dimensions().componentwiseDivide(innerChunkShape);
 			if(!(chunksPerShard.componentwiseMultiply(innerChunkShape) == shard.dimensions())) throw ITLException("inner chunk shape " + toString(innerChunkShape) + " does not evenly divide shard shape " + toString(shard.dimensions()));
 
-			int chunkCount = chunksPerShard.product();
 			Image<index_t> shardIndexArrayOffsets(chunksPerShard);
 			Image<index_t> shardIndexArrayNBytes(chunksPerShard);
-			int indexSize = 2 * sizeof(index_t) * chunkCount; //will change if other index codecs are allowed
+			size_t indexSize = sharding::indexSize(chunksPerShard); //will change if other index codecs are allowed
 			Image<std::vector<char>> chunkBytes(chunksPerShard);
 
 			//TODO: concurrency needed? then working with fixed nbytes would be necessary
@@ -545,8 +613,8 @@ namespace itl2
 			  });
 			  if (innerChunkEmpty)
 			  {
-				  shardIndexArrayOffsets(chunkIndex) = -1;
-				  shardIndexArrayNBytes(chunkIndex) = -1;
+				  shardIndexArrayOffsets(chunkIndex) = sharding::EMPTY_CHUNK;
+				  shardIndexArrayNBytes(chunkIndex) = sharding::EMPTY_CHUNK;
 			  }
 			  else
 			  {
@@ -571,24 +639,8 @@ namespace itl2
 				throw ITLException("This zarr implementation only supports the Bytes Codec at the first position of the sharding index_codecs");
 
 			//apply encodeBytesCodec for shardIndexArrayOffsets and shardIndexArrayNBytes combined
-			//TODO: extract to encodeBytesCodec
 			std::vector<char> indexBuffer;
-			std::vector<index_t> temp(chunkCount*2);
-			size_t n = 0;
-			for (coord_t x = 0; x < chunksPerShard.x; x++)
-			{
-				for (coord_t y = 0; y < chunksPerShard.y; y++)
-				{
-					for (coord_t z = 0; z < chunksPerShard.z; z++)
-					{
-						temp[n++] = shardIndexArrayOffsets(x, y, z);
-						temp[n++] = shardIndexArrayNBytes(x, y, z);
-					}
-				}
-			}
-			size_t indexBufferSize = chunkCount * sizeof(index_t) * 2;
-			indexBuffer = std::vector<char>(indexBufferSize);
-			std::memcpy(indexBuffer.data(), temp.data(), indexBuffer.size());
+			sharding::encodeIndex(shardIndexArrayOffsets, shardIndexArrayNBytes, indexBuffer);
 
 			//encode BytesBytesCodecs
 			++indexCodec;
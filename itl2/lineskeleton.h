@@ -2,9 +2,10 @@
 
 #include "image.h"
 #include "surfaceskeleton.h"
+#include "thinning.h"
 #include "math/vec3.h"
 
-#include <deque>
+#include <vector>
 
 namespace itl2
 {
@@ -510,90 +511,63 @@ namespace itl2
 		*/
 	}
 
-	/*
-	Performs one thinning iteration and returns count of pixels removed from the image.
-	Repeating this thinning process until the image does not change results in line skeleton.
-	@param img Image that should be thinned.
-	*/
-	template<typename pixel_t> size_t lineThin(Image<pixel_t>& img)
+	namespace internals
 	{
-		size_t changed = 0;
-		std::deque<Vec3c> points;
-		size_t counter = 0;
-
-		for(int direction = 1; direction <= 6; direction++)
+		/*
+		Performs one line thinning iteration using the given thinning engine and returns count of pixels removed from the image.
+		*/
+		template<typename pixel_t> size_t lineThin(BorderThinning<pixel_t>& thinning)
 		{
-			points.clear();
-
-			// Collect initial list of points
-			#pragma omp parallel
-			{
-				Image<pixel_t> nbPrivate(3, 3, 3);
-
-				#pragma omp for
-				for (coord_t z = 0; z < img.depth(); z++)
+			return thinning.template iterate<pixel_t>(
+				[](int direction, const Image<pixel_t>& img, coord_t x, coord_t y, coord_t z)
 				{
-					for (coord_t y = 0; y < img.height(); y++)
-					{
-						for (coord_t x = 0; x < img.width(); x++)
-						{
-							pixel_t c = img(x, y, z);
-							if (c != (pixel_t)0)
-							{
-								if (internals::isBorderPoint(direction, img, x, y, z))
-								{
-									getNeighbourhood(img, Vec3c(x, y, z), Vec3c(1, 1, 1), nbPrivate, BoundaryCondition::Zero);
-
-									// Note: This uses the same isEndPoint than hybridSkeleton!
-									if (!internals::isEndPoint(nbPrivate) &&
-										internals::isSimplePointLine(nbPrivate))
-									{
-										#pragma omp critical(linethin_insert)
-											points.push_back(Vec3c(x, y, z));
-									}
-								}
-							}
-						}
-					}
-
-					showThreadProgress(counter, 6 * img.depth());
-				}
-			}
-
-			// This is required to make the result exactly the same than in Fiji (non-threaded version)
-			// Otherwise, the point removal order may change the skeleton points.
-			std::sort(points.begin(), points.end(), vecComparer<coord_t>);
-
-			// Process all points
-			size_t counter = 0;
-			Image<pixel_t> nb(3, 3, 3);
-			while (!points.empty())
-			{
-				Vec3c p;
-				if (counter % 2 == 0)
+					return isBorderPoint(direction, img, x, y, z);
+				},
+				[](const Image<pixel_t>& nb)
 				{
-					p = points.front();
-					points.pop_front();
-				}
-				else
+					// Note: This uses the same isEndPoint than hybridSkeleton!
+					return !isEndPoint(nb) && isSimplePointLine(nb);
+				},
+				[&](const coord_t* begin, const coord_t* end, std::vector<coord_t>& removed)
 				{
-					p = points.back();
-					points.pop_back();
-				}
+					Image<pixel_t>& img = thinning.image();
+					Image<pixel_t> nb(3, 3, 3);
 
-				getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
-				if (!internals::isEndPoint(nb) &&
-					internals::isSimplePointLine(nb))
-				{
-					img(p) = 0;
-					changed++;
-				}
+					// Process points alternately from the beginning and from the end of the list.
+					size_t counter = 0;
+					while (begin < end)
+					{
+						coord_t i;
+						if (counter % 2 == 0)
+							i = *begin++;
+						else
+							i = *--end;
+
+						Vec3c p = img.getCoords(i);
+						getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
+						if (!isEndPoint(nb) &&
+							isSimplePointLine(nb))
+						{
+							img(i) = 0;
+							removed.push_back(i);
+						}
 
-				counter++;
-			}
+						counter++;
+					}
+				});
 		}
+	}
 
-		return changed;
+	/*
+	Performs one thinning iteration and returns count of pixels removed from the image.
+	Repeating this thinning process until the image does not change results in line skeleton.
+	If multiple iterations are required, it is faster to use lineSkeleton function.
+	@param img Image that should be thinned.
+	*/
+	template<typename pixel_t> size_t lineThin(Image<pixel_t>& img)
+	{
+		internals::BorderThinning<pixel_t> thinning(img);
+		return internals::lineThin(thinning);
 	}
 
 	/*
@@ -605,16 +579,19 @@ namespace itl2
 	The resulting skeleton consists of lines only so it is referred to as "line skeleton".
 	Note that if line skeleton is required, it might be better idea to fill holes in the structure
 	and use hybrid skeleton as that algorithm seems to produce cleaner looking skeletons.
+	The image is scanned only once, and after that only the border points of the structure are processed.
+	The points are removed in parallel in slabs, so the result does not depend on the number of threads.
 	@param img Image that should be skeletonized.
 	*/
 	template<typename pixel_t> void lineSkeleton(Image<pixel_t>& img, size_t maxIterations = std::numeric_limits<size_t>::max())
 	{
+		internals::BorderThinning<pixel_t> thinning(img);
 
 		size_t it = 0;
 		size_t changes;
 		do
 		{
-			changes = lineThin(img);
+			changes = internals::lineThin(thinning);
 
 			std::cout << changes << " pixels removed." << std::endl;
 
@@ -630,6 +607,7 @@ namespace itl2
 	namespace tests
 	{
 		void lineSkeleton();
+		void borderThinning();
 	}
 
 }
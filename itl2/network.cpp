@@ -5,6 +5,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 
 #include <random>
 #include <functional>
@@ -20,113 +21,309 @@ namespace itl2
 
 	const Vec3f Network::INVALID_VERTEX = Vec3f(numeric_limits<float32_t>::signaling_NaN(), numeric_limits<float32_t>::signaling_NaN(), numeric_limits<float32_t>::signaling_NaN());
 
-	void Network::degree(vector<size_t>& deg, bool reportProgress) const
+	const size_t VertexEdgeIndex::NO_EDGE = numeric_limits<size_t>::max();
+
+	void VertexEdgeIndex::build(size_t vertexCount, const vector<Edge>& edges)
 	{
-		deg.resize(vertices.size());
+		// Count edges of each vertex
+		offsets.assign(vertexCount + 1, 0);
+		for (size_t n = 0; n < edges.size(); n++)
+		{
+			size_t v1 = edges[n].verts[0];
+			size_t v2 = edges[n].verts[1];
+			if (v1 >= vertexCount || v2 >= vertexCount)
+				throw ITLException(string("Vertex index of edge ") + toString(n) + " is greater than or equal to vertex count.");
 
-		size_t counter = 0;
-		#pragma omp parallel if(!omp_in_parallel() && edges.size() + incompleteEdges.size() > PARALLELIZATION_THRESHOLD)
+			offsets[v1 + 1]++;
+			offsets[v2 + 1]++;
+		}
+
+		for (size_t n = 0; n < vertexCount; n++)
+			offsets[n + 1] += offsets[n];
+
+		// Place edges to the lists. As the edges are processed in order, each list will be sorted.
+		edgeIndices.resize(offsets[vertexCount]);
+		vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+		for (size_t n = 0; n < edges.size(); n++)
 		{
-			vector<size_t> degPrivate;
-			degPrivate.resize(vertices.size());
+			edgeIndices[pos[edges[n].verts[0]]++] = n;
+			edgeIndices[pos[edges[n].verts[1]]++] = n;
+		}
 
-			#pragma omp for nowait
-			for (coord_t n = 0; n < (coord_t)edges.size(); n++)
-			{
-				degPrivate[edges[n].verts[0]]++;
-				degPrivate[edges[n].verts[1]]++;
+		edgeCnt = edges.size();
+	}
 
-				//showThreadProgress(counter, edges.size() + incompleteEdges.size(), reportProgress);
+	void VertexEdgeIndex::removeEdges(const vector<size_t>& oldToNewEdge, size_t newEdgeCount)
+	{
+		// The new indices are increasing, so the lists remain sorted.
+		size_t w = 0;
+		for (size_t v = 0; v < vertexCount(); v++)
+		{
+			size_t start = offsets[v];
+			size_t end = offsets[v + 1];
+			offsets[v] = w;
+			for (size_t i = start; i < end; i++)
+			{
+				size_t e = edgeIndices[i];
+				if (e != NO_EDGE && oldToNewEdge[e] != NO_EDGE)
+					edgeIndices[w++] = oldToNewEdge[e];
 			}
+		}
+		offsets[vertexCount()] = w;
+		edgeIndices.resize(w);
+		edgeCnt = newEdgeCount;
+	}
 
-			#pragma omp for nowait
-			for (coord_t n = 0; n < (coord_t)incompleteEdges.size(); n++)
-			{
-				if(incompleteEdges[n].verts[0] >= 0)
-					degPrivate[incompleteEdges[n].verts[0]]++;
+	void VertexEdgeIndex::removeVertices(const vector<bool>& keep)
+	{
+		size_t w = 0;
+		for (size_t v = 0; v < vertexCount(); v++)
+		{
+			if (keep[v])
+				offsets[w++] = offsets[v];
+			else if (degree(v) > 0)
+				throw ITLException("Only vertices without edges can be removed from the vertex to edge index.");
+		}
+		offsets[w] = offsets[vertexCount()];
+		offsets.resize(w + 1);
+	}
+
+	void VertexEdgeIndex::write(ostream& out) const
+	{
+		// File structure
+		// vertex count (size_t)
+		// edge count (size_t)
+		// count of entries in edge lists (size_t)
+		// offsets (vertex count + 1 size_t values)
+		// edge lists (size_t values)
+		size_t count = vertexCount();
+		out.write((const char*)&count, sizeof(size_t));
+		out.write((const char*)&edgeCnt, sizeof(size_t));
+		count = edgeIndices.size();
+		out.write((const char*)&count, sizeof(size_t));
+		if (offsets.size() > 0)
+			out.write((const char*)offsets.data(), offsets.size() * sizeof(size_t));
+		else
+			out.write((const char*)&count, sizeof(size_t)); // Zero, the single offset of an empty index.
+		out.write((const char*)edgeIndices.data(), edgeIndices.size() * sizeof(size_t));
+	}
+
+	void VertexEdgeIndex::read(istream& in)
+	{
+		size_t vertexCount = 0;
+		size_t entryCount = 0;
+		in.read((char*)&vertexCount, sizeof(size_t));
+		in.read((char*)&edgeCnt, sizeof(size_t));
+		in.read((char*)&entryCount, sizeof(size_t));
+		if (!in || entryCount != 2 * edgeCnt)
+			throw ITLException("Invalid vertex to edge index.");
+
+		offsets.resize(vertexCount + 1);
+		in.read((char*)offsets.data(), offsets.size() * sizeof(size_t));
+		edgeIndices.resize(entryCount);
+		in.read((char*)edgeIndices.data(), edgeIndices.size() * sizeof(size_t));
+		if (!in)
+			throw ITLException("Unexpected end of file while reading vertex to edge index.");
+	}
 
-				if (incompleteEdges[n].verts[1] >= 0)
-					degPrivate[incompleteEdges[n].verts[1]]++;
+	const VertexEdgeIndex& Network::adjacency() const
+	{
+		// Items might have been added to the lists directly.
+		if (!indexValid || index.vertexCount() != vertices.size() || index.edgeCount() != edges.size())
+		{
+			index.build(vertices.size(), edges);
+			indexValid = true;
+		}
+		return index;
+	}
 
-				//showThreadProgress(counter, edges.size() + incompleteEdges.size(), reportProgress);
+	namespace
+	{
+		/**
+		Calculates checksum of the vertex indices of edges.
+		The checksum is used to test that vertex to edge index read from a file belongs to the network.
+		*/
+		class EdgeChecksum
+		{
+		private:
+			uint64_t h = 14695981039346656037ULL;
+
+			void mix(uint64_t x)
+			{
+				h = (h ^ x) * 1099511628211ULL;
 			}
 
-			#pragma omp critical(degree_reduction)
+		public:
+			void add(const Edge& e)
 			{
-				for (coord_t n = 0; n < (coord_t)deg.size(); n++)
-				{
-					deg[n] += degPrivate[n];
-				}
+				mix((uint64_t)e.verts[0]);
+				mix((uint64_t)e.verts[1]);
+			}
+
+			uint64_t value() const
+			{
+				return h;
 			}
+		};
+	}
+
+	void Network::writeIndex(ostream& out) const
+	{
+		// File structure
+		// index present flag (size_t)
+		// vertex count (size_t)
+		// edge count (size_t)
+		// edge checksum (uint64_t)
+		// size of the index in bytes (size_t)
+		// index (see VertexEdgeIndex::write)
+		size_t present = isIndexUpToDate() ? 1 : 0;
+		out.write((const char*)&present, sizeof(size_t));
+		if (!present)
+			return;
+
+		EdgeChecksum checksum;
+		for (const Edge& e : edges)
+			checksum.add(e);
+
+		size_t count = vertices.size();
+		out.write((const char*)&count, sizeof(size_t));
+		count = edges.size();
+		out.write((const char*)&count, sizeof(size_t));
+		uint64_t value = checksum.value();
+		out.write((const char*)&value, sizeof(uint64_t));
+		count = index.writtenSize();
+		out.write((const char*)&count, sizeof(size_t));
+
+		index.write(out);
+	}
+
+	void Network::readIndex(istream& in, uint64_t edgeChecksum)
+	{
+		size_t present = 0;
+		in.read((char*)&present, sizeof(size_t));
+		if (!in || !present)
+			return;
+
+		size_t vertexCount = 0;
+		size_t edgeCount = 0;
+		uint64_t checksum = 0;
+		size_t indexSize = 0;
+		in.read((char*)&vertexCount, sizeof(size_t));
+		in.read((char*)&edgeCount, sizeof(size_t));
+		in.read((char*)&checksum, sizeof(uint64_t));
+		in.read((char*)&indexSize, sizeof(size_t));
+		if (!in)
+			return;
+
+		if (vertexCount != vertices.size() || edgeCount != edges.size() || checksum != edgeChecksum)
+		{
+			// The index belongs to some other network. Skip it, the index of this network will be built when it is needed.
+			in.seekg(indexSize, ios_base::cur);
+			return;
+		}
+
+		VertexEdgeIndex tmp;
+		try
+		{
+			tmp.read(in);
+		}
+		catch (const ITLException&)
+		{
+			// The index file is corrupted. The index will be built when it is needed.
+			in.setstate(ios_base::failbit);
+			return;
+		}
+
+		if (tmp.vertexCount() == vertexCount && tmp.edgeCount() == edgeCount)
+		{
+			index = move(tmp);
+			indexValid = true;
 		}
 	}
 
-	void Network::inEdges(size_t n, vector<size_t>& edg) const
+	void Network::degree(vector<size_t>& deg, bool reportProgress) const
 	{
-		#pragma omp parallel for if(!omp_in_parallel() && edges.size() > PARALLELIZATION_THRESHOLD)
-		for (coord_t i = 0; i < (coord_t)edges.size(); i++)
+		const VertexEdgeIndex& ind = adjacency();
+
+		deg.resize(vertices.size());
+		for (size_t n = 0; n < vertices.size(); n++)
+			deg[n] = ind.degree(n);
+
+		for (size_t n = 0; n < incompleteEdges.size(); n++)
+		{
+			if (incompleteEdges[n].verts[0] >= 0)
+				deg[incompleteEdges[n].verts[0]]++;
+
+			if (incompleteEdges[n].verts[1] >= 0)
+				deg[incompleteEdges[n].verts[1]]++;
+		}
+	}
+
+	namespace
+	{
+		/**
+		Calls f(edge index) for each edge connected to vertex n.
+		Loops are stored twice in the index, but f is called only once for them.
+		*/
+		template<typename F> void forEachEdge(const VertexEdgeIndex& ind, size_t n, F f)
 		{
-			if (edges[i].verts[1] == n)
+			if (n >= ind.vertexCount())
+				return;
+
+			size_t prev = VertexEdgeIndex::NO_EDGE;
+			for (const size_t* p = ind.begin(n); p != ind.end(n); p++)
 			{
-				#pragma omp critical(inEdges)
-				{
-					edg.push_back(i);
-				}
+				if (*p != prev)
+					f(*p);
+				prev = *p;
 			}
 		}
+
+		/**
+		Gets the vertex at the other end of the edge.
+		*/
+		size_t otherEnd(const Edge& e, size_t n)
+		{
+			return (size_t)e.verts[0] == n ? (size_t)e.verts[1] : (size_t)e.verts[0];
+		}
+	}
+
+	void Network::inEdges(size_t n, vector<size_t>& edg) const
+	{
+		forEachEdge(adjacency(), n, [&](size_t i)
+			{
+				if ((size_t)edges[i].verts[1] == n)
+					edg.push_back(i);
+			});
 	}
 
 	void Network::outEdges(size_t n, vector<size_t>& edg) const
 	{
-		#pragma omp parallel for if(!omp_in_parallel() && edges.size() > PARALLELIZATION_THRESHOLD)
-		for (coord_t i = 0; i < (coord_t)edges.size(); i++)
-		{
-			if (edges[i].verts[0] == n)
+		forEachEdge(adjacency(), n, [&](size_t i)
 			{
-				#pragma omp critical(outEdges)
-				{
+				if ((size_t)edges[i].verts[0] == n)
 					edg.push_back(i);
-				}
-			}
-		}
+			});
 	}
 
 	void Network::inOutEdges(size_t n, vector<size_t>& inEdg, vector<size_t>& outEdg) const
 	{
-		#pragma omp parallel for if(!omp_in_parallel() && edges.size() > PARALLELIZATION_THRESHOLD)
-		for (coord_t i = 0; i < (coord_t)edges.size(); i++)
-		{
-			if (edges[i].verts[0] == n)
+		forEachEdge(adjacency(), n, [&](size_t i)
 			{
-				#pragma omp critical(outEdges)
-				{
+				if ((size_t)edges[i].verts[0] == n)
 					outEdg.push_back(i);
-				}
-			}
 
-			if (edges[i].verts[1] == n)
-			{
-				#pragma omp critical(inEdges)
-				{
+				if ((size_t)edges[i].verts[1] == n)
 					inEdg.push_back(i);
-				}
-			}
-		}
+			});
 	}
 
 	void Network::neighbours(size_t n, vector<size_t>& edgeIndices) const
 	{
-		#pragma omp parallel for if(!omp_in_parallel() && edges.size() > PARALLELIZATION_THRESHOLD)
-		for (coord_t i = 0; i < (coord_t)edges.size(); i++)
-		{
-			if (edges[i].verts[0] == n || edges[i].verts[1] == n)
+		forEachEdge(adjacency(), n, [&](size_t i)
 			{
-				#pragma omp critical(outEdges)
-				{
-					edgeIndices.push_back(i);
-				}
-			}
-		}
+				edgeIndices.push_back(i);
+			});
 	}
 
 	//const IncompleteVertex* Network::getIncompleteVertex(size_t vertexIndex) const
@@ -228,74 +425,64 @@ namespace itl2
 
 	void Network::clean(bool reportProgress)
 	{
-	    vector<Edge> newEdges;
+		// Compact the edge list in-place, and record new index of each edge so that the vertex to edge index can be updated.
+		vector<size_t> oldToNew(edges.size());
+		size_t count = 0;
 		for (size_t n = 0; n < edges.size(); n++)
 		{
 			if (edges[n] == Edge::INVALID)
 			{
-				//edges.erase(edges.begin() + n);
-				//n--;
+				oldToNew[n] = VertexEdgeIndex::NO_EDGE;
 			}
 			else
 			{
-			    newEdges.push_back(edges[n]);
+				if (count != n)
+					edges[count] = move(edges[n]);
+				oldToNew[n] = count;
+				count++;
 			}
 
 			showProgress(n, edges.size(), reportProgress);
 		}
-		
-		edges = newEdges;
-	}
-
-	size_t find(size_t ind, const vector<tuple<size_t, EdgeMeasurements> >& list)
-	{
-		for (size_t n = 0; n < list.size(); n++)
-		{
-			if (get<0>(list[n]) == ind)
-				return n;
-		}
 
-		throw ITLException("Impossible situation: Unable to find correct index from neighbour list.");
-	}
+		edges.resize(count);
 
-	void remove(size_t ind, vector<tuple<size_t, EdgeMeasurements> >& list)
-	{
-		size_t n = find(ind, list);
-		list.erase(list.begin() + n);
+		if (indexValid && index.edgeCount() == oldToNew.size())
+			index.removeEdges(oldToNew, count);
+		else
+			indexValid = false;
 	}
 
 	void Network::markStraightThroughNodes(bool reportProgress)
 	{
-		// For each node, list of [neighbour node index, edge properties]
-		vector<vector<tuple<size_t, EdgeMeasurements> > > net(vertices.size());
+		// The edges are combined in-place, and the vertex to edge index is updated accordingly:
+		// the edge list of a removed node is cleared, and the removed edge is replaced by the combined edge in the
+		// edge list of the other end node. The lengths of the edge lists do not change.
+		cout << "Build vertex to edge index..." << endl;
+		adjacency();
 
-		// Populate net list from edges
-		cout << "Convert to neighbour list format..." << endl;
-		for (size_t n = 0; n < edges.size(); n++)
-		{
-			const Edge& edge = edges[n];
-			net[edge.verts[0]].push_back(make_tuple(edge.verts[1], edge.properties));
-			net[edge.verts[1]].push_back(make_tuple(edge.verts[0], edge.properties));
-			showProgress(n, edges.size(), reportProgress);
-		}
-		edges.clear();
+		// Indicates edges that have been removed or already converted to the new edge list.
+		vector<bool> done(edges.size(), false);
 
 		// Find nodes with exactly 2 neighbours
 		cout << "Erase connections to nodes with 2 neighbours..." << endl;
-		for (size_t n = 0; n < net.size(); n++)
+		for (size_t n = 0; n < vertices.size(); n++)
 		{
-			if (net[n].size() == 2)
+			if (index.degree(n) == 2)
 			{
 				// Connect a to b by replacing
-				// - n by b in a:s neighbour list and
-				// - n by a in b:s neighbour list.
-				size_t a = get<0>(net[n][0]);
-				size_t b = get<0>(net[n][1]);
+				// - edge n-a by a-b and
+				// - edge n-b by a-b in b:s edge list.
+				size_t* nEdges = index.begin(n);
+				size_t e1 = nEdges[0];
+				size_t e2 = nEdges[1];
+				size_t a = otherEnd(edges[e1], n);
+				size_t b = otherEnd(edges[e2], n);
 
 				if (a != n && b != n) // Don't adjust connections if any of the neighbours is this node, i.e. there is a loop.
 				{
-					EdgeMeasurements p1 = get<1>(net[n][0]);
-					EdgeMeasurements p2 = get<1>(net[n][1]);
+					EdgeMeasurements& p1 = edges[e1].properties;
+					EdgeMeasurements& p2 = edges[e2].properties;
 
 					EdgeMeasurements combined;
 					combined.pointCount = p1.pointCount + p2.pointCount;
@@ -310,8 +497,8 @@ namespace itl2
 					Vec3f endVertex = vertices[b];
 
 					vector<vector<Vec3sc>> pointLists;
-					pointLists.push_back(p1.edgePoints);
-					pointLists.push_back(p2.edgePoints);
+					pointLists.push_back(std::move(p1.edgePoints));
+					pointLists.push_back(std::move(p2.edgePoints));
 					Vec3f currentEnd = startVertex;
 					while (pointLists.size() > 0)
 					{
@@ -387,36 +574,46 @@ namespace itl2
 							combined.area = p2.area;
 					}
 
-					size_t nInd;
-					nInd = find(n, net[a]);
-					net[a][nInd] = make_tuple(b, combined);
-					nInd = find(n, net[b]);
-					net[b][nInd] = make_tuple(a, combined);
+					edges[e1] = Edge(a, b, std::move(combined));
+					done[e2] = true;
 
-					net[n].clear();
+					size_t* bEnd = index.end(b);
+					size_t* p = std::find(index.begin(b), bEnd, e2);
+					if (p == bEnd)
+						throw ITLException("Impossible situation: Unable to find correct index from edge list.");
+					*p = e1;
+
+					nEdges[0] = VertexEdgeIndex::NO_EDGE;
+					nEdges[1] = VertexEdgeIndex::NO_EDGE;
 
 					// The node should be removed (and it does not have any connections), so mark it as invalid.
 					vertices[n] = INVALID_VERTEX;
 				}
 			}
-			showProgress(n, net.size(), reportProgress);
+			showProgress(n, vertices.size(), reportProgress);
 		}
 
-		// Convert network back to edge list format
+		// Convert network back to edge list format.
+		// Edges are ordered by their first node, and the first node is the one with the smaller index.
 		cout << "Convert to edge list format..." << endl;
-		for (size_t n = 0; n < net.size(); n++)
+		vector<Edge> newEdges;
+		newEdges.reserve(edges.size());
+		for (size_t n = 0; n < vertices.size(); n++)
 		{
-			for (size_t m = 0; m < net[n].size(); m++)
+			for (const size_t* p = index.begin(n); p != index.end(n); p++)
 			{
-				size_t b = get<0>(net[n][m]);
-				EdgeMeasurements p = get<1>(net[n][m]);
-				edges.push_back(Edge(n, b, p));
-
-				// Remove the other item corresponding to this edge.
-				remove(n, net[b]);
+				size_t e = *p;
+				if (e != VertexEdgeIndex::NO_EDGE && !done[e])
+				{
+					newEdges.push_back(Edge(n, otherEnd(edges[e], n), std::move(edges[e].properties)));
+					done[e] = true;
+				}
 			}
-			showProgress(n, net.size(), reportProgress);
+			showProgress(n, vertices.size(), reportProgress);
 		}
+
+		edges = std::move(newEdges);
+		indexValid = false;
 	}
 
 	void Network::removeStraightThroughNodes(bool reportProgress)
@@ -457,6 +654,7 @@ namespace itl2
 		cout << "Remove nodes..." << endl;
 		vector<Vec3f> newNodes;
 		vector<size_t> oldToNewIndex(vertices.size());
+		vector<bool> keep(vertices.size(), false);
 		for (size_t n = 0; n < vertices.size(); n++)
 		{
 			// remove if deg[n] <= 0 && (isnan(vertices[n].x) || isnan(vertices[n].y) || isnan(vertices[n].z))
@@ -465,6 +663,7 @@ namespace itl2
 			{
 				newNodes.push_back(vertices[n]);
 				oldToNewIndex[n] = newNodes.size() - 1;
+				keep[n] = true;
 			}
 
 			showProgress(n, vertices.size(), reportProgress);
@@ -474,6 +673,9 @@ namespace itl2
 
 		vertices = newNodes;
 
+		// The removed nodes have no edges, so the edge lists in the index do not change.
+		index.removeVertices(keep);
+
 		cout << "Removed " << removedCount << " nodes." << endl;
 
 		cout << "Update edges..." << endl;
@@ -684,6 +886,7 @@ namespace itl2
 		vertices.clear();
 		edges.clear();
 		incompleteVertices.clear();
+		indexValid = false;
 
 		vertices.resize(verts.height());
 		#pragma omp parallel for if(!omp_in_parallel())
@@ -881,6 +1084,18 @@ namespace itl2
 				out.write((const char*)&p.components[0], sizeof(Vec3sc));
 			}
 		}
+
+		// Vertex to edge index is written to a separate file so that the network file format does not change.
+		// There is one entry in the index file for each network in the network file.
+		string indexFile = indexFilename(filename);
+		ofstream indexOut(indexFile, mode);
+		if (!indexOut.is_open())
+			indexOut.open(indexFile, ios_base::out | ios_base::trunc | ios_base::binary);
+
+		if (!indexOut)
+			throw ITLException(string("Unable to open file ") + indexFile);
+
+		writeIndex(indexOut);
 	}
 
 	Edge readEdge(ifstream& in)
@@ -919,6 +1134,9 @@ namespace itl2
 		if (!in)
 			throw ITLException(string("Unable to open file ") + filename);
 
+		// The index file is optional, e.g. files written by older versions do not have it.
+		ifstream indexIn(indexFilename(filename), ios_base::in | ios_base::binary);
+
 		do
 		{
 			Network net;
@@ -940,9 +1158,11 @@ namespace itl2
 
 			in.read((char*)&count, sizeof(size_t));
 			net.edges.reserve(count);
+			EdgeChecksum checksum;
 			for (size_t n = 0; n < count; n++)
 			{
 				net.edges.push_back(readEdge(in));
+				checksum.add(net.edges.back());
 			}
 
 			in.read((char*)&count, sizeof(size_t));
@@ -988,6 +1208,9 @@ namespace itl2
 				net.incompleteEdges.push_back(v);
 			}
 
+			if (indexIn)
+				net.readIndex(indexIn, checksum.value());
+
 			nets.push_back(net);
 		} while (!in.eof());
 		
@@ -1211,5 +1434,117 @@ namespace itl2
 				testAssert(net.edges[2].verts == Vec2c(1, 3), "edge 2");
 			}
 		}
+
+		void vertexEdgeIndex()
+		{
+			// Random network with loops and multiple edges between the same vertices.
+			Network net;
+			const size_t NODE_COUNT = 2000;
+			for (size_t n = 0; n < NODE_COUNT; n++)
+				net.vertices.push_back(Vec3f((float32_t)n, 0, 0));
+
+			std::mt19937 gen(17);
+			std::uniform_int_distribution<size_t> dist(0, NODE_COUNT - 1);
+			std::uniform_real_distribution<float32_t> lengthDist(1, 10);
+			for (size_t n = 0; n < 3000; n++)
+			{
+				size_t start = dist(gen);
+				size_t end = n % 100 == 0 ? start : dist(gen);
+				net.edges.push_back(Edge(start, end, EdgeMeasurements(2, lengthDist(gen), 1)));
+			}
+
+			// Compare queries to a full scan of the edges.
+			vector<size_t> deg;
+			net.degree(deg, false);
+			bool ok = true;
+			for (size_t n = 0; n < NODE_COUNT; n++)
+			{
+				vector<size_t> in, out, nb, in2, out2;
+				vector<size_t> expIn, expOut, expNb;
+				size_t expDeg = 0;
+				for (size_t i = 0; i < net.edges.size(); i++)
+				{
+					bool isStart = (size_t)net.edges[i].verts[0] == n;
+					bool isEnd = (size_t)net.edges[i].verts[1] == n;
+					if (isStart)
+						expOut.push_back(i);
+					if (isEnd)
+						expIn.push_back(i);
+					if (isStart || isEnd)
+						expNb.push_back(i);
+					expDeg += (isStart ? 1 : 0) + (isEnd ? 1 : 0);
+				}
+
+				net.inEdges(n, in);
+				net.outEdges(n, out);
+				net.neighbours(n, nb);
+				net.inOutEdges(n, in2, out2);
+				if (in != expIn || out != expOut || nb != expNb || in2 != expIn || out2 != expOut || deg[n] != expDeg)
+					ok = false;
+			}
+			testAssert(ok, "vertex to edge index queries");
+
+			// The index is maintained in pruning.
+			net.prune(3.0f, false, false, false);
+			VertexEdgeIndex fresh;
+			fresh.build(net.vertices.size(), net.edges);
+			testAssert(net.adjacency() == fresh, "index after pruning equals rebuilt index");
+
+			// Removal of straight-through nodes retains total length, and only nodes with loops have degree 2 afterwards.
+			double totalLength = 0;
+			for (const Edge& e : net.edges)
+				totalLength += e.properties.length;
+
+			net.removeStraightThroughNodes(false);
+
+			double newTotalLength = 0;
+			for (const Edge& e : net.edges)
+				newTotalLength += e.properties.length;
+			testAssert(NumberUtils<double>::equals(totalLength, newTotalLength, 1e-3), "total length after removal of straight-through nodes");
+
+			deg.clear();
+			net.degree(deg, false);
+			ok = true;
+			for (size_t n = 0; n < net.vertices.size(); n++)
+			{
+				if (deg[n] == 2)
+				{
+					vector<size_t> nb;
+					net.neighbours(n, nb);
+					if (nb.size() != 1)
+						ok = false;
+				}
+			}
+			testAssert(ok, "straight-through nodes remain");
+
+			// Binary I/O, the index is stored with the network.
+			testAssert(net.isIndexUpToDate(), "index is up to date before write");
+			net.write("./network/index_test.dat", false);
+			net.write("./network/index_test.dat", true);
+			vector<Network> nets;
+			Network::read("./network/index_test.dat", nets);
+			testAssert(nets.size() == 2, "count of networks read from file");
+			for (const Network& net2 : nets)
+			{
+				testAssert(net2.isIndexUpToDate(), "index read from file");
+				testAssert(net2.adjacency() == net.adjacency(), "index read from file equals original");
+			}
+
+			// Index of different network is not accepted.
+			Network net3 = net;
+			coord_t v = 0;
+			while (v == net3.edges[0].verts[0] || v == net3.edges[0].verts[1])
+				v++;
+			net3.edges[0].verts[0] = v;
+			net3.invalidateIndex();
+			net3.adjacency();
+			net3.write("./network/index_test2.dat", false);
+			copyFile(Network::indexFilename("./network/index_test2.dat"), Network::indexFilename("./network/index_test.dat"), false);
+			nets.clear();
+			Network::read("./network/index_test.dat", nets);
+			testAssert(nets.size() == 2, "count of networks read from file with invalid index");
+			testAssert(!nets[0].isIndexUpToDate(), "invalid index read from file");
+			testAssert(nets[0].adjacency() == net.adjacency(), "index rebuilt after invalid index read from file");
+		}
 	}
 }
@@ -236,10 +236,169 @@ namespace itl2
 		}
 	};
 
+	/**
+	Compressed (CSR) index from vertices to the edges connected to them.
+	Indices of edges connected to vertex v are stored in increasing order in positions [offset(v), offset(v + 1)[ of a single array.
+	Loops that begin and end in the same vertex are stored twice, so the count of entries of a vertex equals its degree.
+	*/
+	class VertexEdgeIndex
+	{
+	private:
+		/**
+		Start position of the edge list of each vertex. Contains vertex count + 1 items.
+		*/
+		std::vector<size_t> offsets;
+
+		/**
+		Edge lists of all vertices.
+		*/
+		std::vector<size_t> edgeIndices;
+
+		/**
+		Count of edges in the network for which the index was built.
+		*/
+		size_t edgeCnt;
+
+	public:
+
+		/**
+		Value used to mark removed entries in the edge lists.
+		*/
+		static const size_t NO_EDGE;
+
+		VertexEdgeIndex() :
+			edgeCnt(0)
+		{
+		}
+
+		/**
+		Builds the index for the given vertex count and edges.
+		*/
+		void build(size_t vertexCount, const std::vector<Edge>& edges);
+
+		/**
+		Gets the count of vertices in the index.
+		*/
+		size_t vertexCount() const
+		{
+			return offsets.size() > 0 ? offsets.size() - 1 : 0;
+		}
+
+		/**
+		Gets the count of edges in the network for which the index was built.
+		*/
+		size_t edgeCount() const
+		{
+			return edgeCnt;
+		}
+
+		/**
+		Gets the count of entries in the edge list of vertex v.
+		*/
+		size_t degree(size_t v) const
+		{
+			return offsets[v + 1] - offsets[v];
+		}
+
+		/**
+		Gets pointer to the first entry of the edge list of vertex v.
+		*/
+		const size_t* begin(size_t v) const
+		{
+			return edgeIndices.data() + offsets[v];
+		}
+
+		/**
+		Gets pointer to one past the last entry of the edge list of vertex v.
+		*/
+		const size_t* end(size_t v) const
+		{
+			return edgeIndices.data() + offsets[v + 1];
+		}
+
+		/**
+		Gets pointer to the first entry of the edge list of vertex v.
+		The entries can be changed, e.g. to NO_EDGE, but the length of the list cannot.
+		*/
+		size_t* begin(size_t v)
+		{
+			return edgeIndices.data() + offsets[v];
+		}
+
+		/**
+		Gets pointer to one past the last entry of the edge list of vertex v.
+		*/
+		size_t* end(size_t v)
+		{
+			return edgeIndices.data() + offsets[v + 1];
+		}
+
+		/**
+		Updates the index after edges have been removed and the remaining edges re-numbered.
+		@param oldToNewEdge New index of each old edge, or NO_EDGE if the edge has been removed.
+		@param newEdgeCount Count of edges after the removal.
+		*/
+		void removeEdges(const std::vector<size_t>& oldToNewEdge, size_t newEdgeCount);
+
+		/**
+		Updates the index after vertices have been removed.
+		Only vertices that have no edges can be removed.
+		@param keep Flag for each old vertex, indicating whether the vertex is retained.
+		*/
+		void removeVertices(const std::vector<bool>& keep);
+
+		/**
+		Writes the index to the given stream.
+		*/
+		void write(std::ostream& out) const;
+
+		/**
+		Gets the count of bytes that write() writes.
+		*/
+		size_t writtenSize() const
+		{
+			return (3 + std::max<size_t>(offsets.size(), 1) + edgeIndices.size()) * sizeof(size_t);
+		}
+
+		/**
+		Reads the index from the given stream.
+		*/
+		void read(std::istream& in);
+
+		bool operator==(const VertexEdgeIndex& r) const
+		{
+			return edgeCnt == r.edgeCnt && offsets == r.offsets && edgeIndices == r.edgeIndices;
+		}
+	};
+
 	class Network
 	{
 	private:
 
+		/**
+		Vertex to edge index. Built when it is needed for the first time, and then maintained or rebuilt by
+		the member functions that modify the network.
+		*/
+		mutable VertexEdgeIndex index;
+
+		/**
+		Indicates if the index is up to date.
+		*/
+		mutable bool indexValid = false;
+
+		/**
+		Writes the vertex to edge index of the network to the given stream, if the index is up to date.
+		The index is preceded by vertex count, edge count and checksum of the edges so that it can be matched to the network when it is read.
+		*/
+		void writeIndex(std::ostream& out) const;
+
+		/**
+		Reads vertex to edge index written by writeIndex from the given stream.
+		The index is used only if the vertex count, edge count and edge checksum stored with it match this network.
+		@param edgeChecksum Checksum of the edges of this network.
+		*/
+		void readIndex(std::istream& in, uint64_t edgeChecksum);
+
 		/**
 		Disconnects node n but does not call clean().
 		The network is not in clean state before clean() is called.
@@ -282,6 +441,39 @@ namespace itl2
 		std::vector<IncompleteEdge> incompleteEdges;
 
 
+		/**
+		Gets the vertex to edge index of the network, and builds it if it is not up to date.
+		The index does not contain incomplete edges.
+		Changes made through the member functions of this class are tracked automatically. If vertices or edges
+		lists are modified directly, call invalidateIndex() afterwards, unless only new items have been added to the lists.
+		The index is built lazily, so call this function before querying the network from multiple threads.
+		*/
+		const VertexEdgeIndex& adjacency() const;
+
+		/**
+		Marks the vertex to edge index out of date so that it is rebuilt when it is needed the next time.
+		*/
+		void invalidateIndex()
+		{
+			indexValid = false;
+		}
+
+		/**
+		Tests if the vertex to edge index is up to date, i.e. if it can be used without building it.
+		*/
+		bool isIndexUpToDate() const
+		{
+			return indexValid && index.vertexCount() == vertices.size() && index.edgeCount() == edges.size();
+		}
+
+		/**
+		Gets the name of the file where write() stores the vertex to edge indices of the networks written to the given file.
+		*/
+		static string indexFilename(const string& filename)
+		{
+			return filename + ".index";
+		}
+
 		/**
 		Calculate degree of each node and place the values to given list.
 		Degree of a node is number of edges connected to it.
@@ -309,6 +501,8 @@ namespace itl2
 		*/
 		void neighbours(size_t n, std::vector<size_t>& edgeIndices) const;
 
+		// NOTE: The edge query functions above use the vertex to edge index and add the edge indices in increasing order.
+
 		///**
 		//Return incomplete vertex having specified index.
 		//*/
@@ -390,11 +584,13 @@ namespace itl2
 
 		/**
 		Write network to file.
+		If the vertex to edge index of the network is up to date, it is written to file indexFilename(filename) so that it does not need to be built again when the network is read.
 		*/
 		void write(const string& filename, bool append) const;
 
 		/**
 		Reads one or more networks from a file and places them to given list.
+		Vertex to edge indices are read from file indexFilename(filename) if it exists and the indices match the networks.
 		*/
 		static void read(const string& filename, std::vector<Network>& nets);
 
@@ -440,5 +636,6 @@ namespace itl2
 		void disconnectStraightThroughPerformance();
 		void networkio();
 		void pruning();
+		void vertexEdgeIndex();
 	}
 }
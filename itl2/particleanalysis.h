@@ -11,6 +11,7 @@
 #include "math/vec3.h"
 
 #include "indexforest.h"
+#include "connectedcomponents.h"
 #include "math/aabox.h"
 #include "misc.h"
 
@@ -73,7 +74,7 @@ namespace itl2
 	/**
 	Label all particles with distinct colors beginning from one.
 	It is assumed that background pixels are set to zero.
-	Uses simple flood fill algorithm.
+	The particles are labeled in the order they are encountered when the image is scanned in z, y, x order.
 	If the pixel data type does not support large enough values to label all particles, an exception is thrown.
 	@param image Image containing the particles.
 	@param particleColor Color of particles. This color will be skipped in labeling, and regions having some other color than this are not labeled. Pass zero to label particles of any color.
@@ -82,53 +83,36 @@ namespace itl2
 	*/
 	template<typename pixel_t> pixel_t labelParticles(Image<pixel_t>& image, pixel_t particleColor = 0, pixel_t firstLabelValue = 1, Connectivity connectivity = Connectivity::NearestNeighbours, bool showProgress = true)
 	{
-		size_t counter = 0;
-
-		// Handle "color all particles" case first
+		ComponentRuns runs;
 		if (particleColor == 0)
 		{
+			findComponents(image, [](pixel_t p) { return p != 0; }, connectivity, runs, true, showProgress);
 			particleColor = std::numeric_limits<pixel_t>::max();
-
-			#pragma omp parallel for if (image.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
-			for (coord_t n = 0; n < image.pixelCount(); n++)
-			{
-				if (image(n) != 0)
-					image(n) = particleColor;
-			}
 		}
-
-		pixel_t particleNumber = firstLabelValue;
-		if(particleNumber == particleColor)
-			particleNumber++;
-
-		for (coord_t z = 0; z < image.depth(); z++)
+		else
 		{
-			for (coord_t y = 0; y < image.height(); y++)
-			{
-				for (coord_t x = 0; x < image.width(); x++)
-				{
-					pixel_t pixel = image(x, y, z);
-
-					if (pixel == particleColor)
-					{
-						if (particleNumber >= std::numeric_limits<pixel_t>::max() - 2)
-							throw ITLException("Unable to label because there are not enough distinct pixel values available. Consider converting input image to higher bitdepth (e.g. uint8 to uint16).");
-
-						floodfill(image, Vec3c(x, y, z), particleNumber, particleNumber, connectivity);
+			findComponents(image, [=](pixel_t p) { return p == particleColor; }, connectivity, runs, true, showProgress);
+		}
 
-						particleNumber++;
-						if (particleNumber == particleColor)
-							particleNumber++;
-					}
+		// Label values are consecutive, but particle color is skipped.
+		double first = (double)firstLabelValue;
+		double skipped = (double)particleColor;
+		auto label = [=](size_t c)
+		{
+			double l = first + (double)c;
+			if (first <= skipped && l >= skipped)
+				l++;
+			return l;
+		};
 
-					
-				}
+		if (runs.componentCount > 0 && label(runs.componentCount - 1) >= (double)std::numeric_limits<pixel_t>::max() - 2)
+			throw ITLException("Unable to label because there are not enough distinct pixel values available. Consider converting input image to higher bitdepth (e.g. uint8 to uint16).");
 
-				showThreadProgress(counter, image.depth() * image.height(), showProgress);
-			}
-		}
+		runs.fill(image, [&](size_t c) { return (pixel_t)label(c); }, false);
 
-		return particleNumber - 1;
+		if (runs.componentCount <= 0)
+			return (pixel_t)(firstLabelValue - 1);
+		return (pixel_t)label(runs.componentCount - 1);
 	}
 
     
@@ -216,17 +200,21 @@ namespace itl2
 		@param image The image containing the particles.
 		@param analyzers List of analyzers to apply to the particles.
 		@param results List for result matrix.
+		@param pIncompleteParticles Pointer to array that will be filled with points of particles that touch the z edges of the image. If the analyzers support accumulation, only the points on the z edges are stored.
+		@param pIncompleteStates Pointer to array that will be filled with accumulator states of the particles in pIncompleteParticles, if the analyzers support accumulation.
 		@param largeEdgePoints Pointer to array that will be filled with coordinates of image edge points belonging to large particle.
 		@param volumeLimit Only include particles smaller than this value in the results.
 		@param fillColor The analyzed particles will be colored with this color.
 		@param largeColor Particles that are skipped because their size is larger than volumeLimit are colored with this color.
 		@param backgroundColor Color of background.
 		*/
-		template<typename pixel_t> void analyzeParticlesSingleBlock(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >* pIncompleteParticles, std::vector<std::vector<Vec3sc> >* pLargeEdgePoints, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, size_t& counter, size_t counterMax, const Vec3sc& coordinateShift)
+		template<typename pixel_t> void analyzeParticlesSingleBlock(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >* pIncompleteParticles, std::vector<std::vector<double> >* pIncompleteStates, std::vector<std::vector<Vec3sc> >* pLargeEdgePoints, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, size_t& counter, size_t counterMax, const Vec3sc& coordinateShift)
 		{
 			std::vector<Vec3sc> particlePoints;
 			particlePoints.reserve(1000);
 
+			bool accumulate = pIncompleteStates && analyzers.supportsAccumulation();
+
 			for (coord_t z = 0; z < image.depth(); z++)
 			{
 				for (coord_t y = 0; y < image.height(); y++)
@@ -272,8 +260,31 @@ namespace itl2
 
 								if (isIncomplete)
 								{
-									// The particle touches image edge, store it as incomplete point set.
-									pIncompleteParticles->push_back(particlePoints);
+									if (accumulate)
+									{
+										// The particle touches image edge. Store its accumulator state and the points
+										// that are needed to find its neighbours in the other blocks.
+										std::vector<double> state;
+										analyzers.init(state);
+										std::vector<Vec3sc> edgePoints;
+										int32_t minZ = coordinateShift.z;
+										int32_t maxZ = coordinateShift.z + (int32_t)image.depth() - 1;
+										for (size_t n = 0; n < particlePoints.size(); n++)
+										{
+											const Vec3sc& p = particlePoints[n];
+											analyzers.add(state, p);
+											if (p.z == minZ || p.z == maxZ)
+												edgePoints.push_back(p);
+										}
+
+										pIncompleteParticles->push_back(edgePoints);
+										pIncompleteStates->push_back(state);
+									}
+									else
+									{
+										// The particle touches image edge, store it as incomplete point set.
+										pIncompleteParticles->push_back(particlePoints);
+									}
 								}
 								else
 								{
@@ -331,6 +342,71 @@ namespace itl2
 		}
 
 
+		/**
+		Perform particle analysis using connected component labeling and accumulating analyzers.
+		The particles are not flood filled, so the memory usage is proportional to the count of pixel runs and particles instead of
+		the size of the particles. All the analyzers must support accumulation.
+		Regions colored with fill color or large color are skipped. Analyzed particles are colored with fill color.
+		@param image The image containing the particles.
+		@param analyzers List of analyzers to apply to the particles.
+		@param results The results are added to this table.
+		@param fillColor The analyzed particles will be colored with this color.
+		@param largeColor Regions having this color are skipped.
+		*/
+		template<typename pixel_t> void analyzeParticlesRuns(Image<pixel_t>& image, const AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, Connectivity connectivity, pixel_t fillColor, pixel_t largeColor)
+		{
+			ComponentRuns runs;
+			findComponents(image, [=](pixel_t p) { return p != 0 && p != fillColor && p != largeColor; }, connectivity, runs);
+
+			// Each thread accumulates the particles in a contiguous range of rows, and the states are merged afterwards.
+			std::vector<std::vector<double> > states(runs.componentCount);
+			coord_t rowCount = image.height() * image.depth();
+			#pragma omp parallel if(!omp_in_parallel() && runs.runs.size() > PARALLELIZATION_THRESHOLD)
+			{
+				std::unordered_map<size_t, std::vector<double> > localStates;
+
+				#pragma omp for schedule(static)
+				for (coord_t row = 0; row < rowCount; row++)
+				{
+					int32_t y = (int32_t)(row % image.height());
+					int32_t z = (int32_t)(row / image.height());
+					for (size_t i = runs.rowStart[row]; i < runs.rowStart[row + 1]; i++)
+					{
+						std::vector<double>& state = localStates[runs.component[i]];
+						if (state.size() <= 0)
+							analyzers.init(state);
+
+						for (int32_t x = runs.runs[i].x0; x <= runs.runs[i].x1; x++)
+							analyzers.add(state, Vec3sc(x, y, z));
+					}
+				}
+
+				#pragma omp critical(analyzeParticlesRunsMerge)
+				{
+					for (auto& item : localStates)
+					{
+						std::vector<double>& state = states[item.first];
+						if (state.size() <= 0)
+							state = std::move(item.second);
+						else
+							analyzers.merge(state, item.second);
+					}
+				}
+			}
+
+			size_t first = results.size();
+			results.resize(first + runs.componentCount);
+			#pragma omp parallel for if(!omp_in_parallel() && runs.componentCount > 1000)
+			for (coord_t n = 0; n < (coord_t)runs.componentCount; n++)
+			{
+				analyzers.finalize(states[n], results[first + n]);
+				states[n].clear();
+				states[n].shrink_to_fit();
+			}
+
+			runs.fill(image, [=](size_t c) { return fillColor; }, false);
+		}
+
 		/**
 		Perform particle analysis in blocks, one thread per block.
 		Has no restrictions on particle count. (uses flood fill algorithm)
@@ -341,11 +417,13 @@ namespace itl2
 		@param analyzers List of analyzers to apply to the particles.
 		@param results List for result matrix.
 		@param pLargeEdgePoints Pointer to array that will be filled with coordinates of image edge points belonging to large particle.
+		@param incompleteParticles Array that will be filled with points of particles that touch calculation block edges. If the analyzers support accumulation, only the points on the block edges are stored.
+		@param incompleteStates Array that will be filled with accumulator states of the incomplete particles if the analyzers support accumulation.
 		@param volumeLimit Only include particles smaller than this value in the results.
 		@param fillColor The analyzed particles will be colored with this color.
 		@param largeColor Particles that are skipped because their size is larger than volumeLimit are colored with this color.
 		*/
-		template<typename pixel_t> void analyzeParticlesBlocks(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, const Vec3sc& origin, std::vector<coord_t>& blockEdgeZ)
+		template<typename pixel_t> void analyzeParticlesBlocks(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, std::vector<std::vector<double> >& incompleteStates, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, const Vec3sc& origin, std::vector<coord_t>& blockEdgeZ)
 		{
 			size_t counter = 0;
 
@@ -410,7 +488,8 @@ namespace itl2
 					Results blockResults;
 					std::vector<std::vector<Vec3sc> > blockLargeEdgePoints;
 					std::vector<std::vector<Vec3sc> > blockIncompleteParticles;
-					internals::analyzeParticlesSingleBlock(block, analyzers, blockResults, &blockIncompleteParticles, &blockLargeEdgePoints, connectivity, volumeLimit, fillColor, largeColor, counter, image.depth() * image.height(), origin + Vec3sc(0, 0, (int32_t)minZ));
+					std::vector<std::vector<double> > blockIncompleteStates;
+					internals::analyzeParticlesSingleBlock(block, analyzers, blockResults, &blockIncompleteParticles, &blockIncompleteStates, &blockLargeEdgePoints, connectivity, volumeLimit, fillColor, largeColor, counter, image.depth() * image.height(), origin + Vec3sc(0, 0, (int32_t)minZ));
 
 					//raw::writed(block, "./particleanalysis/block");
 					//raw::writed(image, "./particleanalysis/image");
@@ -420,6 +499,7 @@ namespace itl2
 						results.insert(results.end(), blockResults.begin(), blockResults.end());
 						largeEdgePoints.insert(largeEdgePoints.end(), blockLargeEdgePoints.begin(), blockLargeEdgePoints.end());
 						incompleteParticles.insert(incompleteParticles.end(), blockIncompleteParticles.begin(), blockIncompleteParticles.end());
+						incompleteStates.insert(incompleteStates.end(), blockIncompleteStates.begin(), blockIncompleteStates.end());
 						blockEdgeZ.push_back(minZ + origin.z);
 						blockEdgeZ.push_back(maxZ + origin.z);
 					}
@@ -604,11 +684,13 @@ namespace itl2
 
 		/**
 		Combines incomplete particles and analyzes them.
-		Can be called multiple times, adding more particles to the results, largeEdgePoints, and incompleteParticles arrays.
+		Can be called multiple times, adding more particles to the results, largeEdgePoints, incompleteParticles, and incompleteStates arrays.
 		The added particles must not be from already processed blocks.
+		If the analyzers support accumulation, incompleteParticles contains only the block edge points of each particle, and incompleteStates
+		contains the corresponding accumulator states. Otherwise incompleteParticles contains all points of each particle, and incompleteStates is not used.
 		@param isSubBlock Set to false if this is the final call to this function. This ensures that also particles that touch z-block edges are included in the results table.
 		*/
-		template<typename pixel_t> void combineParticleAnalysisResults(const AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, size_t volumeLimit, Connectivity connectivity, std::vector<coord_t>& blockEdgeZ, bool isSubBlock)
+		template<typename pixel_t> void combineParticleAnalysisResults(const AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, std::vector<std::vector<double> >& incompleteStates, size_t volumeLimit, Connectivity connectivity, std::vector<coord_t>& blockEdgeZ, bool isSubBlock)
 		{
 			/*
 			At end of this function:
@@ -624,6 +706,10 @@ namespace itl2
 
 			coord_t maxZ = max(blockEdgeZ);
 
+			bool accumulate = analyzers.supportsAccumulation();
+			if (accumulate && incompleteStates.size() != incompleteParticles.size())
+				throw ITLException("Accumulator states of incomplete particles are missing.");
+
 			std::cout << "Processing " << incompleteParticles.size() << " particles on block edge boundaries..." << std::endl;
 
 			// Create list of edge points for each incomplete particle
@@ -670,6 +756,13 @@ namespace itl2
 						{
 							concatAndShrink(incompleteParticles[base], incompleteParticles[n]);
 							concatAndShrink(edgePoints[base], edgePoints[n]);
+
+							if (accumulate)
+							{
+								analyzers.merge(incompleteStates[base], incompleteStates[n]);
+								incompleteStates[n].clear();
+								incompleteStates[n].shrink_to_fit();
+							}
 						}
 						else
 						{
@@ -700,7 +793,11 @@ namespace itl2
 					// big particle not in incompleteParticles list)
 					for (coord_t n = 0; n < (coord_t)incompleteParticles.size(); n++)
 					{
-						if (incompleteParticles[n].size() >= volumeLimit)
+						size_t volume = incompleteParticles[n].size();
+						if (accumulate && incompleteStates[n].size() > 0)
+							volume = analyzers.pointCount(incompleteStates[n]);
+
+						if (volume >= volumeLimit)
 							isBig[n] = true;
 					}
 
@@ -721,6 +818,7 @@ namespace itl2
 
 			std::vector<std::vector<Vec3sc> > remainingLargeEdgePoints;
 			std::vector<std::vector<Vec3sc> > remainingIncompleteParticles;
+			std::vector<std::vector<double> > remainingIncompleteStates;
 			std::vector<coord_t> remainingBlockEdgeZ;
 
 			remainingBlockEdgeZ.push_back(0);
@@ -741,9 +839,28 @@ namespace itl2
 						if (isSubBlock && isOnZEdge(points, maxZ))
 						{
 							// The particle is incomplete.
-							#pragma omp critical(remainingIncompleteParticlesInsert)
+							if (accumulate)
+							{
+								// Only the points on the remaining block edges are needed in further combination steps.
+								std::vector<Vec3sc> remainingPoints;
+								for (const Vec3sc& p : points)
+								{
+									if (p.z == 0 || p.z == maxZ)
+										remainingPoints.push_back(p);
+								}
+
+								#pragma omp critical(remainingIncompleteParticlesInsert)
+								{
+									remainingIncompleteParticles.push_back(remainingPoints);
+									remainingIncompleteStates.push_back(incompleteStates[n]);
+								}
+							}
+							else
 							{
-								remainingIncompleteParticles.push_back(points);
+								#pragma omp critical(remainingIncompleteParticlesInsert)
+								{
+									remainingIncompleteParticles.push_back(points);
+								}
 							}
 						}
 						else
@@ -753,7 +870,10 @@ namespace itl2
 							// do not overlap so there are no duplicate points in the point list
 							//Vec3c point = points[0];
 							std::vector<double> resultLine;
-							analyzers.analyze(points, resultLine);
+							if (accumulate)
+								analyzers.finalize(incompleteStates[n], resultLine);
+							else
+								analyzers.analyze(points, resultLine);
 
 							#pragma omp critical(resultsInsert)
 							{
@@ -795,11 +915,13 @@ namespace itl2
 
 				largeEdgePoints = remainingLargeEdgePoints;
 				incompleteParticles = remainingIncompleteParticles;
+				incompleteStates = remainingIncompleteStates;
 				blockEdgeZ = remainingBlockEdgeZ;
 			}
 			else
 			{
 				incompleteParticles.clear();
+				incompleteStates.clear();
 			}
 		}
 	}
@@ -847,6 +969,7 @@ namespace itl2
 			throw ITLException("Large color must not be zero as zero is background color.");
 
 		std::vector<std::vector<Vec3sc> > incompleteParticles;
+		std::vector<std::vector<double> > incompleteStates;
 		std::vector<std::vector<Vec3sc> > largeEdgePoints;
 		std::vector<coord_t> edgeZ;
 		
@@ -854,7 +977,14 @@ namespace itl2
 
 		prepareParticleAnalysis(image, fillColor, largeColor);
 
-		internals::analyzeParticlesBlocks(image, analyzers, results, largeEdgePoints, incompleteParticles, connectivity, volumeLimit, fillColor, largeColor, Vec3sc(), edgeZ);
+		if (volumeLimit <= 0 && analyzers.supportsAccumulation())
+		{
+			// Particles can be analyzed without collecting their points.
+			internals::analyzeParticlesRuns(image, analyzers, results, connectivity, fillColor, largeColor);
+			return;
+		}
+
+		internals::analyzeParticlesBlocks(image, analyzers, results, largeEdgePoints, incompleteParticles, incompleteStates, connectivity, volumeLimit, fillColor, largeColor, Vec3sc(), edgeZ);
 
 		//std::cout << "Block edges are at" << std::endl;
 		//sort(edgeZ.begin(), edgeZ.end());
@@ -871,7 +1001,7 @@ namespace itl2
 		//}
 		//raw::writed(labels, "particleanalysis/labels");
 
-		internals::combineParticleAnalysisResults(analyzers, results, largeEdgePoints, incompleteParticles, volumeLimit, connectivity, edgeZ, false);
+		internals::combineParticleAnalysisResults(analyzers, results, largeEdgePoints, incompleteParticles, incompleteStates, volumeLimit, connectivity, edgeZ, false);
 	}
 
 	/**
@@ -920,7 +1050,7 @@ namespace itl2
 
 		prepareParticleAnalysis(image, fillColor, largeColor);
 
-		internals::analyzeParticlesSingleBlock(image, analyzers, results, nullptr, nullptr, connectivity, volumeLimit, fillColor, largeColor, counter, image.depth() * image.height(), Vec3sc());
+		internals::analyzeParticlesSingleBlock(image, analyzers, results, nullptr, nullptr, nullptr, connectivity, volumeLimit, fillColor, largeColor, counter, image.depth() * image.height(), Vec3sc());
 
 		//raw::writed(image, "particleanalysis/labels");
 	}
@@ -952,7 +1082,43 @@ namespace itl2
 	*/
 	template<typename pixel_t> void analyzeLabels(const Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results)
 	{
-		// TODO: This can be done more efficiently by changing analyzers such that they don't require all the points at once.
+		results.headers() = analyzers.headers();
+
+		if (analyzers.supportsAccumulation())
+		{
+			// Accumulate the analysis results for each label without storing the points.
+			std::map<pixel_t, std::vector<double> > states;
+			{
+				ProgressIndicator prog(image.depth());
+				for (coord_t z = 0; z < image.depth(); z++)
+				{
+					for (coord_t y = 0; y < image.height(); y++)
+					{
+						for (coord_t x = 0; x < image.width(); x++)
+						{
+							pixel_t pixel = image(x, y, z);
+							if (pixel != 0)
+							{
+								std::vector<double>& state = states[pixel];
+								if (state.size() <= 0)
+									analyzers.init(state);
+								analyzers.add(state, Vec3sc(Vec3c(x, y, z)));
+							}
+						}
+					}
+					prog.step();
+				}
+			}
+
+			for (auto& item : states)
+			{
+				std::vector<double> resultLine;
+				analyzers.finalize(item.second, resultLine);
+				results.push_back(resultLine);
+			}
+
+			return;
+		}
 
 		// Divide pixels into point sets based on their value
 		std::map<pixel_t, std::vector<Vec3sc> > points;
@@ -976,7 +1142,6 @@ namespace itl2
 		}
 
 		// Analyze each set
-		results.headers() = analyzers.headers();
 		{
 			ProgressIndicator prog(points.size());
 			for (auto& item : points)
@@ -1343,6 +1508,7 @@ namespace itl2
 		void analyzeParticlesSanity();
 		void analyzeParticlesSanity2();
 		void analyzeParticlesVolumeLimit();
+		void analyzeParticlesAccumulation();
 	}
 }
 
@@ -0,0 +1,204 @@
+
+#include "recursivegauss.h"
+#include "filters.h"
+#include "noise.h"
+#include "timer.h"
+#include "testutils.h"
+
+using namespace std;
+
+namespace itl2
+{
+	namespace tests
+	{
+		namespace
+		{
+			/**
+			Convolves the image in the given dimension with sampled Gaussian or Gaussian derivative kernel that is truncated at 8 sigma.
+			*/
+			void referenceGauss(Image<double>& img, double sigma, size_t dim, size_t derivativeOrder, BoundaryCondition bc)
+			{
+				coord_t r = itl2::ceil(8 * sigma);
+				vector<double> kernel(2 * r + 1);
+				double sum = 0;
+				for (coord_t i = -r; i <= r; i++)
+				{
+					double g = std::exp(-(double)(i * i) / (2 * sigma * sigma));
+					sum += g;
+					if (derivativeOrder == 1)
+						g *= -i / (sigma * sigma);
+					else if (derivativeOrder == 2)
+						g *= i * i / (sigma * sigma * sigma * sigma) - 1 / (sigma * sigma);
+					kernel[i + r] = g;
+				}
+
+				Image<double> out(img.dimensions());
+				coord_t N = img.dimension(dim);
+				for (coord_t z = 0; z < img.depth(); z++)
+				{
+					for (coord_t y = 0; y < img.height(); y++)
+					{
+						for (coord_t x = 0; x < img.width(); x++)
+						{
+							Vec3c p(x, y, z);
+							double res = 0;
+							for (coord_t i = -r; i <= r; i++)
+							{
+								Vec3c q = p;
+								q[dim] -= i;
+								if (q[dim] < 0 || q[dim] >= N)
+								{
+									if (bc == BoundaryCondition::Zero)
+										continue;
+									q[dim] = std::clamp<coord_t>(q[dim], 0, N - 1);
+								}
+								res += kernel[i + r] * img(q);
+							}
+							out(p) = res / sum;
+						}
+					}
+				}
+
+				setValue(img, out);
+			}
+
+			/**
+			Creates test image with sharp edges.
+			*/
+			void createCheckerboard(Image<double>& img)
+			{
+				for (coord_t z = 0; z < img.depth(); z++)
+				{
+					for (coord_t y = 0; y < img.height(); y++)
+					{
+						for (coord_t x = 0; x < img.width(); x++)
+						{
+							img(x, y, z) = ((x / 11 + y / 13 + z / 7) % 2) * 100.0;
+						}
+					}
+				}
+			}
+
+			double maxAbsDifference(const Image<double>& a, const Image<double>& b)
+			{
+				double diff = 0;
+				for (coord_t n = 0; n < a.pixelCount(); n++)
+					diff = std::max(diff, std::abs(a(n) - b(n)));
+				return diff;
+			}
+		}
+
+		void recursiveGauss()
+		{
+			Image<double> img(70, 60, 50);
+			createCheckerboard(img);
+
+			for (BoundaryCondition bc : { BoundaryCondition::Nearest, BoundaryCondition::Zero })
+			{
+				for (size_t dim = 0; dim < 3; dim++)
+				{
+					for (double sigma : { 4.0, 7.5, 20.0 })
+					{
+						Image<double> expected, result;
+						setValue(expected, img);
+						setValue(result, img);
+						referenceGauss(expected, sigma, dim, 0, bc);
+						internals::recursiveGaussOneDimension(result, sigma, dim, 0, bc, false);
+
+						// The error is a fraction of a percent of the height of the edges.
+						double diff = maxAbsDifference(expected, result);
+						testAssert(diff < 0.5, string("recursive Gaussian, sigma = ") + toString(sigma) + ", dimension = " + toString(dim) + ", " + toString(bc) + ", difference = " + toString(diff));
+					}
+				}
+			}
+
+			// Constant image must not change with Nearest boundary condition.
+			Image<double> constant(50, 40, 30);
+			setValue(constant, 10.0);
+			internals::recursiveGaussOneDimension(constant, 10.0, 1, 0, BoundaryCondition::Nearest, false);
+			testAssert(std::abs(min(constant) - 10.0) < 1e-9 && std::abs(max(constant) - 10.0) < 1e-9, "recursive Gaussian of constant image");
+
+			// The public functions select recursive filtering for large sigma.
+			Image<float32_t> imgf(img.dimensions());
+			noise(imgf, 100, 30, 1);
+			Image<float32_t> expectedf, resultf;
+			internals::sepgauss(imgf, expectedf, Vec3d(5, 6, 7), -1, -1, BoundaryCondition::Nearest, false, false);
+			gaussFilter(imgf, resultf, Vec3d(5, 6, 7), true, BoundaryCondition::Nearest);
+			testAssert(!equals(expectedf, resultf), "recursive filtering is not used");
+
+			// Non-finite values are processed with the explicit kernel.
+			imgf(10, 10, 10) = std::numeric_limits<float32_t>::quiet_NaN();
+			gaussFilter(imgf, resultf, Vec3d(5, 5, 5), true, BoundaryCondition::Nearest);
+			testAssert(std::isnan(resultf(11, 11, 11)) && !std::isnan(resultf(60, 50, 40)), "recursive filtering of image containing NaN");
+		}
+
+		void recursiveGaussDerivative()
+		{
+			Image<double> img(70, 60, 50);
+			createCheckerboard(img);
+
+			for (BoundaryCondition bc : { BoundaryCondition::Nearest, BoundaryCondition::Zero })
+			{
+				for (size_t order : { 1, 2 })
+				{
+					for (double sigma : { 4.0, 10.0 })
+					{
+						Image<double> expected, result;
+						setValue(expected, img);
+						setValue(result, img);
+						referenceGauss(expected, sigma, 0, order, bc);
+						internals::recursiveGaussOneDimension(result, sigma, 0, order, bc, false);
+
+						// Derivatives are approximated with differences, so the error decreases with sigma.
+						double diff = maxAbsDifference(expected, result) / std::max(std::abs(min(expected)), std::abs(max(expected)));
+						testAssert(diff < 0.05, string("recursive Gaussian derivative, order = ") + toString(order) + ", sigma = " + toString(sigma) + ", " + toString(bc) + ", relative difference = " + toString(diff));
+					}
+				}
+			}
+
+			// Derivatives of a quadratic function, far enough from the edges.
+			Image<float32_t> f(120, 100, 20);
+			for (coord_t z = 0; z < f.depth(); z++)
+				for (coord_t y = 0; y < f.height(); y++)
+					for (coord_t x = 0; x < f.width(); x++)
+						f(x, y, z) = (float32_t)(0.01 * x * x + 3 * y);
+
+			Image<float32_t> dx, dxx, dy;
+			gaussDerivative(f, dx, 5.0, 0, -1);
+			gaussDerivative(f, dxx, 5.0, 0, 0);
+			gaussDerivative(f, dy, 5.0, 1, -1);
+
+			bool ok = true;
+			for (coord_t y = 40; y < 60; y++)
+			{
+				for (coord_t x = 40; x < 80; x++)
+				{
+					if (std::abs(dx(x, y, 10) - 0.02 * x) > 1e-3 || std::abs(dxx(x, y, 10) - 0.02) > 2e-4 || std::abs(dy(x, y, 10) - 3) > 1e-3)
+						ok = false;
+				}
+			}
+			testAssert(ok, "derivatives of quadratic function");
+		}
+
+		void recursiveGaussSpeed()
+		{
+			Image<float32_t> img(300, 300, 300);
+			noise(img, 100, 30, 1);
+
+			Image<float32_t> out;
+			Timer timer;
+			for (double sigma : { 4.0, 8.0, 16.0, 32.0 })
+			{
+				timer.start();
+				internals::sepgauss(img, out, Vec3d(sigma, sigma, sigma), -1, -1, BoundaryCondition::Nearest, false, true);
+				timer.stop();
+				cout << "Recursive Gaussian filter, sigma = " << sigma << " took " << timer.getTime() << " ms." << endl;
+
+				timer.start();
+				internals::sepgauss(img, out, Vec3d(sigma, sigma, sigma), -1, -1, BoundaryCondition::Nearest, false, false);
+				timer.stop();
+				cout << "Explicit Gaussian filter, sigma = " << sigma << " took " << timer.getTime() << " ms." << endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "image.h"
+#include "boundarycondition.h"
+#include "progress.h"
+#include "utilities.h"
+#include "boxfilters.h"
+
+#include <vector>
+#include <cmath>
+#include <complex>
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Gaussian filtering of dimensions whose standard deviation is at least this large is done with the
+		recursive algorithm, if allowed.
+		The accuracy of the recursive filter is comparable to the accuracy of explicit convolution (whose kernel is truncated at 3 sigma)
+		only for sufficiently large standard deviations.
+		*/
+		static const double RECURSIVE_GAUSS_SIGMA_THRESHOLD = 4.0;
+
+		/**
+		Count of image lines processed simultaneously in the recursive Gaussian filter.
+		The recursions of the lines are independent and they can be calculated using vector instructions.
+		*/
+		static const coord_t RECURSIVE_GAUSS_LANES = 16;
+
+		/**
+		Order of the recursive Gaussian filter.
+		*/
+		static const size_t RECURSIVE_GAUSS_ORDER = 4;
+
+		/**
+		Coefficients of the fourth order recursive Gaussian filter.
+		The filter consists of a causal pass
+		w[n] = B x[n] + b1 w[n - 1] + b2 w[n - 2] + b3 w[n - 3] + b4 w[n - 4]
+		followed by an anti-causal pass
+		y[n] = B w[n] + b1 y[n + 1] + b2 y[n + 2] + b3 y[n + 3] + b4 y[n + 4].
+
+		The poles of the filter are those given in L.J. van Vliet, I.T. Young and P.W. Verbeek, Recursive Gaussian derivative filters,
+		Proceedings of the 14th International Conference on Pattern Recognition, 1998. The poles are scaled so that the variance of the
+		impulse response equals sigma^2.
+
+		The initial state of the anti-causal pass is determined so that the signal is extended by a constant
+		beyond the end of the line, as described in B. Triggs and M. Sdika, Boundary conditions for Young - van Vliet recursive filtering,
+		IEEE Transactions on Signal Processing 54(6), 2006. Here the boundary matrix is calculated numerically.
+		*/
+		struct RecursiveGaussCoefficients
+		{
+			/**
+			Gain of the filter.
+			*/
+			double B;
+
+			/**
+			Feedback coefficients b1, b2, b3 and b4.
+			*/
+			double b[RECURSIVE_GAUSS_ORDER];
+
+			/**
+			Matrix that maps the last deviations of the causal pass from the constant extension value, (w[N - 1], w[N - 2], ...), to
+			the deviations of the initial state of the anti-causal pass, (y[N], y[N + 1], ...).
+			*/
+			double M[RECURSIVE_GAUSS_ORDER][RECURSIVE_GAUSS_ORDER];
+
+			RecursiveGaussCoefficients(double sigma)
+			{
+				const size_t K = RECURSIVE_GAUSS_ORDER;
+
+				// Poles for sigma = 2.
+				const std::complex<double> poles[K] = {
+					std::complex<double>(1.13228, 1.28114),
+					std::complex<double>(1.13228, -1.28114),
+					std::complex<double>(1.78534, 0.46763),
+					std::complex<double>(1.78534, -0.46763)
+				};
+
+				// Variance of the impulse response when the poles are scaled by power 1/q.
+				auto variance = [&](double q)
+				{
+					std::complex<double> v = 0;
+					for (size_t i = 0; i < K; i++)
+					{
+						std::complex<double> d = std::pow(poles[i], 1 / q);
+						v += 2.0 * d / ((d - 1.0) * (d - 1.0));
+					}
+					return v.real();
+				};
+
+				// The variance increases with q.
+				double qMin = 1e-3;
+				double qMax = 1e4;
+				for (size_t n = 0; n < 100; n++)
+				{
+					double q = (qMin + qMax) / 2;
+					if (variance(q) < sigma * sigma)
+						qMin = q;
+					else
+						qMax = q;
+				}
+				double q = (qMin + qMax) / 2;
+
+				// Expand product of (1 - z^-1 / d_i) to get the coefficients.
+				std::complex<double> poly[K + 1] = { 1.0 };
+				for (size_t i = 0; i < K; i++)
+				{
+					std::complex<double> r = 1.0 / std::pow(poles[i], 1 / q);
+					for (size_t j = i + 1; j >= 1; j--)
+						poly[j] -= r * poly[j - 1];
+				}
+
+				B = 1;
+				for (size_t i = 0; i < K; i++)
+				{
+					b[i] = -poly[i + 1].real();
+					B -= b[i];
+				}
+
+				// Calculate the boundary matrix by running both passes for unit deviations in the state of the causal pass,
+				// until the response has decayed to insignificance.
+				for (size_t j = 0; j < K; j++)
+				{
+					// e[K - 1] corresponds to w[N - 1], e[K - 2] to w[N - 2] etc.
+					std::vector<double> e(K, 0.0);
+					e[K - 1 - j] = 1;
+					double tail = 1;
+					while (tail > 1e-20 && e.size() < 100000000)
+					{
+						size_t n = e.size();
+						double w = 0;
+						for (size_t k = 0; k < K; k++)
+							w += b[k] * e[n - 1 - k];
+						e.push_back(w);
+
+						tail = 0;
+						for (size_t k = 0; k < K; k++)
+							tail += std::abs(e[e.size() - 1 - k]);
+					}
+
+					double d[K] = { 0 };
+					for (size_t n = e.size() - 1; n >= K; n--)
+					{
+						double y = B * e[n];
+						for (size_t k = 0; k < K; k++)
+							y += b[k] * d[k];
+						for (size_t k = K - 1; k >= 1; k--)
+							d[k] = d[k - 1];
+						d[0] = y;
+					}
+
+					for (size_t i = 0; i < K; i++)
+						M[i][j] = d[i];
+				}
+			}
+		};
+
+		/**
+		Applies the recursive Gaussian filter to a block of lines stored in an interleaved buffer.
+		Sample n of lane b is stored in buffer[n * RECURSIVE_GAUSS_LANES + b].
+		@param buffer The buffer containing the data.
+		@param N Count of samples in each line.
+		@param lanes Count of lanes that are used.
+		@param c Filter coefficients.
+		@param left, right Values of the signal before the first and after the last sample.
+		*/
+		inline void recursiveGaussLanes(double* buffer, coord_t N, coord_t lanes, const RecursiveGaussCoefficients& c, const double* left, const double* right)
+		{
+			const coord_t L = RECURSIVE_GAUSS_LANES;
+			const size_t K = RECURSIVE_GAUSS_ORDER;
+
+			// state[k][b] contains output of the pass at distance k + 1 from the current sample, in lane b.
+			double state[K][L];
+
+			// Causal pass. Constant signal before the line gives constant response.
+			for (size_t k = 0; k < K; k++)
+			{
+				for (coord_t b = 0; b < lanes; b++)
+					state[k][b] = left[b];
+			}
+
+			for (coord_t n = 0; n < N; n++)
+			{
+				double* p = &buffer[n * L];
+				for (coord_t b = 0; b < lanes; b++)
+				{
+					double w = c.B * p[b] + c.b[0] * state[0][b] + c.b[1] * state[1][b] + c.b[2] * state[2][b] + c.b[3] * state[3][b];
+					state[3][b] = state[2][b];
+					state[2][b] = state[1][b];
+					state[1][b] = state[0][b];
+					state[0][b] = w;
+					p[b] = w;
+				}
+			}
+
+			// Anti-causal pass. The state contains w[N - 1], w[N - 2], ...
+			for (coord_t b = 0; b < lanes; b++)
+			{
+				double u = right[b];
+				double e[K];
+				for (size_t k = 0; k < K; k++)
+					e[k] = state[k][b] - u;
+
+				for (size_t i = 0; i < K; i++)
+				{
+					double y = u;
+					for (size_t k = 0; k < K; k++)
+						y += c.M[i][k] * e[k];
+					state[i][b] = y;
+				}
+			}
+
+			for (coord_t n = N - 1; n >= 0; n--)
+			{
+				double* p = &buffer[n * L];
+				for (coord_t b = 0; b < lanes; b++)
+				{
+					double y = c.B * p[b] + c.b[0] * state[0][b] + c.b[1] * state[1][b] + c.b[2] * state[2][b] + c.b[3] * state[3][b];
+					state[3][b] = state[2][b];
+					state[2][b] = state[1][b];
+					state[1][b] = state[0][b];
+					state[0][b] = y;
+					p[b] = y;
+				}
+			}
+		}
+
+		/**
+		Gaussian filtering or Gaussian derivative in one dimension using recursive filter, in-place.
+		The processing time per pixel does not depend on sigma.
+		Derivatives are calculated by filtering central differences of the image, so the result approximates
+		convolution with derivative of Gaussian kernel well when sigma is large.
+		Lines are processed in blocks of RECURSIVE_GAUSS_LANES lines. In y- and z-directions the lines of a block are adjacent in the x-direction,
+		so the block can be read and written in contiguous runs.
+		@param img Image to process.
+		@param sigma Standard deviation of the Gaussian.
+		@param dim Dimension to process.
+		@param derivativeOrder Order of derivative, 0, 1, or 2.
+		@param bc Boundary condition.
+		*/
+		template<typename pixel_t> void recursiveGaussOneDimension(Image<pixel_t>& img, double sigma, size_t dim, size_t derivativeOrder, BoundaryCondition bc, bool showProgressInfo = true)
+		{
+			if (derivativeOrder > 2)
+				throw ITLException("Invalid derivative order.");
+
+			const coord_t L = RECURSIVE_GAUSS_LANES;
+			RecursiveGaussCoefficients c(sigma);
+
+			// Lanes are in x-direction, except when filtering in x-direction, when they are in y-direction.
+			size_t laneDim = dim == 0 ? 1 : 0;
+			size_t otherDim = 3 - dim - laneDim;
+
+			coord_t N = img.dimension(dim);
+			coord_t laneCount = img.dimension(laneDim);
+			coord_t blockCount = (laneCount + L - 1) / L;
+			coord_t taskCount = blockCount * img.dimension(otherDim);
+
+			Vec3c strides(1, img.width(), img.width() * img.height());
+			coord_t sampleStride = strides[dim];
+			coord_t laneStride = strides[laneDim];
+
+			ProgressIndicator progress(taskCount, showProgressInfo);
+
+			#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				// The buffer contains one extra sample at both ends of the lines.
+				// In derivative calculation with zero boundary condition the differences are non-zero there.
+				std::vector<double> input(N * L);
+				std::vector<double> buffer((N + 2) * L);
+				double left[L], right[L];
+
+				#pragma omp for
+				for (coord_t task = 0; task < taskCount; task++)
+				{
+					coord_t lane0 = (task % blockCount) * L;
+					coord_t lanes = std::min(L, laneCount - lane0);
+
+					Vec3c start(0, 0, 0);
+					start[laneDim] = lane0;
+					start[otherDim] = task / blockCount;
+					pixel_t* p0 = &img(start);
+
+					for (coord_t n = 0; n < N; n++)
+					{
+						for (coord_t b = 0; b < lanes; b++)
+							input[n * L + b] = (double)p0[n * sampleStride + b * laneStride];
+					}
+
+					// Value of input at position n, taking boundary condition into account.
+					auto inputAt = [&](coord_t n, coord_t b)
+					{
+						if (n < 0 || n >= N)
+						{
+							if (bc == BoundaryCondition::Zero)
+								return 0.0;
+							n = std::clamp<coord_t>(n, 0, N - 1);
+						}
+						return input[n * L + b];
+					};
+
+					for (coord_t n = -1; n <= N; n++)
+					{
+						double* p = &buffer[(n + 1) * L];
+						for (coord_t b = 0; b < lanes; b++)
+						{
+							if (derivativeOrder == 0)
+								p[b] = inputAt(n, b);
+							else if (derivativeOrder == 1)
+								p[b] = 0.5 * (inputAt(n + 1, b) - inputAt(n - 1, b));
+							else
+								p[b] = inputAt(n + 1, b) - 2 * inputAt(n, b) + inputAt(n - 1, b);
+						}
+					}
+
+					// Differences of the extended signal are zero outside of the buffer, and the smoothed signal is
+					// extended by the boundary values.
+					for (coord_t b = 0; b < lanes; b++)
+					{
+						left[b] = derivativeOrder == 0 ? inputAt(-1, b) : 0.0;
+						right[b] = derivativeOrder == 0 ? inputAt(N, b) : 0.0;
+					}
+
+					recursiveGaussLanes(buffer.data(), N + 2, lanes, c, left, right);
+
+					for (coord_t n = 0; n < N; n++)
+					{
+						for (coord_t b = 0; b < lanes; b++)
+							p0[n * sampleStride + b * laneStride] = pixelRound<pixel_t>(buffer[(n + 1) * L + b]);
+					}
+
+					progress.step();
+				}
+			}
+		}
+
+		/**
+		Tests if the recursive Gaussian filter can be used for the given image and standard deviation.
+		The recursive filter is used only for real pixel types, and only if all the pixels are finite, as a single
+		non-finite value would spread to the whole line.
+		*/
+		template<typename pixel_t> bool canUseRecursiveGauss(const Image<pixel_t>& img, double sigma)
+		{
+			if (sigma < RECURSIVE_GAUSS_SIGMA_THRESHOLD)
+				return false;
+
+			if constexpr (std::is_arithmetic_v<pixel_t>)
+				return allFinite(img);
+			else
+				return false;
+		}
+	}
+
+	namespace tests
+	{
+		void recursiveGauss();
+		void recursiveGaussDerivative();
+		void recursiveGaussSpeed();
+	}
+}
@@ -1,56 +1,48 @@
 #pragma once
 
 #include "image.h"
-#include "floodfill.h"
-#include "particleanalysis.h"
+#include "connectedcomponents.h"
 
 namespace itl2
 {
 
 	/**
 	Removes all nonzero regions smaller than the given volume limit.
+	The remaining nonzero pixels are set to one.
 	@param img Image to process.
 	@param volumeLimit Nonzero regions smaller than this value are removed.
 	@param preserveEdges Set to true to skip processing of regions that touch image edge.
 	@param connectivity Connectivity of pixels.
+	@param multiThreaded Set to false to process the image in the current thread only.
 	*/
 	template<typename pixel_t> void regionRemoval(Image<pixel_t>& img, size_t volumeLimit, bool preserveEdges = false, Connectivity connectivity = Connectivity::NearestNeighbours, bool multiThreaded = true)
 	{
-		// Analyze particles
-		Results results;
-		AnalyzerSet<Vec3sc, pixel_t> analyzers;
-		analyzers.push_back(new analyzers::Coordinates3D<Vec3sc, pixel_t>());
-		analyzers.push_back(new analyzers::Volume<Vec3sc, pixel_t>());
-		if (preserveEdges)
-			analyzers.push_back(new analyzers::IsOnEdge<Vec3sc, pixel_t>(img.dimensions()));
-
 		std::cout << "Searching for particles..." << std::endl;
-		if(multiThreaded)
-			analyzeParticles<pixel_t>(img, analyzers, results, connectivity, volumeLimit);
-		else
-			analyzeParticlesSingleThreaded<pixel_t>(img, analyzers, results, connectivity, volumeLimit);
-		
+		ComponentRuns runs;
+		findComponents(img, [](pixel_t p) { return p != 0; }, connectivity, runs, multiThreaded);
+
+		std::vector<size_t> volumes = runs.volumes(multiThreaded);
+
+		std::vector<uint8_t> remove(runs.componentCount);
+		for (size_t n = 0; n < runs.componentCount; n++)
+			remove[n] = volumes[n] < volumeLimit ? 1 : 0;
+
 		if (preserveEdges)
 		{
-			// Remove all particles that touch edges.
-			size_t n = 0;
-			while (n < results.size())
-			{
-				if (results[n][results[n].size() - 1] != 0)
+			// Do not remove particles that touch edges.
+			Vec3c dims = img.dimensions();
+			runs.forAllRuns([&](const ComponentRuns::Run& run, coord_t y, coord_t z, size_t c)
 				{
-					results.erase(results.begin() + n);
-					n--;
-				}
-				n++;
-			}
+					if (run.x0 <= 0 || run.x1 >= dims.x - 1 || y <= 0 || y >= dims.y - 1 || z <= 0 || z >= dims.z - 1)
+					{
+						#pragma omp atomic write
+						remove[c] = 0;
+					}
+				}, multiThreaded);
 		}
 
-		// Fill those with too small volume
 		std::cout << "Filling small particles..." << std::endl;
-		//fillParticles<pixel_t>(img, results, 0, 3, (double)volumeLimit, connectivity, false);
-		fillParticles<pixel_t>(img, results, 0, connectivity);
-
-		threshold(img, (pixel_t)0);
+		runs.fill(img, [&](size_t c) { return remove[c] ? (pixel_t)0 : (pixel_t)1; }, true, multiThreaded);
 	}
 
 
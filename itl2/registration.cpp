@@ -12,6 +12,7 @@
 #include "filters.h"
 #include "inpaint.h"
 #include "generation.h"
+#include "noise.h"
 
 using namespace std;
 
@@ -584,5 +585,51 @@ namespace itl2
 			cout << "Reference point = " << p1 << endl;
 			cout << "Deformed point = " << points[0] << endl;
 		}
+
+		void blockMatchWorkspace()
+		{
+			// Smooth random image and its translated version.
+			Image<float32_t> noiseImg(120, 110, 100);
+			noise(noiseImg, 1000, 200, 3);
+			Image<float32_t> reference;
+			gaussFilter(noiseImg, reference, 2.0, false);
+
+			Vec3d shiftGT(3, -2, 4);
+			Image<float32_t> deformed(reference.dimensions());
+			translate(reference, deformed, shiftGT);
+
+			PointGrid3D<coord_t> refGrid(PointGrid1D<coord_t>(20, 100, 20), PointGrid1D<coord_t>(20, 90, 20), PointGrid1D<coord_t>(20, 80, 30));
+			Image<Vec3d> defPoints(refGrid.pointCounts());
+			for (coord_t n = 0; n < defPoints.pixelCount(); n++)
+			{
+				Vec3c p = defPoints.getCoords(n);
+				defPoints(n) = Vec3d(refGrid(p.x, p.y, p.z));
+			}
+			Image<Vec3d> defPointsInitial;
+			setValue(defPointsInitial, defPoints);
+
+			Image<float32_t> accuracy;
+			BlockMatchTimings timings;
+			blockMatchMulti(reference, deformed, refGrid, defPoints, accuracy, Vec3c(16, 16, 16), 2, Vec3c(8, 8, 8), 1, &timings);
+			cout << timings << endl;
+			testAssert(timings.pointCount == (size_t)defPoints.pixelCount(), "block match point count");
+
+			// Points matched one by one without re-used buffers must give the same result.
+			bool same = true;
+			for (coord_t n = 0; n < defPoints.pixelCount(); n++)
+			{
+				Vec3c p = defPoints.getCoords(n);
+				Vec3c refPoint = refGrid(p.x, p.y, p.z);
+				Vec3d defPoint = defPointsInitial(n);
+				double gof;
+				internals::blockMatchOnePoint(reference, deformed, Vec3c(16, 16, 16), refPoint, defPoint, gof, 2);
+				if (gof > 0)
+					internals::blockMatchOnePoint(reference, deformed, Vec3c(8, 8, 8), refPoint, defPoint, gof, 1);
+
+				if (defPoint != defPoints(n) || (float32_t)gof != accuracy(n))
+					same = false;
+			}
+			testAssert(same, "block matching with re-used buffers");
+		}
 	}
 }
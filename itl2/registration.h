@@ -10,12 +10,83 @@
 #include "inpaint.h"
 #include "projections.h"
 #include "io/io.h"
+#include "timer.h"
 
 namespace itl2
 {
 
+	/**
+	Wall-clock time spent in the stages of block matching, summed over all threads.
+	*/
+	struct BlockMatchTimings
+	{
+		/**
+		Time spent in extracting and binning the blocks, in seconds.
+		*/
+		double extraction = 0;
+
+		/**
+		Time spent in filling unknown values of the blocks, in seconds.
+		*/
+		double inpainting = 0;
+
+		/**
+		Time spent in Fourier transforms and phase correlation, in seconds.
+		*/
+		double correlation = 0;
+
+		/**
+		Count of points that have been matched.
+		*/
+		size_t pointCount = 0;
+
+		BlockMatchTimings& operator+=(const BlockMatchTimings& r)
+		{
+			extraction += r.extraction;
+			inpainting += r.inpainting;
+			correlation += r.correlation;
+			pointCount += r.pointCount;
+			return *this;
+		}
+
+		friend std::ostream& operator<<(std::ostream& stream, const BlockMatchTimings& t)
+		{
+			stream << "Block matching of " << t.pointCount << " points: block extraction " << t.extraction << " s, inpainting " << t.inpainting << " s, phase correlation " << t.correlation << " s (summed over all threads).";
+			return stream;
+		}
+	};
+
 	namespace internals
 	{
+		/**
+		Temporary buffers used in block matching.
+		Each thread allocates one workspace and uses it for all the points it processes, so that the buffers are allocated only once.
+		*/
+		class BlockMatchWorkspace
+		{
+		public:
+			Image<float32_t> refBlockOrig;
+			Image<float32_t> defBlockOrig;
+			Image<float32_t> refBlock;
+			Image<float32_t> defBlock;
+			Image<complex32_t> refFFT;
+			Image<complex32_t> defFFT;
+			Image<float32_t> distance;
+			Image<Vec3c> coords;
+
+			/**
+			Full-resolution reference block of the coarse matching phase.
+			The fine matching phase extracts its reference block from this block if possible.
+			*/
+			Image<float32_t> coarseRefBlock;
+			Vec3c coarseRefPoint;
+			Vec3c coarseRefRadius;
+			bool hasCoarseRefBlock = false;
+
+			BlockMatchTimings timings;
+			Timer timer;
+		};
+
 		/*
 		Block matcher.
 		NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
@@ -25,9 +96,13 @@ namespace itl2
 		@param refPoint Point in the reference image.
 		@param defPoint Point in the deformed image. Input value is used as initial guess of the shift. On output, will contain the shift that was estimated.
 		@param accuracy Stores a measure of the accuracy of the matching.
+		@param ws Temporary buffers.
+		@param keepReference Set to true to store full-resolution reference block to the workspace for use in the next call with the same reference point.
 		*/
-		template<typename ref_t, typename def_t> void blockMatchOnePoint(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& blockRadius, const Vec3c& refPoint, Vec3d& defPoint, double& accuracy, size_t binningSize = 1)
+		template<typename ref_t, typename def_t> void blockMatchOnePoint(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& blockRadius, const Vec3c& refPoint, Vec3d& defPoint, double& accuracy, size_t binningSize, BlockMatchWorkspace& ws, bool keepReference = false)
 		{
+			ws.timer.start();
+
 			Vec3c r = blockRadius;
 			for (size_t n = reference.dimensionality(); n < 3; n++)
 				r[n] = 0;
@@ -36,35 +111,64 @@ namespace itl2
 
 			Vec3c defPointRounded = round(defPoint);
 
-			Image<float32_t> refBlock;
-			Image<float32_t> defBlock;
-			if (binningSize > 1)
-			{
-				Image<float32_t> refBlockOrig(blockSize);
-				Image<float32_t> defBlockOrig(blockSize);
-
+			// Extract reference block, from the coarse phase reference block if it contains the current block.
+			Image<float32_t>& refBlockOrig = keepReference ? ws.coarseRefBlock : ws.refBlockOrig;
+			refBlockOrig.ensureSize(blockSize);
+			if (!keepReference && ws.hasCoarseRefBlock && ws.coarseRefPoint == refPoint &&
+				r.x <= ws.coarseRefRadius.x && r.y <= ws.coarseRefRadius.y && r.z <= ws.coarseRefRadius.z)
+				getNeighbourhood(ws.coarseRefBlock, ws.coarseRefRadius, r, refBlockOrig, BoundaryCondition::Zero);
+			else
 				getNeighbourhood(reference, refPoint, r, refBlockOrig, BoundaryCondition::Zero);
-				getNeighbourhood(deformed, defPointRounded, r, defBlockOrig, BoundaryCondition::Zero);
 
-				maskedBinning(refBlockOrig, refBlock, binningSize, (float32_t)0, (float32_t)0, false);
-				maskedBinning(defBlockOrig, defBlock, binningSize, (float32_t)0, (float32_t)0, false);
+			ws.hasCoarseRefBlock = keepReference;
+			ws.coarseRefPoint = refPoint;
+			ws.coarseRefRadius = r;
+
+			ws.defBlockOrig.ensureSize(blockSize);
+			getNeighbourhood(deformed, defPointRounded, r, ws.defBlockOrig, BoundaryCondition::Zero);
+
+			if (binningSize > 1)
+			{
+				maskedBinning(refBlockOrig, ws.refBlock, binningSize, (float32_t)0, (float32_t)0, false);
+				maskedBinning(ws.defBlockOrig, ws.defBlock, binningSize, (float32_t)0, (float32_t)0, false);
 			}
 			else
 			{
-				refBlock.ensureSize(blockSize);
-				defBlock.ensureSize(blockSize);
-				getNeighbourhood(reference, refPoint, r, refBlock, BoundaryCondition::Zero);
-				getNeighbourhood(deformed, defPointRounded, r, defBlock, BoundaryCondition::Zero);
+				setValue(ws.refBlock, refBlockOrig);
+				setValue(ws.defBlock, ws.defBlockOrig);
 			}
 
+			ws.timings.extraction += ws.timer.lap();
+
 			// Set zeros to nearest non-zero value. This has effect particularly in the edges and corners of non-rectangular images.
-			inpaintNearest(refBlock);
-			inpaintNearest(defBlock);
+			inpaintNearest(ws.refBlock, (float32_t)0, ws.distance, ws.coords);
+			inpaintNearest(ws.defBlock, (float32_t)0, ws.distance, ws.coords);
+
+			ws.timings.inpainting += ws.timer.lap();
 
-			Vec3d shift = phaseCorrelation(refBlock, defBlock, r / binningSize, accuracy);
+			Vec3d shift = phaseCorrelation(ws.refBlock, ws.defBlock, r / binningSize, accuracy, ws.refFFT, ws.defFFT);
 			shift *= (double)binningSize;
 
 			defPoint = Vec3d(defPointRounded) - shift;
+
+			ws.timer.stop();
+			ws.timings.correlation += ws.timer.getSeconds();
+		}
+
+		/*
+		Block matcher.
+		NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
+		@param reference Reference image.
+		@param deformed Deformed image.
+		@param blockRadius Radius of matching block. The value is also maximum change in defPoint that can be found.
+		@param refPoint Point in the reference image.
+		@param defPoint Point in the deformed image. Input value is used as initial guess of the shift. On output, will contain the shift that was estimated.
+		@param accuracy Stores a measure of the accuracy of the matching.
+		*/
+		template<typename ref_t, typename def_t> void blockMatchOnePoint(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& blockRadius, const Vec3c& refPoint, Vec3d& defPoint, double& accuracy, size_t binningSize = 1)
+		{
+			BlockMatchWorkspace ws;
+			blockMatchOnePoint(reference, deformed, blockRadius, refPoint, defPoint, accuracy, binningSize, ws);
 		}
 
 		/*
@@ -78,13 +182,18 @@ namespace itl2
 		@param refPoint Point in the reference image.
 		@param defPoint Point in the deformed image. Input value is used as initial guess of the shift. On output, will contain the shift that was estimated.
 		@param accuracy Stores a measure of the accuracy of the matching.
+		@param ws Temporary buffers.
 		*/
-		template<typename ref_t, typename def_t> void blockMatchOnePointMultires(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& coarseBlockRadius, size_t coarseBinning, const Vec3c& fineBlockRadius, size_t fineBinning, const Vec3c& refPoint, Vec3d& defPoint, double& accuracy)
+		template<typename ref_t, typename def_t> void blockMatchOnePointMultires(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& coarseBlockRadius, size_t coarseBinning, const Vec3c& fineBlockRadius, size_t fineBinning, const Vec3c& refPoint, Vec3d& defPoint, double& accuracy, BlockMatchWorkspace& ws)
 		{
-			blockMatchOnePoint(reference, deformed, coarseBlockRadius, refPoint, defPoint, accuracy, coarseBinning);
+			bool fineMatching = coarseBinning > fineBinning;
 
-			if(accuracy > 0 && coarseBinning > fineBinning)
-				blockMatchOnePoint(reference, deformed, fineBlockRadius, refPoint, defPoint, accuracy, fineBinning);
+			blockMatchOnePoint(reference, deformed, coarseBlockRadius, refPoint, defPoint, accuracy, coarseBinning, ws, fineMatching);
+
+			if(accuracy > 0 && fineMatching)
+				blockMatchOnePoint(reference, deformed, fineBlockRadius, refPoint, defPoint, accuracy, fineBinning, ws);
+
+			ws.timings.pointCount++;
 		}
 	}
 
@@ -107,12 +216,17 @@ namespace itl2
 			accuracy.push_back(0);
 
 		size_t counter = 0;
-		#pragma omp parallel for if(!omp_in_parallel())
-		for (coord_t n = 0; n < (coord_t)refPoints.size(); n++)
+		#pragma omp parallel if(!omp_in_parallel())
 		{
-			internals::blockMatchOnePoint(reference, deformed, blockRadius, refPoints[n], defPoints[n], accuracy[n]);
+			internals::BlockMatchWorkspace ws;
+
+			#pragma omp for schedule(dynamic)
+			for (coord_t n = 0; n < (coord_t)refPoints.size(); n++)
+			{
+				internals::blockMatchOnePoint(reference, deformed, blockRadius, refPoints[n], defPoints[n], accuracy[n], 1, ws);
 
-			showThreadProgress(counter, refPoints.size());
+				showThreadProgress(counter, refPoints.size());
+			}
 		}
 	}
 
@@ -245,81 +359,98 @@ namespace itl2
 		}
 	};
 
-	/*
-	Block matching for point grid and image output.
-	NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
-	*/
-	template<typename ref_t, typename def_t> void blockMatch(const Image<ref_t>& reference, const Image<def_t>& deformed, const PointGrid3D<coord_t>& refGrid, Image<Vec3d>& defPoints, Image<float32_t>& accuracy, const Vec3c& blockRadius)
+	namespace internals
 	{
-		accuracy.ensureSize(refGrid.pointCounts());
-		defPoints.ensureSize(refGrid.pointCounts());
-
-		size_t counter = 0;
-		#pragma omp parallel for if(!omp_in_parallel())
-		for (coord_t z = 0; z < defPoints.depth(); z++)
+		/*
+		Block matching for point grid and image output.
+		Each thread processes rows of grid points using its own set of temporary buffers.
+		NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
+		@param refOrigin, defOrigin Position of the reference and deformed images in the coordinate system of the grid and the deformed points.
+		@param timings If not nullptr, timing information of the matching stages is stored here.
+		*/
+		template<typename ref_t, typename def_t> void blockMatchGrid(const Image<ref_t>& reference, const Image<def_t>& deformed, const Vec3c& refOrigin, const Vec3c& defOrigin,
+			const PointGrid3D<coord_t>& refGrid, Image<Vec3d>& defPoints, Image<float32_t>& accuracy,
+			const Vec3c& coarseBlockRadius, size_t coarseBinning,
+			const Vec3c& fineBlockRadius, size_t fineBinning,
+			BlockMatchTimings* timings)
 		{
-			for (coord_t y = 0; y < defPoints.height(); y++)
+			accuracy.ensureSize(refGrid.pointCounts());
+			defPoints.ensureSize(refGrid.pointCounts());
+
+			coord_t rowCount = defPoints.height() * defPoints.depth();
+
+			BlockMatchTimings totalTimings;
+			size_t counter = 0;
+			#pragma omp parallel if(!omp_in_parallel())
 			{
-				for (coord_t x = 0; x < defPoints.width(); x++)
+				BlockMatchWorkspace ws;
+
+				#pragma omp for schedule(dynamic)
+				for (coord_t n = 0; n < rowCount; n++)
 				{
-					Vec3c refPoint = refGrid(x, y, z);
-					Vec3d defPoint = defPoints(x, y, z);
-					double gof;
+					coord_t y = n % defPoints.height();
+					coord_t z = n / defPoints.height();
 
-					internals::blockMatchOnePoint(reference, deformed, blockRadius, refPoint, defPoint, gof);
+					for (coord_t x = 0; x < defPoints.width(); x++)
+					{
+						Vec3c refPoint = refGrid(x, y, z) - refOrigin;
+						Vec3d defPoint = defPoints(x, y, z) - Vec3d(defOrigin);
+						double gof;
+
+						blockMatchOnePointMultires(reference, deformed, coarseBlockRadius, coarseBinning, fineBlockRadius, fineBinning, refPoint, defPoint, gof, ws);
+
+						defPoints(x, y, z) = defPoint + Vec3d(defOrigin);
+						accuracy(x, y, z) = (float32_t)gof;
+					}
 
-					defPoints(x, y, z) = defPoint;
-					accuracy(x, y, z) = (float32_t)gof;
+					showThreadProgress(counter, rowCount);
 				}
 
-				showThreadProgress(counter, defPoints.depth() * defPoints.height());
+				#pragma omp critical(blockmatch_timings)
+				{
+					totalTimings += ws.timings;
+				}
 			}
+
+			if (timings)
+				*timings = totalTimings;
 		}
 	}
 
+	/*
+	Block matching for point grid and image output.
+	NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
+	@param timings If not nullptr, timing information of the matching stages is stored here.
+	*/
+	template<typename ref_t, typename def_t> void blockMatch(const Image<ref_t>& reference, const Image<def_t>& deformed, const PointGrid3D<coord_t>& refGrid, Image<Vec3d>& defPoints, Image<float32_t>& accuracy, const Vec3c& blockRadius, BlockMatchTimings* timings = nullptr)
+	{
+		internals::blockMatchGrid(reference, deformed, Vec3c(0, 0, 0), Vec3c(0, 0, 0), refGrid, defPoints, accuracy, blockRadius, 1, blockRadius, 1, timings);
+	}
+
 
 	/*
 	Block matching for point grid and image output.
 	NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
+	@param timings If not nullptr, timing information of the matching stages is stored here.
 	*/
 	template<typename ref_t, typename def_t> void blockMatchMulti(const Image<ref_t>& reference, const Image<def_t>& deformed, const PointGrid3D<coord_t>& refGrid, Image<Vec3d>& defPoints, Image<float32_t>& accuracy,
 		const Vec3c& coarseBlockRadius, size_t coarseBinning,
-		const Vec3c& fineBlockRadius, size_t fineBinning)
+		const Vec3c& fineBlockRadius, size_t fineBinning,
+		BlockMatchTimings* timings = nullptr)
 	{
-		accuracy.ensureSize(refGrid.pointCounts());
-		defPoints.ensureSize(refGrid.pointCounts());
-
-		size_t counter = 0;
-#pragma omp parallel for if(!omp_in_parallel())
-		for (coord_t z = 0; z < defPoints.depth(); z++)
-		{
-			for (coord_t y = 0; y < defPoints.height(); y++)
-			{
-				for (coord_t x = 0; x < defPoints.width(); x++)
-				{
-					Vec3c refPoint = refGrid(x, y, z);
-					Vec3d defPoint = defPoints(x, y, z);
-					double gof;
-
-					internals::blockMatchOnePointMultires(reference, deformed, coarseBlockRadius, coarseBinning, fineBlockRadius, fineBinning, refPoint, defPoint, gof);
-
-					defPoints(x, y, z) = defPoint;
-					accuracy(x, y, z) = (float32_t)gof;
-				}
-
-				showThreadProgress(counter, defPoints.depth() * defPoints.height());
-			}
-		}
+		internals::blockMatchGrid(reference, deformed, Vec3c(0, 0, 0), Vec3c(0, 0, 0), refGrid, defPoints, accuracy, coarseBlockRadius, coarseBinning, fineBlockRadius, fineBinning, timings);
 	}
 
 	/*
 	Block matching for point grid and image output, loads images only partially.
 	NOTE: Assumes that zero pixels in the images represent unknown values. The unknown values are replaced by the nearest non-zero value.
+	@param timings If not nullptr, timing information of the matching stages is stored here.
 	*/
 	template<typename ref_t, typename def_t> void blockMatchPartialLoad(const string& referenceFile, const string& deformedFile, const PointGrid3D<coord_t>& refGrid, Image<Vec3d>& defPoints, Image<float32_t>& accuracy,
 		const Vec3c& coarseBlockRadius, size_t coarseBinning,
 		const Vec3c& fineBlockRadius, size_t fineBinning,
-		bool normalize, double& normFact, double& normFactStd, double& meanDef)
+		bool normalize, double& normFact, double& normFactStd, double& meanDef,
+		BlockMatchTimings* timings = nullptr)
 	{
 		accuracy.ensureSize(refGrid.pointCounts());
 		defPoints.ensureSize(refGrid.pointCounts());
@@ -388,27 +519,7 @@ namespace itl2
 		//std::cout << "Initial translation = " << mipTranslation << std::endl;
 
 
-		size_t counter = 0;
-		#pragma omp parallel for if(!omp_in_parallel())
-		for (coord_t z = 0; z < defPoints.depth(); z++)
-		{
-			for (coord_t y = 0; y < defPoints.height(); y++)
-			{
-				for (coord_t x = 0; x < defPoints.width(); x++)
-				{
-					Vec3c refPoint = refGrid(x, y, z) - refStart;
-					Vec3d defPoint = defPoints(x, y, z) - Vec3d(defStart);
-					double gof;
-
-					internals::blockMatchOnePointMultires(referenceBlock, deformedBlock, coarseBlockRadius, coarseBinning, fineBlockRadius, fineBinning, refPoint, defPoint, gof);
-
-					defPoints(x, y, z) = defPoint + Vec3d(defStart);
-					accuracy(x, y, z) = (float32_t)gof;
-				}
-
-				showThreadProgress(counter, defPoints.depth() * defPoints.height());
-			}
-		}
+		internals::blockMatchGrid(referenceBlock, deformedBlock, refStart, defStart, refGrid, defPoints, accuracy, coarseBlockRadius, coarseBinning, fineBlockRadius, fineBinning, timings);
 	}
 
 	/*
@@ -544,5 +655,6 @@ namespace itl2
 		void blockMatch2Pullback();
 		void mipMatch();
 		void pointsToDeformed();
+		void blockMatchWorkspace();
 	}
 }
\ No newline at end of file
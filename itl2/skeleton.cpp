@@ -6,6 +6,11 @@
 #include "io/raw.h"
 #include "pointprocess.h"
 #include "projections.h"
+#include "generation.h"
+#include "connectedcomponents.h"
+#include "testutils.h"
+
+#include <random>
 
 namespace itl2
 {
@@ -68,6 +73,75 @@ namespace itl2
 			raw::writed(head, "./skeleton/head_line_skeleton");
 		}
 
+		namespace
+		{
+			/*
+			Creates image containing random thick fibres.
+			*/
+			void createFibres(Image<uint8_t>& img)
+			{
+				std::mt19937 gen(123);
+				std::uniform_real_distribution<double> rnd(0, 1);
+				Vec3d size(img.dimensions());
+				for (size_t n = 0; n < 12; n++)
+				{
+					Vec3d start(rnd(gen) * size.x, rnd(gen) * size.y, rnd(gen) * size.z);
+					Vec3d end(rnd(gen) * size.x, rnd(gen) * size.y, rnd(gen) * size.z);
+					draw(img, Capsule<double>(start, end, 2 + 3 * rnd(gen)), (uint8_t)255);
+				}
+			}
+
+			size_t componentCount(const Image<uint8_t>& img)
+			{
+				Image<uint32_t> labels;
+				return connectedComponents(img, labels, Connectivity::AllNeighbours, (uint8_t)0, false);
+			}
+		}
+
+		void borderThinning()
+		{
+			Image<uint8_t> orig(70, 60, 50);
+			createFibres(orig);
+			size_t origCount = componentCount(orig);
+
+			for (bool line : { true, false })
+			{
+				string name = line ? "line skeleton" : "surface skeleton";
+
+				// Skeleton using the same border list in all iterations.
+				Image<uint8_t> skeleton;
+				setValue(skeleton, orig);
+				if (line)
+					itl2::lineSkeleton(skeleton);
+				else
+					itl2::surfaceSkeleton(skeleton, false);
+
+				// Skeleton where border points are searched from the whole image in each iteration.
+				Image<uint8_t> expected;
+				setValue(expected, orig);
+				while ((line ? lineThin(expected) : thin(expected, false)) > 0)
+				{
+				}
+
+				testAssert(equals(skeleton, expected), name + " and repeated thinning");
+				testAssert(componentCount(skeleton) == origCount, name + " component count");
+				testAssert(sum(skeleton) < sum(orig) / 10, name + " pixel count");
+
+				// The result must not depend on the number of threads.
+				int threads = omp_get_max_threads();
+				omp_set_num_threads(1);
+				Image<uint8_t> singleThreaded;
+				setValue(singleThreaded, orig);
+				if (line)
+					itl2::lineSkeleton(singleThreaded);
+				else
+					itl2::surfaceSkeleton(singleThreaded, false);
+				omp_set_num_threads(threads);
+
+				testAssert(equals(skeleton, singleThreaded), name + " with single thread");
+			}
+		}
+
 		//void cavities()
 		//{
 		//	Image<uint8_t> head;
@@ -1,5 +1,6 @@
 
 #include "stitching.h"
+#include "testutils.h"
 #include <cmath>
 
 namespace itl2
@@ -113,5 +114,55 @@ namespace itl2
 			//raw::writed(output, "./elastic_stitching/test_output");
 
 		}
+
+		void stitchLattice()
+		{
+			// Smooth source image so that small errors in the deformation do not cause large errors in pixel values.
+			Image<float32_t> src(90, 80, 70);
+			for (coord_t z = 0; z < src.depth(); z++)
+				for (coord_t y = 0; y < src.height(); y++)
+					for (coord_t x = 0; x < src.width(); x++)
+						src(x, y, z) = (float32_t)(1000 + 100 * std::sin(x / 7.0) * std::cos(y / 9.0) + 2 * z);
+
+			PointGrid3D<coord_t> refPoints(PointGrid1D<coord_t>(5, 85, 16), PointGrid1D<coord_t>(5, 75, 14), PointGrid1D<coord_t>(5, 65, 12));
+			Image<Vec3f> shifts(refPoints.xg.pointCount(), refPoints.yg.pointCount(), refPoints.zg.pointCount());
+			for (coord_t k = 0; k < shifts.depth(); k++)
+				for (coord_t j = 0; j < shifts.height(); j++)
+					for (coord_t i = 0; i < shifts.width(); i++)
+						shifts(i, j, k) = Vec3f((float32_t)(3 * std::sin(i + 0.5 * k)), (float32_t)(2 * std::cos(0.7 * j)), (float32_t)(0.3 * i - 1));
+
+			Vec3c outPos(20, 10, 15);
+			Vec3c outSize(50, 47, 41);
+
+			// Lattice spacing 1 evaluates the deformation field exactly at each pixel.
+			Image<float32_t> expected(outSize), expectedWeight(outSize), expectedS(outSize);
+			internals::stitchOneVer3<float32_t, float32_t>(src, refPoints, shifts, 0, 1, 0, outPos, expected, expectedWeight, &expectedS, false, 1);
+
+			Image<float32_t> result(outSize), resultWeight(outSize), resultS(outSize);
+			internals::stitchOneVer3<float32_t, float32_t>(src, refPoints, shifts, 0, 1, 0, outPos, result, resultWeight, &resultS, false);
+
+			float32_t maxDiff = 0;
+			for (coord_t n = 0; n < expected.pixelCount(); n++)
+				maxDiff = std::max(maxDiff, std::abs(expected(n) - result(n)));
+			testAssert(maxDiff < 2, string("lattice interpolation of deformation, max difference = ") + toString(maxDiff));
+
+			// Stitching from a block of the source image must give the same result than stitching from the full image.
+			Vec3c start, end;
+			testAssert(internals::stitchRegion(refPoints, src.dimensions(), outPos, outSize, start, end), "stitch region");
+			internals::DeformationLattice<float32_t> lattice(start, end, internals::DEFORMATION_LATTICE_SPACING, refPoints, shifts);
+
+			Vec3c blockPos, blockSize;
+			testAssert(internals::sourceBlock(lattice, src.dimensions(), blockPos, blockSize), "source block");
+			testAssert(blockSize.x < src.width() && blockSize.y < src.height() && blockSize.z < src.depth(), "source block is not smaller than the source image");
+
+			Image<float32_t> block(blockSize);
+			crop(src, block, blockPos);
+
+			Image<float32_t> blockResult(outSize), blockWeight(outSize), blockS(outSize);
+			internals::stitchOneVer3<float32_t, float32_t>(block, blockPos, src.dimensions(), lattice, start, end, 0, 1, 0, outPos, blockResult, blockWeight, &blockS, false);
+
+			testAssert(equals(result, blockResult), "stitching from source block");
+			testAssert(equals(resultWeight, blockWeight), "stitching weights from source block");
+		}
 	}
 }
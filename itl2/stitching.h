@@ -880,131 +880,326 @@ namespace itl2
 		//	}
 		//}
 
+		/*
+		Spacing of the lattice where the deformation field is evaluated in stitchOneVer3.
+		*/
+		constexpr coord_t DEFORMATION_LATTICE_SPACING = 8;
+
+		/*
+		Calculates the region of the output image where stitchOneVer3 processes pixels, given reference grid of the source image.
+		@return False if the region is empty.
+		*/
+		inline bool stitchRegion(const PointGrid3D<coord_t>& refPoints, const Vec3c& srcDimensions, const Vec3c& outPos, const Vec3c& outSize, Vec3c& start, Vec3c& end)
+		{
+			// TODO: Add some padding so that deformations caused by the local deformation field do not result in cut image.
+			start = max(Vec3c(refPoints.xg.first, refPoints.yg.first, refPoints.zg.first), outPos);
+			end = min(Vec3c(refPoints.xg.maximum, refPoints.yg.maximum, refPoints.zg.maximum), outPos + outSize);
+
+			if (getDimensionality(srcDimensions) < 3)
+			{
+				start.z = 0;
+				end.z = 1;
+			}
+
+			return start.x < end.x && start.y < end.y && start.z < end.z;
+		}
+
+		/*
+		Deformation field (shifts from output image coordinates to source image coordinates) evaluated
+		at regular lattice covering a region of the output image.
+		Evaluating cubic interpolation of the shift grid is expensive, so it is done only at the lattice points,
+		and the shifts are interpolated linearly between them.
+		*/
+		template<typename real_t> class DeformationLattice
+		{
+		private:
+			/*
+			Position of the first lattice point and the end of the covered region.
+			*/
+			Vec3c start, end;
+
+			/*
+			Distance between lattice points.
+			*/
+			coord_t spacing;
+
+			/*
+			Shifts at the lattice points.
+			*/
+			Image<Vec3<real_t> > values;
+
+			/*
+			Finds index of lattice point preceding the given coordinate, and the fractional position between it and the next lattice point.
+			*/
+			void locate(coord_t x, coord_t dim, coord_t& i0, coord_t& i1, real_t& f) const
+			{
+				coord_t n = values.dimension(dim);
+				coord_t u = x - start[dim];
+				i0 = std::min(u / spacing, std::max<coord_t>(n - 2, 0));
+				i1 = std::min(i0 + 1, n - 1);
+				f = (real_t)(u - i0 * spacing) / spacing;
+			}
+
+		public:
+			/*
+			Evaluates the deformation field at lattice points covering region [start, end[ of the output image.
+			*/
+			DeformationLattice(const Vec3c& start, const Vec3c& end, coord_t spacing, const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts) :
+				start(start),
+				end(end),
+				spacing(spacing)
+			{
+				// NOTE: Cubic interpolator will overshoot, linear is rough. Perhaps monotone cubic would be the best for shifts?
+				CubicInterpolator<Vec3<real_t>, Vec3<real_t>, real_t, Vec3<real_t> > shiftInterpolator(BoundaryCondition::Nearest);
+
+				// The last lattice point is at or after the last pixel of the region.
+				Vec3c size = end - start;
+				values.ensureSize((size.x - 2 + spacing) / spacing + 1, (size.y - 2 + spacing) / spacing + 1, (size.z - 2 + spacing) / spacing + 1);
+
+				#pragma omp parallel for if(values.pixelCount() * 64 > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+				for (coord_t k = 0; k < values.depth(); k++)
+				{
+					for (coord_t j = 0; j < values.height(); j++)
+					{
+						for (coord_t i = 0; i < values.width(); i++)
+						{
+							Vec3<real_t> X(position(i, j, k));
+							values(i, j, k) = projectPointToDeformed(X, refPoints, shifts, shiftInterpolator);
+						}
+					}
+				}
+			}
+
+			/*
+			Gets position of the given lattice point in the output image.
+			*/
+			Vec3c position(coord_t i, coord_t j, coord_t k) const
+			{
+				return start + spacing * Vec3c(i, j, k);
+			}
+
+			/*
+			Calculates bounding box of the positions in the source image where the pixels of the covered region are mapped to.
+			As the shifts are interpolated linearly between lattice points, the mapped positions are always inside the box
+			spanned by the mapped lattice points.
+			*/
+			void mappedBounds(Vec3<real_t>& pmin, Vec3<real_t>& pmax) const
+			{
+				pmin = Vec3<real_t>(std::numeric_limits<real_t>::infinity(), std::numeric_limits<real_t>::infinity(), std::numeric_limits<real_t>::infinity());
+				pmax = -pmin;
+				for (coord_t k = 0; k < values.depth(); k++)
+				{
+					for (coord_t j = 0; j < values.height(); j++)
+					{
+						for (coord_t i = 0; i < values.width(); i++)
+						{
+							Vec3<real_t> p = Vec3<real_t>(position(i, j, k)) + values(i, j, k);
+							pmin = min(pmin, p);
+							pmax = max(pmax, p);
+						}
+					}
+				}
+			}
+
+			/*
+			Interpolates the shifts of lattice points on line (y, z) of the output image.
+			@param row The shifts at lattice points with x-coordinates start.x, start.x + spacing, etc. are stored here.
+			*/
+			void row(coord_t y, coord_t z, std::vector<Vec3<real_t> >& row) const
+			{
+				coord_t j0, j1, k0, k1;
+				real_t fy, fz;
+				locate(y, 1, j0, j1, fy);
+				locate(z, 2, k0, k1, fz);
+
+				row.resize(values.width());
+				for (coord_t i = 0; i < values.width(); i++)
+				{
+					Vec3<real_t> v0 = values(i, j0, k0) * (1 - fy) + values(i, j1, k0) * fy;
+					Vec3<real_t> v1 = values(i, j0, k1) * (1 - fy) + values(i, j1, k1) * fy;
+					row[i] = v0 * (1 - fz) + v1 * fz;
+				}
+			}
+
+			/*
+			Interpolates shift at location x on a line, given shifts calculated using row method.
+			*/
+			Vec3<real_t> inRow(const std::vector<Vec3<real_t> >& row, coord_t x) const
+			{
+				coord_t i0, i1;
+				real_t fx;
+				locate(x, 0, i0, i1, fx);
+				return row[i0] * (1 - fx) + row[i1] * fx;
+			}
+		};
+
+		/*
+		Calculates the block of the source image that is needed to stitch the region covered by the given deformation lattice.
+		@return False if the region does not map inside the source image.
+		*/
+		template<typename real_t> bool sourceBlock(const DeformationLattice<real_t>& lattice, const Vec3c& srcDimensions, Vec3c& blockPos, Vec3c& blockSize)
+		{
+			Vec3<real_t> pmin, pmax;
+			lattice.mappedBounds(pmin, pmax);
+
+			if (!std::isfinite(pmin.x) || !std::isfinite(pmin.y) || !std::isfinite(pmin.z) ||
+				!std::isfinite(pmax.x) || !std::isfinite(pmax.y) || !std::isfinite(pmax.z))
+			{
+				// Unable to determine the bounds, so use the whole image.
+				blockPos = Vec3c(0, 0, 0);
+				blockSize = srcDimensions;
+				return true;
+			}
+
+			// Cubic interpolation requires one pixel before and two pixels after the floor of the position.
+			// Add one pixel on both sides as a safety margin against rounding errors.
+			Vec3c blockEnd = floor(pmax) + Vec3c(4, 4, 4);
+			blockPos = floor(pmin) - Vec3c(2, 2, 2);
+
+			clamp(blockPos, Vec3c(0, 0, 0), srcDimensions);
+			clamp(blockEnd, Vec3c(0, 0, 0), srcDimensions);
+
+			blockSize = blockEnd - blockPos;
+			return blockSize.x > 0 && blockSize.y > 0 && blockSize.z > 0;
+		}
+
 		/*
 		Stitch src image and the corresponding transformation to output image, and update weight image.
-		This function only processes region starting at outPos and having the size of output image.
+		This function only processes region covered by the given deformation lattice.
 		This version can also calculate standard deviation of overlapping images in the overlapping regions.
 		After calling the method for all input images:
 		- image mean does not need further processing.
 		- image S must be divided by image weight and to get standard deviation, sqrt must be taken.
+		@param src Block of the source image.
+		@param srcBlockPos Position of the block in the source image.
+		@param srcDimensions Dimensions of the full source image.
 		*/
 		template<typename pixel_t, typename real_t> void stitchOneVer3(
-			const Image<pixel_t>& src,
-			const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts,
+			const Image<pixel_t>& src, const Vec3c& srcBlockPos, const Vec3c& srcDimensions,
+			const DeformationLattice<real_t>& lattice, const Vec3c& start, const Vec3c& end,
 			real_t normFactor, real_t normFactorStd, real_t meanDef,
 			const Vec3c& outPos, Image<real_t>& mean, Image<real_t>& weight, Image<real_t>* S,
 			bool normalize)
 		{
 			//const Interpolator<real_t, pixel_t, real_t>& interpolator = NearestNeighbourInterpolator<real_t, pixel_t, real_t>(BoundaryCondition::Zero);
 			//const Interpolator<real_t, pixel_t, real_t>& interpolator = LinearInvalidValueInterpolator<real_t, pixel_t, real_t>(BoundaryCondition::Zero, 0, 0);
-			const Interpolator<real_t, pixel_t, real_t>& interpolator = CubicInvalidValueInterpolator<real_t, pixel_t, real_t>(BoundaryCondition::Zero, 0, 0);
 			//const Interpolator<real_t, pixel_t, real_t>& interpolator = CubicInterpolator<real_t, pixel_t, real_t>(BoundaryCondition::Zero);
+			// The concrete interpolator type is used so that the interpolation does not involve virtual function calls.
+			const CubicInvalidValueInterpolator<real_t, pixel_t, real_t> interpolator(BoundaryCondition::Zero, 0, 0);
 
-			// NOTE: Cubic interpolator will overshoot, linear is rough. Perhaps monotone cubic would be the best for shifts?
-			//const Interpolator<Vec3<real_t>, Vec3<real_t>, real_t>& shiftInterpolator = LinearInterpolator<Vec3<real_t>, Vec3<real_t>, real_t, Vec3<real_t> >(BoundaryCondition::Nearest);
-			const Interpolator<Vec3<real_t>, Vec3<real_t>, real_t>& shiftInterpolator = CubicInterpolator<Vec3<real_t>, Vec3<real_t>, real_t, Vec3<real_t> >(BoundaryCondition::Nearest);
+			coord_t xmin = start.x;
+			coord_t ymin = start.y;
+			coord_t zmin = start.z;
+			coord_t xmax = end.x;
+			coord_t ymax = end.y;
+			coord_t zmax = end.z;
 
-			Vec3c cc(refPoints.xg.first, refPoints.yg.first, refPoints.zg.first);
-			Vec3c cd(refPoints.xg.maximum, refPoints.yg.maximum, refPoints.zg.maximum);
-
-			coord_t xmin = cc.x;
-			coord_t ymin = cc.y;
-			coord_t zmin = cc.z;
-			coord_t xmax = cd.x;
-			coord_t ymax = cd.y;
-			coord_t zmax = cd.z;
-
-			// TODO: Add some padding so that deformations caused by the local deformation field do not result in cut image.
-
-			xmin = std::max(xmin, outPos.x);
-			ymin = std::max(ymin, outPos.y);
-			zmin = std::max(zmin, outPos.z);
-
-			xmax = std::min(xmax, outPos.x + mean.width());
-			ymax = std::min(ymax, outPos.y + mean.height());
-			zmax = std::min(zmax, outPos.z + mean.depth());
-
-			Vec3c srcDimensions = src.dimensions();
 			coord_t s = srcDimensions.min();
-
-			if (src.dimensionality() < 3)
-			{
-				zmin = 0;
-				zmax = 1;
-			}
+			bool is3D = getDimensionality(srcDimensions) >= 3;
+			Vec3<real_t> srcBlockPosR(srcBlockPos);
 
 			std::cout << "Transforming..." << std::endl;
 			// Process all pixels in the relevant region of the target image and find source image value at each location.
 			size_t counter = 0;
-#pragma omp parallel for if((zmax-zmin)*(ymax-ymin)*(xmax-xmin) > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
-			for (coord_t z = zmin; z < zmax; z++)
+#pragma omp parallel if((zmax-zmin)*(ymax-ymin)*(xmax-xmin) > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
 			{
-				for (coord_t y = ymin; y < ymax; y++)
+				std::vector<Vec3<real_t> > shiftRow;
+
+#pragma omp for
+				for (coord_t z = zmin; z < zmax; z++)
 				{
-					for (coord_t x = xmin; x < xmax; x++)
+					for (coord_t y = ymin; y < ymax; y++)
 					{
-						// X is position in the output image
-						Vec3<real_t> X((real_t)x, (real_t)y, (real_t)z);
+						lattice.row(y, z, shiftRow);
 
-						// Convert X to p, position in the input image.
-						Vec3<real_t> p = X + internals::projectPointToDeformed(X, refPoints, shifts, shiftInterpolator);
+						for (coord_t x = xmin; x < xmax; x++)
+						{
+							// X is position in the output image
+							Vec3<real_t> X((real_t)x, (real_t)y, (real_t)z);
 
-						// Convert p to pdot, position in the input block.
-						//Vec3<real_t> pdot = p - Vec3<real_t>(srcBlockPos);
-						Vec3<real_t> pdot = p; // No src block support
+							// Convert X to p, position in the input image.
+							Vec3<real_t> p = X + lattice.inRow(shiftRow, x);
 
-						if (src.isInImage(pdot))
-						{
-							real_t pix = interpolator(src, pdot);
-							if (pix != 0) // Don't process pixels that could not be interpolated (are given background value)
+							if (p.x >= 0 && p.y >= 0 && p.z >= 0 && (coord_t)p.x < srcDimensions.x && (coord_t)p.y < srcDimensions.y && (coord_t)p.z < srcDimensions.z)
 							{
-								if (normalize)
-									pix = (pix - meanDef) * normFactorStd + meanDef + normFactor;
-									//pix += normFactor;
+								// Convert p to pdot, position in the input block.
+								Vec3<real_t> pdot = p - srcBlockPosR;
 
-								real_t w1 = 2 * std::min(p.x, srcDimensions.x - 1 - p.x) / s;
-								real_t w2 = 2 * std::min(p.y, srcDimensions.y - 1 - p.y) / s;
-								real_t w3 = 2 * std::min(p.z, srcDimensions.z - 1 - p.z) / s;
+								real_t pix = interpolator.interpolate(src, pdot.x, pdot.y, pdot.z);
+								if (pix != 0) // Don't process pixels that could not be interpolated (are given background value)
+								{
+									if (normalize)
+										pix = (pix - meanDef) * normFactorStd + meanDef + normFactor;
+										//pix += normFactor;
 
-								if (src.dimensionality() < 3)
-									w3 = 1;
+									real_t w1 = 2 * std::min(p.x, srcDimensions.x - 1 - p.x) / s;
+									real_t w2 = 2 * std::min(p.y, srcDimensions.y - 1 - p.y) / s;
+									real_t w3 = 2 * std::min(p.z, srcDimensions.z - 1 - p.z) / s;
 
-								real_t ww = w1 * w2 * w3;
+									if (!is3D)
+										w3 = 1;
 
-								if (ww > 0)
-								{
-									// Finally transform to the coordinates of the region of the target image that we are processing
-									coord_t xo = x - outPos.x;
-									coord_t yo = y - outPos.y;
-									coord_t zo = z - outPos.z;
+									real_t ww = w1 * w2 * w3;
 
-									if (xo >= 0 && yo >= 0 && zo >= 0 && xo < mean.width() && yo < mean.height() && zo < mean.depth())
+									if (ww > 0)
 									{
-										// Calculate mean and, if requested, standard deviation.
-										// This uses algorithm from West, D. H. D. (1979). "Updating Mean and Variance Estimates: An Improved Method". 
-										// See also https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance -> Weighted incremental algorithm
+										// Finally transform to the coordinates of the region of the target image that we are processing
+										coord_t xo = x - outPos.x;
+										coord_t yo = y - outPos.y;
+										coord_t zo = z - outPos.z;
+
+										if (xo >= 0 && yo >= 0 && zo >= 0 && xo < mean.width() && yo < mean.height() && zo < mean.depth())
+										{
+											// Calculate mean and, if requested, standard deviation.
+											// This uses algorithm from West, D. H. D. (1979). "Updating Mean and Variance Estimates: An Improved Method". 
+											// See also https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance -> Weighted incremental algorithm
 
-										real_t& wSum = weight(xo, yo, zo);
-										wSum += ww;
-										
-										real_t& meanNew = mean(xo, yo, zo);
-										real_t meanOld = meanNew;
+											real_t& wSum = weight(xo, yo, zo);
+											wSum += ww;
+											
+											real_t& meanNew = mean(xo, yo, zo);
+											real_t meanOld = meanNew;
 
-										meanNew = meanOld + (ww / wSum) * (pix - meanOld);
+											meanNew = meanOld + (ww / wSum) * (pix - meanOld);
 
-										if (S)
-											(*S)(xo, yo, zo) += ww * (pix - meanOld) * (pix - meanNew);
+											if (S)
+												(*S)(xo, yo, zo) += ww * (pix - meanOld) * (pix - meanNew);
 
+										}
 									}
 								}
 							}
 						}
 					}
-				}
 
-				showThreadProgress(counter, zmax - zmin);
+					showThreadProgress(counter, zmax - zmin);
+				}
 			}
 		}
+
+		/*
+		Stitch src image and the corresponding transformation to output image, and update weight image.
+		This function only processes region starting at outPos and having the size of output image.
+		This version can also calculate standard deviation of overlapping images in the overlapping regions.
+		After calling the method for all input images:
+		- image mean does not need further processing.
+		- image S must be divided by image weight and to get standard deviation, sqrt must be taken.
+		@param latticeSpacing Spacing of the lattice where the deformation field is evaluated.
+		*/
+		template<typename pixel_t, typename real_t> void stitchOneVer3(
+			const Image<pixel_t>& src,
+			const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts,
+			real_t normFactor, real_t normFactorStd, real_t meanDef,
+			const Vec3c& outPos, Image<real_t>& mean, Image<real_t>& weight, Image<real_t>* S,
+			bool normalize, coord_t latticeSpacing = DEFORMATION_LATTICE_SPACING)
+		{
+			Vec3c start, end;
+			if (!stitchRegion(refPoints, src.dimensions(), outPos, mean.dimensions(), start, end))
+				return;
+
+			DeformationLattice<real_t> lattice(start, end, latticeSpacing, refPoints, shifts);
+			stitchOneVer3(src, Vec3c(0, 0, 0), src.dimensions(), lattice, start, end, normFactor, normFactorStd, meanDef, outPos, mean, weight, S, normalize);
+		}
 	}
 
 
@@ -1196,21 +1391,35 @@ namespace itl2
 				//	}
 				//}
 
+				Vec3c start, end;
+				if (!internals::stitchRegion(refPoints, srcDimensions, outputPos, outputSize, start, end))
+					continue;
+
 				Image<Vec3<float32_t> > shifts;
 				internals::readShifts(wlPrefix, refPoints, shifts);
 
-				Image<pixel_t> src(srcDimensions);
-				io::read(src, imgFile);
+				internals::DeformationLattice<float32_t> lattice(start, end, internals::DEFORMATION_LATTICE_SPACING, refPoints, shifts);
+
+				// Read only the part of the source image that maps to the output region.
+				Vec3c srcBlockPos, srcBlockSize;
+				if (!internals::sourceBlock(lattice, srcDimensions, srcBlockPos, srcBlockSize))
+					continue;
+
+				Image<pixel_t> src(srcBlockSize);
+				if (srcBlockSize == srcDimensions)
+					io::read(src, imgFile);
+				else
+					io::readBlock(src, imgFile, srcBlockPos);
 
 				if (maskMaxCircle)
 				{
 					Image<pixel_t> mask(src.width(), src.height());
-					float32_t d = (float32_t)std::min(src.width(), src.height());
-					draw<pixel_t>(mask, Sphere<float32_t>(Vec3f(src.width() / 2.0f, src.height() / 2.0f, 0), d / 2.0f), (pixel_t)1);
+					float32_t d = (float32_t)std::min(srcDimensions.x, srcDimensions.y);
+					draw<pixel_t>(mask, Sphere<float32_t>(Vec3f(srcDimensions.x / 2.0f - srcBlockPos.x, srcDimensions.y / 2.0f - srcBlockPos.y, 0), d / 2.0f), (pixel_t)1);
 					multiply(src, mask, true);
 				}
 
-				internals::stitchOneVer3<pixel_t, float32_t>(src, refPoints, shifts, normFact, normFactStd, meanDef, outputPos, out, weight, std ? &stdtmp : nullptr, normalize);
+				internals::stitchOneVer3<pixel_t, float32_t>(src, srcBlockPos, srcDimensions, lattice, start, end, normFact, normFactStd, meanDef, outputPos, out, weight, std ? &stdtmp : nullptr, normalize);
 			}
 		}
 
@@ -1234,4 +1443,9 @@ namespace itl2
 			convert(stdtmp, *std);
 		}
 	}
+
+	namespace tests
+	{
+		void stitchLattice();
+	}
 }
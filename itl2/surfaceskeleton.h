@@ -5,6 +5,7 @@
 #include "utilities.h"
 #include "minhash.h"
 #include "math/vec3.h"
+#include "thinning.h"
 
 #include <algorithm>
 
@@ -951,97 +952,72 @@ namespace itl2
 	}
 
 
-	/*
-	Performs one thinning iteration and returns count of pixels removed from the image.
-	Repeating this thinning process until the image does not change results in skeleton.
-	@param retainSurfaces If true, surfaces are not thinned to lines.
-	@param img Image that should be thinned.
-	*/
-	template<typename pixel_t> size_t thin(Image<pixel_t>& img, bool retainSurfaces)
+	namespace internals
 	{
-		internals::createAllowedHashList();
-
-		size_t changed = 0;
-		size_t counter = 0;
-		std::vector<Vec3c> pointsToRemove;
-		pointsToRemove.reserve(10000);
-
-		for (int currentBorder = 1; currentBorder <= 6; currentBorder++)
+		/*
+		Performs one thinning iteration using the given thinning engine and returns count of pixels removed from the image.
+		@param retainSurfaces If true, surfaces are not thinned to lines.
+		*/
+		template<typename pixel_t> size_t thin(BorderThinning<pixel_t>& thinning, bool retainSurfaces)
 		{
-			pointsToRemove.clear();
-
-			#pragma omp parallel
-			{
-				Image<uint8_t> nbPrivate(3, 3, 3);
+			createAllowedHashList();
 
-				#pragma omp for
-				for (coord_t z = 0; z < img.depth(); z++)
+			return thinning.template iterate<uint8_t>(
+				[](int currentBorder, const Image<pixel_t>& img, coord_t x, coord_t y, coord_t z)
 				{
-					for (coord_t y = 0; y < img.height(); y++)
+					// check 6-neighbors to see if the point is a border point of type currentBorder
+					switch (currentBorder)
 					{
-						for (coord_t x = 0; x < img.width(); x++)
-						{
-							pixel_t c = img(x, y, z);
-							if (c != (pixel_t)0)
-							{
-
-								// check 6-neighbors to see if the point is a border point of type currentBorder
-								bool isBorderPoint = false;
-								switch (currentBorder)
-								{
-								case 1: isBorderPoint = internals::N(img, x, y, z); break;
-								case 2: isBorderPoint = internals::S(img, x, y, z); break;
-								case 3: isBorderPoint = internals::E(img, x, y, z); break;
-								case 4: isBorderPoint = internals::W(img, x, y, z); break;
-								case 5: isBorderPoint = internals::U(img, x, y, z); break;
-								case 6: isBorderPoint = internals::B(img, x, y, z); break;
-								}
-
-								if (isBorderPoint)
-								{
-									getNeighbourhood(img, Vec3c(x, y, z), Vec3c(1, 1, 1), nbPrivate, BoundaryCondition::Zero);
-
-									if (!internals::isEndPoint(nbPrivate) &&
-										internals::isEulerInvariant(nbPrivate) &&
-										internals::isSimplePointHybrid(nbPrivate))
-									{
-										#pragma omp critical(surfacethin_insert)
-											pointsToRemove.push_back(Vec3c(x, y, z));
-									}
-								}
-							}
-						}
-
+					case 1: return N(img, x, y, z);
+					case 2: return S(img, x, y, z);
+					case 3: return E(img, x, y, z);
+					case 4: return W(img, x, y, z);
+					case 5: return U(img, x, y, z);
+					case 6: return B(img, x, y, z);
 					}
+					return false;
+				},
+				[](const Image<uint8_t>& nb)
+				{
+					return !isEndPoint(nb) &&
+						isEulerInvariant(nb) &&
+						isSimplePointHybrid(nb);
+				},
+				[&](const coord_t* begin, const coord_t* end, std::vector<coord_t>& removed)
+				{
+					// Re-check while removing points so that connectivity is preserved.
+					Image<pixel_t>& img = thinning.image();
+					Image<uint8_t> nb(3, 3, 3);
+					for (const coord_t* pi = begin; pi != end; pi++)
+					{
+						Vec3c p = img.getCoords(*pi);
 
-					showThreadProgress(counter, 6 * img.depth());
-				}
-			}
-
-			// This is required to make the result exactly the same than in Fiji (non-threaded version)
-			// Otherwise, the point removal order may change the skeleton points.
-			std::sort(pointsToRemove.begin(), pointsToRemove.end(), vecComparer<coord_t>);
-
-			// Re-check while removing points so that connectivity is preserved.
-			Image<uint8_t> nb(3, 3, 3);
-			for (size_t n = 0; n < pointsToRemove.size(); n++)
-			{
-				Vec3c p = pointsToRemove[n];
-
-				getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
-				//nb(1, 1, 1) = 0; // This must not be done. Function isSimplePointHybrid does not consider the center pixel, but it is needed for isSurfacePoint.
+						getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
+						//nb(1, 1, 1) = 0; // This must not be done. Function isSimplePointHybrid does not consider the center pixel, but it is needed for isSurfacePoint.
 
-				if (internals::isSimplePointHybrid(nb) &&
-					((retainSurfaces && !internals::isSurfacePoint(nb)) || !retainSurfaces)
-					)
-				{
-					img(p) = 0;
-					changed++;
-				}
-			}
+						if (isSimplePointHybrid(nb) &&
+							((retainSurfaces && !isSurfacePoint(nb)) || !retainSurfaces)
+							)
+						{
+							img(*pi) = 0;
+							removed.push_back(*pi);
+						}
+					}
+				});
 		}
+	}
 
-		return changed;
+	/*
+	Performs one thinning iteration and returns count of pixels removed from the image.
+	Repeating this thinning process until the image does not change results in skeleton.
+	If multiple iterations are required, it is faster to use surfaceSkeleton function.
+	@param retainSurfaces If true, surfaces are not thinned to lines.
+	@param img Image that should be thinned.
+	*/
+	template<typename pixel_t> size_t thin(Image<pixel_t>& img, bool retainSurfaces)
+	{
+		internals::BorderThinning<pixel_t> thinning(img);
+		return internals::thin(thinning, retainSurfaces);
 	}
 
 	/*
@@ -1063,17 +1039,20 @@ namespace itl2
 	This version also uses additional conditions to avoid skeletonizing that are not present in Lee's paper. See internals::isSurfacePoint
 	and internals::createAllowedHashList for details.
 	The resulting skeleton consists of planes (= surfaces) (not lines) so it is referred to as "surface skeleton".
+	The image is scanned only once, and after that only the border points of the structure are processed.
+	The points are removed in parallel in slabs, so the result may differ from Fiji in a few pixels near slab boundaries, but it does not depend on the number of threads.
 	@param retainSurfaces If true, surfaces are not thinned to lines. If false, as many surfaces as possible are turned into lines, and only those surfaces will be left that surround a cavity.
 	@param img Image that should be skeletonized.
 	*/
 	template<typename pixel_t> void surfaceSkeleton(Image<pixel_t>& img, bool retainSurfaces = true, size_t maxIterations = std::numeric_limits<size_t>::max())
 	{
+		internals::BorderThinning<pixel_t> thinning(img);
 
 		size_t it = 0;
 		size_t changes;
 		do
 		{
-			changes = thin(img, retainSurfaces);
+			changes = internals::thin(thinning, retainSurfaces);
 
 			std::cout << std::endl << changes << " pixels removed." << std::endl;
 
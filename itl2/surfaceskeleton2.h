@@ -155,7 +155,7 @@ namespace itl2
 		Performs one thinning iteration and returns count of pixels removed from the image.
 		Repeating this thinning process until the image does not change results in hybrid skeleton.
 
-		This method gives the same results as itl2::surfaceThin.
+		This method gives the same results as itl2::surfaceThin, except near the slab boundaries where itl2::surfaceThin removes points in different order.
 
 		@param img Image that should be thinned.
 		*/
@@ -257,7 +257,7 @@ namespace itl2
 		but additional conditions are added as those in the paper are not sufficient in many practical cases.
 		See internals::isSurfacePoint and internals::createAllowedHashList for details.
 
-		This method gives the same results as itl2::surfaceSkeleton, but is slower (although probably more understandable).
+		This method gives the same results as itl2::surfaceSkeleton (except near slab boundaries), but is slower (although probably more understandable).
 		*/
 		template<typename pixel_t> void surfaceSkeleton2(Image<pixel_t>& img, size_t maxIterations = std::numeric_limits<size_t>::max())
 		{
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "image.h"
+#include "neighbourhood.h"
+#include "utilities.h"
+#include "math/vec3.h"
+
+namespace itl2
+{
+	namespace internals
+	{
+		/*
+		Thickness of the z-slabs in which candidate points are removed in parallel in BorderThinning.
+		*/
+		constexpr coord_t THINNING_SLAB_THICKNESS = 16;
+
+		/*
+		Thinning engine that keeps a list of border points, i.e. foreground points that have a background 6-neighbour.
+		Only neighbours of removed points can become new border points, so the image is scanned only when the engine is created.
+		The border points are stored as linear indices in increasing order, i.e. sorted by z, y, and x coordinates.
+
+		Each thinning iteration consists of 6 subiterations, one for each border direction.
+		In each subiteration, border points of the current direction are tested in parallel to find candidates for removal.
+		The candidates are then re-tested and removed sequentially in z-slabs of THINNING_SLAB_THICKNESS slices.
+		Even slabs are processed in parallel first, and odd slabs after that. Slabs processed at the same time
+		do not read pixels modified by each other, and the points of each slab are processed in fixed order,
+		so the result does not depend on the number of threads.
+		*/
+		template<typename pixel_t> class BorderThinning
+		{
+		private:
+			Image<pixel_t>& img;
+
+			/*
+			Linear indices of border points, sorted.
+			*/
+			std::vector<coord_t> border;
+
+			/*
+			Tests if the given foreground point has a background 6-neighbour.
+			*/
+			bool isBorder(coord_t x, coord_t y, coord_t z) const
+			{
+				return (x > 0 && img(x - 1, y, z) == (pixel_t)0) ||
+					(x < img.width() - 1 && img(x + 1, y, z) == (pixel_t)0) ||
+					(y > 0 && img(x, y - 1, z) == (pixel_t)0) ||
+					(y < img.height() - 1 && img(x, y + 1, z) == (pixel_t)0) ||
+					(z > 0 && img(x, y, z - 1) == (pixel_t)0) ||
+					(z < img.depth() - 1 && img(x, y, z + 1) == (pixel_t)0);
+			}
+
+			/*
+			Removes background points from the border list and adds foreground 6-neighbours of removed points to it.
+			*/
+			void updateBorder(const std::vector<std::vector<coord_t> >& removed, size_t removedCount)
+			{
+				if (removedCount <= 0)
+					return;
+
+				std::vector<coord_t> added;
+				for (const std::vector<coord_t>& list : removed)
+				{
+					for (coord_t i : list)
+					{
+						Vec3c p = img.getCoords(i);
+						for (size_t dim = 0; dim < 3; dim++)
+						{
+							for (coord_t delta = -1; delta <= 1; delta += 2)
+							{
+								Vec3c q = p;
+								q[dim] += delta;
+								if (img.isInImage(q) && img(q) != (pixel_t)0)
+									added.push_back((coord_t)img.getLinearIndex(q));
+							}
+						}
+					}
+				}
+
+				border.erase(std::remove_if(border.begin(), border.end(), [&](coord_t i) { return img(i) == (pixel_t)0; }), border.end());
+
+				std::sort(added.begin(), added.end());
+				size_t oldSize = border.size();
+				border.insert(border.end(), added.begin(), added.end());
+				std::inplace_merge(border.begin(), border.begin() + oldSize, border.end());
+				border.erase(std::unique(border.begin(), border.end()), border.end());
+			}
+
+		public:
+			/*
+			Creates the engine and finds border points of the image.
+			*/
+			BorderThinning(Image<pixel_t>& img) : img(img)
+			{
+				size_t counter = 0;
+				#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+				{
+					std::vector<coord_t> local;
+
+					#pragma omp for schedule(static)
+					for (coord_t z = 0; z < img.depth(); z++)
+					{
+						for (coord_t y = 0; y < img.height(); y++)
+						{
+							for (coord_t x = 0; x < img.width(); x++)
+							{
+								if (img(x, y, z) != (pixel_t)0 && isBorder(x, y, z))
+									local.push_back((coord_t)img.getLinearIndex(x, y, z));
+							}
+						}
+
+						showThreadProgress(counter, img.depth());
+					}
+
+					#pragma omp critical(borderthinning_init)
+					border.insert(border.end(), local.begin(), local.end());
+				}
+
+				std::sort(border.begin(), border.end());
+			}
+
+			/*
+			Gets the image that is being thinned.
+			*/
+			Image<pixel_t>& image()
+			{
+				return img;
+			}
+
+			/*
+			Gets count of border points.
+			*/
+			size_t borderPointCount() const
+			{
+				return border.size();
+			}
+
+			/*
+			Performs one thinning iteration.
+			@param isBorderPoint Function (direction, img, x, y, z) that returns true if the given point is a border point of type direction, 1 <= direction <= 6.
+			@param isCandidate Function (nb) that returns true if the point whose 3x3x3 neighbourhood is nb might be removed.
+			@param removePoints Function (begin, end, removed) that re-tests candidates in range [begin, end[, sets those that can be removed to zero, and adds their indices to removed list.
+			The candidates passed to one call of the function are in a single slab, and in the increasing order.
+			@return Count of removed points.
+			*/
+			template<typename nb_t, typename border_t, typename candidate_t, typename remove_t> size_t iterate(border_t isBorderPoint, candidate_t isCandidate, remove_t removePoints)
+			{
+				size_t changed = 0;
+				const coord_t slabSize = THINNING_SLAB_THICKNESS * img.width() * img.height();
+				const coord_t slabCount = (img.depth() + THINNING_SLAB_THICKNESS - 1) / THINNING_SLAB_THICKNESS;
+
+				for (int direction = 1; direction <= 6; direction++)
+				{
+					// Find candidate points.
+					std::vector<coord_t> candidates;
+					#pragma omp parallel if(!omp_in_parallel() && border.size() > PARALLELIZATION_THRESHOLD / 27)
+					{
+						Image<nb_t> nb(3, 3, 3);
+						std::vector<coord_t> local;
+
+						#pragma omp for schedule(static)
+						for (coord_t n = 0; n < (coord_t)border.size(); n++)
+						{
+							coord_t i = border[n];
+							Vec3c p = img.getCoords(i);
+							if (isBorderPoint(direction, img, p.x, p.y, p.z))
+							{
+								getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
+								if (isCandidate(nb))
+									local.push_back(i);
+							}
+						}
+
+						#pragma omp critical(borderthinning_insert)
+						candidates.insert(candidates.end(), local.begin(), local.end());
+					}
+
+					// The candidates must be processed in fixed order to make the result deterministic.
+					std::sort(candidates.begin(), candidates.end());
+
+					// Re-test and remove the candidates in slabs.
+					std::vector<size_t> slabStart(slabCount + 1);
+					for (coord_t s = 0; s < slabCount; s++)
+						slabStart[s] = std::lower_bound(candidates.begin(), candidates.end(), s * slabSize) - candidates.begin();
+					slabStart[slabCount] = candidates.size();
+
+					std::vector<std::vector<coord_t> > removed(slabCount);
+					for (coord_t color = 0; color < 2; color++)
+					{
+						#pragma omp parallel for schedule(dynamic) if(!omp_in_parallel() && candidates.size() > PARALLELIZATION_THRESHOLD / 27)
+						for (coord_t k = 0; k < (slabCount - color + 1) / 2; k++)
+						{
+							coord_t s = color + 2 * k;
+							removePoints(candidates.data() + slabStart[s], candidates.data() + slabStart[s + 1], removed[s]);
+						}
+					}
+
+					size_t removedCount = 0;
+					for (const std::vector<coord_t>& list : removed)
+						removedCount += list.size();
+
+					updateBorder(removed, removedCount);
+					changed += removedCount;
+				}
+
+				return changed;
+			}
+		};
+	}
+}
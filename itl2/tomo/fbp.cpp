@@ -100,98 +100,141 @@ namespace itl2
 	}
 
 	/**
-	Performs phase retrieval for single projection slice.
+	Buffers and transfer function for Paganin phase retrieval of projections of fixed size.
+	The buffers are allocated once and re-used for all the projections processed by one thread,
+	and the FFTW plans are taken from the plan cache.
 	*/
-	void paganinSlice(Image<float32_t>& slice, PadType padType, float32_t padFraction, float32_t objectSourceDistance, float32_t objectCameraDistance, float32_t delta, float32_t mu)
+	struct PaganinSettings
 	{
-		clamp(padFraction, 0.0f, 1.0f);
-		size_t mirrorSizeX = (size_t)round(padFraction * slice.width());
-		size_t mirrorSizeY = (size_t)round(padFraction * slice.height());
-
-		size_t paddedWidth = mirrorSizeX + slice.width() + mirrorSizeX;
-		size_t paddedHeight = mirrorSizeY + slice.height() + mirrorSizeY;
+		/**
+		Padded projection.
+		*/
+		Image<float32_t> in;
 
-		size_t width = (size_t)slice.width();
-		size_t height = (size_t)slice.height();
-		
-		Image<float32_t> in(paddedWidth, paddedHeight);
+		/**
+		FFT buffer.
+		*/
 		Image<complex32_t> out;
 
-		for (size_t z0 = 0; z0 < paddedHeight; z0++)
+		/**
+		Transfer function multiplied by the magnification correction M^2 and the normalization of the inverse transform.
+		*/
+		Image<float32_t> H;
+
+		PadType padType;
+
+		/**
+		Amount of padding on each size of the buffers in pixels.
+		*/
+		coord_t mirrorSizeX;
+		coord_t mirrorSizeY;
+
+		PaganinSettings(coord_t projectionWidth, coord_t projectionHeight, PadType padType, float32_t padFraction, float32_t objectSourceDistance, float32_t objectCameraDistance, float32_t delta, float32_t mu) :
+			padType(padType)
+		{
+			if (padType != PadType::Mirror && padType != PadType::Nearest)
+				throw runtime_error("Pad type not supported.");
+
+			clamp(padFraction, 0.0f, 1.0f);
+			mirrorSizeX = (coord_t)round(padFraction * projectionWidth);
+			mirrorSizeY = (coord_t)round(padFraction * projectionHeight);
+
+			coord_t paddedWidth = mirrorSizeX + projectionWidth + mirrorSizeX;
+			coord_t paddedHeight = mirrorSizeY + projectionHeight + mirrorSizeY;
+
+			in.ensureSize(paddedWidth, paddedHeight);
+			out.ensureSize(paddedWidth / 2 + 1, paddedHeight);
+			H.ensureSize(out.dimensions());
+
+			float32_t M = (objectCameraDistance + objectSourceDistance) / objectSourceDistance;
+			double scale = (double)M * (double)M / (double)in.pixelCount();
+
+			// (1 + 4pi^2 d delta/mu |w|^2)^-1
+			// w = 0 are at (0, 0), and (0, outHeight)
+			for (coord_t y = 0; y < H.height(); y++)
+			{
+				for (coord_t x = 0; x < H.width(); x++)
+				{
+					double dx = (double)(x - 0);
+					double dy = (double)std::min(y - 0, H.height() - y);
+					double w2 = dx * dx + dy * dy;
+
+					double trans = 1 / (1 + 4 * PI * PI * objectCameraDistance * delta / mu * w2 / M);
+
+					H(x, y) = (float32_t)(trans * scale);
+				}
+			}
+		}
+	};
+
+	/**
+	Performs phase retrieval for single projection slice.
+	*/
+	void paganinSlice(Image<float32_t>& slice, PaganinSettings& settings)
+	{
+		coord_t width = slice.width();
+		coord_t height = slice.height();
+		coord_t mirrorSizeX = settings.mirrorSizeX;
+		coord_t mirrorSizeY = settings.mirrorSizeY;
+		coord_t paddedHeight = settings.in.height();
+		Image<float32_t>& in = settings.in;
+
+		if (in.width() != mirrorSizeX + width + mirrorSizeX || paddedHeight != mirrorSizeY + height + mirrorSizeY)
+			throw ITLException("Paganin buffers have been created for projections of different size.");
+
+		for (coord_t z0 = 0; z0 < paddedHeight; z0++)
 		{
-			int z = (int)z0 - (int)mirrorSizeY;
-			if (padType == PadType::Mirror)
+			coord_t z = z0 - mirrorSizeY;
+			if (settings.padType == PadType::Mirror)
 			{
 				if (z < 0)
 					z = -z;
-				else if (z >= (int)height)
-					z = (int)height - 1 - (z - (int)height);
+				else if (z >= height)
+					z = height - 1 - (z - height);
 			}
-			else if (padType == PadType::Nearest)
+			else
 			{
 				if (z < 0)
 					z = 0;
-				else if (z >= (int)height)
-					z = (int)height - 1;
+				else if (z >= height)
+					z = height - 1;
 			}
-			else
-				throw runtime_error("Pad type not supported.");
 
 			// Copy data to input buffer and do padding
-			for (size_t x = 0; x < mirrorSizeX; x++)
+			for (coord_t x = 0; x < mirrorSizeX; x++)
 			{
-				if (padType == PadType::Mirror)
+				if (settings.padType == PadType::Mirror)
 					in(mirrorSizeX - x - 1, z0) = slice(x, z);
-				else if (padType == PadType::Nearest)
-					in(mirrorSizeX - x - 1, z0) = slice(0, z); //in[z0 * paddedWidth + mirrorSize - x - 1]
 				else
-					throw runtime_error("Pad type not supported.");
+					in(mirrorSizeX - x - 1, z0) = slice(0, z);
 			}
-			for (size_t x = 0; x < width; x++)
+			for (coord_t x = 0; x < width; x++)
 			{
 				in(mirrorSizeX + x, z0) = slice(x, z);
 			}
-			for (size_t x = 0; x < mirrorSizeX; x++)
+			for (coord_t x = 0; x < mirrorSizeX; x++)
 			{
-				if (padType == PadType::Mirror)
+				if (settings.padType == PadType::Mirror)
 					in(mirrorSizeX + width + x, z0) = slice(width - x - 1, z);
-				else if (padType == PadType::Nearest)
-					in(mirrorSizeX + width + x, z0) = slice(width - 1, z);
 				else
-					throw runtime_error("Pad type not supported.");
+					in(mirrorSizeX + width + x, z0) = slice(width - 1, z);
 			}
 		}
 
-		float32_t M = (objectCameraDistance + objectSourceDistance) / objectSourceDistance;
-
-		multiply(in, M*M);
-
 		// FFT
-		fft(in, out);
+		fft(in, settings.out);
 
-		// Multiply by (1 + 4pi^2 d delta/mu |w|^2)^-1
-		// w = 0 are at (0, 0), and (0, outHeight)
-		for (coord_t y = 0; y < out.height(); y++)
-		{
-			for (coord_t x = 0; x < out.width(); x++)
-			{
-				double dx = (double)(x - 0);
-				double dy = (double)std::min(y - 0, out.height() - y);
-				double w2 = dx * dx + dy * dy;
+		// Multiply by the transfer function
+		for (coord_t n = 0; n < settings.out.pixelCount(); n++)
+			settings.out(n) *= settings.H(n);
 
-				double trans = 1 / (1 + 4 * PI * PI * objectCameraDistance * delta / mu * w2 / M);
-
-				out(x, y) *= (float)trans;
-			}
-		}
-
-		// Inverse FFT
-		ifft(out, in);
+		// Inverse FFT. The normalization is included in the transfer function.
+		ifft(settings.out, in, false);
 
 		// Remove padding and replace original data
-		for (size_t z = 0; z < height; z++)
+		for (coord_t z = 0; z < height; z++)
 		{
-			for (size_t x = 0; x < width; x++)
+			for (coord_t x = 0; x < width; x++)
 			{
 				slice(x, z) = in(x + mirrorSizeX, z + mirrorSizeY);
 			}
@@ -201,6 +244,15 @@ namespace itl2
 		negLog(slice);
 	}
 
+	/**
+	Performs phase retrieval for single projection slice.
+	*/
+	void paganinSlice(Image<float32_t>& slice, PadType padType, float32_t padFraction, float32_t objectSourceDistance, float32_t objectCameraDistance, float32_t delta, float32_t mu)
+	{
+		PaganinSettings settings(slice.width(), slice.height(), padType, padFraction, objectSourceDistance, objectCameraDistance, delta, mu);
+		paganinSlice(slice, settings);
+	}
+
 
 	/**
 	Performs Paganin phase retrieval.
@@ -212,21 +264,27 @@ namespace itl2
 		// Calculate Paganin (single material) filtering
 
 		size_t counter = 0;
-		#pragma omp parallel for
-		for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
+		#pragma omp parallel
 		{
-			Image<float32_t> slice(transmissionProjections, anglei, anglei);
+			PaganinSettings settings(transmissionProjections.width(), transmissionProjections.height(), padType, padFraction, objectSourceDistance, objectCameraDistance, delta, mu);
 
-			paganinSlice(slice, padType, padFraction, objectSourceDistance, objectCameraDistance, delta, mu);
+			#pragma omp for
+			for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
+			{
+				Image<float32_t> slice(transmissionProjections, anglei, anglei);
 
-			showThreadProgress(counter, transmissionProjections.depth());
+				paganinSlice(slice, settings);
+
+				showThreadProgress(counter, transmissionProjections.depth());
+			}
 		}
 	}
 
 	/**
 	Performs phase retrieval or -log operation on a single transmission projection slice.
+	@param paganinSettings Buffers for Paganin phase retrieval. Can be nullptr if phaseMode is not Paganin.
 	*/
-	void phaseRetrievalSlice(Image<float32_t>& slice, PhaseMode phaseMode, PadType padType, float32_t padFraction, float32_t objectSourceDistance, float32_t objectCameraDistance, float32_t delta, float32_t mu)
+	void phaseRetrievalSlice(Image<float32_t>& slice, PhaseMode phaseMode, PaganinSettings* paganinSettings)
 	{
 		switch (phaseMode)
 		{
@@ -234,7 +292,7 @@ namespace itl2
 			negLog(slice);
 			break;
 		case PhaseMode::Paganin:
-			paganinSlice(slice, padType, padFraction, objectSourceDistance, objectCameraDistance, delta, mu);
+			paganinSlice(slice, *paganinSettings);
 			break;
 		case PhaseMode::Direct:
 			// The data is already in -ln(I/I0) format or equivalent, so do not do anything.
@@ -320,9 +378,9 @@ namespace itl2
 		Checks that projection images and settings correspond to each other.
 		Adjusts zero elements in roi size vector to full image dimension.
 		*/
-		void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned)
+		void sanityCheck(const Vec3c& projectionSize, RecSettings& settings, bool projectionsAreBinned)
 		{
-			if (transmissionProjections.depth() != settings.angles.size())
+			if (projectionSize.z != (coord_t)settings.angles.size())
 				throw ITLException("Count of projection images and count of angles do not match.");
 
 			size_t projCount = settings.angles.size();
@@ -347,15 +405,15 @@ namespace itl2
 
 			// Roi size and position
 			if (settings.roiSize.x <= 0)
-				settings.roiSize.x = projectionsAreBinned ? transmissionProjections.width() * settings.binning : transmissionProjections.width();
+				settings.roiSize.x = projectionsAreBinned ? projectionSize.x * settings.binning : projectionSize.x;
 			if (settings.roiSize.x <= 0)
 				settings.roiSize.x = 1;
 			if (settings.roiSize.y <= 0)
-				settings.roiSize.y = projectionsAreBinned ? transmissionProjections.width() * settings.binning : transmissionProjections.width();
+				settings.roiSize.y = projectionsAreBinned ? projectionSize.x * settings.binning : projectionSize.x;
 			if (settings.roiSize.y <= 0)
 				settings.roiSize.y = 1;
 			if (settings.roiSize.z <= 0)
-				settings.roiSize.z = projectionsAreBinned ? transmissionProjections.height() * settings.binning : transmissionProjections.height();
+				settings.roiSize.z = projectionsAreBinned ? projectionSize.y * settings.binning : projectionSize.y;
 			if (settings.roiSize.z <= 0)
 				settings.roiSize.z = 1;
 
@@ -628,30 +686,34 @@ namespace itl2
 			filter(n) = 0;
 	}
 
+	/**
+	Count of projection rows that are filtered using one batched FFT.
+	*/
+	constexpr coord_t FILTER_BATCH_ROWS = 32;
+
+	/**
+	Buffers and filter for sinogram filtering of projections of fixed width.
+	The buffers are allocated once and re-used for all the projections processed by one thread,
+	and the batched FFTW plans are taken from the plan cache.
+	*/
 	struct FilterSettings
 	{
 		/**
-		Input buffer.
+		Input buffer. Each z-slice contains one padded projection row.
 		*/
 		Image<float32_t> in;
 
 		/**
-		FFT buffer.
+		FFT buffer. Each z-slice contains transform of one padded projection row.
 		*/
 		Image<complex32_t> out;
 
 		/**
-		Filter that is to be applied.
+		Filter that is to be applied, multiplied by the normalization of the inverse transform.
 		Currently this is created separately for each thread but the data is the same for all of them.
 		*/
 		Image<float32_t> H;
 
-		/**
-		FFT plans.
-		*/
-		fftwf_plan forward;
-		fftwf_plan backward;
-
 		/**
 		Amount of padding on each size of the buffers in pixels.
 		*/
@@ -664,81 +726,81 @@ namespace itl2
 			if (mirrorSize < 10)
 				mirrorSize = 10;
 
-			size_t paddedWidth = mirrorSize + projectionWidth + mirrorSize;
+			coord_t paddedWidth = mirrorSize + projectionWidth + mirrorSize;
 
-			in.ensureSize(paddedWidth);
+			in.ensureSize(paddedWidth, 1, FILTER_BATCH_ROWS);
 
 			// Build filter
-			size_t outSize = paddedWidth / 2 + 1;
+			coord_t outSize = paddedWidth / 2 + 1;
 
-			out.ensureSize(outSize);
+			out.ensureSize(outSize, 1, FILTER_BATCH_ROWS);
 			H.ensureSize(outSize);
 
 			createFilter(H, filterType, cutoff);
-
-			#pragma omp critical
-			{
-				forward = fftwf_plan_dft_r2c_1d((int)paddedWidth, in.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-				backward = fftwf_plan_dft_c2r_1d((int)paddedWidth, (fftwf_complex*)out.getData(), in.getData(), FFTW_ESTIMATE);
-			}
-		}
-
-		~FilterSettings()
-		{
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(backward);
-				fftwf_destroy_plan(forward);
-			}
+			divide(H, (float32_t)paddedWidth);
 		}
 	};
 
 
 	void filterSlice(Image<float32_t>& slice, FilterSettings& settings, PadType padType)
 	{
+		if (padType != PadType::Mirror && padType != PadType::Nearest)
+			throw runtime_error("Pad type not supported.");
+
 		coord_t projectionWidth = slice.width();
+		coord_t mirrorSize = settings.mirrorSize;
 
-		for (coord_t z = 0; z < slice.height(); z++)
+		for (coord_t z0 = 0; z0 < slice.height(); z0 += FILTER_BATCH_ROWS)
 		{
+			coord_t rowCount = std::min(FILTER_BATCH_ROWS, slice.height() - z0);
+			Image<float32_t> in(settings.in, 0, rowCount - 1);
+			Image<complex32_t> out(settings.out, 0, rowCount - 1);
+
 			// Copy data to input buffer
-			for (coord_t x = 0; x < settings.mirrorSize; x++)
-			{
-				if (padType == PadType::Mirror)
-					settings.in(settings.mirrorSize - x - 1) = slice(x, z);
-				else if (padType == PadType::Nearest)
-					settings.in(settings.mirrorSize - x - 1) = slice(0, z);
-				else
-					throw runtime_error("Pad type not supported.");
-			}
-			for (coord_t x = 0; x < projectionWidth; x++)
-			{
-				settings.in(settings.mirrorSize + x) = slice(x, z);
-			}
-			for (coord_t x = 0; x < settings.mirrorSize; x++)
+			for (coord_t r = 0; r < rowCount; r++)
 			{
-				if (padType == PadType::Mirror)
-					settings.in(settings.mirrorSize + projectionWidth + x) = slice(projectionWidth - x - 1, z);
-				else if (padType == PadType::Nearest)
-					settings.in(settings.mirrorSize + projectionWidth + x) = slice(projectionWidth - 1, z);
-				else
-					throw runtime_error("Pad type not supported.");
+				coord_t z = z0 + r;
+				for (coord_t x = 0; x < mirrorSize; x++)
+				{
+					if (padType == PadType::Mirror)
+						in(mirrorSize - x - 1, 0, r) = slice(x, z);
+					else
+						in(mirrorSize - x - 1, 0, r) = slice(0, z);
+				}
+				for (coord_t x = 0; x < projectionWidth; x++)
+				{
+					in(mirrorSize + x, 0, r) = slice(x, z);
+				}
+				for (coord_t x = 0; x < mirrorSize; x++)
+				{
+					if (padType == PadType::Mirror)
+						in(mirrorSize + projectionWidth + x, 0, r) = slice(projectionWidth - x - 1, z);
+					else
+						in(mirrorSize + projectionWidth + x, 0, r) = slice(projectionWidth - 1, z);
+				}
 			}
 
-			// Transform
+			// Transform all rows using one plan
 			// NOTE: Output stores only non-negative frequencies!
-			fftwf_execute(settings.forward);
+			fftRows(in, out);
 
 			// Apply filter
-			for (coord_t x = 0; x < settings.out.width(); x++)
-				settings.out(x) *= settings.H(x);
+			for (coord_t r = 0; r < rowCount; r++)
+			{
+				for (coord_t x = 0; x < out.width(); x++)
+					out(x, 0, r) *= settings.H(x);
+			}
 
-			// Inverse transform
-			fftwf_execute(settings.backward);
+			// Inverse transform. The normalization is included in the filter.
+			ifftRows(out, in, false);
 
-			// Normalize and copy to output
-			for (coord_t x = 0; x < projectionWidth; x++)
+			// Copy to output
+			for (coord_t r = 0; r < rowCount; r++)
 			{
-				slice(x, z) = settings.in(settings.mirrorSize + x) / settings.in.width();
+				for (coord_t x = 0; x < projectionWidth; x++)
+				{
+					slice(x, z0 + r) = in(mirrorSize + x, 0, r);
+				}
 			}
 		}
 	}
@@ -748,8 +810,6 @@ namespace itl2
 	*/
 	void fbpFilter(Image<float32_t>& transmissionProjections, PadType padType, float32_t padFraction, FilterType filterType, float32_t cutoff)
 	{
-		initFFTW();
-
 		#pragma omp parallel
 		{
 			FilterSettings settings(padFraction, transmissionProjections.width(), filterType, cutoff);
@@ -916,24 +976,29 @@ namespace itl2
 		}
 	}
 	
-	void fbpPreprocess(const Image<float32_t>& transmissionProjections, Image<float32_t>& preprocessedProjections, RecSettings settings)
+	namespace internals
 	{
-		internals::sanityCheck(transmissionProjections, settings, false);
-
-		size_t origBinning = settings.binning;
-
-		// Calculate size of preprocessed projections
-		Vec3c croppedSize(transmissionProjections.dimensions());
-		if (settings.cropSize.max() > 0)
+		/**
+		Calculates size of projections after cropping.
+		*/
+		Vec3c croppedProjectionSize(const Vec3c& transmissionProjectionSize, const RecSettings& settings)
 		{
-			croppedSize.x = transmissionProjections.width() - 2 * settings.cropSize.x;
-			croppedSize.y = transmissionProjections.height() - 2 * settings.cropSize.y;
+			Vec3c croppedSize = transmissionProjectionSize;
+			if (settings.cropSize.max() > 0)
+			{
+				croppedSize.x = transmissionProjectionSize.x - 2 * settings.cropSize.x;
+				croppedSize.y = transmissionProjectionSize.y - 2 * settings.cropSize.y;
 
-			//if (croppedSize.x / settings.binning <= 0 || croppedSize.y / settings.binning <= 0)
-			//	throw ITLException("Too large crop size. Cropped projection image size must be at least 1x1 pixels after cropping and binning.");
+				//if (croppedSize.x / settings.binning <= 0 || croppedSize.y / settings.binning <= 0)
+				//	throw ITLException("Too large crop size. Cropped projection image size must be at least 1x1 pixels after cropping and binning.");
+			}
+			return croppedSize;
 		}
+	}
 
-		Vec3c outputSize = croppedSize;
+	Vec3c fbpPreprocessedSize(const Vec3c& transmissionProjectionSize, const RecSettings& settings)
+	{
+		Vec3c outputSize = internals::croppedProjectionSize(transmissionProjectionSize, settings);
 		if (settings.binning > 1)
 		{
 			outputSize.x /= (coord_t)settings.binning;
@@ -942,6 +1007,29 @@ namespace itl2
 
 		if (outputSize.min() <= 0)
 			throw ITLException("Too large crop size or binning. A projection image must have at least 1x1 pixels after cropping and binning.");
+
+		return outputSize;
+	}
+
+	void fbpPreprocess(const Image<float32_t>& transmissionProjections, Image<float32_t>& preprocessedProjections, RecSettings settings)
+	{
+		internals::sanityCheck(transmissionProjections, settings, false);
+
+		fbpPreprocessBlock(transmissionProjections, 0, preprocessedProjections, settings);
+	}
+
+	void fbpPreprocessBlock(const Image<float32_t>& transmissionProjections, coord_t angleStart, Image<float32_t>& preprocessedProjections, RecSettings settings)
+	{
+		if (angleStart < 0 || angleStart + transmissionProjections.depth() > (coord_t)settings.angles.size())
+			throw ITLException("The projection block is not a block of projections of the data set.");
+
+		internals::sanityCheck(Vec3c(transmissionProjections.width(), transmissionProjections.height(), settings.angles.size()), settings, false);
+
+		size_t origBinning = settings.binning;
+
+		// Calculate size of preprocessed projections
+		Vec3c croppedSize = internals::croppedProjectionSize(transmissionProjections.dimensions(), settings);
+		Vec3c outputSize = fbpPreprocessedSize(transmissionProjections.dimensions(), settings);
 		
 		// Adjust parameters for binning
 		internals::applyBinningToParameters(settings);
@@ -969,6 +1057,9 @@ namespace itl2
 			Image<float32_t> med;
 			Image<float32_t> tmp;
 			FilterSettings filterSettings(settings.padFraction, preprocessedProjections.width(), settings.filterType, settings.filterCutOff);
+			unique_ptr<PaganinSettings> paganinSettings;
+			if (settings.phaseMode == PhaseMode::Paganin)
+				paganinSettings = make_unique<PaganinSettings>(preprocessedProjections.width(), preprocessedProjections.height(), settings.phasePadType, settings.phasePadFraction, settings.sourceToRA, settings.objectCameraDistance, settings.delta, settings.mu);
 
 			Image<float32_t> cropTmp(croppedSize.x, croppedSize.y);
 
@@ -1016,12 +1107,12 @@ namespace itl2
 					}
 				}
 
-				phaseRetrievalSlice(slice, settings.phaseMode, settings.phasePadType, settings.phasePadFraction, settings.sourceToRA, settings.objectCameraDistance, settings.delta, settings.mu);
+				phaseRetrievalSlice(slice, settings.phaseMode, paganinSettings.get());
 				
 				if(!NumberUtils<float32_t>::equals(settings.bhc, 0))
 					beamHardeningCorrection(slice, settings.bhc);
 
-				fbpWeightingSlice(slice, z, settings.reconstructAs180degScan, settings.angles, settings.centerShift, settings.csAngleSlope, settings.sourceToRA, settings.cameraZShift, centralAngle, gammamax0, settings.heuristicSinogramWindowingParameter);
+				fbpWeightingSlice(slice, angleStart + z, settings.reconstructAs180degScan, settings.angles, settings.centerShift, settings.csAngleSlope, settings.sourceToRA, settings.cameraZShift, centralAngle, gammamax0, settings.heuristicSinogramWindowingParameter);
 				
 				filterSlice(slice, filterSettings, settings.padType);
 				
@@ -1062,6 +1153,82 @@ namespace itl2
 
 
 
+	Vec3c backprojectionSize(const Vec3c& projectionSize, RecSettings settings)
+	{
+		internals::sanityCheck(projectionSize, settings, true);
+		internals::applyBinningToParameters(settings);
+		return settings.roiSize;
+	}
+
+	Vec2c backprojectionRowRange(const Vec3c& projectionSize, RecSettings settings, coord_t outputZStart, coord_t outputZEnd)
+	{
+		internals::sanityCheck(projectionSize, settings, true);
+		internals::applyBinningToParameters(settings);
+
+		if (outputZStart < 0 || outputZEnd > settings.roiSize.z || outputZStart >= outputZEnd)
+			throw ITLException("Invalid slab of the reconstruction.");
+
+		vector<Vec3f> pss, pds, us, vs, ws;
+		internals::determineBackprojectionGeometry(settings, projectionSize.x, pss, pds, us, vs, ws);
+
+		float32_t projectionHalfHeight = (float32_t)projectionSize.y / 2.0f;
+
+		// Centers of the corner voxels of the slab.
+		Vec3f origin = internals::backprojectionOrigin(settings);
+		float32_t x1 = (float32_t)(settings.roiSize.x - 1);
+		float32_t y1 = (float32_t)(settings.roiSize.y - 1);
+		float32_t z0 = (float32_t)outputZStart;
+		float32_t z1 = (float32_t)(outputZEnd - 1);
+		array<Vec3f, 8> corners =
+			{
+				Vec3f(0, 0, z0),
+				Vec3f(x1, 0, z0),
+				Vec3f(0, y1, z0),
+				Vec3f(x1, y1, z0),
+				Vec3f(0, 0, z1),
+				Vec3f(x1, 0, z1),
+				Vec3f(0, y1, z1),
+				Vec3f(x1, y1, z1),
+			};
+
+		// The detector v-coordinate is a linear fractional function of the voxel position, so its extrema over the slab are
+		// found at the corners, provided that the whole slab is in front of the source.
+		float32_t vMin = numeric_limits<float32_t>::infinity();
+		float32_t vMax = -numeric_limits<float32_t>::infinity();
+		for (size_t anglei = 0; anglei < pss.size(); anglei++)
+		{
+			Vec3f psmpd = pss[anglei] - pds[anglei];
+			for (const Vec3f& corner : corners)
+			{
+				Vec3f dVec = origin + corner - pss[anglei];
+				float32_t denom = dVec.dot(ws[anglei]);
+				if (denom <= NumberUtils<float32_t>::tolerance())
+					return Vec2c(0, projectionSize.y);
+
+				float32_t d = (-psmpd.dot(ws[anglei])) / denom;
+				Vec3f pDot = psmpd + d * dVec;
+				float32_t v = pDot.dot(vs[anglei]) + projectionHalfHeight;
+
+				vMin = std::min(vMin, v);
+				vMax = std::max(vMax, v);
+			}
+		}
+
+		if (!std::isfinite(vMin) || !std::isfinite(vMax))
+			return Vec2c(0, projectionSize.y);
+
+		// Interpolation at v needs rows floor(v) and floor(v) + 1. Add one row to both ends to account for rounding errors.
+		coord_t rowStart = (coord_t)std::floor(vMin) - 1;
+		coord_t rowEnd = (coord_t)std::floor(vMax) + 3;
+
+		// Always return at least one row so that the band is a valid image.
+		rowStart = std::clamp(rowStart, (coord_t)0, projectionSize.y - 1);
+		rowEnd = std::clamp(rowEnd, rowStart + 1, projectionSize.y);
+
+		return Vec2c(rowStart, rowEnd);
+	}
+
+
 #if defined(USE_OPENCL)
 
 	namespace internals
@@ -2045,6 +2212,143 @@ kernel void backproject(read_only image3d_t transmissionProjections,
 #endif
 		}
 
+		/**
+		Straightforward voxel-by-voxel implementation of CPU backprojection, used to check the results of backproject.
+		*/
+		void backprojectReference(const Image<float32_t>& transmissionProjections, RecSettings settings, Image<float32_t>& output)
+		{
+			internals::sanityCheck(transmissionProjections, settings, true);
+			internals::applyBinningToParameters(settings);
+			output.ensureSize(settings.roiSize);
+			float32_t normFact = normFactor(settings);
+
+			vector<Vec3f> pss, pds, us, vs, ws;
+			internals::determineBackprojectionGeometry(settings, transmissionProjections.width(), pss, pds, us, vs, ws);
+
+			float32_t projectionHalfWidth = (float32_t)transmissionProjections.width() / 2.0f;
+			float32_t projectionHalfHeight = (float32_t)transmissionProjections.height() / 2.0f;
+			LinearInterpolator<float32_t, float32_t> interpolator(BoundaryCondition::Zero);
+
+			forAllPixels(output, [&](coord_t x, coord_t y, coord_t z)
+				{
+					Vec3f p = Vec3f((float)x, (float)y, (float)z) - Vec3f(settings.roiSize) / 2.0f + Vec3f(settings.roiCenter) + Vec3f(0.5, 0.5, 0.5);
+
+					float32_t sum = 0;
+					for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
+					{
+						Vec3f dVec = p - pss[anglei];
+						float32_t denom = dVec.dot(ws[anglei]);
+						if (!NumberUtils<float32_t>::equals(denom, 0))
+						{
+							Vec3f psmpd = pss[anglei] - pds[anglei];
+							float32_t d = (-psmpd.dot(ws[anglei])) / denom;
+							Vec3f pDot = psmpd + d * dVec;
+							float32_t u = pDot.dot(us[anglei]) + projectionHalfWidth;
+							float32_t v = pDot.dot(vs[anglei]) + projectionHalfHeight;
+							float32_t weight = settings.sourceToRA / (settings.sourceToRA + p.dot(ws[anglei]));
+							weight *= weight;
+							sum += weight * interpolator(transmissionProjections, u, v, (float32_t)anglei);
+						}
+					}
+
+					sum *= normFact;
+					output(x, y, z) = (sum - settings.dynMin) / (settings.dynMax - settings.dynMin);
+				});
+		}
+
+		void cpuBackProjection()
+		{
+			coord_t projectionCount = 90;
+			Image<float32_t> projections(60, 40, projectionCount);
+			forAllPixels(projections, [&](coord_t x, coord_t y, coord_t z)
+				{
+					projections(x, y, z) = sin(0.3f * x) + cos(0.2f * y) + 0.01f * z;
+				});
+
+			RecSettings settings;
+			settings.sourceToRA = 200;
+			settings.objectCameraDistance = 50;
+			settings.roiSize = Vec3c(70, 65, 45);
+			settings.roiCenter = Vec3c(2, -3, 1);
+			for (coord_t anglei = 0; anglei < projectionCount; anglei++)
+			{
+				settings.angles.push_back(360.0f / projectionCount * anglei);
+				settings.sampleShifts.push_back(Vec3f(3 * sin(0.1f * anglei), 2 * cos(0.2f * anglei), sin(0.3f * anglei)));
+			}
+
+			Image<float32_t> expected;
+			backprojectReference(projections, settings, expected);
+
+			Image<float32_t> result;
+			backproject(projections, settings, result);
+
+			float32_t maxValue = std::max(std::abs(max(expected)), std::abs(min(expected)));
+			testAssert(equals(expected, result, 1e-4f * maxValue), "CPU backprojection does not match reference implementation.");
+		}
+
+		void backprojectBlocks()
+		{
+			coord_t projectionCount = 60;
+			Image<float32_t> transmissionProjections(80, 50, projectionCount);
+			forAllPixels(transmissionProjections, [&](coord_t x, coord_t y, coord_t z)
+				{
+					transmissionProjections(x, y, z) = 0.5f + 0.2f * sin(0.3f * x + 0.05f * z) * cos(0.2f * y);
+				});
+
+			RecSettings settings;
+			settings.sourceToRA = 150;
+			settings.objectCameraDistance = 50;
+			settings.cameraRotation = 2;
+			settings.cameraZShift = 3;
+			settings.roiSize = Vec3c(60, 55, 41);
+			settings.roiCenter = Vec3c(1, -2, 3);
+			for (coord_t anglei = 0; anglei < projectionCount; anglei++)
+			{
+				settings.angles.push_back(360.0f / projectionCount * anglei);
+				settings.sampleShifts.push_back(Vec3f(sin(0.1f * anglei), cos(0.2f * anglei), 2 * sin(0.3f * anglei)));
+			}
+
+			// Preprocessing in blocks of projections
+			Image<float32_t> preprocessed;
+			fbpPreprocess(transmissionProjections, preprocessed, settings);
+
+			Image<float32_t> preprocessedInBlocks(preprocessed.dimensions());
+			for (coord_t angleStart = 0; angleStart < projectionCount; angleStart += 13)
+			{
+				coord_t angleEnd = std::min(angleStart + 13, projectionCount);
+				Image<float32_t> in(transmissionProjections.width(), transmissionProjections.height(), angleEnd - angleStart);
+				crop(transmissionProjections, in, Vec3c(0, 0, angleStart));
+				Image<float32_t> out;
+				fbpPreprocessBlock(in, angleStart, out, settings);
+				copyValues(preprocessedInBlocks, out, Vec3c(0, 0, angleStart));
+			}
+
+			testAssert(equals(preprocessed, preprocessedInBlocks), "preprocessing in blocks");
+
+			// Backprojection in slabs, each using only the projection rows it needs
+			Image<float32_t> expected;
+			backproject(preprocessed, settings, expected);
+
+			Image<float32_t> result(expected.dimensions());
+			coord_t maxBandHeight = 0;
+			for (coord_t zStart = 0; zStart < expected.depth(); zStart += 7)
+			{
+				coord_t zEnd = std::min(zStart + 7, expected.depth());
+				Vec2c rows = backprojectionRowRange(preprocessed.dimensions(), settings, zStart, zEnd);
+				maxBandHeight = std::max(maxBandHeight, rows.y - rows.x);
+
+				Image<float32_t> band(preprocessed.width(), rows.y - rows.x, preprocessed.depth());
+				crop(preprocessed, band, Vec3c(0, rows.x, 0));
+
+				Image<float32_t> slab(expected.width(), expected.height(), zEnd - zStart);
+				backprojectBlock(band, preprocessed.dimensions(), rows.x, settings, slab, zStart);
+				copyValues(result, slab, Vec3c(0, 0, zStart));
+			}
+
+			testAssert(maxBandHeight < preprocessed.height(), "slabs should need only some of the projection rows");
+			testAssert(equals(expected, result), "backprojection in slabs");
+		}
+
 
 
 	}
@@ -8,6 +8,7 @@
 #endif
 
 #include <vector>
+#include <omp.h>
 
 #include "image.h"
 #include "iteration.h"
@@ -539,6 +540,21 @@ namespace itl2
 	*/
 	void fbpPreprocess(const Image<float32_t>& transmissionProjections, Image<float32_t>& preprocessedProjections, RecSettings settings);
 
+	/**
+	Pre-processing of a block of consecutive projections for filtered backprojection.
+	The result equals the corresponding block of the output of fbpPreprocess called for all the projections.
+	@param transmissionProjectionBlock Projections angleStart, angleStart + 1, ..., angleStart + depth - 1 of the full data set.
+	@param angleStart Index of the first projection in the block.
+	@param preprocessedProjectionBlock Preprocessed projections are placed into this image.
+	@param settings Reconstruction settings for the full data set.
+	*/
+	void fbpPreprocessBlock(const Image<float32_t>& transmissionProjectionBlock, coord_t angleStart, Image<float32_t>& preprocessedProjectionBlock, RecSettings settings);
+
+	/**
+	Calculates size of output of fbpPreprocess, given size of transmission projections.
+	*/
+	Vec3c fbpPreprocessedSize(const Vec3c& transmissionProjectionSize, const RecSettings& settings);
+
 
 	/**
 	Remove bad pixels from one slice of projection data.
@@ -630,7 +646,12 @@ namespace itl2
 
 	namespace internals
 	{
-		void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned);
+		void sanityCheck(const Vec3c& projectionSize, RecSettings& settings, bool projectionsAreBinned);
+
+		inline void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned)
+		{
+			sanityCheck(transmissionProjections.dimensions(), settings, projectionsAreBinned);
+		}
 
 		float32_t calculateTrueCentralAngle(float32_t centralAngleFor180degScan, const std::vector<float32_t>& angles, float32_t gammamax0);
 
@@ -794,14 +815,175 @@ namespace itl2
 		}
 	}
 
-	template<typename out_t> void backproject(const Image<float32_t>& transmissionProjections, RecSettings settings, Image<out_t>& output)
+	namespace internals
 	{
-		internals::sanityCheck(transmissionProjections, settings, true);
-		output.mustNotBe(transmissionProjections);
+		/**
+		Backprojection geometry of a single projection, in a form where the detector coordinates and the FDK weight of
+		voxels on a row parallel to the x-axis are simple functions of the x-coordinate of the voxel.
+		*/
+		struct ProjectionGeometry
+		{
+			/**
+			Source position.
+			*/
+			Vec3f ps;
+
+			/**
+			Source position minus detector position.
+			*/
+			Vec3f psmpd;
+
+			/**
+			Detector right, up, and normal vectors, as returned by determineBackprojectionGeometry.
+			*/
+			Vec3f u, v, w;
+
+			/**
+			-(ps - pd).w
+			*/
+			float32_t k;
+
+			/**
+			Detector coordinates of (ps - pd), shifted by half of the projection size.
+			*/
+			float32_t u0, v0;
+		};
+
+		/**
+		Calculates position of the center of the first voxel of the reconstruction.
+		The settings must have been adjusted for binning.
+		*/
+		inline Vec3f backprojectionOrigin(const RecSettings& settings)
+		{
+			// NOTE: Adding 0.5 ensures that if x = 0, roiSize = 1, and roiCenter = 0,
+			// p.x = 0 - 1/2.0f + c + 0.5 = 0, as expected.
+			// NOTE: In this new version we use the more correct +0.5 in all coordinate directions. This is different from the old version
+			// where +0.5 was used only in the z direction
+			return Vec3f(settings.roiCenter) - Vec3f(settings.roiSize) / 2.0f + Vec3f(0.5, 0.5, 0.5);
+		}
+
+		/**
+		Adds backprojection of a single projection to a row of voxels parallel to the x-axis.
+		@param projections Projection images, or a band of rows of them.
+		@param rowStart Index of the first row of projections in the full projection images.
+		@param anglei Index of the projection to backproject.
+		@param p0 Position of the first voxel of the row.
+		@param row Sums of the voxels of the row.
+		@param us, vs, weights Temporary buffers whose size is at least the width of the row.
+		*/
+		inline void backprojectRow(const Image<float32_t>& projections, coord_t rowStart, coord_t anglei, const ProjectionGeometry& g, const Vec3f& p0, float32_t sourceToRA,
+			coord_t width, float32_t* row, float32_t* us, float32_t* vs, float32_t* weights)
+		{
+			// For voxel p = p0 + (x, 0, 0), the dot products needed in the backprojection are linear functions of x.
+			Vec3f dVec0 = p0 - g.ps;
+			const float32_t a0 = dVec0.dot(g.w);
+			const float32_t a1 = g.w.x;
+			const float32_t b0 = dVec0.dot(g.u);
+			const float32_t b1 = g.u.x;
+			const float32_t c0 = dVec0.dot(g.v);
+			const float32_t c1 = g.v.x;
+			const float32_t e0 = sourceToRA + p0.dot(g.w);
+			const float32_t e1 = g.w.x;
+			const float32_t k = g.k;
+			const float32_t u0 = g.u0;
+			const float32_t v0 = g.v0;
+			const float32_t tolerance = NumberUtils<float32_t>::tolerance();
+
+			// Detector coordinates and FDK weights of all voxels in the row.
+			#pragma omp simd
+			for (coord_t x = 0; x < width; x++)
+			{
+				float32_t xf = (float32_t)x;
+				float32_t denom = a0 + a1 * xf;
+				float32_t d = k / denom;
+				us[x] = u0 + d * (b0 + b1 * xf);
+				vs[x] = v0 + d * (c0 + c1 * xf);
+				float32_t weight = sourceToRA / (e0 + e1 * xf);
+				weights[x] = std::abs(denom) < tolerance ? 0.0f : weight * weight;
+			}
+
+			// Sample the projection using linear interpolation and zero boundary condition.
+			const coord_t pw = projections.width();
+			const coord_t ph = projections.height();
+			const float32_t maxU = (float32_t)pw;
+			const float32_t minV = (float32_t)rowStart - 1;
+			const float32_t maxV = (float32_t)(rowStart + ph);
+			const float32_t* slice = projections.getData() + anglei * pw * ph;
+			auto pixel = [&](coord_t i, coord_t j)
+			{
+				return i >= 0 && j >= 0 && i < pw && j < ph ? slice[j * pw + i] : 0.0f;
+			};
+
+			for (coord_t x = 0; x < width; x++)
+			{
+				float32_t u = us[x];
+				float32_t v = vs[x];
+
+				// All the samples are outside of the projection if these conditions are false. This test also discards NaNs and infinities.
+				if (u > -1 && u < maxU && v > minV && v < maxV)
+				{
+					float32_t vFloor = std::floor(v);
+					coord_t i = (coord_t)std::floor(u);
+					coord_t j = (coord_t)vFloor - rowStart;
+					float32_t fu = u - i;
+					float32_t fv = v - vFloor;
+
+					float32_t value;
+					if (i >= 0 && j >= 0 && i + 1 < pw && j + 1 < ph)
+					{
+						const float32_t* p = slice + j * pw + i;
+						value = (p[0] * (1 - fu) + p[1] * fu) * (1 - fv) + (p[pw] * (1 - fu) + p[pw + 1] * fu) * fv;
+					}
+					else
+					{
+						value = (pixel(i, j) * (1 - fu) + pixel(i + 1, j) * fu) * (1 - fv) + (pixel(i, j + 1) * (1 - fu) + pixel(i + 1, j + 1) * fu) * fv;
+					}
+
+					row[x] += weights[x] * value;
+				}
+			}
+		}
+	}
+
+	/**
+	Calculates size of the reconstruction made from preprocessed projections of given size.
+	*/
+	Vec3c backprojectionSize(const Vec3c& projectionSize, RecSettings settings);
+
+	/**
+	Determines the band of projection rows that contributes to slices outputZStart, ..., outputZEnd - 1 of the reconstruction.
+	The band is found by projecting the corners of the slab to each projection.
+	@param projectionSize Size of the full stack of preprocessed projections.
+	@return Index of the first row of the band and index of one past its last row.
+	*/
+	Vec2c backprojectionRowRange(const Vec3c& projectionSize, RecSettings settings, coord_t outputZStart, coord_t outputZEnd);
+
+	/**
+	Backprojects preprocessed projections to a slab of the reconstruction using the CPU.
+	The output is processed in tiles of a few rows, and the projections in blocks of a few angles,
+	so that both the partial sums of the tile and the accessed parts of the projections stay in the cache.
+	The tiles are processed in parallel.
+	@param projectionBlock Band of rows of all the preprocessed projections. The band must contain at least the rows given by backprojectionRowRange.
+	@param projectionSize Size of the full stack of preprocessed projections.
+	@param projectionRowStart Index of the first row of the band.
+	@param settings Reconstruction settings for the full reconstruction.
+	@param outputBlock Slab of the reconstruction. Its width and height must equal those of the full reconstruction.
+	@param outputZStart z-coordinate of the first slice of the slab in the full reconstruction.
+	*/
+	template<typename out_t> void backprojectBlock(const Image<float32_t>& projectionBlock, const Vec3c& projectionSize, coord_t projectionRowStart, RecSettings settings, Image<out_t>& outputBlock, coord_t outputZStart)
+	{
+		internals::sanityCheck(projectionSize, settings, true);
+		outputBlock.mustNotBe(projectionBlock);
 
 		internals::applyBinningToParameters(settings);
 
-		output.ensureSize(settings.roiSize);
+		if (projectionBlock.width() != projectionSize.x || projectionBlock.depth() != projectionSize.z ||
+			projectionRowStart < 0 || projectionRowStart + projectionBlock.height() > projectionSize.y)
+			throw ITLException("The projection block is not a band of rows of the projections.");
+
+		if (outputBlock.width() != settings.roiSize.x || outputBlock.height() != settings.roiSize.y ||
+			outputZStart < 0 || outputZStart + outputBlock.depth() > settings.roiSize.z)
+			throw ITLException("The output block is not a slab of the reconstruction.");
 
 		float32_t normFact = normFactor(settings);
 
@@ -812,74 +994,91 @@ namespace itl2
 		std::vector<Vec3f> us;			// Detector right vectors
 		std::vector<Vec3f> vs;			// Detector up vectors
 		std::vector<Vec3f> ws;			// Detector normal vectors, w = u x w
-		internals::determineBackprojectionGeometry(settings, transmissionProjections.width(), pss, pds, us, vs, ws);
+		internals::determineBackprojectionGeometry(settings, projectionSize.x, pss, pds, us, vs, ws);
+
+		float32_t projectionHalfWidth = (float32_t)projectionSize.x / 2.0f;
+		float32_t projectionHalfHeight = (float32_t)projectionSize.y / 2.0f;
+
+		coord_t angleCount = projectionSize.z;
+		std::vector<internals::ProjectionGeometry> geometry(angleCount);
+		for (coord_t anglei = 0; anglei < angleCount; anglei++)
+		{
+			internals::ProjectionGeometry& g = geometry[anglei];
+			g.ps = pss[anglei];
+			g.psmpd = pss[anglei] - pds[anglei];
+			g.u = us[anglei];
+			g.v = vs[anglei];
+			g.w = ws[anglei];
+			g.k = -g.psmpd.dot(g.w);
+			g.u0 = g.psmpd.dot(g.u) + projectionHalfWidth;
+			g.v0 = g.psmpd.dot(g.v) + projectionHalfHeight;
+		}
 
 		// Backproject
 		// -----------
-		float32_t projectionHalfWidth = (float32_t)transmissionProjections.width() / 2.0f;
-		float32_t projectionHalfHeight = (float32_t)transmissionProjections.height() / 2.0f;
 
-		LinearInterpolator<float32_t, float32_t> interpolator(BoundaryCondition::Zero);
+		Vec3f origin = internals::backprojectionOrigin(settings) + Vec3f(0, 0, (float32_t)outputZStart);
 
-		size_t counter = 0;
-		forAllPixels(output, [&](coord_t x, coord_t y, coord_t z)
-			{
-				// NOTE: Adding 0.5 ensures that if x = 0, roiSize = 1, and roiCenter = 0,
-				// p.x = 0 - 1/2.0f + c + 0.5 = 0, as expected.
-				// NOTE: In this new version we use the more correct +0.5 in all coordinate directions. This is different from the old version
-				// where +0.5 was used only in the z direction
-				Vec3f p = Vec3f((float)x, (float)y, (float)z) - Vec3f(settings.roiSize) / 2.0f + Vec3f(settings.roiCenter)
-					//+ Vec3f(0, 0, 0.5); // Old version was like this
-					+ Vec3f(0.5, 0.5, 0.5);
-
-				// Sum contributions from all projections
-				float32_t sum = 0;
-				for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
-				{
-					Vec3f ps = pss[anglei];
-					Vec3f pd = pds[anglei];
-					Vec3f uVec = us[anglei];
-					Vec3f vVec = vs[anglei];
-					Vec3f wHat = ws[anglei];
-
-					Vec3f dVec = p - ps;
-					float32_t denom = dVec.dot(wHat);
-					if (!NumberUtils<float32_t>::equals(denom, 0))
-					{
-						Vec3f psmpd = ps - pd; // NOTE: In principle we could pre-calculate ps-pd as we don't need plain pd anywhere.
-						float32_t d = (-psmpd.dot(wHat)) / denom;
+		constexpr coord_t ROWS_PER_TILE = 8;
+		constexpr coord_t ANGLES_PER_BLOCK = 32;
 
-						// (ps + d * dVec) is projection of source point through reconstruction point to the detector plane,
-						// and pd is detector position.
-						Vec3f pDot = psmpd + d * dVec;
+		const coord_t width = outputBlock.width();
+		const coord_t tilesPerSlice = (outputBlock.height() + ROWS_PER_TILE - 1) / ROWS_PER_TILE;
+		const coord_t tileCount = tilesPerSlice * outputBlock.depth();
 
-						// Convert to camera coordinates
-						float32_t u = pDot.dot(uVec);
-						float32_t v = pDot.dot(vVec);
+		size_t counter = 0;
+		#pragma omp parallel if(!omp_in_parallel() && tileCount > 1)
+		{
+			std::vector<float32_t> sums(ROWS_PER_TILE * width);
+			std::vector<float32_t> uBuffer(width);
+			std::vector<float32_t> vBuffer(width);
+			std::vector<float32_t> weightBuffer(width);
 
-						// NOTE: We have pre-divided uVec and vVec by M, so division is not necessary here.
-						// If uVec and vVec would be unit vectors, then we have to divide by M here.
-						//u /= M;
-						//v /= M;
+			#pragma omp for schedule(dynamic)
+			for (coord_t tile = 0; tile < tileCount; tile++)
+			{
+				coord_t z = tile / tilesPerSlice;
+				coord_t yStart = (tile % tilesPerSlice) * ROWS_PER_TILE;
+				coord_t yEnd = std::min(yStart + ROWS_PER_TILE, outputBlock.height());
 
-						u += projectionHalfWidth;
-						v += projectionHalfHeight;
+				std::fill(sums.begin(), sums.end(), 0.0f);
 
-						// This weight is needed in the FDK algorithm.
-						float32_t weight = settings.sourceToRA / (settings.sourceToRA + p.dot(wHat));
-						weight *= weight;
+				for (coord_t angleStart = 0; angleStart < angleCount; angleStart += ANGLES_PER_BLOCK)
+				{
+					coord_t angleEnd = std::min(angleStart + ANGLES_PER_BLOCK, angleCount);
+					for (coord_t y = yStart; y < yEnd; y++)
+					{
+						Vec3f p0 = origin + Vec3f(0, (float32_t)y, (float32_t)z);
+						float32_t* row = &sums[(y - yStart) * width];
+						for (coord_t anglei = angleStart; anglei < angleEnd; anglei++)
+							internals::backprojectRow(projectionBlock, projectionRowStart, anglei, geometry[anglei], p0, settings.sourceToRA, width, row, uBuffer.data(), vBuffer.data(), weightBuffer.data());
+					}
+				}
 
-						sum += weight * interpolator(transmissionProjections, u, v, (float32_t)anglei);
+				// Scaling
+				for (coord_t y = yStart; y < yEnd; y++)
+				{
+					const float32_t* row = &sums[(y - yStart) * width];
+					for (coord_t x = 0; x < width; x++)
+					{
+						float32_t sum = row[x] * normFact;
+						sum = (sum - settings.dynMin) / (settings.dynMax - settings.dynMin) * NumberUtils<out_t>::scale();
+						outputBlock(x, y, z) = pixelRound<out_t>(sum);
 					}
 				}
 
-				sum *= normFact;
+				showThreadProgress(counter, tileCount);
+			}
+		}
+	}
 
-				// Scaling
-				sum = (sum - settings.dynMin) / (settings.dynMax - settings.dynMin) * NumberUtils<out_t>::scale();
-				output(x, y, z) = pixelRound<out_t>(sum);
-			},
-			true);
+	/**
+	Backprojects preprocessed projections using the CPU.
+	*/
+	template<typename out_t> void backproject(const Image<float32_t>& transmissionProjections, RecSettings settings, Image<out_t>& output)
+	{
+		output.ensureSize(backprojectionSize(transmissionProjections.dimensions(), settings));
+		backprojectBlock(transmissionProjections, transmissionProjections.dimensions(), 0, settings, output, 0);
 	}
 
 
@@ -895,6 +1094,8 @@ namespace itl2
 		void recSettings();
 		void fbp();
 		void paganin();
+		void cpuBackProjection();
+		void backprojectBlocks();
 
 		void openCLBackProjection();
 		void openCLBackProjectionRealBin2();
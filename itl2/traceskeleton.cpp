@@ -396,6 +396,7 @@ namespace itl2
 
 				showThreadProgress(counter, net.edges.size());
 			}
+			net.invalidateIndex();
 
 			// Change indices also in incomplete edge list
 			counter = 0;
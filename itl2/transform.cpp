@@ -6,6 +6,7 @@
 #include "pointprocess.h"
 #include "testutils.h"
 #include "generation.h"
+#include "timer.h"
 
 
 using namespace std;
@@ -257,5 +258,147 @@ namespace itl2
 			singleCropTest(Vec3c(110, 90, 0));
 			singleCropTest(Vec3c(-50, 90, 0));
 		}
+
+		namespace
+		{
+			/*
+			Straightforward linear or cubic interpolation that evaluates all taps using getPixelSafe.
+			*/
+			double referenceInterpolate(const Image<float32_t>& img, double x, double y, double z, bool cubic, BoundaryCondition bc, bool invalid)
+			{
+				coord_t before = cubic ? 1 : 0;
+				coord_t size = cubic ? 4 : 2;
+				auto weight = [&](double d)
+				{
+					return cubic ? internals::w_cub(d, 0.5) : 1 - std::abs(d);
+				};
+
+				coord_t u0 = itl2::floor(x) - before;
+				coord_t v0 = itl2::floor(y) - before;
+				coord_t w0 = itl2::floor(z) - before;
+
+				double r = 0, wTotR = 0;
+				for (coord_t w = w0; w < w0 + size; w++)
+				{
+					double q = 0, wTotQ = 0;
+					for (coord_t v = v0; v < v0 + size; v++)
+					{
+						double p = 0, wTotP = 0;
+						for (coord_t u = u0; u < u0 + size; u++)
+						{
+							float32_t pix = getPixelSafe(img, u, v, w, bc);
+							if (!invalid || pix != 0)
+							{
+								p += pix * weight(x - u);
+								wTotP += weight(x - u);
+							}
+						}
+						if (!invalid || wTotP > 0)
+						{
+							q += (invalid ? p / wTotP : p) * weight(y - v);
+							wTotQ += weight(y - v);
+						}
+					}
+					if (!invalid || wTotQ > 0)
+					{
+						r += (invalid ? q / wTotQ : q) * weight(z - w);
+						wTotR += weight(z - w);
+					}
+				}
+
+				if (invalid)
+					return wTotR > 0 ? r / wTotR : 0;
+				return r;
+			}
+
+			void testInterpolator(const Image<float32_t>& img, const Interpolator<float32_t, float32_t, double>& interp, bool cubic, bool invalid)
+			{
+				string desc = string(cubic ? "cubic" : "linear") + (invalid ? " invalid value" : "") + " interpolation, " + toString(interp.boundaryCondition()) + ", image size = " + toString(img.dimensions());
+
+				// Lines that start outside the image, cross it, and include pixel centers.
+				vector<tuple<Vec3d, Vec3d> > lines =
+				{
+					{ Vec3d(-3.3, 2.7, 1.2), Vec3d(0.37, 0.11, 0.05) },
+					{ Vec3d(-2, 3, 0), Vec3d(1, 0, 0) },
+					{ Vec3d(4.5, -2.5, 3.25), Vec3d(0.5, 0.25, 0) },
+					{ Vec3d(30.2, 1.1, 0), Vec3d(-0.7, 0.3, 0.1) },
+				};
+
+				vector<float32_t> result(80);
+				double maxDiff = 0;
+				for (const auto& line : lines)
+				{
+					Vec3d start = get<0>(line);
+					Vec3d step = get<1>(line);
+					if (img.depth() <= 1)
+					{
+						start.z = 0;
+						step.z = 0;
+					}
+
+					interp.line(img, start, step, (coord_t)result.size(), result.data());
+
+					for (size_t i = 0; i < result.size(); i++)
+					{
+						Vec3d p = start + (double)i * step;
+						double expected = referenceInterpolate(img, p.x, p.y, p.z, cubic, interp.boundaryCondition(), invalid);
+						maxDiff = std::max(maxDiff, std::abs(expected - result[i]));
+						maxDiff = std::max(maxDiff, std::abs((double)interp(img, p) - result[i]));
+					}
+				}
+
+				testAssert(maxDiff < 1e-3, desc + ", max difference = " + toString(maxDiff));
+			}
+		}
+
+		void interpolation()
+		{
+			Image<float32_t> img3(25, 21, 17);
+			Image<float32_t> img2(25, 21);
+			for (Image<float32_t>* img : { &img3, &img2 })
+			{
+				for (coord_t n = 0; n < img->pixelCount(); n++)
+					(*img)(n) = (float32_t)((n * 7919) % 101 + 1);
+
+				// Some invalid pixels for the invalid value interpolators.
+				(*img)(3, 4, 0) = 0;
+				(*img)(10, 5, 0) = 0;
+				(*img)(11, 5, 0) = 0;
+			}
+
+			for (BoundaryCondition bc : { BoundaryCondition::Zero, BoundaryCondition::Nearest })
+			{
+				for (const Image<float32_t>* img : { &img3, &img2 })
+				{
+					testInterpolator(*img, LinearInterpolator<float32_t, float32_t, double, double>(bc), false, false);
+					testInterpolator(*img, CubicInterpolator<float32_t, float32_t, double, double>(bc), true, false);
+					testInterpolator(*img, LinearInvalidValueInterpolator<float32_t, float32_t, double, double>(bc, 0, 0), false, true);
+					testInterpolator(*img, CubicInvalidValueInterpolator<float32_t, float32_t, double, double>(bc, 0, 0), true, true);
+				}
+			}
+
+			// Translation by integer shift must copy pixel values.
+			Image<float32_t> shifted(img3.dimensions());
+			translate(img3, shifted, Vec3d(2, -1, 3), CubicInterpolator<float32_t, float32_t>(BoundaryCondition::Zero));
+			testAssert(shifted(2, 0, 3) == img3(0, 1, 0) && shifted(24, 19, 16) == img3(22, 20, 13) && shifted(1, 5, 5) == 0, "translation by integer shift");
+		}
+
+		void interpolationSpeed()
+		{
+			Image<uint16_t> img(400, 400, 400);
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+				img(n) = (uint16_t)(n % 1000);
+
+			Image<uint16_t> out(img.dimensions());
+			Timer timer;
+			for (InterpolationMode mode : { InterpolationMode::Nearest, InterpolationMode::Linear, InterpolationMode::Cubic })
+			{
+				timer.start();
+				rotate(img, out, 0.3, Vec3d(1, 1, 1), *createInterpolator<uint16_t, uint16_t>(mode, BoundaryCondition::Zero));
+				timer.stop();
+				cout << "Rotation with " << toString(mode) << " interpolation took " << timer.getTime() << " ms." << endl;
+			}
+		}
 	}
 }
+
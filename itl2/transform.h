@@ -244,12 +244,19 @@ namespace itl2
 		Matrix3x3<real_t> R = Matrix3x3<real_t>::rotationMatrix(angle, axis);
 		R.transpose();
 
-		forAllPixels(out, [&](coord_t x, coord_t y, coord_t z)
+		// Input positions corresponding to a line of output pixels are on a line, too.
+		Vec3d step = R * Vec3d(1, 0, 0);
+
+		#pragma omp parallel for if(out.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+		for (coord_t z = 0; z < out.depth(); z++)
 		{
-			Vec3d outPos((real_t)x, (real_t)y, (real_t)z);
-			Vec3d inPos = R * (outPos - outCenter) + inCenter;
-			out(x, y, z) = interpolate(in, Vec3<typename NumberUtils<out_t>::RealFloatType>(inPos));
-		});
+			for (coord_t y = 0; y < out.height(); y++)
+			{
+				Vec3d outPos(0, (real_t)y, (real_t)z);
+				Vec3d inPos = R * (outPos - outCenter) + inCenter;
+				interpolate.line(in, inPos, step, out.width(), &out(0, y, z));
+			}
+		}
 	}
 
 	/**
@@ -277,18 +284,19 @@ namespace itl2
 	*/
 	template<typename pixel_t, typename out_t> void translate(const Image<pixel_t>& in, Image<out_t>& out, const Vec3d& shift, const Interpolator<out_t, pixel_t>& interpolate = LinearInterpolator<out_t, pixel_t>(BoundaryCondition::Zero))
 	{
-		using real_t = typename NumberUtils<out_t>::RealFloatType;
 		out.mustNotBe(in);
 		if(out.dimensions().max() <= 1)
 			out.ensureSize(in);
 
-		forAllPixels(out, [&](coord_t x, coord_t y, coord_t z)
+		#pragma omp parallel for if(out.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+		for (coord_t z = 0; z < out.depth(); z++)
 		{
-			real_t xs = (real_t)(x - shift.x);
-			real_t ys = (real_t)(y - shift.y);
-			real_t zs = (real_t)(z - shift.z);
-			out(x, y, z) = interpolate(in, xs, ys, zs);
-		});
+			for (coord_t y = 0; y < out.height(); y++)
+			{
+				Vec3d start(-shift.x, y - shift.y, z - shift.z);
+				interpolate.line(in, start, Vec3d(1, 0, 0), out.width(), &out(0, y, z));
+			}
+		}
 	}
 	/**
 	Transposes the input image and stores the result in the output image.
@@ -621,11 +629,7 @@ namespace itl2
 				for (coord_t y = 0; y < out.height(); y++)
 				{
 					real_t sy = (real_t)(y / factor.y) + (real_t)delta.y;
-					for (coord_t x = 0; x < out.width(); x++)
-					{
-						real_t sx = (real_t)(x / factor.x) + (real_t)delta.x;
-						out(x, y, z) = interpolate(in, sx, sy, sz);
-					}
+					interpolate.line(in, Vec3d(delta.x, sy, sz), Vec3d(1 / factor.x, 0, 0), out.width(), &out(0, y, z));
 				}
 
 				showThreadProgress(counter, out.depth(), indicateProgress);
@@ -951,6 +955,8 @@ namespace itl2
 		void rotate();
 		void reslice();
 		void crop();
+		void interpolation();
+		void interpolationSpeed();
 	}
 
 }
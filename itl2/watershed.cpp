@@ -0,0 +1,236 @@
+
+#include "watershed.h"
+#include "noise.h"
+#include "filters.h"
+#include "pointprocess.h"
+#include "projections.h"
+#include "timer.h"
+#include "testutils.h"
+
+#include <random>
+
+using namespace std;
+
+namespace itl2
+{
+	namespace tests
+	{
+		void hierarchicalQueue()
+		{
+			HierarchicalQueue<size_t> queue(100);
+			std::vector<std::tuple<size_t, size_t> > items;
+
+			std::mt19937 gen(123);
+			std::uniform_int_distribution<size_t> dist(0, 99);
+			for (size_t n = 0; n < 100000; n++)
+			{
+				size_t level = dist(gen);
+				queue.push(level, n);
+				items.push_back(std::make_tuple(level, n));
+			}
+
+			testAssert(queue.size() == items.size(), "queue size");
+
+			// Higher levels first, and in insertion order within each level.
+			std::sort(items.begin(), items.end(), [](const auto& a, const auto& b)
+				{
+					if (std::get<0>(a) != std::get<0>(b))
+						return std::get<0>(a) > std::get<0>(b);
+					return std::get<1>(a) < std::get<1>(b);
+				});
+
+			for (size_t n = 0; n < items.size(); n++)
+			{
+				testAssert(queue.level() == std::get<0>(items[n]), "queue level");
+				size_t item = queue.pop();
+				testAssert(item == std::get<1>(items[n]), "queue order");
+			}
+
+			testAssert(queue.empty(), "queue not empty");
+
+			// Interleaved pushes and pops.
+			queue.push(10, 1);
+			queue.push(20, 2);
+			testAssert(queue.pop() == 2, "interleaved pop 1");
+			queue.push(5, 3);
+			queue.push(10, 4);
+			testAssert(queue.pop() == 1, "interleaved pop 2");
+			testAssert(queue.pop() == 4, "interleaved pop 3");
+			testAssert(queue.pop() == 3, "interleaved pop 4");
+			testAssert(queue.empty(), "queue not empty after interleaved operations");
+		}
+
+		namespace
+		{
+			/**
+			Creates test weight image and seeds.
+			*/
+			void createGrowTestImages(Image<uint16_t>& weights, Image<uint32_t>& labels, coord_t seedCount)
+			{
+				Image<uint16_t> tmp(weights.dimensions());
+				noise(tmp, 500, 300, 17);
+				gaussFilter(tmp, weights, 3.0);
+				linearMap(weights, Vec4d(470, 530, 1, 1000));
+
+				// Some pixels can't be filled.
+				for (coord_t n = 0; n < weights.pixelCount(); n += 97)
+					weights(n) = 0;
+
+				labels.ensureSize(weights);
+				setValue(labels, 0);
+				std::mt19937 gen(456);
+				for (coord_t n = 0; n < seedCount; n++)
+				{
+					Vec3c pos(gen() % weights.width(), gen() % weights.height(), gen() % weights.depth());
+					labels(pos) = (uint32_t)(n % (seedCount / 2) + 1);
+				}
+			}
+
+			/**
+			Counts pixels whose labels differ, and checks that the same pixels are filled in both images.
+			*/
+			size_t countDifferences(const Image<uint32_t>& a, const Image<uint32_t>& b)
+			{
+				size_t diff = 0;
+				bool sameFilled = true;
+				for (coord_t n = 0; n < a.pixelCount(); n++)
+				{
+					if (a(n) != b(n))
+						diff++;
+					if ((a(n) == 0) != (b(n) == 0))
+						sameFilled = false;
+				}
+
+				testAssert(sameFilled, "filled pixels differ");
+				return diff;
+			}
+		}
+
+		void growHierarchical()
+		{
+			Image<uint16_t> weights(120, 110, 100);
+			Image<uint32_t> seeds;
+			createGrowTestImages(weights, seeds, 40);
+
+			Image<uint32_t> expected;
+			setValue(expected, seeds);
+			grow(expected, weights);
+
+			Image<uint32_t> result;
+			setValue(result, seeds);
+			grow(result, weights, GrowMethod::HierarchicalQueue);
+
+			// Only pixels reached simultaneously from two seeds may differ.
+			size_t diff = countDifferences(expected, result);
+			cout << diff << " pixels differ." << endl;
+			testAssert(diff < (size_t)(0.001 * expected.pixelCount()), "hierarchical queue result");
+
+			// Non-integer weights are not supported.
+			Image<float32_t> fweights(weights.dimensions());
+			try
+			{
+				grow(result, fweights, GrowMethod::HierarchicalQueue);
+				testAssert(false, "float weights should not be supported");
+			}
+			catch (const ITLException&)
+			{
+			}
+		}
+
+		void growParallel()
+		{
+			Image<uint16_t> weights(120, 110, 100);
+			Image<uint32_t> seeds;
+			createGrowTestImages(weights, seeds, 40);
+
+			Image<uint32_t> expected;
+			setValue(expected, seeds);
+			grow(expected, weights, GrowMethod::HierarchicalQueue);
+
+			Image<uint32_t> result;
+			setValue(result, seeds);
+			grow(result, weights, GrowMethod::Parallel);
+
+			// Only pixels whose filling order is ambiguous may differ.
+			size_t diff = countDifferences(expected, result);
+			cout << diff << " pixels differ." << endl;
+			testAssert(diff < (size_t)(0.05 * expected.pixelCount()), "parallel result");
+
+			// The result must not depend on the count of slabs.
+			for (int32_t slabCount : { 1, 3, 8, 100 })
+			{
+				Image<uint32_t> slabResult;
+				setValue(slabResult, seeds);
+				internals::growParallel(slabResult, weights, slabCount, false);
+				testAssert(equals(slabResult, result), string("parallel result with ") + toString(slabCount) + " slabs");
+			}
+
+			// Two basins separated by a wall that has a single hole.
+			// The fronts must be passed through all the slabs processed by separate threads.
+			Image<uint8_t> w2(50, 40, 60);
+			for (coord_t z = 0; z < w2.depth(); z++)
+			{
+				for (coord_t y = 0; y < w2.height(); y++)
+				{
+					for (coord_t x = 0; x < w2.width(); x++)
+					{
+						if (x < 25)
+							w2(x, y, z) = (uint8_t)(100 + x);
+						else if (x > 25)
+							w2(x, y, z) = (uint8_t)(50 + x);
+					}
+				}
+			}
+			w2(25, 20, 30) = 10;
+
+			// Each basin is filled from its own seed.
+			Image<uint32_t> l2(w2.dimensions());
+			l2(5, 5, 0) = 1;
+			l2(45, 35, 59) = 2;
+			itl2::growParallel(l2, w2);
+			bool ok = true;
+			for (coord_t z = 0; z < w2.depth(); z++)
+			{
+				for (coord_t y = 0; y < w2.height(); y++)
+				{
+					for (coord_t x = 0; x < w2.width(); x++)
+					{
+						if (x != 25 && l2(x, y, z) != (x < 25 ? 1u : 2u))
+							ok = false;
+					}
+				}
+			}
+			testAssert(ok, "parallel result in two basins");
+
+			// Both basins are filled from single seed through the hole.
+			setValue(l2, 0);
+			l2(5, 5, 0) = 1;
+			itl2::growParallel(l2, w2);
+			ok = true;
+			for (coord_t n = 0; n < w2.pixelCount(); n++)
+			{
+				if (l2(n) != (w2(n) > 0 ? 1u : 0u))
+					ok = false;
+			}
+			testAssert(ok, "parallel result through hole");
+		}
+
+		void growSpeed()
+		{
+			Image<uint16_t> weights(400, 400, 400);
+			Image<uint32_t> seeds;
+			createGrowTestImages(weights, seeds, 2000);
+
+			Timer timer;
+			for (GrowMethod method : { GrowMethod::PriorityQueue, GrowMethod::HierarchicalQueue, GrowMethod::Parallel })
+			{
+				Image<uint32_t> result;
+				setValue(result, seeds);
+				timer.start();
+				grow(result, weights, method);
+				timer.stop();
+				cout << toString(method) << " took " << timer.getTime() << " ms." << endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,806 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <omp.h>
+
+#include "image.h"
+#include "math/vec3.h"
+#include "floodfill.h"
+#include "utilities.h"
+
+namespace itl2
+{
+	/**
+	Priority queue whose priorities are integers in range [0, level count - 1].
+	Each priority level is stored in a separate first-in-first-out bucket, so that
+	push and pop operations take constant time. Items having the highest priority level are popped first,
+	and items with equal priority are popped in the order they were pushed.
+	*/
+	template<typename item_t> class HierarchicalQueue
+	{
+	private:
+		/**
+		Items in each priority level.
+		*/
+		std::vector<std::vector<item_t> > buckets;
+
+		/**
+		Index of the first item not yet popped in each bucket.
+		*/
+		std::vector<size_t> heads;
+
+		/**
+		Highest priority level that contains items.
+		*/
+		size_t topLevel;
+
+		/**
+		Total count of items in the queue.
+		*/
+		size_t itemCount;
+
+	public:
+		/**
+		Constructor
+		@param levelCount Count of priority levels.
+		*/
+		explicit HierarchicalQueue(size_t levelCount) :
+			buckets(levelCount),
+			heads(levelCount, 0),
+			topLevel(0),
+			itemCount(0)
+		{
+		}
+
+		/**
+		Gets count of priority levels.
+		*/
+		size_t levelCount() const
+		{
+			return buckets.size();
+		}
+
+		/**
+		Tests if the queue is empty.
+		*/
+		bool empty() const
+		{
+			return itemCount <= 0;
+		}
+
+		/**
+		Gets count of items in the queue.
+		*/
+		size_t size() const
+		{
+			return itemCount;
+		}
+
+		/**
+		Gets priority level of the item that will be popped next.
+		The queue must not be empty.
+		*/
+		size_t level() const
+		{
+			return topLevel;
+		}
+
+		/**
+		Adds an item to the queue.
+		@param level Priority level of the item, in range [0, level count - 1].
+		*/
+		void push(size_t level, const item_t& item)
+		{
+			buckets[level].push_back(item);
+			if (itemCount <= 0 || level > topLevel)
+				topLevel = level;
+			itemCount++;
+		}
+
+		/**
+		Removes the oldest item in the highest priority level and returns it.
+		The queue must not be empty.
+		*/
+		item_t pop()
+		{
+			std::vector<item_t>& bucket = buckets[topLevel];
+			size_t& head = heads[topLevel];
+			item_t item = bucket[head];
+			head++;
+			itemCount--;
+
+			if (head >= bucket.size())
+			{
+				bucket.clear();
+				head = 0;
+
+				if (itemCount > 0)
+				{
+					while (buckets[topLevel].empty())
+						topLevel--;
+				}
+			}
+			else if (head >= 4096 && 2 * head >= bucket.size())
+			{
+				// Items are pushed to the current level while it is being processed, so the bucket might never become empty.
+				// Remove the popped items from the beginning of the bucket to keep memory usage proportional to the count of items in the queue.
+				bucket.erase(bucket.begin(), bucket.begin() + head);
+				head = 0;
+			}
+
+			return item;
+		}
+	};
+
+	/**
+	Algorithms available for priority-based region growing.
+	*/
+	enum class GrowMethod
+	{
+		/**
+		Meyer's flooding algorithm using a binary heap as priority queue.
+		Supports all weight data types.
+		*/
+		PriorityQueue,
+
+		/**
+		Meyer's flooding algorithm using a hierarchical queue.
+		Supports integer weights only.
+		The result equals that of PriorityQueue method, except possibly at pixels that are reached simultaneously from different seeds.
+		*/
+		HierarchicalQueue,
+
+		/**
+		Parallel flooding where the image is divided into blocks that are processed in separate threads,
+		and label fronts are passed between blocks until the result does not change.
+		Supports integer weights only.
+		The result differs from that of the other methods only at pixels where the filling order cannot be determined locally.
+		*/
+		Parallel
+	};
+
+	template<>
+	inline std::string toString(const GrowMethod& x)
+	{
+		switch (x)
+		{
+		case GrowMethod::PriorityQueue: return "PriorityQueue";
+		case GrowMethod::HierarchicalQueue: return "HierarchicalQueue";
+		case GrowMethod::Parallel: return "Parallel";
+		}
+		throw ITLException("Invalid grow method.");
+	}
+
+	template<>
+	inline GrowMethod fromString(const string& str0)
+	{
+		string str = str0;
+		toLower(str);
+		if (str == "priorityqueue")
+			return GrowMethod::PriorityQueue;
+		if (str == "hierarchicalqueue")
+			return GrowMethod::HierarchicalQueue;
+		if (str == "parallel")
+			return GrowMethod::Parallel;
+
+		throw ITLException(string("Invalid grow method: ") + str0);
+	}
+
+	namespace internals
+	{
+		/**
+		Finds minimum and maximum of positive weights.
+		@return False if there are no positive weights in the image.
+		*/
+		template<typename weight_t> bool positiveWeightRange(const Image<weight_t>& weights, weight_t& minWeight, weight_t& maxWeight)
+		{
+			minWeight = std::numeric_limits<weight_t>::max();
+			maxWeight = 0;
+
+			#pragma omp parallel if(!omp_in_parallel() && weights.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				weight_t minLocal = std::numeric_limits<weight_t>::max();
+				weight_t maxLocal = 0;
+
+				#pragma omp for
+				for (coord_t n = 0; n < weights.pixelCount(); n++)
+				{
+					weight_t w = weights(n);
+					if (w > 0)
+					{
+						minLocal = std::min(minLocal, w);
+						maxLocal = std::max(maxLocal, w);
+					}
+				}
+
+				#pragma omp critical(positiveWeightRange)
+				{
+					minWeight = std::min(minWeight, minLocal);
+					maxWeight = std::max(maxWeight, maxLocal);
+				}
+			}
+
+			return maxWeight > 0;
+		}
+
+		/**
+		Calculates count of levels needed in a hierarchical queue for the given weight range.
+		*/
+		template<typename weight_t> size_t levelCount(weight_t minWeight, weight_t maxWeight)
+		{
+			static_assert(std::is_integral_v<weight_t>, "Hierarchical queues support integer weights only.");
+
+			constexpr uint64_t MAX_LEVELS = 1 << 24;
+			uint64_t count = (uint64_t)maxWeight - (uint64_t)minWeight + 1;
+			if (count > MAX_LEVELS)
+				throw ITLException(string("The range of weights is too large for a hierarchical queue. Use priority queue instead, or scale the weights to range [1, ") + toString(MAX_LEVELS) + "].");
+
+			return (size_t)count;
+		}
+
+		/**
+		Storage class for fill point hierarchical queue in Meyer's algorithm.
+		*/
+		template<typename label_t> struct HierarchicalSeed
+		{
+			Vec3sc pos;
+			label_t label;
+		};
+	}
+
+	/**
+	Region grow segmentation using Meyer's flooding algorithm and hierarchical queue.
+	The result equals that of grow(labels, weights), except possibly at pixels that are reached simultaneously from
+	two different seeds, but the processing is faster as hierarchical queue operations take constant time.
+	The argument images must be of the same size.
+	@param labels Image containing the labels of distinct areas. At input, the image must contain the seed points as nonzero pixels and background as zero pixels; after the algorithm finishes, the image will contain the segmented regions corresponding to the seed points. Multiple seeds may have the same value.
+	@param weights Image containing the filling priority of each pixel. This image is not modified. If priority is zero or negative, the pixel is never filled. Must be of integer data type.
+	*/
+	template<typename label_t, typename weight_t> void growHierarchical(Image<label_t>& labels, const Image<weight_t>& weights)
+	{
+		weights.checkSize(labels);
+		weights.mustNotBe(labels);
+
+		if constexpr (!std::is_integral_v<weight_t>)
+		{
+			throw ITLException("Region growing using hierarchical queue supports integer weights only.");
+		}
+		else
+		{
+			weight_t minWeight, maxWeight;
+			if (!internals::positiveWeightRange(weights, minWeight, maxWeight))
+				minWeight = maxWeight = 1;
+
+			// Seeds are placed to the highest level, above all weights.
+			size_t seedLevel = internals::levelCount(minWeight, maxWeight);
+			HierarchicalQueue<internals::HierarchicalSeed<label_t> > points(seedLevel + 1);
+
+			// Add all seed points to the queue
+			for (coord_t z = 0; z < labels.depth(); z++)
+			{
+				for (coord_t y = 0; y < labels.height(); y++)
+				{
+					for (coord_t x = 0; x < labels.width(); x++)
+					{
+						label_t& p = labels(x, y, z);
+						if (p != 0)
+						{
+							points.push(seedLevel, { Vec3sc((int32_t)x, (int32_t)y, (int32_t)z), p });
+							p = 0;
+						}
+					}
+				}
+			}
+
+			while (!points.empty())
+			{
+				internals::HierarchicalSeed<label_t> obj = points.pop();
+				const Vec3sc& p = obj.pos;
+
+				// Only proceed if the label of this pixel has not been set yet.
+				if (labels(p) == 0)
+				{
+					labels(p) = obj.label;
+
+					// Insert neighbours into the queue.
+					for (size_t n = 0; n < p.size(); n++)
+					{
+						if (p[n] > 0)
+						{
+							Vec3sc np = p;
+							np[n]--;
+
+							if (labels(np) == 0)
+							{
+								weight_t w = weights(np);
+								if (w > 0)
+									points.push((size_t)(w - minWeight), { np, obj.label });
+							}
+						}
+
+						if (p[n] < labels.dimension(n) - 1)
+						{
+							Vec3sc np = p;
+							np[n]++;
+
+							if (labels(np) == 0)
+							{
+								weight_t w = weights(np);
+								if (w > 0)
+									points.push((size_t)(w - minWeight), { np, obj.label });
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	namespace internals
+	{
+		/**
+		Flooding state of each pixel in the parallel region growing algorithm.
+		The states define the order in which Meyer's algorithm would fill the pixels:
+		Pixels are filled in descending order of flooding level. The flooding level of a pixel is the maximum over all paths
+		from a seed of the minimum weight along the path.
+		Pixels of equal level are filled in ascending order of distance from the point where the flood entered that level,
+		and among equal distances, in descending order of the level from where the flood entered the current level.
+		*/
+		template<typename weight_t> struct FloodState
+		{
+			/**
+			Flooding level of each pixel. Seeds are at the highest possible level, and pixels not reached yet are at level zero.
+			*/
+			Image<weight_t> levels;
+
+			/**
+			Level from where the flood entered the level of each pixel.
+			*/
+			Image<weight_t> entryLevels;
+
+			/**
+			Count of steps from the point where the flood entered the level of each pixel.
+			*/
+			Image<uint16_t> distances;
+
+			weight_t minWeight;
+			weight_t maxWeight;
+
+			FloodState(const Vec3c& dimensions, weight_t minWeight, weight_t maxWeight) :
+				levels(dimensions),
+				entryLevels(dimensions),
+				distances(dimensions),
+				minWeight(minWeight),
+				maxWeight(maxWeight)
+			{
+			}
+
+			/**
+			Calculates hierarchical queue level corresponding to flooding level.
+			*/
+			size_t queueLevel(weight_t level) const
+			{
+				return (size_t)(std::min(level, maxWeight) - minWeight);
+			}
+
+			/**
+			Calculates the state that pixel at np would get if flooded from pixel at p.
+			*/
+			void offer(const Vec3sc& p, const Vec3sc& np, const Image<weight_t>& weights, weight_t& level, uint16_t& distance, weight_t& entryLevel) const
+			{
+				weight_t w = weights(np);
+				weight_t pLevel = levels(p);
+				if (w < pLevel)
+				{
+					// The flood enters a lower level.
+					level = w;
+					distance = 0;
+					entryLevel = pLevel;
+				}
+				else
+				{
+					// The flood stays at the same level. Pixels of larger weight are filled immediately by Meyer's algorithm.
+					uint16_t pDistance = distances(p);
+					level = pLevel;
+					distance = w == pLevel && pDistance < std::numeric_limits<uint16_t>::max() ? pDistance + 1 : pDistance;
+					entryLevel = entryLevels(p);
+				}
+			}
+
+			/**
+			Tests if the given state is better than the state of pixel p.
+			*/
+			bool isBetter(weight_t level, uint16_t distance, weight_t entryLevel, const Vec3sc& p) const
+			{
+				weight_t pLevel = levels(p);
+				if (level != pLevel)
+					return level > pLevel;
+				uint16_t pDistance = distances(p);
+				if (distance != pDistance)
+					return distance < pDistance;
+				return entryLevel > entryLevels(p);
+			}
+
+			/**
+			Tests if the state of pixel np is the one it gets if flooded from its neighbour p.
+			*/
+			bool isFloodedFrom(const Vec3sc& p, const Vec3sc& np, const Image<weight_t>& weights) const
+			{
+				weight_t level;
+				uint16_t distance;
+				weight_t entryLevel;
+				offer(p, np, weights, level, distance, entryLevel);
+				return level == levels(np) && distance == distances(np) && entryLevel == entryLevels(np);
+			}
+
+			/**
+			Sets state of a pixel.
+			*/
+			void set(const Vec3sc& p, weight_t level, uint16_t distance, weight_t entryLevel)
+			{
+				levels(p) = level;
+				distances(p) = distance;
+				entryLevels(p) = entryLevel;
+			}
+		};
+
+		/**
+		Point in the hierarchical queue of the parallel region growing algorithm.
+		*/
+		struct FloodPoint
+		{
+			Vec3sc pos;
+			uint16_t distance;
+		};
+
+		/**
+		Pending update of flooding state of a pixel on a slab boundary.
+		*/
+		template<typename weight_t> struct StateUpdate
+		{
+			Vec3sc pos;
+			weight_t level;
+			uint16_t distance;
+			weight_t entryLevel;
+		};
+
+		/**
+		Pending update of label of a pixel on a slab boundary.
+		*/
+		template<typename label_t> struct LabelUpdate
+		{
+			Vec3sc pos;
+			label_t label;
+		};
+
+		/**
+		Calls f(p, np) for each 6-neighbour np of p that is inside z-range [z0, z1[ and can be filled.
+		*/
+		template<typename weight_t, typename F> void forFillableNeighbours(const Vec3sc& p, const Image<weight_t>& weights, int32_t z0, int32_t z1, F f)
+		{
+			Vec3sc dims((int32_t)weights.width(), (int32_t)weights.height(), z1);
+			for (size_t n = 0; n < p.size(); n++)
+			{
+				int32_t lowLimit = n == 2 ? z0 : 0;
+
+				for (int32_t delta : { -1, 1 })
+				{
+					Vec3sc np = p;
+					np[n] += delta;
+					if (np[n] >= lowLimit && np[n] < dims[n] && weights(np) > 0)
+						f(np);
+				}
+			}
+		}
+
+		/**
+		Calls find(p, np, updates) for each pixel np on plane z and its neighbour p on plane z + dz.
+		*/
+		template<typename update_t, typename F> void findBoundaryUpdates(const Vec3c& dimensions, int32_t z, int32_t dz, std::vector<update_t>& updates, F find)
+		{
+			for (int32_t y = 0; y < (int32_t)dimensions.y; y++)
+			{
+				for (int32_t x = 0; x < (int32_t)dimensions.x; x++)
+					find(Vec3sc(x, y, z + dz), Vec3sc(x, y, z), updates);
+			}
+		}
+
+		/**
+		Processes all slabs in parallel until nothing changes at slab boundaries.
+		@param process Function process(s) that processes slab s until its queue is empty.
+		@param find Function find(p, np, updates) that adds update of pixel np on boundary of a slab to the list if the pixel changes when processed from pixel p in the neighbouring slab.
+		@param apply Function apply(s, update) that applies update to slab s and adds the updated pixel to the queue of the slab.
+		@return Count of iterations where some pixels at slab boundaries changed.
+		*/
+		template<typename update_t, typename Process, typename Find, typename Apply> size_t processSlabs(const Vec3c& dimensions, const std::vector<int32_t>& slabStart, Process process, Find find, Apply apply, bool showProgressInfo)
+		{
+			int32_t slabCount = (int32_t)slabStart.size() - 1;
+			std::vector<std::vector<update_t> > updates(slabCount);
+
+			size_t iteration = 0;
+			while (true)
+			{
+				#pragma omp parallel for schedule(static, 1) if(slabCount > 1)
+				for (int32_t s = 0; s < slabCount; s++)
+					process(s);
+
+				// All updates are found before they are applied so that each slab reads only boundaries of its neighbours.
+				size_t updateCount = 0;
+				#pragma omp parallel for schedule(static, 1) reduction(+:updateCount) if(slabCount > 1)
+				for (int32_t s = 0; s < slabCount; s++)
+				{
+					updates[s].clear();
+					if (s > 0)
+						findBoundaryUpdates(dimensions, slabStart[s], -1, updates[s], find);
+					if (s < slabCount - 1)
+						findBoundaryUpdates(dimensions, slabStart[s + 1] - 1, 1, updates[s], find);
+					updateCount += updates[s].size();
+				}
+
+				if (updateCount <= 0)
+					break;
+
+				iteration++;
+				if (showProgressInfo)
+					std::cout << "Iteration " << iteration << ", " << updateCount << " pixels changed at slab boundaries...\r" << std::flush;
+
+				#pragma omp parallel for schedule(static, 1) if(slabCount > 1)
+				for (int32_t s = 0; s < slabCount; s++)
+				{
+					for (const auto& update : updates[s])
+						apply(s, update);
+				}
+			}
+
+			if (showProgressInfo && iteration > 0)
+				std::cout << std::endl;
+
+			return iteration;
+		}
+
+		/**
+		Parallel region grow segmentation using the given count of slabs.
+		See growParallel.
+		*/
+		template<typename label_t, typename weight_t> void growParallel(Image<label_t>& labels, const Image<weight_t>& weights, int32_t slabCount, bool showProgressInfo)
+		{
+			weight_t minWeight, maxWeight;
+			if (!positiveWeightRange(weights, minWeight, maxWeight))
+				return;
+
+			size_t levelCount = internals::levelCount(minWeight, maxWeight);
+			Vec3c dimensions = labels.dimensions();
+
+			FloodState<weight_t> state(dimensions, minWeight, maxWeight);
+
+			int32_t depth = (int32_t)dimensions.z;
+			slabCount = std::max(1, std::min(depth, slabCount));
+			std::vector<int32_t> slabStart(slabCount + 1);
+			for (int32_t s = 0; s <= slabCount; s++)
+				slabStart[s] = (int32_t)((int64_t)s * depth / slabCount);
+
+			// Phase 1: Determine flooding state of each pixel.
+			// The states do not depend on the processing order, so the slabs can be processed independently and
+			// the states are corrected at slab boundaries afterwards.
+			{
+				std::vector<HierarchicalQueue<FloodPoint> > queues(slabCount, HierarchicalQueue<FloodPoint>(levelCount));
+				std::vector<std::vector<Vec3sc> > immediatePoints(slabCount);
+
+				#pragma omp parallel for schedule(static, 1) if(slabCount > 1)
+				for (int32_t s = 0; s < slabCount; s++)
+				{
+					for (int32_t z = slabStart[s]; z < slabStart[s + 1]; z++)
+					{
+						for (int32_t y = 0; y < (int32_t)dimensions.y; y++)
+						{
+							for (int32_t x = 0; x < (int32_t)dimensions.x; x++)
+							{
+								Vec3sc p(x, y, z);
+								if (labels(p) != 0)
+								{
+									state.set(p, std::numeric_limits<weight_t>::max(), 0, std::numeric_limits<weight_t>::max());
+									queues[s].push(levelCount - 1, { p, 0 });
+								}
+								else
+								{
+									state.set(p, 0, std::numeric_limits<uint16_t>::max(), 0);
+								}
+							}
+						}
+					}
+				}
+
+				auto process = [&](int32_t s)
+				{
+					HierarchicalQueue<FloodPoint>& points = queues[s];
+					std::vector<Vec3sc>& immediate = immediatePoints[s];
+
+					while (!immediate.empty() || !points.empty())
+					{
+						Vec3sc p;
+						if (!immediate.empty())
+						{
+							// Points at the current level and distance are processed before anything else in the queue.
+							p = immediate.back();
+							immediate.pop_back();
+						}
+						else
+						{
+							size_t queueLevel = points.level();
+							FloodPoint point = points.pop();
+							p = point.pos;
+
+							// Skip the point if its state has been improved after it was added to the queue.
+							if (state.queueLevel(state.levels(p)) != queueLevel || state.distances(p) != point.distance)
+								continue;
+						}
+
+						weight_t pLevel = state.levels(p);
+						uint16_t pDistance = state.distances(p);
+
+						forFillableNeighbours(p, weights, slabStart[s], slabStart[s + 1], [&](const Vec3sc& np)
+							{
+								weight_t level;
+								uint16_t distance;
+								weight_t entryLevel;
+								state.offer(p, np, weights, level, distance, entryLevel);
+								if (state.isBetter(level, distance, entryLevel, np))
+								{
+									state.set(np, level, distance, entryLevel);
+									if (level == pLevel && distance == pDistance)
+										immediate.push_back(np);
+									else
+										points.push(state.queueLevel(level), { np, distance });
+								}
+							});
+					}
+				};
+
+				auto find = [&](const Vec3sc& p, const Vec3sc& np, std::vector<StateUpdate<weight_t> >& updates)
+				{
+					if (state.levels(p) > 0 && weights(np) > 0)
+					{
+						StateUpdate<weight_t> update;
+						update.pos = np;
+						state.offer(p, np, weights, update.level, update.distance, update.entryLevel);
+						if (state.isBetter(update.level, update.distance, update.entryLevel, np))
+							updates.push_back(update);
+					}
+				};
+
+				auto apply = [&](int32_t s, const StateUpdate<weight_t>& update)
+				{
+					// If the slab is one pixel thick, the same pixel might get an update from both sides.
+					if (state.isBetter(update.level, update.distance, update.entryLevel, update.pos))
+					{
+						state.set(update.pos, update.level, update.distance, update.entryLevel);
+						queues[s].push(state.queueLevel(update.level), { update.pos, update.distance });
+					}
+				};
+
+				if (showProgressInfo)
+					std::cout << "Determining filling order..." << std::endl;
+				processSlabs<StateUpdate<weight_t> >(dimensions, slabStart, process, find, apply, showProgressInfo);
+			}
+
+			// Phase 2: Propagate labels from seeds to the pixels whose state they determine.
+			// If the state of a pixel is determined by multiple neighbours with different labels, the smallest label is selected
+			// so that the result does not depend on the processing order.
+			{
+				std::vector<HierarchicalQueue<Vec3sc> > queues(slabCount, HierarchicalQueue<Vec3sc>(levelCount));
+
+				#pragma omp parallel for schedule(static, 1) if(slabCount > 1)
+				for (int32_t s = 0; s < slabCount; s++)
+				{
+					for (int32_t z = slabStart[s]; z < slabStart[s + 1]; z++)
+					{
+						for (int32_t y = 0; y < (int32_t)dimensions.y; y++)
+						{
+							for (int32_t x = 0; x < (int32_t)dimensions.x; x++)
+							{
+								if (labels(x, y, z) != 0)
+									queues[s].push(levelCount - 1, Vec3sc(x, y, z));
+							}
+						}
+					}
+				}
+
+				auto process = [&](int32_t s)
+				{
+					HierarchicalQueue<Vec3sc>& points = queues[s];
+					while (!points.empty())
+					{
+						Vec3sc p = points.pop();
+						label_t label = labels(p);
+
+						forFillableNeighbours(p, weights, slabStart[s], slabStart[s + 1], [&](const Vec3sc& np)
+							{
+								label_t& nLabel = labels(np);
+								if ((nLabel == 0 || label < nLabel) && state.isFloodedFrom(p, np, weights))
+								{
+									nLabel = label;
+									points.push(state.queueLevel(state.levels(np)), np);
+								}
+							});
+					}
+				};
+
+				auto find = [&](const Vec3sc& p, const Vec3sc& np, std::vector<LabelUpdate<label_t> >& updates)
+				{
+					label_t label = labels(p);
+					label_t nLabel = labels(np);
+					if (label != 0 && weights(np) > 0 && (nLabel == 0 || label < nLabel) && state.isFloodedFrom(p, np, weights))
+						updates.push_back({ np, label });
+				};
+
+				auto apply = [&](int32_t s, const LabelUpdate<label_t>& update)
+				{
+					label_t& nLabel = labels(update.pos);
+					if (nLabel == 0 || update.label < nLabel)
+					{
+						nLabel = update.label;
+						queues[s].push(state.queueLevel(state.levels(update.pos)), update.pos);
+					}
+				};
+
+				if (showProgressInfo)
+					std::cout << "Filling..." << std::endl;
+				processSlabs<LabelUpdate<label_t> >(dimensions, slabStart, process, find, apply, showProgressInfo);
+			}
+		}
+	}
+
+	/**
+	Parallel region grow segmentation.
+	The image is divided into slabs that are processed in separate threads using hierarchical queues, and
+	changes at slab boundaries are passed to the neighbouring slabs until nothing changes.
+	The filling order of Meyer's algorithm is tracked for each pixel, and each pixel gets the label of the neighbour it would be filled from.
+	The result differs from that of the sequential algorithms only at pixels where the filling order cannot be determined locally. At such pixels
+	the smallest of the candidate labels is selected. The result does not depend on the count of threads.
+	The argument images must be of the same size.
+	The algorithm needs temporary storage of size of two weight images and one 16-bit image.
+	@param labels Image containing the labels of distinct areas. At input, the image must contain the seed points as nonzero pixels and background as zero pixels; after the algorithm finishes, the image will contain the segmented regions corresponding to the seed points. Multiple seeds may have the same value.
+	@param weights Image containing the filling priority of each pixel. This image is not modified. If priority is zero or negative, the pixel is never filled. Must be of integer data type.
+	@param showProgressInfo Set to true to print progress information.
+	*/
+	template<typename label_t, typename weight_t> void growParallel(Image<label_t>& labels, const Image<weight_t>& weights, bool showProgressInfo = true)
+	{
+		weights.checkSize(labels);
+		weights.mustNotBe(labels);
+
+		if constexpr (!std::is_integral_v<weight_t>)
+			throw ITLException("Parallel region growing supports integer weights only.");
+		else
+			internals::growParallel(labels, weights, omp_get_max_threads(), showProgressInfo);
+	}
+
+
+	/**
+	Region grow segmentation.
+	The argument images must be of the same size.
+	@param labels Image containing the labels of distinct areas. At input, the image must contain the seed points as nonzero pixels and background as zero pixels; after the algorithm finishes, the image will contain the segmented regions corresponding to the seed points. Multiple seeds may have the same value.
+	@param weights Image containing the filling priority of each pixel. This image is not modified. If priority is zero or negative, the pixel is never filled.
+	@param method The algorithm to use. See GrowMethod.
+	*/
+	template<typename label_t, typename weight_t> void grow(Image<label_t>& labels, const Image<weight_t>& weights, GrowMethod method)
+	{
+		switch (method)
+		{
+		case GrowMethod::PriorityQueue: grow(labels, weights); break;
+		case GrowMethod::HierarchicalQueue: growHierarchical(labels, weights); break;
+		case GrowMethod::Parallel: growParallel(labels, weights); break;
+		default: throw ITLException("Invalid grow method.");
+		}
+	}
+
+	namespace tests
+	{
+		void hierarchicalQueue();
+		void growHierarchical();
+		void growParallel();
+		void growSpeed();
+	}
+}
@@ -21,6 +21,7 @@
 #include "stitching.h"
 #include "histogram.h"
 #include "floodfill.h"
+#include "watershed.h"
 #include "lineskeleton.h"
 #include "surfaceskeleton.h"
 #include "surfaceskeleton2.h"
@@ -28,7 +29,9 @@
 #include "structure.h"
 #include "particleanalysis.h"
 #include "regionremoval.h"
+#include "connectedcomponents.h"
 #include "fastbilateralfilter.h"
+#include "fastmedianfilter.h"
 #include "minhash.h"
 #include "tomo/fbp.h"
 #include "thickmap.h"
@@ -76,9 +79,11 @@ int main()
 	//test(io::tests::readWrite, "IO read");
 	//test(raw::tests::writeBlock, "Block based raw reader & writer");
 	//test(raw::tests::writeBlockFast, "Optimized block based raw reader & writer");
+	//test(itl2::tests::blockIO, "Parallel block reads and writes");
 	//test(vol::tests::volio, ".vol input/output");
 	//test(itl2::png::tests::png, "Png read and write");
 	//test(itl2::tiff::tests::readWrite, "Tiff read and write");
+	//test(itl2::tiff::tests::tiledBlocks, "Tiled and block-wise Tiff read and write");
 	////test(itl2::tiff::tests::imageJLargeTiff, "ImageJ large Tiff");
 	//test(itl2::nrrd::tests::readWrite, "NRRD read and write");
 	//test(itl2::pcr::tests::read, "PCR read");
@@ -101,9 +106,17 @@ int main()
 	//test(itl2::tests::projections, "projections");
 	//test(itl2::tests::fourierTransformPair, "Fourier transforms");
 	//test(itl2::tests::dctPair, "DCT");
+	//test(itl2::tests::fftPlanCache, "FFT plan cache");
+	//test(itl2::tests::fftRows, "batched FFT of rows");
 	//test(itl2::tests::bandpass, "Bandpass filtering");
 	//test(itl2::tests::projections2, "projections 2");
 	//test(itl2::tests::filters, "filtering");
+	//test(itl2::tests::boxFilters, "running sum mean, variance and standard deviation filters");
+	//test(itl2::tests::boxFiltersSpeed, "running sum filter speed");
+	//test(itl2::tests::recursiveGauss, "recursive Gaussian filter");
+	//test(itl2::tests::recursiveGaussDerivative, "recursive Gaussian derivative");
+	//test(itl2::tests::recursiveGaussSpeed, "recursive Gaussian filter speed");
+	//test(itl2::tests::slidingMedian, "sliding window median filter");
 
 	//test(itl2::tests::broadcast, "Broadcasted point process");
 	//test(itl2::tests::bilateral, "bilateral filter");
@@ -114,6 +127,8 @@ int main()
 	//test(itl2::tests::rotate, "rotations around general axes");
 	//test(itl2::tests::reslice, "reslice");
 	//test(itl2::tests::crop, "crop and reverse crop");
+	//test(itl2::tests::interpolation, "interpolation kernels");
+	//test(itl2::tests::interpolationSpeed, "interpolation speed");
 
 	//test(itl2::tests::pointProcess, "point processes");
 	//test(itl2::tests::pointProcessComplex, "point processes on complex numbers");
@@ -128,11 +143,14 @@ int main()
 	//test(itl2::tests::blockMatch1, "block match 1");
 	//test(itl2::tests::blockMatch2Match, "block match 2 (match)");
 	//test(itl2::tests::blockMatch2Pullback, "block match 2 (pullback)");
+	//test(itl2::tests::blockMatchWorkspace, "block match with re-used buffers");
+	//test(itl2::tests::stitchLattice, "Stitching using deformation lattice and source block");
 
 	//test(itl2::tests::inpaintNearest, "Inpainting");
 	//test(itl2::tests::inpaintGarcia, "Inpainting (Garcia)");
 	//test(itl2::tests::inpaintGarcia2, "Inpainting 2 (Garcia)");
 	//test(itl2::tests::dmap1, "Distance map");
+	//test(itl2::tests::dmapTiled, "Tiled distance map");
 
 	//test(itl2::tests::buffers, "Disk mapped buffer");
 	//test(itl2::tests::histogramIntermediateType, "Intermediate types in histogram");
@@ -156,6 +174,7 @@ int main()
 	//test(itl2::tests::surfaceSkeleton, "Surface skeleton");
 	//test(itl2::experimental::tests::surfaceSkeleton2, "Hybrid skeleton 2");
 	//test(itl2::tests::lineSkeleton, "Line skeleton");
+	//test(itl2::tests::borderThinning, "Thinning using border point lists");
 
 	//test(itl2::tests::traceSkeleton, "trace skeleton");
 	//test(itl2::tests::traceSkeletonRealData, "trace skeleton (real data)");
@@ -163,6 +182,7 @@ int main()
 	//test(itl2::tests::disconnections, "network connect, disconnect, degree, etc.");
 	//test(itl2::tests::disconnectStraightThroughPerformance, "network optimization performance");
 	//test(itl2::tests::pruning, "pruning");
+	//test(itl2::tests::vertexEdgeIndex, "network vertex to edge index");
 	//test(itl2::tests::lineLength, "line length calculation");
 	//test(itl2::tests::skeletonToPointsAndLines, "skeleton to point-line form");
 
@@ -177,6 +197,10 @@ int main()
 	//test(itl2::tests::analyzeParticlesVolumeLimit, "Analyze particles volume limit");
 	//test(itl2::tests::analyzeParticlesThreading, "Analyze particles threading");
 	//test(itl2::tests::analyzeParticlesThreadingBig, "Analyze particles threading, big volumes"); // This is a long test
+	//test(itl2::tests::analyzeParticlesAccumulation, "Analyze particles with accumulating analyzers");
+
+	//test(itl2::tests::connectedComponents, "Connected components");
+	//test(itl2::tests::connectedComponentsSpeed, "Connected components speed"); // This is a long test
 
 	//test(itl2::tests::regionRemoval, "Region removal");
 
@@ -194,6 +218,10 @@ int main()
 	//test(itl2::tests::growPriority, "Meyer's growing algorithm");
 	//test(itl2::tests::growAll, "region growing");
 	//test(itl2::tests::growComparison, "region growing algorithm comparison");
+	//test(itl2::tests::hierarchicalQueue, "hierarchical queue");
+	//test(itl2::tests::growHierarchical, "Meyer's growing algorithm using hierarchical queue");
+	//test(itl2::tests::growParallel, "parallel region growing");
+	//test(itl2::tests::growSpeed, "region growing speed"); // This is a long test
 
 
 	//test(itl2::tests::fillSkeleton, "skeleton filling");
@@ -218,6 +246,9 @@ int main()
 
 	//test(itl2::tests::autothreshold, "automatic thresholding");
 	//test(itl2::tests::localThreshold, "local thresholding");
+	//test(itl2::tests::localThresholdMethods, "local thresholding with mean and standard deviation based methods");
+	//test(itl2::tests::localThresholdHistogram, "local thresholding with sliding histogram");
+	//test(itl2::tests::localThresholdHistogramSpeed, "local thresholding with sliding histogram speed");
 	//test(itl2::tests::localMaxima, "local maxima search");
 
 	//test(itl2::tests::carpet, "surface finding");
@@ -235,6 +266,7 @@ int main()
 	
 
 	//test(itl2::tests::eval, "evaluation of string expressions");
+	//test(itl2::tests::evalBytecode, "bytecode evaluation of string expressions");
 
 	//test(itl2::tests::seededDMap, "seeded distance map");
 
@@ -256,6 +288,7 @@ int main()
 	//test(itl2::zarr::tests::zarrMetadataEquals, "zarr test zarrMetadataEquals");
 	//test(itl2::zarr::tests::separator, "zarr test separator");
 	//test(itl2::zarr::tests::sharding, "zarr test sharding");
+	//test(itl2::zarr::tests::shardingPartialAccess, "zarr test partial shard access");
 	//test(itl2::zarr::tests::emptyChunks, "zarr test emptyChunks");
 	test(itl2::zarr::tests::concurrency, "zarr test concurrency");
 
@@ -274,6 +307,8 @@ int main()
 	//test(itl2::tests::createPlates, "Input geometry generation");
 	//test(itl2::tests::createMoreProjections, "Large number of projections");
 	//test(itl2::tests::fbp, "Filtered backprojection");
+	//test(itl2::tests::cpuBackProjection, "CPU backprojection");
+	//test(itl2::tests::backprojectBlocks, "Preprocessing and backprojection in blocks");
 	
 	
 	//test(itl2::tests::openCLBackProjection, "OpenCL filtered backprojection");
@@ -511,7 +511,8 @@ namespace pilib
 				CommandArgument<double>(ParameterDirection::In, "argument 2", "Argument for the thresholding method. The purpose of this argument depends on the method, see the list above. Specify nan in order to use a method-specific default value.", std::numeric_limits<double>::quiet_NaN()),
 				CommandArgument<double>(ParameterDirection::In, "argument 3", "Argument for the thresholding method. The purpose of this argument depends on the method, see the list above. Specify nan in order to use a method-specific default value.", std::numeric_limits<double>::quiet_NaN()),
 				CommandArgument<double>(ParameterDirection::In, "argument 4", "Argument for the thresholding method. The purpose of this argument depends on the method, see the list above. Specify nan in order to use a method-specific default value.", std::numeric_limits<double>::quiet_NaN()),
-				CommandArgument<BoundaryCondition>(ParameterDirection::In, "boundary condition", string("Type of boundary condition. ") + boundaryConditionHelp(), BoundaryCondition::Nearest)
+				CommandArgument<BoundaryCondition>(ParameterDirection::In, "boundary condition", string("Type of boundary condition. ") + boundaryConditionHelp(), BoundaryCondition::Nearest),
+				CommandArgument<Vec3c>(ParameterDirection::In, "threshold spacing", "Histogram-based methods calculate the threshold value at points of a regular grid with this spacing, and interpolate it linearly between the grid points. Grid spacing larger than one makes thresholding with large neighbourhoods much faster, but the result is only an approximation. Set to [1, 1, 1] to calculate the threshold separately for each pixel. Methods that are not histogram-based ignore this argument. In distributed processing, the grid is placed separately in each block.", Vec3c(1, 1, 1))
 			},
 			"autothreshold, threshold")
 		{
@@ -527,10 +528,11 @@ namespace pilib
 			double arg2 = pop<double>(args);
 			double arg3 = pop<double>(args);
 			BoundaryCondition bc = pop<BoundaryCondition>(args);
+			Vec3c spacing = pop<Vec3c>(args);
 
 			AutoThresholdMethod method = fromString<AutoThresholdMethod>(methods);
 
-			localThreshold(in, out, r, method, arg0, arg1, arg2, arg3, bc);
+			localThreshold(in, out, r, method, arg0, arg1, arg2, arg3, bc, spacing);
 		}
 
 		virtual Vec3c calculateOverlap(const vector<ParamVariant>& args) const override
@@ -128,6 +128,19 @@ namespace pilib
 			return false;
 		}
 
+		/**
+		Gets a value indicating whether this command with the given arguments is a pixelwise operation.
+		Pixelwise commands calculate the value of each output pixel from the values of the same pixel
+		in the image arguments only, do not change the size of any image, and produce the same result
+		if they are run separately for views to different pixel ranges of the image arguments.
+		Such commands can be fused into a single pass over the images.
+		Returns false by default.
+		*/
+		virtual bool isPixelwise(const std::vector<ParamVariant>& args) const
+		{
+			return false;
+		}
+
 		/**
 		Run method that calls the pure run method or is overridden in special commands.
 		There are two run methods so that the most used one is as simple as possible
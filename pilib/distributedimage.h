@@ -263,6 +263,20 @@ namespace pilib
 		*/
 		std::string emitWriteBlock(const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const;
 
+		/**
+		Reads a block of this image into a new image in RAM.
+		This is the in-process counterpart of emitReadBlock.
+		@param dataNeeded Set to true if the image is used as input data. In that case the image data is read from disk, otherwise the block is left empty.
+		*/
+		virtual std::unique_ptr<ImageBase> readBlock(const Vec3c& filePos, const Vec3c& blockSize, bool dataNeeded) const = 0;
+
+		/**
+		Writes a block of the given image to the current write target of this image.
+		This is the in-process counterpart of emitWriteBlock.
+		@param block Image created using readBlock.
+		*/
+		virtual void writeBlock(ImageBase& block, const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const = 0;
+
 		/**
 		Start concurrent write process for given processes.
 		*/
@@ -568,6 +582,49 @@ namespace pilib
 		// TODO: setPixel could be added here along the same lines than getPixel functions above.
 
 
+		virtual std::unique_ptr<ImageBase> readBlock(const Vec3c& filePos, const Vec3c& blockSize, bool dataNeeded) const override
+		{
+			std::unique_ptr<Image<pixel_t> > block = std::make_unique<Image<pixel_t> >(blockSize);
+
+			if (isSavedToDisk() && dataNeeded)
+				itl2::io::readBlock(*block, currentReadSource(), filePos);
+
+			return block;
+		}
+
+		virtual void writeBlock(ImageBase& block, const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const override
+		{
+			Image<pixel_t>* pi = dynamic_cast<Image<pixel_t>*>(&block);
+			if (!pi)
+				throw ITLException("The data type of the block is not the same than the data type of the distributed image.");
+
+			switch (currentWriteTargetType())
+			{
+			case DistributedImageStorageType::NN5:
+			{
+				// TODO: NN5 compression default
+				itl2::nn5::writeBlock(*pi, currentWriteTarget(), getChunkSize(), itl2::nn5::NN5Compression::LZ4, filePos, dimensions(), imagePos, blockSize);
+				break;
+			}
+			case DistributedImageStorageType::Raw:
+			{
+				itl2::raw::writeBlock(*pi, currentWriteTarget(), filePos, dimensions(), imagePos, blockSize);
+				break;
+			}
+			case DistributedImageStorageType::Sequence:
+			{
+				itl2::sequence::writeBlock(*pi, currentWriteTarget(), filePos, dimensions(), imagePos, blockSize);
+				break;
+			}
+			case DistributedImageStorageType::Zarr:
+			{
+				throw ITLException("Writing blocks of Zarr datasets is not supported.");
+			}
+			default: throw ITLException("Invalid write target type.");
+			}
+		}
+
+
 		virtual void setData(const ImageBase* pImage) override
 		{
 			const Image<pixel_t>* pi = dynamic_cast<const Image<pixel_t>*>(pImage);
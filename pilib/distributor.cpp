@@ -159,6 +159,8 @@ namespace pilib
 		chunkSize(reader.get<Vec3c>("chunk_size", nn5::DEFAULT_CHUNK_SIZE));
 		maxSubmittedJobCount = reader.get<size_t>("max_parallel_submit_count", 0);
 		promoteThreshold = reader.get<size_t>("promote_threshold", 3);
+		blockIOThreads = reader.get<size_t>("block_io_threads", 0);
+		directIO = reader.get<bool>("direct_io", false);
 	}
 
 
@@ -1014,6 +1016,88 @@ namespace pilib
 		return newOutput;
 	}
 
+	/**
+	Maps distributed image pointer type to the type of the corresponding normal image.
+	*/
+	template<typename T> struct BlockImage
+	{
+	};
+
+	template<typename pixel_t> struct BlockImage<DistributedImage<pixel_t>*>
+	{
+		typedef Image<pixel_t> type;
+	};
+
+	/**
+	Converts argument containing a distributed image to an argument containing the given block of that image.
+	*/
+	ParamVariant toBlockArgument(const ParamVariant& arg, ImageBase* block)
+	{
+		ParamVariant result;
+		std::visit(
+			[&](auto& item)
+			{
+				using T = std::decay_t<decltype(item)>;
+				if constexpr (std::is_convertible_v<T, DistributedImageBase*>)
+				{
+					result = static_cast<typename BlockImage<T>::type*>(block);
+				}
+				else
+				{
+					throw ITLException("No distributed image found in variant.");
+				}
+			},
+			arg);
+		return result;
+	}
+
+	/**
+	Block job that is run in the current process instead of converting it to pi2 code.
+	Corresponds to one job script created in Distributor::runDelayedCommands.
+	*/
+	struct InProcessBlockJob
+	{
+		/**
+		Images to read: image, read start position, read size, and flag indicating whether the image data is needed.
+		*/
+		vector<tuple<DistributedImageBase*, Vec3c, Vec3c, bool> > reads;
+
+		/**
+		Commands to run and their arguments.
+		The arguments still refer to distributed images.
+		*/
+		vector<tuple<const Command*, vector<ParamVariant> > > commands;
+
+		/**
+		Images to write: image, position in file, position in block, and size of region to write.
+		*/
+		vector<tuple<DistributedImageBase*, Vec3c, Vec3c, Vec3c> > writes;
+
+		void run() const
+		{
+			map<DistributedImageBase*, unique_ptr<ImageBase> > blocks;
+			for (const auto& item : reads)
+				blocks[get<0>(item)] = get<0>(item)->readBlock(get<1>(item), get<2>(item), get<3>(item));
+
+			for (const auto& item : commands)
+			{
+				const Command* command = get<0>(item);
+				vector<ParamVariant> args = get<1>(item);
+				for (ParamVariant& arg : args)
+				{
+					DistributedImageBase* img = getDistributedImageNoThrow(arg);
+					if (img)
+						arg = toBlockArgument(arg, blocks.at(img).get());
+				}
+
+				command->run(args);
+			}
+
+			for (const auto& item : writes)
+				get<0>(item)->writeBlock(*blocks.at(get<0>(item)), get<1>(item), get<2>(item), get<3>(item));
+		}
+	};
+
 	void Distributor::runDelayedCommands()
 	{
 		if (delayedCommands.size() <= 0)
@@ -1086,6 +1170,8 @@ namespace pilib
 		cout << "Submitting " << jobCount << " jobs, each estimated to require at most " << bytesToString((double)memoryReq) << " of RAM per job..." << endl;
 		vector<size_t> skippedJobs;
 		vector<tuple<string, JobType>> jobsToSubmit;
+		vector<InProcessBlockJob> inProcessJobs;
+		bool inProcess = runsJobsInProcess();
 		for (size_t i = 0; i < jobCount; i++)
 		{
 			// Build job script:
@@ -1105,16 +1191,22 @@ namespace pilib
 			// print("Everything done")
 
 			stringstream script;
+			InProcessBlockJob inProcessJob;
 
 			// Init so that we always print something (required at least in the SLURM distributor)
 			script << "echo(true, false);" << endl;
 
+			// Block I/O settings
+			if (blockIOThreads > 0 || directIO)
+				script << "blockio(" << blockIOThreads << ", " << (directIO ? "true" : "false") << ");" << endl;
+
 			// Image read commands
 			for(DistributedImageBase* img : inputImages)
 			{
 				Vec3c readStart = get<0>(blocksPerImage[img][i]);
 				Vec3c readSize = get<1>(blocksPerImage[img][i]);
 				script << img->emitReadBlock(readStart, readSize, true);
+				inProcessJob.reads.push_back(make_tuple(img, readStart, readSize, true));
 			}
 
 			// Output image creation commands
@@ -1125,6 +1217,7 @@ namespace pilib
 					Vec3c readStart = get<0>(blocksPerImage[img][i]);
 					Vec3c readSize = get<1>(blocksPerImage[img][i]);
 					script << img->emitReadBlock(readStart, readSize, false);
+					inProcessJob.reads.push_back(make_tuple(img, readStart, readSize, false));
 				}
 			}
 
@@ -1146,6 +1239,7 @@ namespace pilib
 				{
 					hasCommandsToRun = true;
 					script << command->name() << "(";
+					vector<ParamVariant> jobArgs;
 					for (size_t n = 0; n < args.size(); n++)
 					{
 						// Value of argument whose type is Vec3c and name is "block origin" is replaced by the origin of current calculation block.
@@ -1160,12 +1254,26 @@ namespace pilib
 						{
 							argVal = (coord_t)i;
 						}
+						else if (argDef.dataType() == parameterType<INPUT_BLOCK_ORIGIN_ARG_TYPE>() && argDef.name() == INPUT_BLOCK_ORIGIN_ARG_NAME)
+						{
+							for (size_t m = 0; m < args.size(); m++)
+							{
+								DistributedImageBase* inputImage = getDistributedImageNoThrow(args[m]);
+								if (inputImage && command->args()[m].direction() == ParameterDirection::In)
+								{
+									argVal = get<0>(blocksPerImage[inputImage][i]);
+									break;
+								}
+							}
+						}
 
 						script << "\"" << argumentToString(argDef, argVal) << "\"";
 						if (n < args.size() - 1)
 							script << ", ";
+						jobArgs.push_back(argVal);
 					}
 					script << ");" << endl;
+					inProcessJob.commands.push_back(make_tuple(command, jobArgs));
 				}
 			}
 
@@ -1180,14 +1288,19 @@ namespace pilib
 					Vec3c writeSize = get<4>(blocksPerImage[img][i]);
 
 					// Only write if writing is requested by the command.
-					if(writeSize.min() > 0)
+					if (writeSize.min() > 0)
+					{
 						script << img->emitWriteBlock(writeFilePos, writeImPos, writeSize);
+						inProcessJob.writes.push_back(make_tuple(img, writeFilePos, writeImPos, writeSize));
+					}
 				}
 			}
 
 			if (hasCommandsToRun || !jobSkippingAllowed)
 			{
 				jobsToSubmit.push_back(make_tuple(script.str(), jobType));
+				if (inProcess)
+					inProcessJobs.push_back(inProcessJob);
 			}
 			else
 			{
@@ -1281,11 +1394,12 @@ namespace pilib
 
 		Timing::Add(TimeClass::WritePreparation, timer.lap());
 
-		// Combine small jobs
+		// Combine small jobs.
+		// Jobs run in the current process are not combined as they do not have any startup overhead.
 		const string jobStartLine = "------ start of job";
 		size_t combinationRounds = 0;
 		size_t originalJobCount = jobsToSubmit.size();
-		if (maxSubmittedJobCount > 0)
+		if (maxSubmittedJobCount > 0 && !inProcess)
 		{
 			if (jobsToSubmit.size() > maxSubmittedJobCount)
 			{
@@ -1317,10 +1431,11 @@ namespace pilib
 			cout << "Small jobs were combined into " << jobsToSubmit.size() << " larger jobs (" << std::fixed << std::setprecision(1) << tasksPerJob << " small jobs per combined job)." << endl;
 
 		// Submit jobs
-		for (auto& tup : jobsToSubmit)
+		submittedJobMemory = memoryReq;
+		for (size_t n = 0; n < jobsToSubmit.size(); n++)
 		{
-			string& script = get<0>(tup);
-			JobType type = get<1>(tup);
+			string& script = get<0>(jobsToSubmit[n]);
+			JobType type = get<1>(jobsToSubmit[n]);
 
 			if (showSubmittedScripts)
 			{
@@ -1332,8 +1447,17 @@ namespace pilib
 			if (tasksPerJob >= promoteThreshold)
 				type = promote(type);
 
-			submitJob(script, type);
+			if (inProcess)
+			{
+				InProcessBlockJob job = inProcessJobs[n];
+				submitInProcessJob([job]() { job.run(); }, type);
+			}
+			else
+			{
+				submitJob(script, type);
+			}
 		}
+		submittedJobMemory = 0;
 
 		// Run jobs first and set writeComplete() only after the jobs have finished to make sure that
 		// the output image exists before writeComplete() is called.
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <functional>
 
 namespace pilib
 {
@@ -50,6 +51,16 @@ namespace pilib
 		*/
 		bool allowDelaying = false;
 
+		/**
+		Count of threads used to read and write image blocks in the jobs, or zero to use the default count.
+		*/
+		size_t blockIOThreads = 0;
+
+		/**
+		Indicates if image blocks should be read with direct I/O in the jobs.
+		*/
+		bool directIO = false;
+
 		/**
 		Maximum number of jobs to submit at once.
 		Individual tasks are combined into larger jobs if there are more of them.
@@ -92,6 +103,12 @@ namespace pilib
 		*/
 		Vec3c distributedImageChunkSize;
 
+		/**
+		Estimated memory requirement of the jobs that are currently being submitted, in bytes.
+		Zero if the requirement is not known.
+		*/
+		size_t submittedJobMemory = 0;
+
 		/**
 		Determines suitable block size etc. for running commands in delayedCommands list.
 		Throws exception if the commands cannot be run together.
@@ -127,6 +144,25 @@ namespace pilib
 			return piCommand;
 		}
 
+		/**
+		Returns estimated memory requirement (in bytes) of the job that is being submitted, or zero if the requirement is not known.
+		Can be called from submitJob.
+		*/
+		size_t getSubmittedJobMemory() const
+		{
+			return submittedJobMemory;
+		}
+
+		/**
+		Gets a value indicating whether this distributor runs jobs in the current process.
+		If true, block jobs created in distribute(...) are submitted using submitInProcessJob instead of
+		converting them to pi2 code and submitting them using submitJob.
+		*/
+		virtual bool runsJobsInProcess() const
+		{
+			return false;
+		}
+
 		/**
 		Gets configuration directory.
 		*/
@@ -161,6 +197,14 @@ namespace pilib
 		typedef coord_t BLOCK_INDEX_ARG_TYPE;
 		inline static const std::string BLOCK_INDEX_ARG_NAME = "block index";
 
+		/**
+		Input block origin command parameter type and name.
+		The value is the position of the block of the first input image of the command, which might differ from the block origin
+		if getCorrespondingBlock of the command returns different blocks for the input and the reference image.
+		*/
+		typedef Vec3c INPUT_BLOCK_ORIGIN_ARG_TYPE;
+		inline static const std::string INPUT_BLOCK_ORIGIN_ARG_NAME = "input block origin";
+
 		/**
 		Enables or disables delaying.
 		*/
@@ -234,6 +278,16 @@ namespace pilib
 		*/
 		virtual void submitJob(const std::string& piCode, JobType jobType) = 0;
 
+		/**
+		Submits a job that runs the given function in the current process.
+		The output written to std::cout by the function is the output of the job.
+		Called only if runsJobsInProcess() returns true.
+		*/
+		virtual void submitInProcessJob(const std::function<void()>& job, JobType jobType)
+		{
+			throw ITLException("This distributor cannot run jobs in the current process.");
+		}
+
 		/**
 		Waits until all jobs have completed.
 		Throws exception if any of the jobs fails or job output does not end in line "Everything done.".
@@ -11,7 +11,7 @@ namespace pilib
 	class EvalBase : public Command, public Distributable
 	{
 	protected:
-		EvalBase(const std::vector<CommandArgumentBase>& imageArgs) : Command("eval", "Evaluates a mathematical expression on each pixel of one or more images. The expression is given as a string.",
+		EvalBase(const std::vector<CommandArgumentBase>& imageArgs) : Command("eval", "Evaluates a mathematical expression on each pixel of one or more images. The expression is given as a string. Expressions that consist of arithmetic, comparison and logical operators and common functions (e.g. abs, sqrt, exp, log, sin, cos, min, max, round, if, clamp) are evaluated for blocks of pixels at a time, which is considerably faster than the evaluation of other expressions.",
 			concat({
 				CommandArgument<string>(ParameterDirection::In, "expression", "The expression to evaluate on each pixel."),
 			}, imageArgs)
@@ -1,6 +1,7 @@
 
 #include "filtercommands.h"
 #include "commandmacros.h"
+#include "whereamicpp.h"
 
 namespace pilib
 {
@@ -9,6 +10,7 @@ namespace pilib
 		CommandList::add<BandpassFilterCommand>();
 		CommandList::add<FFTCommand>();
 		CommandList::add<InverseFFTCommand>();
+		CommandList::add<FFTPlanningCommand>();
 		ADD_REAL(MinFilterCommand);
 		ADD_REAL(MaxFilterCommand);
 		ADD_REAL(MedianFilterCommand);
@@ -58,4 +60,12 @@ namespace pilib
 		ADD_REAL(FrangiLineFilterCommand);
 		ADD_REAL2(MorphoRecCommand);
 	}
+
+	void FFTPlanningCommand::run(vector<ParamVariant>& args) const
+	{
+		bool measure = pop<bool>(args);
+
+		fs::path path = getModulePath();
+		setFFTWPlanning(measure, path.replace_filename("fftw_wisdom.txt").string());
+	}
 }
\ No newline at end of file
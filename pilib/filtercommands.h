@@ -2,6 +2,7 @@
 
 #include "commandsbase.h"
 #include "overlapdistributable.h"
+#include "trivialdistributable.h"
 #include "filters.h"
 #include "structure.h"
 #include "fastbilateralfilter.h"
@@ -572,7 +573,7 @@ namespace pilib
 
 	inline std::string gaussianOptimizationHelp()
 	{
-		return "If optimization flag is set to true, processes integer images with more than 8 bits of resolution with separable convolution and floating point images with FFT filtering. If optimization flag is set to false, processes all integer images with normal convolution and floating point images with separable convolution.";
+		return "If optimization flag is set to true, processes integer images with more than 8 bits of resolution with separable convolution and floating point images with FFT filtering. If optimization flag is set to false, processes all integer images with normal convolution and floating point images with separable convolution. If optimization flag is set to true, separable convolution is replaced by recursive filtering in those dimensions where the standard deviation is at least 4 pixels.";
 	}
 
 	template<typename pixel_t> class GaussianFilterCommand : public OverlapDistributable<TwoImageInputOutputCommand<pixel_t> >
@@ -920,7 +921,7 @@ namespace pilib
 
 	inline std::string fftSeeAlso()
 	{
-		return "fft, ifft, bandpassfilter, highpassfilter";
+		return "fft, ifft, bandpassfilter, highpassfilter, fftplanning";
 	}
 
 
@@ -984,4 +985,21 @@ namespace pilib
 			ifft(in, out);
 		}
 	};
+
+	class FFTPlanningCommand : virtual public Command, public TrivialDistributable
+	{
+	protected:
+		friend class CommandList;
+
+		FFTPlanningCommand() : Command("fftplanning", "Sets the planning mode of Fourier transforms. Fourier transform algorithms are selected when a transform of given size is calculated for the first time, and the selection is re-used in subsequent transforms of the same size. The algorithms can be selected using heuristics (default) or by measuring the fastest algorithm. Measurements are saved to file fftw_wisdom.txt in the folder where pi2 executable is, and re-used in subsequent sessions.",
+			{
+				CommandArgument<bool>(ParameterDirection::In, "measure", "Set to true to measure the fastest algorithm for each new transform size. This makes the first transform of each size slow but may make the subsequent transforms faster. Set to false to select the algorithm using heuristics.", true)
+			},
+			fftSeeAlso())
+		{
+		}
+
+	public:
+		virtual void run(vector<ParamVariant>& args) const override;
+	};
 }
@@ -0,0 +1,180 @@
+#include "fused.h"
+#include "pisystem.h"
+
+#include "command.h"
+
+#include <exception>
+
+using namespace std;
+
+namespace pilib
+{
+	namespace
+	{
+		/**
+		Makes view a linear view to pixels [start, start + count[ of the image in source variant,
+		and assigns the view to result variant.
+		The view image is created if it does not exist yet.
+		*/
+		void makeView(const ParamVariant& source, unique_ptr<ImageBase>& view, coord_t start, coord_t count, ParamVariant& result)
+		{
+			std::visit(
+				[&](auto& item)
+				{
+					using T = std::decay_t<decltype(item)>;
+					if constexpr (std::is_convertible_v<T, ImageBase*>)
+					{
+						using image_t = std::remove_pointer_t<T>;
+						if (!view)
+							view = make_unique<image_t>();
+						image_t* p = (image_t*)view.get();
+						p->initLinearView(*item, start, count);
+						result = p;
+					}
+				},
+				source);
+		}
+	}
+
+	bool FusedCommands::canAdd(const Command* command, vector<ParamVariant>& args) const
+	{
+		if (!command->isPixelwise(args))
+			return false;
+
+		// All the images must have the same size as the images already in the chain.
+		bool hasImages = !empty();
+		Vec3c refDims = dims;
+		for (size_t n = 0; n < args.size(); n++)
+		{
+			ImageBase* img = getImageNoThrow(args[n]);
+			if (img)
+			{
+				if (!hasImages)
+				{
+					refDims = img->dimensions();
+					hasImages = true;
+				}
+				else if (img->dimensions() != refDims)
+				{
+					return false;
+				}
+			}
+			else if (getDistributedImageNoThrow(args[n]))
+			{
+				return false;
+			}
+		}
+
+		return hasImages;
+	}
+
+	void FusedCommands::add(PISystem* system, const Command* command, vector<ParamVariant>& args)
+	{
+		if (!canAdd(command, args))
+			throw logic_error("Command cannot be added to the fused chain.");
+
+		Item item;
+		item.command = command;
+		item.args = args;
+
+		for (size_t n = 0; n < args.size(); n++)
+		{
+			ImageBase* img = getImageNoThrow(args[n]);
+			if (img)
+			{
+				size_t index = 0;
+				while (index < images.size() && getImage(images[index]) != img)
+					index++;
+
+				if (index >= images.size())
+				{
+					imagePointers.push_back(system->getImagePointer(img));
+					images.push_back(args[n]);
+				}
+
+				item.imageArgs.push_back(make_tuple(n, index));
+			}
+		}
+
+		if (items.empty())
+			dims = getImage(images[0])->dimensions();
+
+		items.push_back(item);
+	}
+
+	void FusedCommands::clear()
+	{
+		items.clear();
+		images.clear();
+		imagePointers.clear();
+	}
+
+	void FusedCommands::run()
+	{
+		if (empty())
+			return;
+
+		// Move the chain to local variables so that the chain is cleared even if the commands throw.
+		vector<Item> items;
+		vector<shared_ptr<ImageBase> > imagePointers;
+		vector<ParamVariant> images;
+		swap(items, this->items);
+		swap(imagePointers, this->imagePointers);
+		swap(images, this->images);
+
+		size_t bytesPerPixel = 0;
+		for (const auto& img : imagePointers)
+			bytesPerPixel += img->pixelSize();
+
+		coord_t pixelCount = dims.x * dims.y * dims.z;
+		coord_t tileSize = std::max<coord_t>(1024, (coord_t)(FUSION_TILE_BYTES / bytesPerPixel));
+		coord_t tileCount = (pixelCount + tileSize - 1) / tileSize;
+
+		bool failed = false;
+		exception_ptr error;
+		#pragma omp parallel if(!omp_in_parallel() && tileCount > 1)
+		{
+			// Views to the current tile, one for each image.
+			vector<unique_ptr<ImageBase> > views(images.size());
+			vector<ParamVariant> viewArgs(images.size());
+			vector<ParamVariant> args;
+
+			#pragma omp for schedule(dynamic)
+			for (coord_t n = 0; n < tileCount; n++)
+			{
+				if (failed)
+					continue;
+
+				try
+				{
+					coord_t start = n * tileSize;
+					coord_t count = std::min(tileSize, pixelCount - start);
+					for (size_t i = 0; i < images.size(); i++)
+						makeView(images[i], views[i], start, count, viewArgs[i]);
+
+					for (const Item& item : items)
+					{
+						args = item.args;
+						for (const auto& imageArg : item.imageArgs)
+							args[get<0>(imageArg)] = viewArgs[get<1>(imageArg)];
+						item.command->run(args);
+					}
+				}
+				catch (...)
+				{
+					// Exceptions must not propagate out of the parallel region.
+					// The first one is re-thrown after the region.
+					#pragma omp critical(fused_error)
+					{
+						if (!error)
+							error = current_exception();
+						failed = true;
+					}
+				}
+			}
+		}
+
+		if (failed)
+			rethrow_exception(error);
+	}
+}
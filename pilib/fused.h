@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <tuple>
+
+#include "argumentdatatype.h"
+
+namespace pilib
+{
+	class Command;
+	class PISystem;
+
+	/**
+	Approximate count of bytes of image data that is processed by all the commands of a fused chain
+	before proceeding to the next pixels. The data should fit in the cache of a single core.
+	*/
+	constexpr size_t FUSION_TILE_BYTES = 512 * 1024;
+
+	/**
+	Stores a chain of pixelwise commands (see Command::isPixelwise) for fused execution.
+	The chain is run in one pass over the images: the pixels are divided into tiles of about
+	FUSION_TILE_BYTES bytes, and all the commands are run for one tile before proceeding to the next one.
+	All images in the chain have the same dimensions.
+	Keeps shared_ptrs to all the image arguments.
+	*/
+	class FusedCommands
+	{
+	private:
+		/**
+		Command and its arguments.
+		*/
+		struct Item
+		{
+			const Command* command;
+			std::vector<ParamVariant> args;
+
+			/**
+			Pairs (argument index, index in images list) for each image argument.
+			*/
+			std::vector<std::tuple<size_t, size_t> > imageArgs;
+		};
+
+		std::vector<Item> items;
+
+		/**
+		Distinct images used in the chain, and ParamVariants containing them.
+		*/
+		std::vector<std::shared_ptr<ImageBase> > imagePointers;
+		std::vector<ParamVariant> images;
+
+		/**
+		Dimensions of all the images in the chain.
+		*/
+		Vec3c dims;
+
+	public:
+		/**
+		Tests if the given command can be added to the chain.
+		*/
+		bool canAdd(const Command* command, std::vector<ParamVariant>& args) const;
+
+		/**
+		Adds command to the end of the chain.
+		*/
+		void add(PISystem* system, const Command* command, std::vector<ParamVariant>& args);
+
+		/**
+		Gets a value indicating whether there are no commands in the chain.
+		*/
+		bool empty() const
+		{
+			return items.empty();
+		}
+
+		/**
+		Gets count of commands in the chain.
+		*/
+		size_t size() const
+		{
+			return items.size();
+		}
+
+		/**
+		Runs all the commands in the chain and clears the chain.
+		The chain is cleared also if the commands throw an exception.
+		*/
+		void run();
+
+		/**
+		Removes all commands from the chain without running them.
+		*/
+		void clear();
+	};
+}
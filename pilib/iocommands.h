@@ -224,7 +224,9 @@ namespace pilib
 		WriteTiffCommand() : Command("writetif", "Write an image to a .tif file.",
 			{
 				CommandArgument<Image<pixel_t> >(ParameterDirection::In, "input image", "Image to save."),
-				CommandArgument<std::string>(ParameterDirection::In, "filename", "Name (and path) of the file to write. If the file exists, its current contents are erased. Extension .tif is automatically appended to the name of the file.")
+				CommandArgument<std::string>(ParameterDirection::In, "filename", "Name (and path) of the file to write. If the file exists, its current contents are erased. Extension .tif is automatically appended to the name of the file."),
+				CommandArgument<coord_t>(ParameterDirection::In, "tile size", "Width and height of tiles in the output file. Must be a multiple of 16. Set to zero to store each slice as a single strip.", 0),
+				CommandArgument<bool>(ParameterDirection::In, "BigTIFF", "Set to true to write the file in BigTIFF format. BigTIFF format is used automatically if the image is too large for a normal .tif file.", false)
 			})
 		{
 		}
@@ -234,8 +236,10 @@ namespace pilib
 		{
 			Image<pixel_t>& in = *pop<Image<pixel_t>* >(args);
 			std::string fname = pop<std::string>(args);
+			coord_t tileSize = pop<coord_t>(args);
+			bool bigTiff = pop<bool>(args);
 
-			itl2::tiff::writed(in, fname);
+			itl2::tiff::writed(in, fname, Vec2c(tileSize, tileSize), bigTiff);
 		}
 	};
 
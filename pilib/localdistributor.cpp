@@ -5,6 +5,9 @@
 #include "exeutils.h"
 
 #include <algorithm>
+#include <random>
+#include <chrono>
+#include <omp.h>
 #include "filesystem.h"
 
 using namespace itl2;
@@ -12,12 +15,19 @@ using namespace std;
 
 namespace pilib
 {
-	LocalDistributor::LocalDistributor(PISystem* piSystem) : Distributor(piSystem), allowedMem(0)
+	LocalDistributor::LocalDistributor(PISystem* piSystem) : Distributor(piSystem), totalMem(0), maxParallelJobsSetting(0), maxParallelJobs(1), threadsPerJob(1), jobCounter(0)
 	{
+		// Create unique name for this distributor so that multiple pi2 instances can run in the same folder.
+		std::random_device dev;
+		std::mt19937 rng(dev());
+		std::uniform_int_distribution<std::mt19937::result_type> dist(0, 10000);
+		myName = itl2::toString(dist(rng));
+
 		fs::path configPath = getConfigDirectory() / "local_config.txt";
 
 		INIReader reader(configPath.string());
 		size_t mem = (size_t)(reader.get<double>("max_memory", 0) * 1024 * 1024);
+		maxParallelJobsSetting = reader.get<size_t>("max_parallel_jobs", 0);
 		readSettings(reader);
 
 		allowedMemory(mem);
@@ -25,36 +35,138 @@ namespace pilib
 
 	void LocalDistributor::allowedMemory(size_t maxMem)
 	{
-		allowedMem = maxMem;
+		totalMem = maxMem;
+
+		if (totalMem <= 0)
+			totalMem = (size_t)(0.85 * itl2::memorySize());
+
+		size_t coreCount = (size_t)omp_get_num_procs();
+
+		// Determine the number of concurrent jobs automatically: one job per core, but leave each job at least 2 GiB of RAM.
+		maxParallelJobs = maxParallelJobsSetting;
+		if (maxParallelJobs <= 0)
+		{
+			constexpr size_t MIN_JOB_MEMORY = (size_t)2 * 1024 * 1024 * 1024;
+			maxParallelJobs = std::max<size_t>(1, std::min(coreCount, totalMem / MIN_JOB_MEMORY));
+		}
+
+		threadsPerJob = std::max<size_t>(1, coreCount / maxParallelJobs);
 
-		if (allowedMem <= 0)
-			allowedMem = (size_t)(0.85 * itl2::memorySize());
+		cout << "Using " << bytesToString((double)totalMem) << " RAM for at most " << maxParallelJobs << " concurrent tasks (" << bytesToString((double)allowedMemory()) << " and " << threadsPerJob << " threads per task)." << endl;
+	}
 
-		cout << "Using " << bytesToString((double)allowedMem) << " RAM per task." << endl;
+	string LocalDistributor::makeJobFileName(size_t jobIndex) const
+	{
+		return "pi2_local_job_" + myName + "_" + itl2::toString(jobIndex) + ".txt";
 	}
 
 	void LocalDistributor::submitJob(const string& piCode, JobType jobType)
 	{
+		LocalJob job;
+		job.scriptFile = makeJobFileName(jobCounter);
+		jobCounter++;
+
+		// Jobs whose memory requirement is unknown are assumed to use all the memory allowed for a single job.
+		job.memory = getSubmittedJobMemory();
+		if (job.memory <= 0)
+			job.memory = allowedMemory();
+
+		job.progress = JOB_WAITING;
+
 		// Write the code to (temporary) file
 		{
-			ofstream f("pi2_local_job.txt");
+			ofstream f(job.scriptFile);
 			f << piCode << endl;
 			f << "print(Everything done.)" << endl;
 		}
 
-		string output = execute(getJobPiCommand(), "pi2_local_job.txt", true);
+		// The job is started in waitForJobs, when there is room for it.
+		jobs.push_back(std::move(job));
+	}
 
-		outputs.push_back(output);
+	void LocalDistributor::startJob(LocalJob& job) const
+	{
+		string cmd = getJobPiCommand();
+
+#if defined(__linux__) || defined(__APPLE__)
+		// Limit the number of threads so that the concurrent jobs do not oversubscribe the processor.
+		if (maxParallelJobs > 1)
+			cmd = "OMP_NUM_THREADS=" + itl2::toString(threadsPerJob) + " " + cmd;
+#endif
+
+		// Show output of the job directly only if jobs are run one at a time.
+		bool showOutput = maxParallelJobs <= 1;
+		string scriptFile = job.scriptFile;
+		job.result = std::async(std::launch::async, [cmd, scriptFile, showOutput]()
+			{
+				return execute(cmd, scriptFile, showOutput);
+			});
+		job.progress = 0;
 	}
 
 	vector<string> LocalDistributor::waitForJobs()
 	{
-		// Do not wait as the jobs have already finished (they are run sequentially on submit).
+		size_t barLength = 0;
+		size_t nextJob = 0;
+		size_t runningCount = 0;
+		size_t runningMem = 0;
+		size_t finishedCount = 0;
+		while (finishedCount < jobs.size())
+		{
+			// Start new jobs if there are free slots and enough memory.
+			// At least one job is always allowed to run.
+			while (nextJob < jobs.size() && runningCount < maxParallelJobs && (runningCount == 0 || runningMem + jobs[nextJob].memory <= totalMem))
+			{
+				startJob(jobs[nextJob]);
+				runningCount++;
+				runningMem += jobs[nextJob].memory;
+				nextJob++;
+			}
+
+			// Wait a while for running jobs and collect the finished ones.
+			bool waited = false;
+			for (LocalJob& job : jobs)
+			{
+				if (job.progress == 0)
+				{
+					if (job.result.wait_for(waited ? chrono::milliseconds(0) : chrono::milliseconds(100)) == future_status::ready)
+					{
+						try
+						{
+							job.output = job.result.get();
+						}
+						catch (const exception& e)
+						{
+							job.output = string("Error: ") + e.what();
+						}
+
+						std::error_code ec;
+						fs::remove(job.scriptFile, ec);
+
+						job.progress = 100;
+						runningCount--;
+						runningMem -= job.memory;
+						finishedCount++;
+					}
+					waited = true;
+				}
+			}
+
+			if (maxParallelJobs > 1)
+			{
+				vector<int> progress;
+				for (const LocalJob& job : jobs)
+					progress.push_back(job.progress);
+				showProgressBar(createProgressBar(progress), barLength);
+			}
+		}
+
+		showProgressBar("", barLength);
 
 		ostringstream msg;
-		for(size_t n = 0; n < outputs.size(); n++)
+		for(size_t n = 0; n < jobs.size(); n++)
 		{
-			string line = lastLine(outputs[n]);
+			string line = lastLine(jobs[n].output);
 
 			if (startsWith(line, "Error"))
 			{
@@ -66,12 +178,15 @@ namespace pilib
 			}
 		}
 
+		vector<string> result;
+		for (const LocalJob& job : jobs)
+			result.push_back(job.output);
+		jobs.clear();
+
 		string s = msg.str();
 		if (s.length() > 0)
 			throw ITLException(s.substr(0, s.length() - 1));
 
-		vector<string> result = outputs;
-		outputs.clear();
 		return result;
 	}
 
@@ -2,20 +2,93 @@
 
 #include "distributor.h"
 
+#include <future>
+
 namespace pilib
 {
 	/**
-	Runs tasks sequentially on the local computer.
+	Runs tasks on the local computer.
+	Multiple tasks are run concurrently in separate pi2 processes, such that the count of running processes
+	and the sum of their estimated memory requirements stay within the configured limits.
 	*/
 	class LocalDistributor : public Distributor
 	{
 	private:
-		size_t allowedMem;
+		/**
+		Amount of memory available for all concurrently running jobs.
+		*/
+		size_t totalMem;
+
+		/**
+		Maximum number of concurrent jobs read from the configuration file, or zero to determine the value automatically.
+		*/
+		size_t maxParallelJobsSetting;
+
+		/**
+		Maximum number of jobs that are run concurrently.
+		*/
+		size_t maxParallelJobs;
+
+		/**
+		Number of threads each job is allowed to use.
+		*/
+		size_t threadsPerJob;
+
+		/**
+		Unique name of this distributor, used to create unique job file names.
+		*/
+		std::string myName;
+
+		/**
+		Running number used to create unique job file names.
+		*/
+		size_t jobCounter;
+
+		/**
+		Information about a job that has been submitted since last call to waitForJobs.
+		*/
+		struct LocalJob
+		{
+			/**
+			Name of file containing the pi2 script of the job.
+			*/
+			std::string scriptFile;
+
+			/**
+			Estimated memory requirement of the job.
+			*/
+			size_t memory;
+
+			/**
+			Output of the job. Valid when the job has finished.
+			*/
+			std::string output;
+
+			/**
+			Progress of the job, JOB_WAITING, 0 (running) or 100 (finished).
+			*/
+			int progress;
+
+			/**
+			Future that becomes ready when the job process finishes.
+			*/
+			std::future<std::string> result;
+		};
+
+		/**
+		Jobs that have been submitted since last call to waitForJobs.
+		*/
+		std::vector<LocalJob> jobs;
+
+		/**
+		Creates name of script file for job with given running number.
+		*/
+		std::string makeJobFileName(size_t jobIndex) const;
 
 		/**
-		Stores output of each subprocess that has been run since last call to waitForJobs.
+		Starts job process in background.
 		*/
-		std::vector<std::string> outputs;
+		void startJob(LocalJob& job) const;
 
 	public:
 		LocalDistributor(PISystem* system);
@@ -26,7 +99,7 @@ namespace pilib
 
 		virtual size_t allowedMemory() const override
 		{
-			return allowedMem;
+			return totalMem / maxParallelJobs;
 		}
 
 		virtual void allowedMemory(size_t maxMem) override;
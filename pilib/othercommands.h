@@ -14,6 +14,7 @@
 #include "commandlist.h"
 #include "standardhelp.h"
 #include "montage.h"
+#include "watershed.h"
 #include "pilibutilities.h"
 #include "io/vectorio.h"
 
@@ -91,7 +92,9 @@ namespace pilib
 				}
 			}
 
-			blockMatch(ref, def, refPoints, defPoints, fitGoodness, compRadius);
+			BlockMatchTimings timings;
+			blockMatch(ref, def, refPoints, defPoints, fitGoodness, compRadius, &timings);
+			std::cout << timings << std::endl;
 
 			//filterDisplacements(refPoints, defPoints, fitGoodness);
 			writeBlockMatchResult(fname, refPoints, defPoints, fitGoodness, 0, 1, 0);
@@ -163,7 +166,9 @@ namespace pilib
 				}
 			}
 
-			blockMatchMulti(ref, def, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning);
+			BlockMatchTimings timings;
+			blockMatchMulti(ref, def, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, &timings);
+			std::cout << timings << std::endl;
 
 			// TODO: Instead of writing to disk, return the values in images.
 
@@ -276,21 +281,24 @@ namespace pilib
 				}
 			}
 
+			BlockMatchTimings timings;
 			if (refDT == ImageDataType::UInt8)
 			{
-				blockMatchPartialLoad<uint8_t, uint8_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef);
+				blockMatchPartialLoad<uint8_t, uint8_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef, &timings);
 			}
 			else if (refDT == ImageDataType::UInt16)
 			{
-				blockMatchPartialLoad<uint16_t, uint16_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef);
+				blockMatchPartialLoad<uint16_t, uint16_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef, &timings);
 			}
 			else if (refDT == ImageDataType::Float32)
 			{
-				blockMatchPartialLoad<float32_t, float32_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef);
+				blockMatchPartialLoad<float32_t, float32_t>(refFile, defFile, refPoints, defPoints, fitGoodness, coarseCompRadius, coarseBinning, fineCompRadius, fineBinning, normalize, normFact, normFactStd, meanDef, &timings);
 			}
 			else
 				throw ParseException("Unsupported image data type (Please add the data type to BlockMatchPartialLoadCommand in commands.h file).");
 
+			std::cout << timings << std::endl;
+
 			writeBlockMatchResult(fname, refPoints, defPoints, fitGoodness, normFact, normFactStd, meanDef);
 		}
 	};
@@ -1250,7 +1258,14 @@ namespace pilib
 
 		GrowPriorityCommand() : TwoImageInputParamCommand<label_t, weight_t>("grow",
 			"Grows regions from seed points outwards. Seeds points are all nonzero pixels in the input image, pixel value defining region label. Each seed is grown towards surrounding zero pixels. Fill priority for each pixel is read from the corresponding pixel in the parameter image. Pixels for which priority is zero or negative are never filled. This process is equal to Meyer's watershed algorithm for given set of seeds, and watershed cuts are borders between filled regions in the output image.",
-			{},
+			{
+				CommandArgument<string>(ParameterDirection::In, "method", "Algorithm to use. "
+					"**PriorityQueue** is the classic implementation of Meyer's algorithm, and it supports all priority data types. "
+					"**HierarchicalQueue** gives the same result but it is faster, and it supports only integer priorities whose range (maximum - minimum) is less than 16777216. "
+					"**Parallel** divides the image into blocks that are processed in separate threads. It supports only integer priorities, and it needs temporary storage of the size of two priority images and one 16-bit image. "
+					"Its result differs from the result of the other methods only at pixels where the filling order of Meyer's algorithm cannot be determined locally, and in that case the smallest of the candidate labels is assigned to the pixel.",
+					"PriorityQueue"),
+			},
 			"grow, growlabels, floodfill, regionremoval")
 		{
 		}
@@ -1258,7 +1273,8 @@ namespace pilib
 	public:
 		virtual void run(Image<label_t>& labels, Image<weight_t>& weights, std::vector<ParamVariant>& args) const override
 		{
-			grow(labels, weights);
+			GrowMethod method = fromString<GrowMethod>(pop<string>(args));
+			grow(labels, weights, method);
 		}
 	};
 
@@ -11,6 +11,24 @@ namespace pilib
 		ADD_REAL(PrepareAnalyzeParticlesCommand);
 		ADD_REAL(AnalyzeParticlesCommand);
 		ADD_REAL(LabelCommand);
+		CommandList::add<LabelComponentsCommand<uint8_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<uint16_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<uint32_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<uint64_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<int8_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<int16_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<int32_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<int64_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<float32_t, uint32_t> >();
+		CommandList::add<LabelComponentsCommand<uint8_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<uint16_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<uint32_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<uint64_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<int8_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<int16_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<int32_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<int64_t, uint64_t> >();
+		CommandList::add<LabelComponentsCommand<float32_t, uint64_t> >();
 		ADD_REAL(AnalyzeLabelsCommand);
 		CommandList::add<HeadersCommand>();
 		CommandList::add<Headers2Command>();
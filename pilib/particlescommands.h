@@ -56,6 +56,32 @@ namespace pilib
 	};
 
 
+	template<typename pixel_t, typename label_t> class LabelComponentsCommand : public TwoImageInputOutputCommand<pixel_t, label_t>
+	{
+	protected:
+		friend class CommandList;
+
+		LabelComponentsCommand() : TwoImageInputOutputCommand<pixel_t, label_t>("label", "Labels distinct regions in the input image with individual colors and places the labels to the output image. The regions are found using a parallel connected component labeling algorithm. Labels are assigned in the order of the first pixel of each region in the image, starting from one. Background pixels are set to zero. The output image is resized to the size of the input image. Execution is terminated in an error if the pixel data type of the output image does not support large enough values to label all the particles.",
+			{
+				CommandArgument<double>(ParameterDirection::In, "region color", "Current color of regions that should be labeled. Set to zero to label all non-zero regions.", 0),
+				CommandArgument<Connectivity>(ParameterDirection::In, "connectivity", string("Connectivity of the particles. ") + connectivityHelp(), Connectivity::NearestNeighbours),
+			},
+			particleSeeAlso())
+		{
+		}
+
+	public:
+		virtual void run(Image<pixel_t>& in, Image<label_t>& out, std::vector<ParamVariant>& args) const override
+		{
+			pixel_t color = pixelRound<pixel_t>(pop<double>(args));
+			Connectivity connectivity = pop<Connectivity>(args);
+
+			size_t count = connectedComponents(in, out, connectivity, color);
+			std::cout << "Found " << count << " regions." << std::endl;
+		}
+	};
+
+
 
 	class ListAnalyzersCommand : public TrivialDistributable
 	{
@@ -214,9 +240,9 @@ namespace pilib
 		//	}
 		//}
 
-		static void writeList(const string& filename, const vector<vector<Vec3sc> >& v)
+		template<typename item_t> static void writeList(const string& filename, const vector<vector<item_t> >& v)
 		{
-			itl2::writeListFile(filename, v, [=](std::ofstream& out, const std::vector<Vec3sc>& v) { itl2::writeList<Vec3sc>(out, v); });
+			itl2::writeListFile(filename, v, [=](std::ofstream& out, const std::vector<item_t>& v) { itl2::writeList<item_t>(out, v); });
 		}
 		
 	protected:
@@ -262,18 +288,20 @@ namespace pilib
 
 			Results results;
 			vector<vector<Vec3sc> > incompleteParticles;
+			vector<vector<double> > incompleteStates;
 			vector<vector<Vec3sc> > largeEdgePoints;
 			vector<coord_t> edgeZ;
 
 			results.headers() = analyzers.headers();
 
-			itl2::internals::analyzeParticlesBlocks(img, analyzers, results, largeEdgePoints, incompleteParticles, connectivity, volumeLimit, fillColor, largeColor, Vec3sc(origin), edgeZ);
+			itl2::internals::analyzeParticlesBlocks(img, analyzers, results, largeEdgePoints, incompleteParticles, incompleteStates, connectivity, volumeLimit, fillColor, largeColor, Vec3sc(origin), edgeZ);
 
 			// Write outputs to the output file
 			filename += "_" + itl2::toString(index);
 
 			writeText(filename + "_results.txt", results.str());
 			writeList(filename + "_incomplete_particles.dat", incompleteParticles);
+			writeList(filename + "_incomplete_states.dat", incompleteStates);
 			writeList(filename + "_large_edge_points.dat", largeEdgePoints);
 			itl2::writeListFile(filename + "_edge_z.dat", edgeZ);
 		}
@@ -391,9 +419,9 @@ namespace pilib
 		//	}
 		//}
 
-		static void readList(const string& filename, vector<vector<Vec3sc> >& v)
+		template<typename item_t> static void readList(const string& filename, vector<vector<item_t> >& v)
 		{
-			itl2::readListFile(filename, v, [=](std::ifstream& in, std::vector<Vec3sc>& v) { itl2::readList<Vec3sc>(in, v); });
+			itl2::readListFile(filename, v, [=](std::ifstream& in, std::vector<item_t>& v) { itl2::readList<item_t>(in, v); });
 		}
 
 	protected:
@@ -470,12 +498,14 @@ namespace pilib
 
 			// Load data files and combine results (local processing, loads files one at a time)
 			vector<vector<Vec3sc> > incompleteParticles;
+			vector<vector<double> > incompleteStates;
 			vector<vector<Vec3sc> > largeEdgePoints;
 			vector<coord_t> edgeZ;
 			for (size_t n = 0; n < output.size(); n++)
 			{
 				string resultsName = tempFilename + "_" + itl2::toString(n) + "_results.txt";
 				string incompleteName = tempFilename + "_" + itl2::toString(n) + "_incomplete_particles.dat";
+				string statesName = tempFilename + "_" + itl2::toString(n) + "_incomplete_states.dat";
 				string largeName = tempFilename + "_" + itl2::toString(n) + "_large_edge_points.dat";
 				string edgezName = tempFilename + "_" + itl2::toString(n) + "_edge_z.dat";
 
@@ -483,10 +513,11 @@ namespace pilib
 
 				results.readText(resultsName);
 				readList(incompleteName, incompleteParticles);
+				readList(statesName, incompleteStates);
 				readList(largeName, largeEdgePoints);
 				itl2::readListFile(edgezName, edgeZ);
 
-				itl2::internals::combineParticleAnalysisResults(analyzers, results, largeEdgePoints, incompleteParticles, volumeLimit, connectivity, edgeZ, n < output.size() - 1);
+				itl2::internals::combineParticleAnalysisResults(analyzers, results, largeEdgePoints, incompleteParticles, incompleteStates, volumeLimit, connectivity, edgeZ, n < output.size() - 1);
 			}
 
 			// Load data files and combine results (local processing, loads all data files at once -> memory problem for large images)
@@ -515,11 +546,13 @@ namespace pilib
 			{
 				string resultsName = tempFilename + "_" + itl2::toString(n) + "_results.txt";
 				string incompleteName = tempFilename + "_" + itl2::toString(n) + "_incomplete_particles.dat";
+				string statesName = tempFilename + "_" + itl2::toString(n) + "_incomplete_states.dat";
 				string largeName = tempFilename + "_" + itl2::toString(n) + "_large_edge_points.dat";
 				string edgezName = tempFilename + "_" + itl2::toString(n) + "_edge_z.dat";
 				
 				fs::remove(resultsName);
 				fs::remove(incompleteName);
+				fs::remove(statesName);
 				fs::remove(largeName);
 				fs::remove(edgezName);
 			}
@@ -7,6 +7,7 @@
 #include "slurmdistributor.h"
 #include "localdistributor.h"
 #include "lsfdistributor.h"
+#include "threaddistributor.h"
 
 using namespace std;
 
@@ -811,6 +812,22 @@ namespace pilib
 			convertedArgs.push_back(res);
 		}
 
+		if (!isDistributed())
+		{
+			// Collect consecutive pixelwise commands into a chain that is run in a single pass.
+			if (fusingEnabled && fused.canAdd(cmd, convertedArgs))
+			{
+				fused.add(this, cmd, convertedArgs);
+
+				imageStore.clear();
+				stringStore.clear();
+				distributedImageStore.clear();
+				return;
+			}
+
+			flushFused();
+		}
+
 		// Run command with timing
 		Timer timer;
 		timer.start();
@@ -920,6 +937,23 @@ namespace pilib
 
 	PISystem::~PISystem()
 	{
+		try
+		{
+			flushFused();
+		}
+		catch (ITLException& e)
+		{
+			cout << e.message() << endl;
+		}
+		catch (exception& e)
+		{
+			cout << e.what() << endl;
+		}
+		catch (...)
+		{
+			// Exceptions must not propagate out of the destructor.
+			cout << "Unknown error while running pending commands." << endl;
+		}
 	}
 
 	/**
@@ -966,6 +1000,8 @@ namespace pilib
 	*/
 	ImageBase* PISystem::getImage(const string& name)
 	{
+		flushFused();
+
 		if (isDistributed())
 		{
 			// Convert the distributed image to normal image and return that.
@@ -1184,6 +1220,8 @@ namespace pilib
 	*/
 	void PISystem::distributedProcessing(string provider)
 	{
+		flushFused();
+
 		if (distributor)
 		{
 			distributor->flush();
@@ -1211,8 +1249,34 @@ namespace pilib
 				cout << "Enabling distributed computing mode using LSF workload manager." << endl;
 				distributor = new LSFDistributor(this);
 			}
+			else if (provider == "threads")
+			{
+				cout << "Enabling distributed computing mode using threads of the current process." << endl;
+				distributor = new ThreadDistributor(this);
+			}
 			else
-				throw ITLException(string("Invalid distributed computing system name: ") + provider + ". Valid names are SLURM or Local.");
+				throw ITLException(string("Invalid distributed computing system name: ") + provider + ". Valid names are SLURM, LSF, Local, or Threads.");
+		}
+	}
+
+	void PISystem::fusing(bool enable)
+	{
+		if (!enable)
+			flushFused();
+		fusingEnabled = enable;
+	}
+
+	void PISystem::flushFused()
+	{
+		if (!fused.empty())
+		{
+			Timer timer;
+			timer.start();
+			fused.run();
+			timer.stop();
+
+			if (showTiming)
+				cout << "Fused pixelwise commands took " << setprecision(3) << timer.getSeconds() << " s" << endl;
 		}
 	}
 
@@ -1272,6 +1336,23 @@ namespace pilib
 	}
 
 
+	shared_ptr<ImageBase> PISystem::getImagePointer(ImageBase* img) const
+	{
+		for (auto& item : images)
+		{
+			if (item.second.get() == img)
+				return item.second;
+		}
+
+		for (auto& item : imageStore)
+		{
+			if (item.get() == img)
+				return item;
+		}
+
+		throw ITLException("Unknown image pointer.");
+	}
+
 	shared_ptr<DistributedImageBase> PISystem::getDistributedImagePointer(DistributedImageBase* img) const
 	{
 		for (auto& item : distributedImgs)
@@ -14,6 +14,7 @@
 #include "distributor.h"
 #include "distributable.h"
 #include "distributedimage.h"
+#include "fused.h"
 #include "stringutils.h"
 #include "commandlist.h"
 
@@ -89,6 +90,16 @@ namespace pilib
 		*/
 		bool running = false;
 
+		/**
+		Set to true to fuse consecutive pixelwise commands in local processing mode.
+		*/
+		bool fusingEnabled = false;
+
+		/**
+		Pixelwise commands that are waiting for fused execution.
+		*/
+		FusedCommands fused;
+
 		/**
 		Parse line expected to contain function call
 		funcname(param1, param2, param3, ...)
@@ -218,6 +229,12 @@ namespace pilib
 		*/
 		ImageBase* getImage(const std::string& name);
 
+		/**
+		Gets smart pointer to given image. Used to store images during fused execution even if they are
+		removed from the PISystem.
+		*/
+		std::shared_ptr<ImageBase> getImagePointer(ImageBase* img) const;
+
 		/**
 		Gets smart pointer to given image. Used to store images during delayed distribution even if they are
 		removed from the PISystem.
@@ -324,6 +341,20 @@ namespace pilib
 		*/
 		void distributedProcessing(std::string provider);
 
+		/**
+		Enables or disables fusing of consecutive pixelwise commands in local processing mode.
+		If fusing is enabled, pixelwise commands are not run immediately but they are collected to a chain that is
+		run in a single pass over the image data before the next non-pixelwise command, before an image is retrieved using getImage,
+		or when flushFused is called.
+		Disabling fusing runs the commands that are waiting.
+		*/
+		void fusing(bool enable);
+
+		/**
+		Runs all pixelwise commands that are waiting for fused execution.
+		*/
+		void flushFused();
+
 		/**
 		Parses commands in the given string and runs them.
 		*/
@@ -66,6 +66,11 @@ namespace pilib
 		{
 			return true;
 		}
+
+		virtual bool isPixelwise(const std::vector<ParamVariant>& args) const override
+		{
+			return true;
+		}
 	};
 
 	/**
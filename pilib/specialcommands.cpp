@@ -7,6 +7,7 @@
 #include <omp.h>
 #include "io/vol.h"
 #include "io/io.h"
+#include "io/blockio.h"
 #include "pilibutilities.h"
 #include "whereamicpp.h"
 #include "commandmacros.h"
@@ -23,7 +24,9 @@ namespace pilib
 		CommandList::add<MaxMemoryCommand>();
 		CommandList::add<MaxJobsCommand>();
 		CommandList::add<ChunkSizeCommand>();
+		CommandList::add<BlockIOCommand>();
 		CommandList::add<DelayingCommand>();
+		CommandList::add<FusingCommand>();
 		CommandList::add<PrintTaskScriptsCommand>();
 		CommandList::add<EchoCommandsCommand>();
 		CommandList::add<HelloCommand>();
@@ -1492,6 +1495,12 @@ the FAQ for more information on the distribution of modified source versions.)EN
 			system->getDistributor()->delaying(enable);
 	}
 
+	void FusingCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
+	{
+		bool enable = pop<bool>(args);
+		system->fusing(enable);
+	}
+
 	void PrintTaskScriptsCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
 	{
 		bool enable = pop<bool>(args);
@@ -1520,6 +1529,14 @@ the FAQ for more information on the distribution of modified source versions.)EN
 			system->getDistributor()->chunkSize(chunkSize);
 	}
 
+	void BlockIOCommand::run(vector<ParamVariant>& args) const
+	{
+		size_t threads = pop<size_t>(args);
+		bool direct = pop<bool>(args);
+		blockIOSettings().threads = threads;
+		blockIOSettings().directRead = direct;
+	}
+
 	void DistributeCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
 	{
 		string provider = pop<string>(args);
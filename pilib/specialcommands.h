@@ -769,7 +769,7 @@ namespace pilib
 
 	inline std::string distributeSeeAlso()
 	{
-		return "distribute, delaying, maxmemory, maxjobs, chunksize, printscripts";
+		return "distribute, delaying, maxmemory, maxjobs, chunksize, blockio, printscripts";
 	}
 
 	class DistributeCommand : virtual public Command, public TrivialDistributable
@@ -779,7 +779,7 @@ namespace pilib
 
 		DistributeCommand() : Command("distribute", "Enables or disables distributed processing of commands. Run this command before commands that you would like to run using distributed processing. Images used during distributed processing are not available for local processing and vice versa, unless they are loaded again from disk. All commands do not support distributed processing.",
 			{
-				CommandArgument<string>(ParameterDirection::In, "workload manager system name", "Set to 'SLURM' to use SLURM workload manager; set to 'LOCAL' to process tasks sequentially using the local computer; set to empty string to disable distributed processing (default).", "")
+				CommandArgument<string>(ParameterDirection::In, "workload manager system name", "Set to 'SLURM' to use SLURM workload manager; set to 'LSF' to use LSF workload manager; set to 'LOCAL' to process tasks in separate pi2 processes on the local computer; set to 'THREADS' to process tasks in threads of the current process, without starting new pi2 processes; set to empty string to disable distributed processing (default).", "")
 			},
 			distributeSeeAlso())
 		{
@@ -860,6 +860,25 @@ namespace pilib
 	};
 
 
+	class BlockIOCommand : virtual public Command, public TrivialDistributable
+	{
+	protected:
+		friend class CommandList;
+
+		BlockIOCommand() : Command("blockio", "Sets parameters used when blocks of .raw files are read or written, e.g. in distributed processing. In distributed processing, this command is added automatically to the beginning of each job, if block_io_threads or direct_io are set in the configuration file.",
+			{
+				CommandArgument<size_t>(ParameterDirection::In, "threads", "Count of threads used to read or write a single block. Specify zero to use the default count of threads.", 0),
+				CommandArgument<bool>(ParameterDirection::In, "direct io", "Set to true to read data with direct I/O, bypassing the file system cache of the operating system. This may be beneficial when large files are read only once. Direct I/O is available in Linux only, and it is not supported by all file systems. If direct I/O is not available, normal I/O is used.", false)
+			},
+			distributeSeeAlso())
+		{
+		}
+
+	public:
+		virtual void run(vector<ParamVariant>& args) const override;
+	};
+
+
 	class DelayingCommand : virtual public Command, public TrivialDistributable
 	{
 	protected:
@@ -881,6 +900,27 @@ namespace pilib
 		}
 	};
 
+	class FusingCommand : virtual public Command, public TrivialDistributable
+	{
+	protected:
+		friend class CommandList;
+
+		FusingCommand() : Command("fusing", "Enables or disables fusing of consecutive pixelwise commands (e.g. add, multiply, threshold, linmap) in local processing mode (kind of lazy evaluation). When fusing is enabled, pixelwise commands that process images of the same size are not run immediately. Instead, they are collected to a chain that is run in a single pass over the image data when the next command that is not pixelwise is run, or when the image data is retrieved, e.g. from Python. The chain processes the images in small blocks that fit in the processor cache, so fusing decreases memory bandwidth used by long sequences of pixelwise commands. When fusing is enabled, command run times (see echo command) are not accurate, and errors in pixelwise commands are reported when the chain is run. Disabling fusing runs the pending commands. Fusing is disabled by default.",
+			{
+				CommandArgument<bool>(ParameterDirection::In, "enable", "Set to true to enable fusing.", true)
+			},
+			"fusing, delaying")
+		{
+		}
+
+	public:
+		virtual void runInternal(PISystem* system, vector<ParamVariant>& args) const override;
+
+		virtual void run(vector<ParamVariant>& args) const override
+		{
+		}
+	};
+
 	class PrintTaskScriptsCommand : virtual public Command, public TrivialDistributable
 	{
 	protected:
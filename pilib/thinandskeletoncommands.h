@@ -544,6 +544,7 @@ namespace pilib
 			{
 				string fname = tempFilename + "_" + itl2::toString(n) + ".dat";
 				fs::remove(fname);
+				fs::remove(Network::indexFilename(fname));
 			}
 
 			return vector<string>();
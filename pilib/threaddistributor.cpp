@@ -0,0 +1,205 @@
+
+#include "threaddistributor.h"
+
+#include "pisystem.h"
+#include "stringutils.h"
+
+#include <algorithm>
+#include <streambuf>
+#include <omp.h>
+#include "filesystem.h"
+
+using namespace itl2;
+using namespace std;
+
+namespace pilib
+{
+	namespace
+	{
+		/**
+		Output of the job that is being run by the current thread, or nullptr if the output of the current thread is not captured.
+		*/
+		thread_local string* capturedJobOutput = nullptr;
+
+		/**
+		Stream buffer that appends output of threads that are running a job to the output of the job,
+		and passes output of other threads to the original stream buffer.
+		*/
+		class JobOutputBuffer : public streambuf
+		{
+		private:
+			streambuf* original;
+
+		protected:
+			virtual int_type overflow(int_type c) override
+			{
+				if (traits_type::eq_int_type(c, traits_type::eof()))
+					return traits_type::not_eof(c);
+
+				if (capturedJobOutput)
+				{
+					capturedJobOutput->push_back(traits_type::to_char_type(c));
+					return c;
+				}
+
+				return original->sputc(traits_type::to_char_type(c));
+			}
+
+			virtual streamsize xsputn(const char* s, streamsize n) override
+			{
+				if (capturedJobOutput)
+				{
+					capturedJobOutput->append(s, (size_t)n);
+					return n;
+				}
+
+				return original->sputn(s, n);
+			}
+
+			virtual int sync() override
+			{
+				if (capturedJobOutput)
+					return 0;
+
+				return original->pubsync();
+			}
+
+		public:
+			JobOutputBuffer(ostream& stream) : original(stream.rdbuf())
+			{
+			}
+
+			streambuf* originalBuffer() const
+			{
+				return original;
+			}
+		};
+	}
+
+	ThreadDistributor::ThreadDistributor(PISystem* piSystem) : Distributor(piSystem), totalMem(0), maxParallelJobsSetting(0), maxParallelJobs(1)
+	{
+		fs::path configPath = getConfigDirectory() / "threads_config.txt";
+
+		INIReader reader(configPath.string());
+		size_t mem = (size_t)(reader.get<double>("max_memory", 0) * 1024 * 1024);
+		maxParallelJobsSetting = reader.get<size_t>("max_parallel_jobs", 0);
+		readSettings(reader);
+
+		allowedMemory(mem);
+	}
+
+	void ThreadDistributor::allowedMemory(size_t maxMem)
+	{
+		totalMem = maxMem;
+
+		if (totalMem <= 0)
+			totalMem = (size_t)(0.85 * itl2::memorySize());
+
+		// Determine the number of concurrent jobs automatically: one job per core, but leave each job at least 2 GiB of RAM.
+		maxParallelJobs = maxParallelJobsSetting;
+		if (maxParallelJobs <= 0)
+		{
+			constexpr size_t MIN_JOB_MEMORY = (size_t)2 * 1024 * 1024 * 1024;
+			maxParallelJobs = std::max<size_t>(1, std::min((size_t)omp_get_num_procs(), totalMem / MIN_JOB_MEMORY));
+		}
+
+		cout << "Using " << bytesToString((double)totalMem) << " RAM for at most " << maxParallelJobs << " concurrent tasks (" << bytesToString((double)allowedMemory()) << " per task)." << endl;
+	}
+
+	void ThreadDistributor::submitJob(const string& piCode, JobType jobType)
+	{
+		// Jobs given as pi2 code are run in a PISystem of their own, just like in a separate pi2 process.
+		jobs.push_back([piCode]()
+			{
+				PISystem system;
+				system.run("echo(true, false)");
+				if (!system.run(piCode))
+					throw ITLException(system.getLastErrorMessage());
+			});
+	}
+
+	void ThreadDistributor::submitInProcessJob(const function<void()>& job, JobType jobType)
+	{
+		jobs.push_back(job);
+	}
+
+	vector<string> ThreadDistributor::waitForJobs()
+	{
+		vector<string> result(jobs.size());
+		vector<int> progress(jobs.size(), JOB_WAITING);
+		size_t barLength = 0;
+
+		// If there is only one job or one thread, run the jobs in this thread so that the commands may use all the processor cores.
+		// Otherwise, each job runs in a single thread.
+		int threadCount = (int)std::min(maxParallelJobs, jobs.size());
+
+		// Redirect output of each job to its own output string.
+		JobOutputBuffer buffer(cout);
+		cout.rdbuf(&buffer);
+
+		#pragma omp parallel for schedule(dynamic) num_threads(std::max(threadCount, 1)) if(threadCount > 1)
+		for (coord_t n = 0; n < (coord_t)jobs.size(); n++)
+		{
+			#pragma omp critical(thread_distributor_progress)
+			{
+				progress[n] = 0;
+			}
+
+			string& output = result[n];
+			capturedJobOutput = &output;
+			try
+			{
+				jobs[n]();
+				output += "\nEverything done.\n";
+			}
+			catch (const ITLException& e)
+			{
+				output += string("\nError: ") + e.message() + "\n";
+			}
+			catch (const exception& e)
+			{
+				output += string("\nError: ") + e.what() + "\n";
+			}
+			catch (...)
+			{
+				output += "\nError: Unknown error.\n";
+			}
+			capturedJobOutput = nullptr;
+
+			#pragma omp critical(thread_distributor_progress)
+			{
+				progress[n] = 100;
+				if (threadCount > 1)
+					showProgressBar(createProgressBar(progress), barLength);
+			}
+		}
+
+		cout.rdbuf(buffer.originalBuffer());
+
+		showProgressBar("", barLength);
+
+		ostringstream msg;
+		for (size_t n = 0; n < result.size(); n++)
+		{
+			string line = lastLine(result[n]);
+
+			if (startsWith(line, "Error"))
+			{
+				msg << "Job " << n << " failed with message '" << line << "'" << endl;
+			}
+			else if (line != "Everything done.")
+			{
+				msg << "Job " << n << " failed without error message." << endl;
+			}
+		}
+
+		jobs.clear();
+
+		string s = msg.str();
+		if (s.length() > 0)
+			throw ITLException(s.substr(0, s.length() - 1));
+
+		return result;
+	}
+
+}
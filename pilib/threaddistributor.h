@@ -0,0 +1,60 @@
+#pragma once
+
+#include "distributor.h"
+
+#include <functional>
+
+namespace pilib
+{
+	/**
+	Runs tasks on the local computer, in the current process.
+	Block jobs are executed by passing the command arguments directly to the commands, without converting
+	them to pi2 code and starting new pi2 processes.
+	Multiple jobs are run concurrently in separate threads.
+	*/
+	class ThreadDistributor : public Distributor
+	{
+	private:
+		/**
+		Amount of memory available for all concurrently running jobs.
+		*/
+		size_t totalMem;
+
+		/**
+		Maximum number of concurrent jobs read from the configuration file, or zero to determine the value automatically.
+		*/
+		size_t maxParallelJobsSetting;
+
+		/**
+		Maximum number of jobs that are run concurrently.
+		*/
+		size_t maxParallelJobs;
+
+		/**
+		Jobs that have been submitted since last call to waitForJobs.
+		*/
+		std::vector<std::function<void()> > jobs;
+
+	protected:
+		virtual bool runsJobsInProcess() const override
+		{
+			return true;
+		}
+
+	public:
+		ThreadDistributor(PISystem* system);
+
+		virtual void submitJob(const std::string& piCode, JobType jobType) override;
+
+		virtual void submitInProcessJob(const std::function<void()>& job, JobType jobType) override;
+
+		virtual std::vector<std::string> waitForJobs() override;
+
+		virtual size_t allowedMemory() const override
+		{
+			return totalMem / maxParallelJobs;
+		}
+
+		virtual void allowedMemory(size_t maxMem) override;
+	};
+}
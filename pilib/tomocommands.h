@@ -1,19 +1,37 @@
 #pragma once
 
 #include "commandsbase.h"
+#include "distributable.h"
 #include "tomo/fbp.h"
 
 namespace pilib
 {
+	namespace internals
+	{
+		/**
+		Reads reconstruction settings from file or string as described in the help of the reconstruction commands.
+		*/
+		inline RecSettings readRecSettings(std::string settings)
+		{
+			if (fs::exists(settings))
+			{
+				settings = readText(settings, true);
+			}
+
+			return fromString<RecSettings>(settings);
+		}
+	}
 
-	class FBPPreprocessCommand : public TwoImageInputOutputCommand<float32_t>
+	class FBPPreprocessCommand : public TwoImageInputOutputCommand<float32_t>, public Distributable
 	{
 	protected:
 		friend class CommandList;
 
-		FBPPreprocessCommand() : TwoImageInputOutputCommand<float32_t>("fbppreprocess", "Performs preprocessing of transmission projection data for filtered backprojection. This command is experimental and may change in the near future.",
+		FBPPreprocessCommand() : TwoImageInputOutputCommand<float32_t>("fbppreprocess", "Performs preprocessing of transmission projection data for filtered backprojection. This command is experimental and may change in the near future. In the distributed processing mode, each job preprocesses a block of consecutive projections.",
 			{
-				CommandArgument<std::string>(ParameterDirection::In, "reconstruction settings", "Settings for the reconstruction. If this string contains only a name of an existing file, the settings are read from that file. Otherwise, the string is treated as contents of the settings file.", "")
+				CommandArgument<std::string>(ParameterDirection::In, "reconstruction settings", "Settings for the reconstruction. If this string contains only a name of an existing file, the settings are read from that file. Otherwise, the string is treated as contents of the settings file.", ""),
+				CommandArgument<Distributor::BLOCK_ORIGIN_ARG_TYPE>(ParameterDirection::In, Distributor::BLOCK_ORIGIN_ARG_NAME, "Origin of current calculation block in coordinates of the full image. This argument is used internally in distributed processing. Set to zero in normal usage.", Distributor::BLOCK_ORIGIN_ARG_TYPE(0, 0, 0)),
+				CommandArgument<Vec3c>(ParameterDirection::In, "input size", "Size of the full input image. This argument is used internally in distributed processing. Set to zero in normal usage.", Vec3c(0, 0, 0))
 			},
 			"fbp")
 		{
@@ -23,15 +41,55 @@ namespace pilib
 		virtual void run(Image<float32_t>& in, Image<float32_t>& out, std::vector<ParamVariant>& args) const override
 		{
 			std::string settings = pop<std::string>(args);
+			Distributor::BLOCK_ORIGIN_ARG_TYPE origin = pop<Distributor::BLOCK_ORIGIN_ARG_TYPE>(args);
+			Vec3c inputSize = pop<Vec3c>(args);
 
-			if (fs::exists(settings))
+			RecSettings sets = internals::readRecSettings(settings);
+
+			if (inputSize == Vec3c(0, 0, 0))
 			{
-				settings = readText(settings, true);
+				fbpPreprocess(in, out, sets);
+			}
+			else
+			{
+				// The input image is a block of projections of the full data set.
+				fbpPreprocessBlock(in, origin.z, out, sets);
 			}
-			
-			RecSettings sets = fromString<RecSettings>(settings);
+		}
+
+		virtual std::vector<std::string> runDistributed(Distributor& distributor, std::vector<ParamVariant>& args) const override
+		{
+			DistributedImage<float32_t>& in = *std::get<DistributedImage<float32_t>* >(args[0]);
+			DistributedImage<float32_t>& out = *std::get<DistributedImage<float32_t>* >(args[1]);
+			RecSettings sets = internals::readRecSettings(std::get<std::string>(args[2]));
+
+			in.mustNotBe(out);
+
+			if (in.depth() != (coord_t)sets.angles.size())
+				throw ITLException("Count of projection images and count of angles do not match.");
+
+			out.ensureSize(fbpPreprocessedSize(in.dimensions(), sets));
+
+			std::vector<ParamVariant> newArgs = args;
+			newArgs[4] = in.dimensions();
 
-			fbpPreprocess(in, out, sets);
+			return distributor.distribute(this, newArgs);
+		}
+
+		virtual void getCorrespondingBlock(const std::vector<ParamVariant>& args, size_t argIndex, Vec3c& readStart, Vec3c& readSize, Vec3c& writeFilePos, Vec3c& writeImPos, Vec3c& writeSize) const override
+		{
+			if (argIndex == 0)
+			{
+				// Each block of output projections is calculated from whole input projections with the same indices.
+				DistributedImage<float32_t>& in = *std::get<DistributedImage<float32_t>* >(args[0]);
+				readStart = Vec3c(0, 0, readStart.z);
+				readSize = Vec3c(in.width(), in.height(), readSize.z);
+			}
+		}
+
+		virtual JobType getJobType(const std::vector<ParamVariant>& args) const override
+		{
+			return JobType::Slow;
 		}
 	};
 
@@ -70,15 +128,18 @@ namespace pilib
 	};
 	
 
-	class FBPCommand : public TwoImageInputOutputCommand<float32_t>
+	class FBPCommand : public TwoImageInputOutputCommand<float32_t>, public Distributable
 	{
 	protected:
 		friend class CommandList;
 
-		FBPCommand() : TwoImageInputOutputCommand<float32_t>("fbp", "Performs filtered backprojection of data for which fbppreprocess has been called. This command is experimental and may change in the near future.",
+		FBPCommand() : TwoImageInputOutputCommand<float32_t>("fbp", "Performs filtered backprojection of data for which fbppreprocess has been called. This command is experimental and may change in the near future. In the distributed processing mode, the output is divided into slabs in the z-direction, and each job reads only those rows of the projections that are needed to reconstruct its slab. The distributed jobs always run on the CPU.",
 			{
 				CommandArgument<std::string>(ParameterDirection::In, "reconstruction settings", "Settings for the reconstruction. If this string contains only a name of an existing file, the settings are read from that file. Otherwise, the string is treated as contents of the settings file.", ""),
-				CommandArgument<bool>(ParameterDirection::In, "use GPU", "Set to true to allow processing on a GPU.", true)
+				CommandArgument<bool>(ParameterDirection::In, "use GPU", "Set to true to allow processing on a GPU. If no GPU is available, the processing is done on the CPU.", true),
+				CommandArgument<Distributor::BLOCK_ORIGIN_ARG_TYPE>(ParameterDirection::In, Distributor::BLOCK_ORIGIN_ARG_NAME, "Origin of current calculation block in coordinates of the full image. This argument is used internally in distributed processing. Set to zero in normal usage.", Distributor::BLOCK_ORIGIN_ARG_TYPE(0, 0, 0)),
+				CommandArgument<Vec3c>(ParameterDirection::In, "input size", "Size of the full input image. This argument is used internally in distributed processing. Set to zero in normal usage.", Vec3c(0, 0, 0)),
+				CommandArgument<Distributor::INPUT_BLOCK_ORIGIN_ARG_TYPE>(ParameterDirection::In, Distributor::INPUT_BLOCK_ORIGIN_ARG_NAME, "Origin of the block of the input image in coordinates of the full input image. This argument is used internally in distributed processing. Set to zero in normal usage.", Distributor::INPUT_BLOCK_ORIGIN_ARG_TYPE(0, 0, 0))
 			},
 			"fbppreprocess")
 		{
@@ -89,28 +150,72 @@ namespace pilib
 		{
 			std::string settings = pop<std::string>(args);
 			bool useGPU = pop<bool>(args);
-			
+			Distributor::BLOCK_ORIGIN_ARG_TYPE origin = pop<Distributor::BLOCK_ORIGIN_ARG_TYPE>(args);
+			Vec3c inputSize = pop<Vec3c>(args);
+			Distributor::INPUT_BLOCK_ORIGIN_ARG_TYPE inputOrigin = pop<Distributor::INPUT_BLOCK_ORIGIN_ARG_TYPE>(args);
 
-			if (fs::exists(settings))
+			RecSettings sets = internals::readRecSettings(settings);
+
+			if (inputSize != Vec3c(0, 0, 0))
 			{
-				settings = readText(settings, true);
+				// The input image is the band of projection rows selected in getCorrespondingBlock for the output slab starting at origin.z.
+				// The band is not re-calculated here, as floating point results might differ between the computers running the jobs.
+				backprojectBlock(in, inputSize, inputOrigin.y, sets, out, origin.z);
+				return;
 			}
 
-			RecSettings sets = fromString<RecSettings>(settings);
-
+#if defined(USE_OPENCL)
 			if (useGPU)
 			{
-#if defined(USE_OPENCL)
-				backprojectOpenCL(in, sets, out);
-#else
-				backproject(in, sets, out);
-#endif
+				try
+				{
+					backprojectOpenCL(in, sets, out);
+					return;
+				}
+				catch (const ITLException& e)
+				{
+					// E.g. no OpenCL devices available.
+					std::cout << "Unable to use GPU for backprojection, using CPU instead. Reason: " << e.message() << std::endl;
+				}
 			}
-			else
+#endif
+
+			backproject(in, sets, out);
+		}
+
+		virtual std::vector<std::string> runDistributed(Distributor& distributor, std::vector<ParamVariant>& args) const override
+		{
+			DistributedImage<float32_t>& in = *std::get<DistributedImage<float32_t>* >(args[0]);
+			DistributedImage<float32_t>& out = *std::get<DistributedImage<float32_t>* >(args[1]);
+			RecSettings sets = internals::readRecSettings(std::get<std::string>(args[2]));
+
+			in.mustNotBe(out);
+
+			out.ensureSize(backprojectionSize(in.dimensions(), sets));
+
+			std::vector<ParamVariant> newArgs = args;
+			newArgs[5] = in.dimensions();
+
+			return distributor.distribute(this, newArgs);
+		}
+
+		virtual void getCorrespondingBlock(const std::vector<ParamVariant>& args, size_t argIndex, Vec3c& readStart, Vec3c& readSize, Vec3c& writeFilePos, Vec3c& writeImPos, Vec3c& writeSize) const override
+		{
+			if (argIndex == 0)
 			{
-				backproject(in, sets, out);
+				// Read all the projections, but only the rows that are needed for the output slab.
+				DistributedImage<float32_t>& in = *std::get<DistributedImage<float32_t>* >(args[0]);
+				RecSettings sets = internals::readRecSettings(std::get<std::string>(args[2]));
+				Vec2c rows = backprojectionRowRange(in.dimensions(), sets, readStart.z, readStart.z + readSize.z);
+				readStart = Vec3c(0, rows.x, 0);
+				readSize = Vec3c(in.width(), rows.y - rows.x, in.depth());
 			}
 		}
+
+		virtual JobType getJobType(const std::vector<ParamVariant>& args) const override
+		{
+			return JobType::Slow;
+		}
 	};
 
 	class CreateFBPFilterCommand : public Command
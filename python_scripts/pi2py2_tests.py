@@ -125,6 +125,29 @@ def test_difference_delaying(testname, script, resultname='result', tolerance=0.
 
 
 
+def test_difference_fusing(testname, script, resultname='result', tolerance=0.00001):
+    """
+    Calculates given script in local processing mode with fusing of pixelwise commands enabled and disabled.
+    Compares the results and reports errors.
+    """
+
+    outfile_normal = output_file(f"{testname}_normal")
+    outfile_fused = output_file(f"{testname}_fused")
+
+    pi2.fusing(False)
+    pi2.run_script(script)
+    pi2.writeraw(resultname, outfile_normal)
+
+    pi2.fusing(True)
+    pi2.run_script(script)
+    pi2.writeraw(resultname, outfile_fused)
+    pi2.fusing(False)
+
+    check_distribution_test_result(outfile_normal, outfile_fused, testname, 'normal and fused', tolerance)
+
+
+
+
 def test_difference_normal_distributed(opname, args, resultname='result', infile=input_file(), tolerance=0.00001, convert_to_type=ImageDataType.UNKNOWN, maxmem=15, chunk_size=[64, 64, 64], max_jobs=0):
     """
     Calculates operation normally and using distributed processing.
@@ -1299,6 +1322,9 @@ test_difference_delaying('delaying_1', f"read(img, {infile}); gaussfilter(img, o
 test_difference_delaying('delaying_2', f"read(img, {infile}); add(img, 100); crop(img, out, [0,0,0], [100, 100, 120]); subtract(out, 100);", 'out');
 test_difference_delaying('delaying_3', f"read(img, {infile}); convert(img, img32, float32); clear(img); threshold(img32, 5e-4); convert(img32, cyl, uint8); clear(img32);", 'cyl');
 test_difference_delaying('delaying_4', f"read(img, {infile}); convert(img, img32, float32); clear(img); cylindricality(img32, 0.5, 0.5); threshold(img32, 5e-4); convert(img32, cyl, uint8); clear(img32);", 'cyl', maxmem=100);
+test_difference_fusing('fusing_1', f"read(img, {infile}); convert(img, img32, float32); subtract(img32, 100); multiply(img32, 0.5); max(img32, 0); squareroot(img32); linmap(img32, 0, 30, 0, 255); convert(img32, out, uint8);", 'out');
+test_difference_fusing('fusing_2', f"read(img, {infile}); copy(img, tmp); add(tmp, 300); multiply(img, tmp); threshold(img, 20000); gaussfilter(img, out, 1); add(out, 1);", 'out');
+test_difference_fusing('fusing_3', f"read(img, {infile}); crop(img, small, [0, 0, 0], [50, 50, 50]); add(img, 10); add(small, 20); add(img, small, True); threshold(img, 300); copy(img, out);", 'out');
 
 
 